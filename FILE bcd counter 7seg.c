@@ -8,6 +8,63 @@
  ******************************************************************************/
 
 #include <LPC17xx.h>
+#include "isr_share.h"
+#include "clock.h"
+#include "seg7.h"
+#include "ram_place.h"
+
+/* Define MEASURE_IRQ_LATENCY to histogram the tick interrupt's latency and
+ * run time with the DWT cycle counter; results go out on the ITM debug
+ * channel every 10 ticks.
+ */
+#ifdef MEASURE_IRQ_LATENCY
+#include "irq_latency.h"
+#endif
+
+/* Define BOOT_PROFILE to timestamp each init phase, from the top of main()
+ * to the first digit lit, and print the timeline once on the ITM channel.
+ */
+#ifdef BOOT_PROFILE
+#include "boot_prof.h"
+#endif
+
+/* Define PERSIST_STATE to keep the count across resets and power cuts in
+ * the flash log (sectors 28-29): restored at boot, saved once per tick.
+ */
+#ifdef PERSIST_STATE
+#include "flash_log.h"
+#define TAG_BCD_COUNTER 0
+#endif
+
+/* Define CLOCK_SCALING to run at CLOCK_IDLE_HZ (4 MHz) once set up: the
+ * display loop spends its time in delays anyway. The clock manager
+ * retunes the Timer0 prescaler and the delay loops on every change, so
+ * the count still steps once a second.
+ */
+
+/* Define BITBAND_FLAGS to keep the counting direction as one bit of the
+ * bit-band flag word (AHB SRAM) and read SW2 through its FIOPIN alias:
+ * each is then a single load or store, whatever else shares the word.
+ */
+#ifdef BITBAND_FLAGS
+#include "bitband.h"
+#endif
+
+/* Define STACK_WATERMARK to paint the stack at boot and report, every 10
+ * ticks on the ITM channel, how deep it has been and how deep the stack
+ * was when the tick interrupt came in.
+ */
+#ifdef STACK_WATERMARK
+#include "stack_paint.h"
+#endif
+
+/* Define RAM_HOT to run the tick handler, update_bcd_counter() and
+ * display_digit() from SRAM, with the segment table copied there too, so
+ * they never wait for a flash line (the linker lines are in ram_place.h).
+ * Define HOT_CYCLES to time the three with the DWT cycle counter and print
+ * where each one runs and its min/mean/max cycles every 10 ticks on the
+ * ITM channel; build with and without RAM_HOT to compare.
+ */
 
 /*=============================================================================
  * HARDWARE PIN DEFINITIONS
@@ -17,9 +74,10 @@
 /* 7-SEGMENT DATA LINES: Connected to P0.4 through P0.11
  * These 8 pins control the segments (a,b,c,d,e,f,g,decimal point)
  * P0.4 = Segment a, P0.5 = Segment b, ..., P0.11 = Segment h (decimal point)
+ * Another wiring or a common anode display: change the map in seg7.h
  */
 #define DATA_PORT       LPC_GPIO0           // GPIO Port 0 for segment data
-#define DATA_MASK       0x00000FF0          // Mask for P0.4-P0.11 (bits 4-11)
+#define DATA_MASK       SEG7_MASK           // Mask for P0.4-P0.11 (bits 4-11)
                                             // Binary: 0000 0000 0000 0000 0000 1111 1111 0000
 
 /* 7-SEGMENT ENABLE LINES: Connected to P1.23 through P1.26
@@ -47,6 +105,11 @@
 #define SWITCH_PRESSED  0                   // Logic level when switch is pressed
 #define SWITCH_RELEASED 1                   // Logic level when switch is released
 
+#ifdef BITBAND_FLAGS
+#define FLAG_COUNT_UP   BB_FLAG(0)          // 1 = UP, 0 = DOWN
+#define SWITCH_BIT      BB_GPIO(LPC_GPIO2_BASE, BB_FIOPIN, 12)
+#endif
+
 /*=============================================================================
  * GLOBAL VARIABLES
  *============================================================================*/
@@ -82,60 +145,113 @@ unsigned char current_digit = 0;            // Start with first digit
  */
 unsigned int timer_accumulator = 0;         // Accumulates time for 1-second check
 
-/* 7-SEGMENT LOOKUP TABLE for BCD digits 0-9
- * Each entry defines which segments to light for that digit
- * Segment mapping: bit 0 = segment a, bit 1 = segment b, ..., bit 7 = segment h (decimal point)
+/* DELAY LOOP COUNTS
+ * Worked out from the CPU clock by calibrate_delays() at start-up (and
+ * after every clock change) instead of being fixed for 72MHz. Cycles per
+ * pass are what the old constants implied at 72MHz: 24 passes per
+ * microsecond, 10000 per millisecond.
+ */
+#define US_LOOP_CYCLES  3                   // One nop loop pass
+#define MS_LOOP_CYCLES  7                   // One volatile loop pass
+unsigned int us_loops = 24;                 // Passes per microsecond
+unsigned int ms_loops = 10000;              // Passes per millisecond
+
+/* COUNTER LOCK
+ * bcd_counter and counting_direction are written by TIMER0_IRQHandler and
+ * read by the multiplexing loop. The ISR writes them inside this seqlock
+ * and main() takes one consistent snapshot per display frame, so a tick
+ * that lands mid-refresh can no longer show a mix of old and new digits.
+ */
+seqlock_t counter_lock = { 0 };
+
+#ifdef MEASURE_IRQ_LATENCY
+irq_lat_t tick_latency;                     // TIMER0 MR0 -> handler statistics
+#endif
+#ifdef STACK_WATERMARK
+stack_isr_t tick_stack;                     // TIMER0 handler stack depths
+#endif
+#ifdef HOT_CYCLES
+ram_place_t hot_tick, hot_update, hot_digit;
+#endif
+
+/* 7-SEGMENT LOOKUP TABLE for digits 0-9 (and A-F)
+ * Each entry is the P0 word that lights that digit: seg7.h moves the
+ * glyph's segment bits to the pins in its map (a = P0.4 ... h = P0.11)
+ * and inverts them for a common anode display, all at compile time, so
+ * display_digit() writes it as is. RAM_HOT copies it to SRAM with
+ * display_digit() itself.
  * Common cathode display: Segment lights when corresponding pin is HIGH
- * Values are for active-high segments:
- *   0x3F = 00111111 = segments a,b,c,d,e,f ON for digit '0'
- *   0x06 = 00000110 = segments b,c ON for digit '1'
+ *   digit 0 = segments a,b,c,d,e,f = 0x3F -> 0x3F0 on P0.4-P0.11
+ *   digit 1 = segments b,c         = 0x06 -> 0x060
  *   etc.
  */
-const unsigned char bcd_seg_table[10] = {
-    0x3F,   // 0: segments a,b,c,d,e,f
-    0x06,   // 1: segments b,c
-    0x5B,   // 2: segments a,b,d,e,g
-    0x4F,   // 3: segments a,b,c,d,g
-    0x66,   // 4: segments b,c,f,g
-    0x6D,   // 5: segments a,c,d,f,g
-    0x7D,   // 6: segments a,c,d,e,f,g
-    0x07,   // 7: segments a,b,c
-    0x7F,   // 8: all segments a,b,c,d,e,f,g
-    0x6F    // 9: segments a,b,c,d,f,g
-};
+RAMCONST uint32_t bcd_seg_words[16] = { SEG7_HEX_WORDS };
 
 /*=============================================================================
  * FUNCTION PROTOTYPES
  *============================================================================*/
 void initialize_gpio(void);                 // Initialize all GPIO pins
 void initialize_timer0(void);               // Initialize Timer0 for 1-second interrupts
-void display_digit(unsigned char digit_position, unsigned char bcd_value); // Display one digit
+RAMFUNC void display_digit(unsigned char digit_position, unsigned char bcd_value); // Display one digit
 unsigned char extract_bcd_digit(unsigned int bcd_number, unsigned char position); // Get digit from BCD
-void update_bcd_counter(void);              // Increment/decrement BCD counter
+RAMFUNC void update_bcd_counter(void);      // Increment/decrement BCD counter
 void delay_microseconds(unsigned int us);   // Simple delay function
 void delay_milliseconds(unsigned int ms);   // Millisecond delay
+void calibrate_delays(void);                // Loop counts for the current clock
+#ifdef CLOCK_SCALING
+void timer0_clock_changed(uint32_t cclk);   // Clock manager hook
+#endif
 
 /*=============================================================================
  * TIMER0 INTERRUPT HANDLER
  * This function is called automatically by hardware every 1 second
  * when Timer0 match occurs. It updates the BCD counter.
  *============================================================================*/
-void TIMER0_IRQHandler(void) {
+RAMFUNC void TIMER0_IRQHandler(void) {
+#ifdef HOT_CYCLES
+    uint32_t hot_start = ram_place_start();
+#endif
+#ifdef MEASURE_IRQ_LATENCY
+    /* PCLK = CCLK/4, so one timer tick is 4 CPU cycles */
+    irq_lat_enter(&tick_latency, irq_lat_since_match(LPC_TIM0, 999, 4));
+#endif
+#ifdef STACK_WATERMARK
+    STACK_ISR_ENTER(&tick_stack);
+#endif
     /* Check if interrupt is from MR0 (Match Register 0) */
     if (LPC_TIM0->IR & (1 << 0)) {
         /* Clear the interrupt flag - IMPORTANT: Must clear to prevent infinite interrupts */
         LPC_TIM0->IR = (1 << 0);
         
-        /* Read switch state to determine counting direction */
+        /* Open the write window: main() retries any snapshot it overlaps */
+        seqlock_write_begin(&counter_lock);
+#ifdef BITBAND_FLAGS
+        bb_write(FLAG_COUNT_UP, bb_read(SWITCH_BIT));   // Released = count UP
+#else
         if (SWITCH_PORT->FIOPIN & SWITCH_PIN) {
             counting_direction = 1;         // Switch NOT pressed = count UP
         } else {
             counting_direction = 0;         // Switch PRESSED = count DOWN
         }
+#endif
         
         /* Update BCD counter based on direction */
+#ifdef HOT_CYCLES
+        RAM_PLACE_TIME(&hot_update, update_bcd_counter());
+#else
         update_bcd_counter();
+#endif
+        seqlock_write_end(&counter_lock);
     }
+#ifdef HOT_CYCLES
+    ram_place_stop(&hot_tick, hot_start);
+#endif
+#ifdef STACK_WATERMARK
+    STACK_ISR_EXIT(&tick_stack);
+#endif
+#ifdef MEASURE_IRQ_LATENCY
+    irq_lat_exit(&tick_latency);
+#endif
 }
 
 /*=============================================================================
@@ -144,22 +260,88 @@ void TIMER0_IRQHandler(void) {
 int main(void) {
     unsigned char i;
     unsigned char digit_value;
+    unsigned int frame_counter;             // Snapshot shown for one frame
+    uint32_t seq;
+#ifdef MEASURE_IRQ_LATENCY
+    unsigned long dumped_at = 0;            // tick_latency.count at last report
+#endif
+#ifdef PERSIST_STATE
+    uint32_t saved[FLASH_LOG_WORDS];        // Last value in the flash log
+#endif
+#ifdef STACK_WATERMARK
+    const stack_isr_t *const stack_isrs[] = { &tick_stack };
+    unsigned long stack_dumped_at = 0;      // tick_stack.count at last report
+#endif
+#ifdef HOT_CYCLES
+    ram_place_t *const hot[] = { &hot_tick, &hot_update, &hot_digit };
+    unsigned long hot_dumped_at = 0;        // hot_tick.calls at last report
+#endif
+#ifdef BOOT_PROFILE
+    unsigned char boot_reported = 0;        // Timeline printed after frame 1
+
+    boot_prof_init(BOOT_IRC_HZ);            // CPU still on the IRC here
+#endif
+#ifdef STACK_WATERMARK
+    stack_paint();                          // Before any interrupt is enabled
+    stack_isr_reset(&tick_stack, "TIMER0 tick");
+#endif
     
     /* Step 1: SYSTEM INITIALIZATION
      * Configure system clocks and peripherals
      */
     SystemInit();                           // Initialize system clock
     SystemCoreClockUpdate();                // Update system core clock variable
+    calibrate_delays();
+#ifdef BOOT_PROFILE
+    boot_prof_clock(SystemCoreClock);
+    boot_mark("SystemInit");
+#endif
     
     /* Step 2: GPIO INITIALIZATION
      * Configure data lines, enable lines, and switch
      */
     initialize_gpio();
+#ifdef BITBAND_FLAGS
+    bb_flags_init(0);                       // AHB SRAM is not cleared at reset
+    bb_write(FLAG_COUNT_UP, counting_direction);
+#endif
+#ifdef BOOT_PROFILE
+    boot_mark("gpio");
+#endif
+#ifdef PERSIST_STATE
+    flash_log_init(1);                      // Before the tick can change it
+    if (flash_log_read(TAG_BCD_COUNTER, saved)) {
+        bcd_counter = saved[0] & 0xFFFF;
+    } else {
+        saved[0] = bcd_counter;
+        saved[1] = 0;
+    }
+#ifdef BOOT_PROFILE
+    boot_mark("flash log");
+#endif
+#endif
     
     /* Step 3: TIMER INITIALIZATION
      * Configure Timer0 for 1-second interrupts
      */
+#ifdef MEASURE_IRQ_LATENCY
+    irq_lat_init();
+    irq_lat_reset(&tick_latency, "TIMER0 tick");
+#endif
+#ifdef HOT_CYCLES
+    ram_place_init();
+    ram_place_reset(&hot_tick, "TIMER0_IRQHandler", (uintptr_t)TIMER0_IRQHandler);
+    ram_place_reset(&hot_update, "update_bcd_counter", (uintptr_t)update_bcd_counter);
+    ram_place_reset(&hot_digit, "display_digit", (uintptr_t)display_digit);
+#endif
     initialize_timer0();
+#ifdef BOOT_PROFILE
+    boot_mark("timer0");
+#endif
+#ifdef CLOCK_SCALING
+    clock_on_change(timer0_clock_changed);
+    clock_set(CLOCK_IDLE_HZ);
+#endif
     
     /* Step 4: INITIAL DISPLAY CLEAR
      * Turn off all segments and digits initially
@@ -172,6 +354,26 @@ int main(void) {
      * Timer interrupts handle the 1-second counter updates
      */
     while (1) {
+        /* FRAME SNAPSHOT
+         * Copy the counter once per frame; retry if a timer tick
+         * updated it while we were copying
+         */
+        do {
+            seq = seqlock_read_begin(&counter_lock);
+            frame_counter = bcd_counter;
+        } while (seqlock_read_retry(&counter_lock, seq));
+        
+#ifdef PERSIST_STATE
+        /* SAVE each new value (once a second). Interrupts are off for
+         * about 1 ms, 100 ms when the log switches sectors (every 34 min),
+         * and the last digit shown stays lit that much longer.
+         */
+        if (frame_counter != saved[0]) {
+            saved[0] = frame_counter;
+            flash_log_write(TAG_BCD_COUNTER, saved);
+        }
+#endif
+        
         /* DISPLAY MULTIPLEXING LOOP
          * Display each digit one at a time with short persistence
          * Human eye persistence creates illusion of all digits lit simultaneously
@@ -180,10 +382,19 @@ int main(void) {
             /* Extract BCD digit from appropriate position
              * Position: 0 = thousands, 1 = hundreds, 2 = tens, 3 = units
              */
-            digit_value = extract_bcd_digit(bcd_counter, i);
+            digit_value = extract_bcd_digit(frame_counter, i);
             
             /* Display this digit on the corresponding 7-segment display */
+#ifdef HOT_CYCLES
+            RAM_PLACE_TIME(&hot_digit, display_digit(i, digit_value));
+#else
             display_digit(i, digit_value);
+#endif
+#ifdef BOOT_PROFILE
+            if (!boot_reported && i == 0) {
+                boot_mark("first digit");
+            }
+#endif
             
             /* PERSISTENCE DELAY
              * Each digit displayed for 2ms, total cycle = 8ms
@@ -197,6 +408,32 @@ int main(void) {
          * Helps with display stability
          */
         delay_microseconds(100);
+        
+#ifdef BOOT_PROFILE
+        if (!boot_reported) {
+            boot_reported = 1;
+            boot_prof_dump();
+        }
+#endif
+#ifdef MEASURE_IRQ_LATENCY
+        /* REPORT every 10 ticks over the debug channel */
+        if (tick_latency.count >= dumped_at + 10) {
+            dumped_at = tick_latency.count;
+            irq_lat_dump(&tick_latency);
+        }
+#endif
+#ifdef STACK_WATERMARK
+        if (tick_stack.count >= stack_dumped_at + 10) {
+            stack_dumped_at = tick_stack.count;
+            stack_dump(stack_isrs, 1);
+        }
+#endif
+#ifdef HOT_CYCLES
+        if (hot_tick.calls >= hot_dumped_at + 10) {
+            hot_dumped_at = hot_tick.calls;
+            ram_place_dump(hot, 3);
+        }
+#endif
     }
     
     return 0;  // Never reached, but included for completeness
@@ -237,7 +474,8 @@ void initialize_gpio(void) {
 /*=============================================================================
  * TIMER0 INITIALIZATION FUNCTION
  * Configures Timer0 to generate interrupts every 1 second
- * System clock = 72MHz, we want 1Hz interrupt
+ * The prescaler comes from the Timer0 peripheral clock, so the tick is
+ * right at whatever rate SystemInit() (or the clock manager) set
  *============================================================================*/
 void initialize_timer0(void) {
     /* Step 1: POWER UP TIMER0
@@ -254,19 +492,20 @@ void initialize_timer0(void) {
     
     /* Step 3: SET PRESCALER FOR 1ms TICK
      * PR = Prescale Register
-     * Formula: PR = (SystemClock / DesiredTickRate) - 1
-     * SystemClock = 72MHz = 72,000,000 Hz
+     * Formula: PR = (PCLK / DesiredTickRate) - 1
+     * PCLK = CCLK / 4 after reset (PCLKSEL0 bits 3:2 = 00)
      * Desired tick = 1ms = 1000Hz
-     * PR = (72,000,000 / 1000) - 1 = 71999
+     * At 100MHz: PR = (25,000,000 / 1000) - 1 = 24999
      * This gives us 1ms interrupts
      */
-    LPC_TIM0->PR = 71999;                   // 72MHz/72000 = 1KHz = 1ms
+    LPC_TIM0->PR = clock_pclk(CLOCK_PCLK_TIMER0) / 1000 - 1;
     
     /* Step 4: SET MATCH REGISTER FOR 1 SECOND
      * MR0 = Match Register 0
      * We want interrupt every 1000ms = 1000 * 1ms ticks
+     * With reset on match TC runs 0..MR0, so MR0 = 1000 - 1
      */
-    LPC_TIM0->MR0 = 1000;                   // Match every 1000ms = 1 second
+    LPC_TIM0->MR0 = 999;                    // Match every 1000ms = 1 second
     
     /* Step 5: CONFIGURE MATCH CONTROL
      * MCR = Match Control Register
@@ -304,7 +543,7 @@ void initialize_timer0(void) {
  *   digit_position: 0=thousands, 1=hundreds, 2=tens, 3=units
  *   bcd_value: 0-9 to display
  *============================================================================*/
-void display_digit(unsigned char digit_position, unsigned char bcd_value) {
+RAMFUNC void display_digit(unsigned char digit_position, unsigned char bcd_value) {
     unsigned long enable_mask = 0;
     
     /* STEP 1: DETERMINE WHICH DIGIT TO ENABLE
@@ -340,11 +579,11 @@ void display_digit(unsigned char digit_position, unsigned char bcd_value) {
      */
     DATA_PORT->FIOCLR = DATA_MASK;          // Clear all segments
     
-    /* Get segment pattern from lookup table
-     * Shift left by 4 because segments start at P0.4 (not P0.0)
-     * Mask with DATA_MASK to ensure only P0.4-P0.11 are affected
+    /* Get the port word from the lookup table
+     * Already placed on P0.4-P0.11 (and inverted if active low) by seg7.h,
+     * so no shift or mask on every refresh
      */
-    DATA_PORT->FIOSET = (bcd_seg_table[bcd_value] << 4) & DATA_MASK;
+    DATA_PORT->FIOSET = bcd_seg_words[bcd_value];
     
     /* STEP 4: ENABLE THE SELECTED DIGIT
      * This turns on the transistor that connects the common cathode to ground
@@ -384,10 +623,14 @@ unsigned char extract_bcd_digit(unsigned int bcd_number, unsigned char position)
  * Increments or decrements BCD counter with proper BCD arithmetic
  * Handles carry/borrow between digits and wrap-around
  *============================================================================*/
-void update_bcd_counter(void) {
+RAMFUNC void update_bcd_counter(void) {
     unsigned char units, tens, hundreds, thousands;
     
+#ifdef BITBAND_FLAGS
+    if (bb_read(FLAG_COUNT_UP)) {
+#else
     if (counting_direction == 1) {
+#endif
         /* COUNTING UP (INCREMENT) */
         
         /* Extract individual BCD digits */
@@ -466,10 +709,13 @@ void update_bcd_counter(void) {
 /* MICROSECOND DELAY - Approximate */
 void delay_microseconds(unsigned int us) {
     unsigned int i;
-    /* Loop count needs calibration based on clock speed
-     * Approximate: 72MHz → ~72 cycles per microsecond
+    if (DELAY_LOOP_SKIP(us * us_loops, US_LOOP_CYCLES)) {
+        return;                             // Timed by the simulator
+    }
+    /* Loop count calibrated for the clock speed (calibrate_delays)
+     * Approximate: 72MHz → ~72 cycles per microsecond, 24 passes
      */
-    for (i = 0; i < (us * 24); i++) {
+    for (i = 0; i < (us * us_loops); i++) {
         __asm("nop");                       // No operation assembly instruction
     }
 }
@@ -477,11 +723,14 @@ void delay_microseconds(unsigned int us) {
 /* MILLISECOND DELAY - Approximate */
 void delay_milliseconds(unsigned int ms) {
     unsigned int i, j;
+    if (DELAY_LOOP_SKIP(ms * ms_loops, MS_LOOP_CYCLES)) {
+        return;
+    }
     /* Nested loops for longer delays
      * Inner loop calibrated for approximately 1ms
      */
     for (i = 0; i < ms; i++) {
-        for (j = 0; j < 10000; j++) {
+        for (j = 0; j < ms_loops; j++) {
             // Empty loop - compiler may optimize away
             // Using volatile to prevent optimization
             volatile int k = 0;
@@ -490,6 +739,26 @@ void delay_milliseconds(unsigned int ms) {
     }
 }
 
+/* DELAY CALIBRATION - loop counts for the current SystemCoreClock */
+void calibrate_delays(void) {
+    us_loops = clock_loops(1, US_LOOP_CYCLES);
+    ms_loops = clock_loops(1000, MS_LOOP_CYCLES);
+}
+
+#ifdef CLOCK_SCALING
+/*=============================================================================
+ * CLOCK CHANGE HOOK
+ * Called by clock_set() with interrupts off: new Timer0 prescaler for the
+ * same 1ms tick (the current millisecond keeps its progress) and new delay
+ * loop counts
+ *============================================================================*/
+void timer0_clock_changed(uint32_t cclk) {
+    (void)cclk;
+    clock_timer_retune(LPC_TIM0, clock_pclk(CLOCK_PCLK_TIMER0), 1000);
+    calibrate_delays();
+}
+#endif
+
 /*=============================================================================
  * ALTERNATIVE: POLLING VERSION (Without Timer Interrupt)
  * Uncomment this main() function and comment out the timer interrupt
@@ -508,3 +777,4 @@ int main_polling_version(void) {
     
     while (1) {
        
+*/
@@ -7,6 +7,42 @@
  ******************************************************************************/
 
 #include <LPC17xx.h>
+#include "clock.h"                     // DELAY_LOOP_SKIP
+
+/* Build with PORT_DEBOUNCE defined to debounce SW2 with the vertical-counter
+ * debouncer (port_debounce.c) from a 5 ms SysTick instead of the delay-and-
+ * re-read check in is_button_pressed()
+ */
+#ifdef PORT_DEBOUNCE
+#include "port_debounce.h"
+#endif
+
+/* Build with PERSIST_STATE defined to keep the lit LED across resets and
+ * power cuts in the flash log (flash_log.c, sectors 28-29)
+ */
+#ifdef PERSIST_STATE
+#include "flash_log.h"
+#define TAG_RING_COUNTER 0
+#endif
+
+/* Build with BITBAND_FLAGS defined to keep the previous switch state as a
+ * bit of the bit-band flag word and to read and configure P2.12 through
+ * its FIOPIN / FIODIR aliases (bitband.h): one load or store each, no
+ * shifting or masking
+ */
+#ifdef BITBAND_FLAGS
+#include "bitband.h"
+#endif
+
+/* Build with LED_SEQ_AUTO defined (and led_sequencer.c) to let the ring run
+ * by itself at RING_STEP_HZ: TIMER2 and GPDMA copy each step into P0.4-
+ * P0.11 with no CPU work per step, and SW2 pauses or resumes the ring
+ * instead of shifting it
+ */
+#ifdef LED_SEQ_AUTO
+#include "led_sequencer.h"
+#define RING_STEP_HZ 4
+#endif
 
 // ==================== HARDWARE DEFINITIONS ====================
 
@@ -25,6 +61,14 @@
 #define SWITCH_PORT LPC_GPIO2          // Port 2 for switch
 #define SWITCH_PIN  (1 << 12)          // Bit 12 = P2.12
 
+#define DELAY_MS_LOOP_CYCLES 8         // One inner delay_ms() pass, roughly
+
+#ifdef BITBAND_FLAGS
+#define FLAG_PREV_SWITCH BB_FLAG(0)    // prev_switch_state
+#define SWITCH_BIT  BB_GPIO(LPC_GPIO2_BASE, BB_FIOPIN, 12)
+#define SWITCH_DIR  BB_GPIO(LPC_GPIO2_BASE, BB_FIODIR, 12)
+#endif
+
 // ==================== GLOBAL VARIABLES ====================
 
 /* RING COUNTER STATE
@@ -41,10 +85,31 @@ unsigned char ring_counter = 0x01;     // Initial: Only LED0 ON (binary 00000001
  */
 unsigned char prev_switch_state = 1;   // Start assuming button NOT pressed (HIGH)
 
+#ifdef LED_SEQ_AUTO
+/* HARDWARE-STEPPED RING
+ * ring_words[] is read by the GPDMA while the ring runs; ring_counter is
+ * only brought up to date when it is paused
+ */
+uint32_t ring_words[8];
+unsigned char ring_running = 0;
+#endif
+
+#ifdef PORT_DEBOUNCE
+/* PORT 2 DEBOUNCER
+ * Every pin of port 2 is debounced; SW2 (and any other switch to ground)
+ * is active-low, so it is listed in the active_low mask
+ */
+port_debounce_t port2_debounce;
+#endif
+
 // ==================== FUNCTION PROTOTYPES ====================
 void init_gpio(void);
 void update_leds(void);
 void delay_ms(unsigned int ms);
+#ifdef LED_SEQ_AUTO
+void ring_start(void);
+void ring_pause(void);
+#endif
 unsigned char is_button_pressed(void);
 
 // ==================== MAIN FUNCTION ====================
@@ -54,13 +119,47 @@ int main(void)
     
     init_gpio();                       // Setup LED and switch pins
     
+#ifdef PORT_DEBOUNCE
+    SystemCoreClockUpdate();
+    port_debounce_init(&port2_debounce, SWITCH_PIN, SWITCH_PORT->FIOPIN);
+    SysTick_Config(SystemCoreClock / 200);  // 5 ms debounce tick
+#endif
+    
+#ifdef PERSIST_STATE
+    SystemCoreClockUpdate();           // IAP needs the real CCLK
+    flash_log_init(1);
+    {
+        uint32_t saved[FLASH_LOG_WORDS];
+        if (flash_log_read(TAG_RING_COUNTER, saved) &&
+            saved[0] && saved[0] <= 0x80 && !(saved[0] & (saved[0] - 1))) {
+            ring_counter = (unsigned char)saved[0];   // One bit set: a valid state
+        }
+    }
+#endif
+    
     update_leds();                     // Display initial ring counter state
+#ifdef LED_SEQ_AUTO
+    ring_start();                      // Steps from here on need no CPU
+#endif
     
     while(1)                           // Infinite loop
     {
         /* CHECK IF BUTTON WAS PRESSED (edge detection) */
         if(is_button_pressed())
         {
+#ifdef LED_SEQ_AUTO
+            /* PAUSE OR RESUME THE RING: a pause leaves the lit LED where
+             * the last step put it, and the ring resumes from the next one
+             */
+            if(ring_running)
+            {
+                ring_pause();
+            }
+            else
+            {
+                ring_start();
+            }
+#else
             /* SHIFT THE RING COUNTER
              * Example: 00000001 → 00000010 → 00000100 → ... → 10000000 → 00000001
              */
@@ -74,9 +173,19 @@ int main(void)
             }
             
             update_leds();             // Update LEDs to show new pattern
+#endif
+            
+#ifdef PERSIST_STATE
+            {
+                uint32_t saved[FLASH_LOG_WORDS] = { ring_counter };
+                flash_log_write(TAG_RING_COUNTER, saved);   // About 1 ms
+            }
+#endif
             
+#ifndef PORT_DEBOUNCE
             /* WAIT UNTIL BUTTON IS RELEASED
-             * Prevents multiple triggers from single press
+             * Prevents multiple triggers from single press (the debouncer
+             * already reports each press once, however long it is held)
              */
             while(!(SWITCH_PORT->FIOPIN & SWITCH_PIN))
             {
@@ -84,6 +193,7 @@ int main(void)
             }
             
             delay_ms(100);             // Debounce delay after release
+#endif
         }
         
         delay_ms(10);                  // Small delay in main loop
@@ -103,7 +213,13 @@ void init_gpio(void)
     LPC_PINCON->PINSEL4 &= ~(3 << 24); // Clear bits 25:24 → GPIO mode
     
     // Second: Set as input direction
+#ifdef BITBAND_FLAGS
+    bb_clear(SWITCH_DIR);              // Bit 12 only, one store
+    bb_flags_init(0);
+    bb_write(FLAG_PREV_SWITCH, prev_switch_state);
+#else
     SWITCH_PORT->FIODIR &= ~SWITCH_PIN; // Clear bit 12 → input mode
+#endif
     
     /* 3. INITIALIZE ALL LEDS OFF */
     LED_PORT->FIOCLR = LED_MASK;       // Clear all LED pins (turn OFF)
@@ -124,7 +240,56 @@ void update_leds(void)
     LED_PORT->FIOSET = (ring_counter << 4) & LED_MASK;
 }
 
+#ifdef LED_SEQ_AUTO
+// ==================== HARDWARE-STEPPED RING ====================
+/* The pattern is rotated so that its first word, written one step period
+ * after the start, lights the LED after the current one
+ */
+void ring_start(void)
+{
+    unsigned char steps[8], led = ring_counter;
+    unsigned int i;
+    
+    for(i = 0; i < 8; i++)
+    {
+        led = (led == 0x80) ? 0x01 : (unsigned char)(led << 1);
+        steps[i] = led;
+    }
+    led_seq_from_bytes(ring_words, steps, 8, 4);
+    led_seq_start(LED_PORT, LED_MASK, ring_words, 8, RING_STEP_HZ);
+    ring_running = 1;
+}
+
+/* Stop the sequencer and read back the LED it left lit */
+void ring_pause(void)
+{
+    unsigned char leds;
+    
+    led_seq_stop();
+    leds = (unsigned char)((LED_PORT->FIOPIN & LED_MASK) >> 4);
+    if(leds && !(leds & (leds - 1)))   // One bit set: a valid state
+    {
+        ring_counter = leds;
+    }
+    update_leds();
+    ring_running = 0;
+}
+#endif
+
 // ==================== BUTTON DETECTION FUNCTION ====================
+#ifdef PORT_DEBOUNCE
+/* DEBOUNCE TICK: one FIOPIN read debounces all 32 pins of port 2 */
+void SysTick_Handler(void)
+{
+    port_debounce_tick(&port2_debounce, SWITCH_PORT->FIOPIN);
+}
+
+/* A press is reported once, however long the switch bounces or is held */
+unsigned char is_button_pressed(void)
+{
+    return (port_debounce_take_pressed(&port2_debounce) & SWITCH_PIN) != 0;
+}
+#else
 unsigned char is_button_pressed(void)
 {
     unsigned char current_state;
@@ -134,12 +299,20 @@ unsigned char is_button_pressed(void)
      * If bit is 1: switch NOT pressed (pulled high)
      * If bit is 0: switch IS pressed (connected to ground)
      */
+#ifdef BITBAND_FLAGS
+    current_state = bb_read(SWITCH_BIT);
+#else
     current_state = (SWITCH_PORT->FIOPIN >> 12) & 0x01;
+#endif
     
     /* DETECT FALLING EDGE (1→0 transition)
      * Previous was HIGH (1) AND Current is LOW (0) = Button just pressed
      */
+#ifdef BITBAND_FLAGS
+    if(bb_read(FLAG_PREV_SWITCH) && (current_state == 0))
+#else
     if((prev_switch_state == 1) && (current_state == 0))
+#endif
     {
         pressed = 1;                   // Button was pressed
         
@@ -149,7 +322,11 @@ unsigned char is_button_pressed(void)
          */
         delay_ms(20);                  // Debounce delay
         
+#ifdef BITBAND_FLAGS
+        current_state = bb_read(SWITCH_BIT);
+#else
         current_state = (SWITCH_PORT->FIOPIN >> 12) & 0x01;
+#endif
         if(current_state != 0)         // If not still low, it was noise
         {
             pressed = 0;
@@ -157,16 +334,23 @@ unsigned char is_button_pressed(void)
     }
     
     /* UPDATE PREVIOUS STATE FOR NEXT CHECK */
+#ifdef BITBAND_FLAGS
+    bb_write(FLAG_PREV_SWITCH, current_state);
+#else
     prev_switch_state = current_state;
+#endif
     
     return pressed;                    // Return 1 if pressed, 0 if not
 }
+#endif
 
 // ==================== DELAY FUNCTION ====================
 void delay_ms(unsigned int ms)
 {
     unsigned int i, j;
     
+    if (DELAY_LOOP_SKIP(ms * 10000, DELAY_MS_LOOP_CYCLES)) return;  // Timed by the simulator
+    
     /* SIMPLE SOFTWARE DELAY
      * Not precise - varies with compiler and optimization
      * But works for basic timing needs
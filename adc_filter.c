@@ -0,0 +1,120 @@
+/******************************************************************************
+ * FILE: adc_filter.c
+ * DESCRIPTION: Fixed-point streaming filters for 12-bit ADC samples
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "adc_filter.h"
+
+/*=============================================================================
+ * FILTER INITIALIZATION
+ * mode  = ADC_FILTER_OVERSAMPLE / ADC_FILTER_MOVING_AVG / ADC_FILTER_CIC
+ * shift = n
+ *   OVERSAMPLE: 4^n samples per output, output has 12+n bits
+ *   MOVING_AVG: 2^n taps, output has 12+n/2 bits, one output per sample
+ *   CIC:        decimation 2^n, 3 stages, output has 12+n/2 bits
+ *============================================================================*/
+void adc_filter_init(adc_filter_t *f, unsigned char mode, unsigned char shift) {
+    unsigned int i;
+
+    f->mode = mode;
+    f->count = 0;
+    f->acc = 0;
+    f->ring_idx = 0;
+    for (i = 0; i < (1u << ADC_MA_MAX_SHIFT); i++) {
+        f->ring[i] = 0;
+    }
+    for (i = 0; i < ADC_CIC_ORDER; i++) {
+        f->integ[i] = 0;
+        f->comb[i] = 0;
+    }
+
+    switch (mode) {
+        case ADC_FILTER_OVERSAMPLE:
+            if (shift > 6) shift = 6;           // 4096 samples, acc fits 24 bits
+            f->period = 1u << (2 * shift);
+            f->out_bits = ADC_RAW_BITS + shift;
+            break;
+        case ADC_FILTER_MOVING_AVG:
+            if (shift > ADC_MA_MAX_SHIFT) shift = ADC_MA_MAX_SHIFT;
+            f->period = 1;
+            f->out_bits = ADC_RAW_BITS + shift / 2;
+            break;
+        default:                                // ADC_FILTER_CIC
+            if (shift > ADC_CIC_MAX_SHIFT) shift = ADC_CIC_MAX_SHIFT;
+            f->period = 1u << shift;
+            f->out_bits = ADC_RAW_BITS + shift / 2;
+            break;
+    }
+    f->shift = shift;
+}
+
+/*=============================================================================
+ * PUSH ONE RAW SAMPLE
+ * Returns 1 and writes *out when the filter produced an output sample.
+ *============================================================================*/
+int adc_filter_push(adc_filter_t *f, unsigned int raw, unsigned int *out) {
+    unsigned long x;
+    unsigned int i;
+
+    raw &= (1u << ADC_RAW_BITS) - 1;
+
+    switch (f->mode) {
+    case ADC_FILTER_OVERSAMPLE:
+        /* Sum 4^n samples, keep n of the 2n extra bits (noise averages
+         * down by 2^n, so only n of them carry information)
+         */
+        f->acc += raw;
+        if (++f->count < f->period) {
+            return 0;
+        }
+        *out = (unsigned int)(f->acc >> f->shift);
+        f->acc = 0;
+        f->count = 0;
+        return 1;
+
+    case ADC_FILTER_MOVING_AVG:
+        /* Running sum: add newest, subtract the one leaving the window */
+        f->acc += raw;
+        f->acc -= f->ring[f->ring_idx];
+        f->ring[f->ring_idx] = (unsigned short)raw;
+        f->ring_idx = (f->ring_idx + 1) & ((1u << f->shift) - 1);
+        *out = (unsigned int)(f->acc >> (f->shift - (f->out_bits - ADC_RAW_BITS)));
+        return 1;
+
+    default:
+        /* CIC: integrators run at the input rate, combs at the output rate.
+         * Wrap-around in the integrators is harmless - the combs undo it
+         * as long as the final gain R^N fits in 32 bits (R^3 * 4095 < 2^32).
+         */
+        x = raw;
+        for (i = 0; i < ADC_CIC_ORDER; i++) {
+            f->integ[i] += x;
+            x = f->integ[i];
+        }
+        if (++f->count < f->period) {
+            return 0;
+        }
+        f->count = 0;
+        for (i = 0; i < ADC_CIC_ORDER; i++) {
+            unsigned long y = x - f->comb[i];
+            f->comb[i] = x;
+            x = y;
+        }
+        /* Gain is R^N = 2^(n*N); keep out_bits of result */
+        *out = (unsigned int)((x & 0xFFFFFFFFUL) >>
+                              (f->shift * ADC_CIC_ORDER - (f->out_bits - ADC_RAW_BITS)));
+        return 1;
+    }
+}
+
+/*=============================================================================
+ * MILLIVOLT SCALER
+ * Precomputes recip = vref_mv * 65536 / (2^bits - 1), rounded. The
+ * per-sample conversion is then one multiply and one shift.
+ *============================================================================*/
+void adc_mv_scale_init(adc_mv_scale_t *s, unsigned int vref_mv, unsigned char bits) {
+    unsigned long full = (1UL << bits) - 1;
+
+    s->recip = (((unsigned long)vref_mv << 16) + full / 2) / full;
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ * FILE: adc_filter.h
+ * DESCRIPTION: Fixed-point streaming filters for 12-bit ADC samples -
+ *              oversampling/decimation, running-sum moving average, CIC,
+ *              and millivolt scaling by precomputed reciprocal
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * NOTE: Only adds, subtracts and shifts on the per-sample path; the one
+ *       division (for the mV reciprocal) happens at init time.
+ ******************************************************************************/
+
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+/*=============================================================================
+ * FILTER MODES
+ *============================================================================*/
+#define ADC_FILTER_OVERSAMPLE   0   // Sum 4^n samples, >> n: +n bits, rate / 4^n
+#define ADC_FILTER_MOVING_AVG   1   // 2^n-tap boxcar, +n/2 bits, one output per input
+#define ADC_FILTER_CIC          2   // 3-stage CIC decimator, rate / 2^n
+
+#define ADC_RAW_BITS            12  // LPC1768 ADC resolution
+#define ADC_MA_MAX_SHIFT        6   // Moving average up to 64 taps
+#define ADC_CIC_ORDER           3   // Integrator/comb stages
+#define ADC_CIC_MAX_SHIFT       6   // Decimation up to 64
+
+/*=============================================================================
+ * FILTER STATE (one per ADC channel)
+ *============================================================================*/
+typedef struct {
+    unsigned char mode;             // ADC_FILTER_*
+    unsigned char shift;            // n: log2 of window / decimation factor
+    unsigned char out_bits;         // Resolution of the filter output
+    unsigned int  count;            // Samples since last output
+    unsigned int  period;           // Samples per output (decimation factor)
+    unsigned long acc;              // Oversample accumulator / MA running sum
+    unsigned short ring[1 << ADC_MA_MAX_SHIFT];  // Moving-average history
+    unsigned int  ring_idx;
+    unsigned long integ[ADC_CIC_ORDER];   // CIC integrators (mod 2^32)
+    unsigned long comb[ADC_CIC_ORDER];    // CIC comb delay elements
+} adc_filter_t;
+
+/* Millivolt scaler: mv = (code * recip + 0x8000) >> 16 */
+typedef struct {
+    unsigned long recip;            // (vref_mv << 16) / full_scale_code
+} adc_mv_scale_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void adc_filter_init(adc_filter_t *f, unsigned char mode, unsigned char shift);
+int adc_filter_push(adc_filter_t *f, unsigned int raw, unsigned int *out);
+void adc_mv_scale_init(adc_mv_scale_t *s, unsigned int vref_mv, unsigned char bits);
+
+/* Code -> millivolts, no division (inline so the hot path stays a MUL+shift) */
+static inline unsigned int adc_to_mv(const adc_mv_scale_t *s, unsigned int code) {
+    return (unsigned int)((code * s->recip + 0x8000UL) >> 16);
+}
+
+#endif /* ADC_FILTER_H */
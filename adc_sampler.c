@@ -0,0 +1,109 @@
+/******************************************************************************
+ * FILE: adc_sampler.c
+ * DESCRIPTION: Timer-paced ADC sampling into a queue (see adc_sampler.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "adc_sampler.h"
+#include "clock.h"
+
+volatile adc_sampler_t adc_sampler;
+
+#define PCONP_TIM1          (1 << 2)
+#define PCONP_ADC           (1 << 12)
+#define MCR_MR0_RESET       (1 << 1)
+#define EMR_EMC0_TOGGLE     (3 << 4)        // MAT1.0 toggles on MR0
+#define ADCR_PDN            (1 << 21)
+#define ADCR_START_MAT10    (6 << 24)       // Convert on MAT1.0 rising edge
+#define ADINTEN_GLOBAL      (1 << 8)        // Interrupt on the global DONE
+#define ADGDR_DONE          (1UL << 31)
+
+/*=============================================================================
+ * START / STOP
+ *============================================================================*/
+void adc_sampler_start(uint32_t rate_hz, const uint8_t *channels, unsigned int n) {
+    unsigned int i;
+
+    adc_sampler_stop();
+
+    /* Step 1: CHANNEL LIST AND EMPTY QUEUE */
+    if (n > ADC_SAMPLER_CHANNELS) {
+        n = ADC_SAMPLER_CHANNELS;
+    }
+    for (i = 0; i < n; i++) {
+        adc_sampler.channels[i] = channels[i];
+    }
+    adc_sampler.n_channels = (uint8_t)n;
+    adc_sampler.next = 0;
+    adc_sampler.head = adc_sampler.tail = 0;
+    adc_sampler.seq = 0;
+    adc_sampler.dropped = 0;
+    adc_sampler.rate_hz = rate_hz;
+
+    /* Step 2: ADC ARMED FOR MAT1.0, first channel selected */
+    LPC_SC->PCONP |= PCONP_ADC | PCONP_TIM1;
+    adc_sampler.adcr = (clock_adc_clkdiv() << 8) | ADCR_PDN | ADCR_START_MAT10;
+    LPC_ADC->ADINTEN = ADINTEN_GLOBAL;
+    LPC_ADC->ADCR = adc_sampler.adcr | (1UL << channels[0]);
+    NVIC_SetPriority(ADC_IRQn, 1);
+    NVIC_EnableIRQ(ADC_IRQn);
+
+    /* Step 3: TIMER1 - two matches per conversion, since MAT1.0 toggles */
+    LPC_TIM1->TCR = 0x02;                   // Hold in reset while configuring
+    LPC_TIM1->PR = 0;
+    LPC_TIM1->MR0 = clock_pclk(CLOCK_PCLK_TIMER1) / (2 * rate_hz) - 1;
+    LPC_TIM1->MCR = MCR_MR0_RESET;          // No timer interrupt at all
+    LPC_TIM1->EMR = EMR_EMC0_TOGGLE;        // MAT1.0 starts low
+    LPC_TIM1->TCR = 0x01;
+}
+
+void adc_sampler_stop(void) {
+    LPC_TIM1->TCR = 0x02;
+    LPC_TIM1->EMR = 0;
+    NVIC_DisableIRQ(ADC_IRQn);
+}
+
+/*=============================================================================
+ * QUEUE - one writer (the interrupt), one reader (main)
+ *============================================================================*/
+int adc_sampler_read(adc_sample_t *out) {
+    uint32_t tail = adc_sampler.tail;
+
+    if (tail == adc_sampler.head) {
+        return 0;
+    }
+    *out = adc_sampler.queue[tail % ADC_SAMPLER_QUEUE];
+    adc_sampler.tail = tail + 1;            // Slot free only after the copy
+    return 1;
+}
+
+unsigned int adc_sampler_pending(void) {
+    return adc_sampler.head - adc_sampler.tail;
+}
+
+/*=============================================================================
+ * ADC INTERRUPT - one per conversion
+ *============================================================================*/
+void adc_sampler_isr(void) {
+    uint32_t gdr = LPC_ADC->ADGDR;          // Reading clears DONE and the request
+    uint32_t head = adc_sampler.head;
+    uint8_t channel = adc_sampler.channels[adc_sampler.next];
+
+    if (!(gdr & ADGDR_DONE)) {
+        return;
+    }
+
+    /* Next channel for the next edge, long before it comes */
+    adc_sampler.next = (uint8_t)((adc_sampler.next + 1) % adc_sampler.n_channels);
+    LPC_ADC->ADCR = adc_sampler.adcr | (1UL << adc_sampler.channels[adc_sampler.next]);
+
+    if (head - adc_sampler.tail < ADC_SAMPLER_QUEUE) {
+        adc_sampler.queue[head % ADC_SAMPLER_QUEUE].seq = adc_sampler.seq;
+        adc_sampler.queue[head % ADC_SAMPLER_QUEUE].code = (uint16_t)((gdr >> 4) & 0xFFF);
+        adc_sampler.queue[head % ADC_SAMPLER_QUEUE].channel = channel;
+        adc_sampler.head = head + 1;
+    } else {
+        adc_sampler.dropped++;
+    }
+    adc_sampler.seq++;
+}
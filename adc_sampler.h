@@ -0,0 +1,65 @@
+/******************************************************************************
+ * FILE: adc_sampler.h
+ * DESCRIPTION: Timer-paced ADC sampling - conversions started in hardware
+ *              by a TIMER1 match output, results queued with their sample
+ *              number by the ADC interrupt
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * HARDWARE: Analog inputs on the AD0.x pins of the channels asked for
+ *           (PINSEL set by the caller). TIMER1 and MAT1.0 are used
+ *           internally; P1.22 does not need to be pinned out.
+ * OPERATION:
+ *   TIMER1 resets on MR0 and toggles MAT1.0 on each match, and ADCR START
+ *   = 110 converts on every rising edge of MAT1.0: one conversion per two
+ *   matches, at exactly rate_hz, whatever the CPU is doing. The ADC
+ *   interrupt takes the result, points SEL at the next channel of the
+ *   list (so the channels are sampled in turn, each at rate_hz / n) and
+ *   queues it. A sample's number says when it was taken: seq / rate_hz s
+ *   after adc_sampler_start(). Interrupt latency only has to stay below
+ *   one sample period; main() reads the queue whenever it gets to it.
+ ******************************************************************************/
+
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <LPC17xx.h>
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+#define ADC_SAMPLER_QUEUE       64          // Power of two
+#define ADC_SAMPLER_CHANNELS    8           // Longest channel list
+
+/*=============================================================================
+ * SAMPLES AND STATE (the queue is written by the ADC interrupt only)
+ *============================================================================*/
+typedef struct {
+    uint32_t seq;                       // Conversion number since start
+    uint16_t code;                      // 12-bit result
+    uint8_t  channel;
+} adc_sample_t;
+
+typedef struct {
+    adc_sample_t queue[ADC_SAMPLER_QUEUE];
+    uint32_t head;                      // Next slot the interrupt fills
+    uint32_t tail;                      // Next slot main() reads
+    uint32_t seq;                       // Conversions completed
+    uint32_t dropped;                   // Queue full: sample lost
+    uint32_t rate_hz;                   // Conversions per second, all channels
+    uint32_t adcr;                      // ADCR less the channel select
+    uint8_t  channels[ADC_SAMPLER_CHANNELS];
+    uint8_t  n_channels;
+    uint8_t  next;                      // Index of the channel converting
+} adc_sampler_t;
+
+extern volatile adc_sampler_t adc_sampler;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void adc_sampler_start(uint32_t rate_hz, const uint8_t *channels, unsigned int n);
+void adc_sampler_stop(void);
+int adc_sampler_read(adc_sample_t *out);    // 0 when the queue is empty
+unsigned int adc_sampler_pending(void);     // Samples queued, not yet read
+void adc_sampler_isr(void);                 // Call from ADC_IRQHandler
+
+#endif /* ADC_SAMPLER_H */
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * FILE: bitband.h
+ * DESCRIPTION: Bit-band accessors - set, clear and test one bit of a flag
+ *              word, a GPIO pin or a peripheral register with a single load
+ *              or store that no interrupt can split
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   The M3 gives every bit of 0x20000000-0x200FFFFF (AHB SRAM, GPIO) and
+ *   of 0x40000000-0x400FFFFF (APB peripherals) its own word in an alias
+ *   region 32 MB higher:
+ *       alias = region + 0x02000000 + byte offset * 32 + bit * 4
+ *   A store to the alias writes bit 0 of the value into that one bit; the
+ *   bus performs the read-modify-write as one locked transfer. A load
+ *   returns 0 or 1. BB_BIT() works the alias out with integer constant
+ *   arithmetic, so for a fixed address it is an immediate in the code.
+ *   Ordinary variables sit in the local SRAM at 0x10000000, which is NOT
+ *   bit-banded, and the linker cannot multiply a symbol's address. Flags
+ *   shared with interrupts therefore live in one word at a fixed address
+ *   in the AHB SRAM (BB_FLAGS_ADDR); each flag is a bit number in it.
+ * COST (Thumb-2, alias or word address loaded from the literal pool):
+ *     set/clear a flag   bit-band: MOVS, LDR, STR                      3
+ *                        RMW under __disable_irq(): CPSID, LDR, LDR,
+ *                          ORR/BIC, STR, CPSIE                          6
+ *                        same, keeping PRIMASK (MRS ... MSR)           7
+ *                        LDREX/STREX loop: LDR, LDREX, ORR, STREX,
+ *                          CMP, BNE                                    6 per try
+ *     test a flag        bit-band: LDR, LDR                            2
+ *                        word: LDR, LDR, UBFX (or LSLS + flags)        3
+ *   The bit-band store never masks interrupts, so it adds nothing to their
+ *   latency. A flag kept in a byte of its own and only ever stored whole
+ *   (STRB) is atomic too; bit-band is for flags that share a word with
+ *   bits other code owns, and for single register bits (FIODIR, MCR,
+ *   PCONP) that would otherwise take |= or &= ~.
+ * CAUTION: an alias store still reads and rewrites the whole register on
+ *   the bus. Never use one on a write-1-to-clear register (timer IR): it
+ *   would clear every pending flag. A FIOPIN alias store writes back the
+ *   pin levels of the other bits, as FIOPIN |= does; the FIOSET / FIOCLR
+ *   words are already one-store set and clear for outputs.
+ *   The host simulator supplies BITBAND_ALIAS_PTR / BITBAND_WORD_PTR from
+ *   sim/LPC17xx.h and models the AHB SRAM, GPIO and APB aliases.
+ ******************************************************************************/
+
+#ifndef BITBAND_H
+#define BITBAND_H
+
+#include <LPC17xx.h>
+
+#ifndef BITBAND_ALIAS_PTR
+#define BITBAND_ALIAS_PTR(alias)    ((volatile uint32_t *)(alias))
+#define BITBAND_WORD_PTR(addr)      ((volatile uint32_t *)(addr))
+#endif
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+/* Flag word: first word of AHB SRAM bank 0, which none of the labs use
+ * (Keil places variables in IRAM1 unless IRAM2 is ticked). Move it if
+ * USB or Ethernet buffers are put there. Its reset value is undefined,
+ * so bb_flags_init() must run before the first interrupt. */
+#ifndef BB_FLAGS_ADDR
+#define BB_FLAGS_ADDR       LPC_AHBRAM0_BASE
+#endif
+
+/* Register offsets inside one GPIO port */
+#define BB_FIODIR           0x00
+#define BB_FIOMASK          0x10
+#define BB_FIOPIN           0x14
+#define BB_FIOSET           0x18
+#define BB_FIOCLR           0x1C
+
+/*=============================================================================
+ * ALIAS ADDRESSES - integer constant expressions for constant arguments
+ *============================================================================*/
+#define BITBAND_ALIAS(addr, bit) \
+    (((addr) & 0xF0000000UL) + 0x02000000UL + (((addr) & 0x000FFFFFUL) << 5) + \
+     ((uint32_t)(bit) << 2))
+
+/* One bit; a struct so a plain address cannot be passed by mistake */
+typedef struct {
+    uint32_t alias;
+} bb_bit_t;
+
+#define BB_BIT(addr, bit)   ((bb_bit_t){ BITBAND_ALIAS((uint32_t)(addr), bit) })
+#define BB_FLAG(n)          BB_BIT(BB_FLAGS_ADDR, n)
+#define BB_GPIO(port_base, reg, pin) BB_BIT((port_base) + (reg), pin)
+
+/*=============================================================================
+ * ACCESSORS - one load or one store each
+ *============================================================================*/
+static inline void bb_set(bb_bit_t b) {
+    *BITBAND_ALIAS_PTR(b.alias) = 1;
+}
+
+static inline void bb_clear(bb_bit_t b) {
+    *BITBAND_ALIAS_PTR(b.alias) = 0;
+}
+
+static inline void bb_write(bb_bit_t b, uint32_t v) {
+    *BITBAND_ALIAS_PTR(b.alias) = v;    // Only bit 0 of v counts
+}
+
+static inline uint32_t bb_read(bb_bit_t b) {
+    return *BITBAND_ALIAS_PTR(b.alias); // 0 or 1
+}
+
+/* Whole flag word: start-up value, or several flags in one read */
+static inline void bb_flags_init(uint32_t value) {
+    *BITBAND_WORD_PTR(BB_FLAGS_ADDR) = value;
+}
+
+static inline uint32_t bb_flags(void) {
+    return *BITBAND_WORD_PTR(BB_FLAGS_ADDR);
+}
+
+#endif /* BITBAND_H */
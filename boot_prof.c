@@ -0,0 +1,88 @@
+/******************************************************************************
+ * FILE: boot_prof.c
+ * DESCRIPTION: Boot-time profiler (see boot_prof.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "boot_prof.h"
+#include "itm_print.h"
+
+static uint32_t base_cycles;            // CYCCNT at the last clock change
+static uint32_t base_us;                // Elapsed time at the last clock change
+static uint32_t cycles_per_us;          // Rounded up: waits may run long, never short
+
+static const char *mark_name[BOOT_PROF_MARKS];
+static uint32_t mark_us[BOOT_PROF_MARKS];
+static unsigned int marks, marks_dropped;
+
+/*=============================================================================
+ * CLOCK - elapsed microseconds across CPU clock changes
+ *============================================================================*/
+void boot_prof_init(uint32_t cpu_hz) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    base_cycles = 0;
+    base_us = 0;
+    cycles_per_us = (cpu_hz + 999999UL) / 1000000UL;
+    marks = 0;
+    marks_dropped = 0;
+}
+
+uint32_t boot_now_us(void) {
+    return base_us + (DWT->CYCCNT - base_cycles) / cycles_per_us;
+}
+
+void boot_prof_clock(uint32_t cpu_hz) {
+    uint32_t now = DWT->CYCCNT;
+
+    base_us += (now - base_cycles) / cycles_per_us;
+    base_cycles = now;
+    cycles_per_us = (cpu_hz + 999999UL) / 1000000UL;
+}
+
+/*=============================================================================
+ * MARKS
+ *============================================================================*/
+void boot_mark(const char *phase) {
+    if (marks < BOOT_PROF_MARKS) {
+        mark_name[marks] = phase;
+        mark_us[marks] = boot_now_us();
+        marks++;
+    } else {
+        marks_dropped++;
+    }
+}
+
+uint32_t boot_mark_us(const char *phase) {
+    unsigned int i;
+
+    for (i = 0; i < marks; i++) {
+        if (mark_name[i] == phase) {
+            return mark_us[i];
+        }
+    }
+    return 0;
+}
+
+/*=============================================================================
+ * DUMP over ITM stimulus port 0
+ *============================================================================*/
+void boot_prof_dump(void) {
+    unsigned int i;
+    uint32_t prev = 0;
+
+    itm_puts("BOOT      at us    phase us\r\n");
+    for (i = 0; i < marks; i++) {
+        itm_putu(mark_us[i], 12);
+        itm_putu(mark_us[i] - prev, 12);
+        itm_puts("  ");
+        itm_puts(mark_name[i]);
+        itm_puts("\r\n");
+        prev = mark_us[i];
+    }
+    if (marks_dropped) {
+        itm_putu(marks_dropped, 0);
+        itm_puts(" later marks not kept\r\n");
+    }
+}
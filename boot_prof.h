@@ -0,0 +1,41 @@
+/******************************************************************************
+ * FILE: boot_prof.h
+ * DESCRIPTION: Boot-time profiler - timestamps each init phase from the
+ *              start of main() to the first visible output, using the DWT
+ *              cycle counter, and prints the timeline over ITM
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   boot_prof_init() starts CYCCNT at the top of main(). CYCCNT counts CPU
+ *   clocks, and the CPU clock changes when SystemInit() switches from the
+ *   4 MHz IRC to the PLL. So boot_prof_clock() is called with the new rate
+ *   once it is known, and the elapsed time is kept as microseconds: the
+ *   cycles counted so far are converted at the old rate first. The time
+ *   inside SystemInit() itself is counted at the IRC rate, which is where
+ *   it starts.
+ *   A rate that is not a whole number of MHz (12.5 MHz from the clock
+ *   manager) is rounded up to one: time then reads up to 4% slow, so a
+ *   deadline can come late but never early.
+ *   Time spent before main() (startup code, .data/.bss init) is not seen.
+ *   boot_mark() costs about 20 cycles and never blocks, so it can stay in
+ *   release builds; boot_prof_dump() prints the table when convenient.
+ ******************************************************************************/
+
+#ifndef BOOT_PROF_H
+#define BOOT_PROF_H
+
+#include <LPC17xx.h>
+
+#define BOOT_PROF_MARKS     24          // Marks kept; later ones are counted only
+#define BOOT_IRC_HZ         4000000UL   // CPU clock out of reset
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void boot_prof_init(uint32_t cpu_hz);               // First line of main()
+void boot_prof_clock(uint32_t cpu_hz);              // CPU clock just changed
+uint32_t boot_now_us(void);                         // Microseconds since init
+void boot_mark(const char *phase);                  // Phase 'phase' just ended
+uint32_t boot_mark_us(const char *phase);           // Time of a mark, 0 if none
+void boot_prof_dump(void);                          // Timeline over ITM
+
+#endif /* BOOT_PROF_H */
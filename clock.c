@@ -0,0 +1,173 @@
+/******************************************************************************
+ * FILE: clock.c
+ * DESCRIPTION: Clock manager (see clock.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "clock.h"
+
+#define PLLSTAT_ENABLED     (1UL << 24)
+#define PLLSTAT_CONNECTED   (1UL << 25)
+#define PLLSTAT_LOCK        (1UL << 26)
+#define FCCO_MIN            275000000ULL
+#define FCCO_MAX            550000000ULL
+
+typedef struct {
+    uint32_t m, n, div;                 // FCCO = 2*m*Fin/n, CCLK = FCCO/div
+} pll_setting_t;
+
+static clock_hook_fn hooks[CLOCK_HOOKS];
+static unsigned int n_hooks;
+
+/*=============================================================================
+ * PLL0
+ *============================================================================*/
+static void pll_feed(void) {
+    LPC_SC->PLL0FEED = 0xAA;            // Makes PLL0CON/PLL0CFG take effect
+    LPC_SC->PLL0FEED = 0x55;
+}
+
+static uint32_t pll_input(void) {
+    switch (LPC_SC->CLKSRCSEL & 3) {
+        case 1:  return CLOCK_XTAL_HZ;
+        case 2:  return 32768UL;        // RTC oscillator
+        default: return CLOCK_IRC_HZ;
+    }
+}
+
+/* FCCO of the PLL driving the CPU now, 0 if the CPU runs straight off Fin */
+static uint64_t pll_fcco(void) {
+    uint32_t stat = LPC_SC->PLL0STAT;
+
+    if ((stat & (PLLSTAT_ENABLED | PLLSTAT_CONNECTED)) !=
+        (PLLSTAT_ENABLED | PLLSTAT_CONNECTED)) {
+        return 0;
+    }
+    return 2ULL * ((stat & 0x7FFF) + 1) * pll_input() / (((stat >> 16) & 0xFF) + 1);
+}
+
+/* Lowest FCCO giving exactly 'hz': M 6..512, N 1..32, divider 3..256 */
+static int pll_search(uint32_t hz, uint32_t fin, pll_setting_t *s) {
+    uint64_t fcco, num;
+    uint32_t div, n;
+
+    for (div = 3; div <= 256; div++) {
+        fcco = (uint64_t)hz * div;
+        if (fcco < FCCO_MIN) continue;
+        if (fcco > FCCO_MAX) break;
+        for (n = 1; n <= 32; n++) {
+            num = fcco * n;
+            if (num % (2ULL * fin) == 0 && num / (2ULL * fin) >= 6 &&
+                num / (2ULL * fin) <= 512) {
+                s->m = (uint32_t)(num / (2ULL * fin));
+                s->n = n;
+                s->div = div;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*=============================================================================
+ * CLOCK CHANGES
+ *============================================================================*/
+/* One flash access time per 20 MHz or part of it (UM10360 5.4) */
+static void flash_wait(uint32_t hz) {
+    LPC_SC->FLASHCFG = (((hz - 1) / 20000000UL) << 12) | 0x03A;
+}
+
+static void clock_changed(uint32_t hz) {
+    unsigned int i;
+
+    SystemCoreClock = hz;
+    for (i = 0; i < n_hooks; i++) {
+        hooks[i](hz);
+    }
+}
+
+/* CCLK = FCCO / div with PLL0 connected: takes effect at once */
+static uint32_t cclk_divide(uint64_t fcco, uint32_t div) {
+    uint32_t old = SystemCoreClock, hz = (uint32_t)(fcco / div);
+
+    if (hz > old) flash_wait(hz);       // Slow flash first when speeding up
+    LPC_SC->CCLKCFG = div - 1;
+    if (hz < old) flash_wait(hz);
+    clock_changed(hz);
+    return hz;
+}
+
+uint32_t clock_set(uint32_t hz) {
+    uint32_t fin;
+    uint64_t fcco;
+    pll_setting_t s;
+
+    if (hz == 0 || hz > CLOCK_MAX_HZ) {
+        return 0;
+    }
+    if (hz == SystemCoreClock) {
+        return hz;
+    }
+    __disable_irq();
+    fcco = pll_fcco();
+    if (fcco && fcco % hz == 0 && fcco / hz >= 3 && fcco / hz <= 256) {
+        cclk_divide(fcco, (uint32_t)(fcco / hz));
+        __enable_irq();
+        return hz;
+    }
+    fin = pll_input();
+    if (!pll_search(hz, fin, &s)) {
+        __enable_irq();
+        return 0;
+    }
+
+    /* UM10360 4.5.13. Between a register write and the hooks that follow
+     * it the timers count at the wrong rate; going to full speed first
+     * keeps the disconnect window to a few hundred nanoseconds (it would
+     * be tens of microseconds at Fin / 100) */
+    if (fcco) {
+        cclk_divide(fcco, (uint32_t)((fcco + CLOCK_MAX_HZ - 1) / CLOCK_MAX_HZ));
+    } else {
+        flash_wait(CLOCK_MAX_HZ);
+    }
+    LPC_SC->PLL0CON = 1;                // Disconnect
+    pll_feed();
+    LPC_SC->CCLKCFG = 0;                // CPU runs on Fin while PLL0 locks
+    clock_changed(fin);
+    LPC_SC->PLL0CON = 0;                // Disable
+    pll_feed();
+    LPC_SC->PLL0CFG = ((s.n - 1) << 16) | (s.m - 1);
+    pll_feed();
+    LPC_SC->PLL0CON = 1;                // Enable
+    pll_feed();
+    while (!(LPC_SC->PLL0STAT & PLLSTAT_LOCK));
+    LPC_SC->CCLKCFG = s.div - 1;        // Fin / div until connected
+    clock_changed(fin / s.div);
+    LPC_SC->PLL0CON = 3;                // Connect
+    pll_feed();
+    clock_changed(hz);
+    flash_wait(hz);
+    __enable_irq();
+    return hz;
+}
+
+int clock_on_change(clock_hook_fn fn) {
+    if (n_hooks >= CLOCK_HOOKS) {
+        return -1;
+    }
+    hooks[n_hooks++] = fn;
+    fn(SystemCoreClock);
+    return 0;
+}
+
+/*=============================================================================
+ * TIMER RECALIBRATION - new prescaler for the same tick rate; the prescale
+ * count is scaled too, so the tick in progress keeps its phase
+ *============================================================================*/
+void clock_timer_retune(LPC_TIM_TypeDef *tim, uint32_t pclk, uint32_t tick_hz) {
+    uint32_t old_per = tim->PR + 1, new_per = pclk / tick_hz;
+    uint32_t pc = tim->PC;
+
+    tim->PR = new_per - 1;
+    tim->PC = (uint32_t)((uint64_t)pc * new_per / old_per);
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * FILE: clock.h
+ * DESCRIPTION: Clock manager - changes the CPU clock at run time (slow while
+ *              waiting, fast for bursts of work) and has every module that
+ *              depends on it recalibrate its timer prescalers, ADC dividers
+ *              and delay loops
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   CCLK = FCCO / (CCLKCFG + 1), where PLL0 makes FCCO = 2 * M * Fin / N
+ *   (275-550 MHz) from the 12 MHz crystal or the 4 MHz IRC. SystemInit()
+ *   leaves FCCO at 400 MHz. clock_set() first tries a divider of the
+ *   running FCCO (3..256): then only CCLKCFG changes, at once and without
+ *   a relock (400 MHz gives 100, 80, 50, 25, 12.5, 4 MHz ...). Otherwise
+ *   it reprograms PLL0 with the UM10360 sequence: disconnect, disable, new
+ *   M/N, enable, wait for lock (about 100 us, CPU on Fin meanwhile),
+ *   connect. FLASHCFG gets more wait states before a speed-up and fewer
+ *   after a slow-down.
+ *   Peripherals count PCLK = CCLK / 1, 2, 4 or 8, so every clock change
+ *   moves their timing. Modules register a hook with clock_on_change();
+ *   clock_set() calls each one after every CCLK change (also the
+ *   intermediate Fin step of a relock), with interrupts still disabled,
+ *   so no ISR runs while a timer counts the new PCLK with the old
+ *   prescaler. Hooks should only rewrite a few registers and constants.
+ *   The helpers below (clock_pclk, clock_adc_clkdiv, clock_loops) only
+ *   read SystemCoreClock and PCLKSEL, so programs with a fixed clock can
+ *   use them without clock.c.
+ ******************************************************************************/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <LPC17xx.h>
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+#define CLOCK_FAST_HZ       100000000UL // LCD bursts, flash writes
+#define CLOCK_IDLE_HZ       4000000UL   // Waiting: FCCO / 100, no relock
+#define CLOCK_MAX_HZ        100000000UL // LPC1768 limit
+#define CLOCK_XTAL_HZ       12000000UL  // Board crystal (CLKSRCSEL = 1)
+#define CLOCK_IRC_HZ        4000000UL   // Internal RC (CLKSRCSEL = 0)
+#define CLOCK_HOOKS         8
+#define CLOCK_ADC_MAX_HZ    13000000UL  // ADC clock limit (UM10360 29.5.1)
+
+/* Peripheral clock selectors: bit position of the field in PCLKSEL0,
+ * or 32 + position in PCLKSEL1 */
+#define CLOCK_PCLK_TIMER0   2
+#define CLOCK_PCLK_TIMER1   4
+#define CLOCK_PCLK_ADC      24
+#define CLOCK_PCLK_TIMER2   (32 + 12)
+#define CLOCK_PCLK_TIMER3   (32 + 14)
+
+/* Called with the new CCLK after every change */
+typedef void (*clock_hook_fn)(uint32_t cclk);
+
+/*=============================================================================
+ * HELPERS - derived from the current SystemCoreClock
+ *============================================================================*/
+static inline uint32_t clock_pclk(unsigned int sel) {
+    static const uint8_t div[4] = { 4, 1, 2, 8 };
+    uint32_t reg = (sel < 32) ? LPC_SC->PCLKSEL0 : LPC_SC->PCLKSEL1;
+
+    return SystemCoreClock / div[(reg >> (sel & 31)) & 3];
+}
+
+/* ADCR CLKDIV (bits 15:8) for the fastest ADC clock within the limit */
+static inline uint32_t clock_adc_clkdiv(void) {
+    return (clock_pclk(CLOCK_PCLK_ADC) - 1) / CLOCK_ADC_MAX_HZ;
+}
+
+/* Iterations of a delay loop taking 'loop_cycles' per pass for 'us'
+ * microseconds, rounded up so the delay is never short */
+static inline uint32_t clock_loops(uint32_t us, uint32_t loop_cycles) {
+    uint64_t cycles = (uint64_t)SystemCoreClock * us;
+
+    return (uint32_t)((cycles + 1000000ull * loop_cycles - 1) / (1000000ull * loop_cycles));
+}
+
+/* First statement of a delay loop: "if (DELAY_LOOP_SKIP(n, cycles)) return;".
+ * Never true on the chip; the simulator may time the n passes itself
+ * (sim_delay_mode() in sim/sim.h) instead of running them */
+#ifndef DELAY_LOOP_SKIP
+#define DELAY_LOOP_SKIP(passes, loop_cycles)    0
+#endif
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES (clock.c)
+ *============================================================================*/
+uint32_t clock_set(uint32_t hz);                    // New CCLK, 0 = not reachable
+int clock_on_change(clock_hook_fn fn);              // Also runs fn once now
+void clock_timer_retune(LPC_TIM_TypeDef *tim, uint32_t pclk, uint32_t tick_hz);
+
+#endif /* CLOCK_H */
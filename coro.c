@@ -0,0 +1,190 @@
+/******************************************************************************
+ * FILE: coro.c
+ * DESCRIPTION: Stackless coroutine scheduler, frame arena and microsecond
+ *              clock (see coro.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "coro.h"
+#include "itm_print.h"
+
+uint32_t coro_lcd_idle_us;
+
+static uint32_t arena[(CORO_ARENA_BYTES + 3) / 4];   // Word-aligned frames
+static unsigned int arena_used;
+static coro_t *first, *last;
+
+static uint32_t last_cycles;            // CYCCNT at the last coro_now_us()
+static uint32_t spare_cycles;           // Not yet a whole microsecond
+static uint32_t now_us;
+static uint32_t cycles_per_us = 4;      // The 4 MHz IRC until coro_init()
+
+/*=============================================================================
+ * CLOCK - microseconds from CYCCNT, one call at a time
+ *============================================================================*/
+void coro_init(uint32_t cpu_hz) {
+    unsigned int k;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    last_cycles = DWT->CYCCNT;
+    spare_cycles = 0;
+    now_us = 0;
+    cycles_per_us = (cpu_hz + 999999UL) / 1000000UL;
+    coro_lcd_idle_us = 0;
+
+    for (k = 0; k < sizeof arena / sizeof arena[0]; k++) {
+        arena[k] = 0;
+    }
+    arena_used = 0;
+    first = last = 0;
+}
+
+uint32_t coro_now_us(void) {
+    uint32_t now = DWT->CYCCNT;
+    uint32_t cycles = now - last_cycles + spare_cycles;
+
+    last_cycles = now;
+    now_us += cycles / cycles_per_us;
+    spare_cycles = cycles % cycles_per_us;
+    return now_us;
+}
+
+void coro_clock(uint32_t cpu_hz) {
+    coro_now_us();                      // Cycles so far at the old rate
+    spare_cycles = 0;
+    cycles_per_us = (cpu_hz + 999999UL) / 1000000UL;
+}
+
+/*=============================================================================
+ * ARENA
+ *============================================================================*/
+coro_t *coro_spawn(coro_fn_t fn, const char *name, unsigned int frame_bytes) {
+    unsigned int words = (frame_bytes + 3) / 4;
+    coro_t *co;
+
+    if (frame_bytes < sizeof(coro_t) ||
+        arena_used + 4 * words > sizeof arena) {
+        return 0;
+    }
+    co = (coro_t *)&arena[arena_used / 4];
+    arena_used += 4 * words;
+
+    co->fn = fn;
+    co->name = name;
+    co->size = (uint16_t)frame_bytes;
+    co->pc = 0;
+    co->wait = CORO_WAIT_NONE;
+    co->next = 0;
+    if (last) {
+        last->next = co;
+    } else {
+        first = co;
+    }
+    last = co;
+    return co;
+}
+
+unsigned int coro_arena_used(void) {
+    return arena_used;
+}
+
+/*=============================================================================
+ * SCHEDULER - one pass over the list, resuming every coroutine that can go
+ * on; idle(wait) when none could. Deadlines wrap as in init_seq.h.
+ *============================================================================*/
+static int ready(coro_t *co, uint32_t now, uint32_t *wait_us) {
+    switch (co->wait) {
+    case CORO_WAIT_DELAY:
+        if ((int32_t)(co->due_us - now) > 0) {
+            if (co->due_us - now < *wait_us) {
+                *wait_us = co->due_us - now;
+            }
+            return 0;
+        }
+        return 1;
+    case CORO_WAIT_EVENT:
+        if (co->event->posted == co->event->taken) {
+            return 0;
+        }
+        co->event->taken++;
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+void coro_run(coro_idle_fn idle) {
+    for (;;) {
+        uint32_t now = coro_now_us(), wait_us = CORO_FOREVER;
+        int alive = 0, resumed = 0;
+        coro_t *co;
+
+        for (co = first; co; co = co->next) {
+            if (co->pc == CORO_PC_DONE) {
+                continue;
+            }
+            alive = 1;
+            if (!ready(co, now, &wait_us)) {
+                continue;
+            }
+            resumed = 1;
+#ifdef CORO_PROFILE
+            {
+                uint32_t start = DWT->CYCCNT, cycles;
+
+                co->fn(co);
+                cycles = DWT->CYCCNT - start;
+                if (co->resumes == 0 || cycles < co->min) co->min = cycles;
+                if (cycles > co->max) co->max = cycles;
+                co->total += cycles;
+                co->resumes++;
+            }
+#else
+            co->fn(co);
+#endif
+        }
+        if (!alive) {
+            return;
+        }
+        if (!resumed && idle) {
+            idle(wait_us);
+        }
+    }
+}
+
+/*=============================================================================
+ * DUMP over ITM stimulus port 0
+ *============================================================================*/
+#ifdef CORO_PROFILE
+void coro_dump(void) {
+    const coro_t *co;
+
+    itm_puts("CORO name            frame  resumes   min  mean   max cycles\r\n");
+    for (co = first; co; co = co->next) {
+        int pad;
+
+        itm_puts("  ");
+        itm_puts(co->name);
+        for (pad = 0; co->name[pad] && pad < 16; pad++) {
+        }
+        while (pad++ < 16) {
+            ITM_SendChar(' ');
+        }
+        itm_putu(co->size, 5);
+        itm_putu(co->resumes, 9);
+        itm_putu(co->min, 6);
+        itm_putu(co->resumes ? (unsigned long)(co->total / co->resumes) : 0, 6);
+        itm_putu(co->max, 6);
+        itm_puts("\r\n");
+    }
+    itm_puts("  arena ");
+    itm_putu(arena_used, 0);
+    itm_puts(" of ");
+    itm_putu(CORO_ARENA_BYTES, 0);
+    itm_puts(" bytes\r\n");
+}
+#else
+void coro_dump(void) {
+}
+#endif
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * FILE: coro.h
+ * DESCRIPTION: Stackless coroutines (protothread style) - a device sequence
+ *              is written as straight-line code with awaits, and a small
+ *              scheduler interleaves several of them on one stack
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * USAGE:
+ *     typedef struct {
+ *         coro_t co;                      // First member
+ *         unsigned char n;                // Locals that live across an await
+ *     } blink_frame_t;
+ *
+ *     static char blink(coro_t *co) {
+ *         blink_frame_t *f = (blink_frame_t *)co;
+ *         CORO_BEGIN(co);
+ *         for (f->n = 0; f->n < 10; f->n++) {
+ *             LPC_GPIO0->FIOPIN ^= 1 << 4;
+ *             await_delay(co, 500000);
+ *         }
+ *         CORO_END(co);
+ *     }
+ *
+ *     coro_init(SystemCoreClock);
+ *     coro_spawn(blink, "blink", sizeof(blink_frame_t));
+ *     coro_run(0);                        // Until every coroutine ends
+ * OPERATION:
+ *   CORO_BEGIN() is a switch on the line number saved at the last await,
+ *   so a resume jumps straight back there. Nothing on the C stack survives
+ *   an await: keep such values in the frame, not in local variables. Two
+ *   awaits on one source line, or an await inside a switch of the
+ *   coroutine's own, do not work.
+ *   Frames come from a static arena (CORO_ARENA_BYTES, no heap) and are
+ *   never freed; coro_spawn() returns 0 once it is full.
+ *   The scheduler checks each coroutine's wait itself and calls only those
+ *   that can go on, in spawn order. When none could, it passes the time to
+ *   the nearest deadline to the idle function, which may sleep (__WFI())
+ *   if some interrupt will wake the core in time.
+ *   Time is microseconds from the DWT cycle counter, kept by coro_now_us()
+ *   across CYCCNT wrap-around as long as it runs at least every 42 s at
+ *   100 MHz (the scheduler calls it every pass). A clock that is not a
+ *   whole number of MHz is rounded up as in boot_prof.h. CYCCNT is started
+ *   but not cleared; call coro_init() after boot_prof_init(), which clears
+ *   it.
+ *   Build with CORO_PROFILE defined to time every resume with CYCCNT;
+ *   coro_dump() prints the counts over ITM with each frame's size.
+ ******************************************************************************/
+
+#ifndef CORO_H
+#define CORO_H
+
+#include <LPC17xx.h>
+#include <stdint.h>
+
+#ifndef CORO_ARENA_BYTES
+#define CORO_ARENA_BYTES    256         // Room for all frames
+#endif
+
+#define CORO_WAITING        0           // Returned at an await
+#define CORO_DONE           1           // Returned at CORO_END()
+#define CORO_FOREVER        0xFFFFFFFFUL    // Idle: no deadline pending
+
+/*=============================================================================
+ * TYPES
+ *============================================================================*/
+/* Posted by an ISR or a coroutine, taken by one awaiting coroutine. Every
+ * post is taken once, in order, however many arrive before the await. */
+typedef struct {
+    volatile uint32_t posted;           // Written by the poster only
+    uint32_t taken;                     // Written on the awaiting side only
+} coro_event_t;
+
+typedef struct coro coro_t;
+typedef char (*coro_fn_t)(coro_t *co);  // CORO_WAITING or CORO_DONE
+typedef void (*coro_idle_fn)(uint32_t wait_us);
+
+struct coro {
+    coro_fn_t fn;
+    const char *name;
+    coro_t *next;                       // Spawn order
+    coro_event_t *event;                // CORO_WAIT_EVENT
+    uint32_t due_us;                    // CORO_WAIT_DELAY: earliest coro_now_us()
+    uint16_t pc;                        // Resume line, 0 = start, CORO_PC_DONE
+    uint16_t size;                      // Frame bytes, coro_t included
+    uint8_t wait;
+#ifdef CORO_PROFILE
+    uint32_t resumes;
+    uint32_t min, max;                  // Cycles per resume
+    unsigned long long total;
+#endif
+};
+
+#define CORO_PC_DONE        0xFFFFu
+#define CORO_WAIT_NONE      0           // Runs on the next pass
+#define CORO_WAIT_DELAY     1
+#define CORO_WAIT_EVENT     2
+
+/*=============================================================================
+ * COROUTINE BODY
+ *============================================================================*/
+#define CORO_BEGIN(co)      switch ((co)->pc) { case 0:
+#define CORO_END(co)        } (co)->pc = CORO_PC_DONE; return CORO_DONE
+
+/* Save the resume point and hand back to the scheduler */
+#define CORO_SUSPEND_(co)                                                   \
+    (co)->pc = __LINE__; return CORO_WAITING; case __LINE__:
+
+#define CORO_YIELD(co)                                                      \
+    do { (co)->wait = CORO_WAIT_NONE; CORO_SUSPEND_(co); } while (0)
+
+/* Resume no sooner than 'us' microseconds from now */
+#define await_delay(co, us)                                                 \
+    do {                                                                    \
+        (co)->due_us = coro_now_us() + (us);                                \
+        (co)->wait = CORO_WAIT_DELAY;                                       \
+        CORO_SUSPEND_(co);                                                  \
+    } while (0)
+
+/* Resume no sooner than coro_now_us() == t */
+#define await_until_us(co, t)                                               \
+    do {                                                                    \
+        (co)->due_us = (t);                                                 \
+        (co)->wait = CORO_WAIT_DELAY;                                       \
+        CORO_SUSPEND_(co);                                                  \
+    } while (0)
+
+/* Resume once 'ev' has a post this coroutine has not taken yet */
+#define await_event(co, ev)                                                 \
+    do {                                                                    \
+        (co)->event = (ev);                                                 \
+        (co)->wait = CORO_WAIT_EVENT;                                       \
+        CORO_SUSPEND_(co);                                                  \
+    } while (0)
+
+/* Resume once the HD44780 has executed the last write (coro_lcd_busy()) */
+#define await_lcd_idle(co)  await_until_us(co, coro_lcd_idle_us)
+
+/*=============================================================================
+ * LCD BUSY TIME
+ * The lab LCDs have R/W tied low, so the busy flag cannot be read. Instead
+ * the write path notes each command's datasheet execution time here.
+ *============================================================================*/
+#define CORO_LCD_EXEC_US    40          // Most instructions and data writes
+#define CORO_LCD_CLEAR_US   1640        // Clear display, return home
+
+extern uint32_t coro_lcd_idle_us;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void coro_init(uint32_t cpu_hz);                    // Clock, empty arena
+void coro_clock(uint32_t cpu_hz);                   // CPU clock just changed
+uint32_t coro_now_us(void);
+coro_t *coro_spawn(coro_fn_t fn, const char *name, unsigned int frame_bytes);
+void coro_run(coro_idle_fn idle);                   // Until all have ended
+unsigned int coro_arena_used(void);                 // Bytes
+void coro_dump(void);                               // CORO_PROFILE: over ITM
+
+static inline void coro_post(coro_event_t *ev) {
+    ev->posted++;
+}
+
+static inline int coro_lcd_idle(void) {
+    return (int32_t)(coro_now_us() - coro_lcd_idle_us) >= 0;
+}
+
+static inline void coro_lcd_busy(uint32_t us) {
+    coro_lcd_idle_us = coro_now_us() + us;
+}
+
+#endif /* CORO_H */
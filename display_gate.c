@@ -0,0 +1,81 @@
+/******************************************************************************
+ * FILE: display_gate.c
+ * DESCRIPTION: Change gate with hysteresis and max-age refresh
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "display_gate.h"
+
+/*=============================================================================
+ * GATE INITIALIZATION
+ * count      = number of values compared on each check (1-4)
+ * hysteresis = allowed drift, in the same units as the values
+ * max_age    = forced refresh interval in ticks (0 = never forced)
+ *============================================================================*/
+void display_gate_init(display_gate_t *g, unsigned char count,
+                       unsigned int hysteresis, unsigned long max_age) {
+    unsigned char i;
+
+    if (count > DISPLAY_GATE_MAX_VALUES) {
+        count = DISPLAY_GATE_MAX_VALUES;
+    }
+    g->count = count;
+    g->hysteresis = hysteresis;
+    g->max_age = max_age;
+    g->valid = 0;
+    for (i = 0; i < DISPLAY_GATE_MAX_VALUES; i++) {
+        g->shown[i] = 0;
+    }
+    g->last_update = 0;
+    g->samples = 0;
+    g->updates = 0;
+}
+
+/*=============================================================================
+ * CHECK A NEW READING
+ * Returns 1 when the caller should redraw; the gate then records 'values'
+ * as the ones on screen. Returns 0 when the change is inside the band.
+ * 'now' is a free-running tick count (wrap-around safe).
+ *============================================================================*/
+int display_gate_check(display_gate_t *g, const unsigned int *values,
+                       unsigned long now) {
+    unsigned char i;
+    unsigned int delta;
+    int redraw = 0;
+
+    g->samples++;
+
+    if (!g->valid) {
+        redraw = 1;                         // Nothing shown yet
+    } else if (g->max_age != 0 && (now - g->last_update) >= g->max_age) {
+        redraw = 1;                         // Screen too old
+    } else {
+        for (i = 0; i < g->count; i++) {
+            delta = (values[i] > g->shown[i]) ? (values[i] - g->shown[i])
+                                              : (g->shown[i] - values[i]);
+            if (delta > g->hysteresis) {
+                redraw = 1;
+                break;
+            }
+        }
+    }
+
+    if (redraw) {
+        for (i = 0; i < g->count; i++) {
+            g->shown[i] = values[i];
+        }
+        g->valid = 1;
+        g->last_update = now;
+        g->updates++;
+    }
+    return redraw;
+}
+
+/*=============================================================================
+ * SKIP A READING
+ * For a reading the caller will not redraw for another reason (e.g. work
+ * pending): counted in 'samples', the values on screen are unchanged.
+ *============================================================================*/
+void display_gate_skip(display_gate_t *g) {
+    g->samples++;
+}
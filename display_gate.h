@@ -0,0 +1,40 @@
+/******************************************************************************
+ * FILE: display_gate.h
+ * DESCRIPTION: Change gate for display updates - a new reading is only
+ *              shown when it leaves a hysteresis band around the value on
+ *              screen, or when the screen is older than a maximum age
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#ifndef DISPLAY_GATE_H
+#define DISPLAY_GATE_H
+
+#define DISPLAY_GATE_MAX_VALUES 4       // Values tracked per gate
+
+/*=============================================================================
+ * GATE STATE
+ * shown[]   = values currently on the display
+ * samples   = readings offered to the gate, including skipped ones
+ * updates   = readings that actually triggered a redraw
+ *============================================================================*/
+typedef struct {
+    unsigned int  hysteresis;           // Redraw when |new - shown| > hysteresis
+    unsigned long max_age;              // Redraw at least every max_age ticks
+    unsigned char count;                // Number of values in use
+    unsigned char valid;                // 0 until the first redraw
+    unsigned int  shown[DISPLAY_GATE_MAX_VALUES];
+    unsigned long last_update;          // Tick of the last redraw
+    unsigned long samples;
+    unsigned long updates;
+} display_gate_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void display_gate_init(display_gate_t *g, unsigned char count,
+                       unsigned int hysteresis, unsigned long max_age);
+int display_gate_check(display_gate_t *g, const unsigned int *values,
+                       unsigned long now);
+void display_gate_skip(display_gate_t *g);
+
+#endif /* DISPLAY_GATE_H */
@@ -0,0 +1,217 @@
+/******************************************************************************
+ * FILE: flash_log.c
+ * DESCRIPTION: Wear-levelled flash log (see flash_log.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "flash_log.h"
+
+static uint32_t latest[FLASH_LOG_TAGS][FLASH_LOG_WORDS];   // RAM copy of each value
+static uint8_t known[FLASH_LOG_TAGS];
+static unsigned int n_tags;
+
+static unsigned int active;             // Sector being appended to
+static unsigned int next_slot;
+static uint32_t next_seq;
+
+static uint32_t page[64];               // One 256-byte copy, word aligned
+
+/*=============================================================================
+ * RECORDS
+ *============================================================================*/
+static uint16_t crc16(const uint8_t *p, unsigned int n, uint16_t crc) {
+    unsigned int i;
+
+    while (n--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t rec_check(const flash_log_rec_t *r) {
+    uint16_t crc = crc16((const uint8_t *)&r->seq, 6, 0xFFFF);  // seq + tag
+
+    return crc16((const uint8_t *)r->value, sizeof r->value, crc);
+}
+
+static uint32_t slot_addr(unsigned int sector, unsigned int slot) {
+    return iap_sector_addr(sector) + slot * sizeof(flash_log_rec_t);
+}
+
+static void rec_read(unsigned int sector, unsigned int slot, flash_log_rec_t *r) {
+    *r = *(const flash_log_rec_t *)FLASH_PTR(slot_addr(sector, slot));
+}
+
+static int rec_blank(const flash_log_rec_t *r) {
+    uint32_t ones = r->seq & r->tag & r->check & 0xFFFFu;
+    unsigned int i;
+
+    for (i = 0; i < FLASH_LOG_WORDS; i++) {
+        ones &= r->value[i];
+    }
+    return r->seq == 0xFFFFFFFFu && ones == 0xFFFFu;
+}
+
+static int rec_valid(const flash_log_rec_t *r) {
+    return !rec_blank(r) && r->check == rec_check(r);
+}
+
+/* Program one record; the rest of its 256-byte page is sent as 0xFF */
+static uint32_t rec_write(unsigned int sector, unsigned int slot, uint16_t tag,
+                          const uint32_t *value) {
+    flash_log_rec_t *r;
+    uint32_t addr = slot_addr(sector, slot);
+    unsigned int i;
+
+    for (i = 0; i < 64; i++) {
+        page[i] = 0xFFFFFFFFu;
+    }
+    r = (flash_log_rec_t *)&page[(addr & 0xFF) / 4];
+    r->seq = next_seq++;
+    r->tag = tag;
+    for (i = 0; i < FLASH_LOG_WORDS; i++) {
+        r->value[i] = value[i];
+    }
+    r->check = rec_check(r);
+    return iap_copy(sector, addr & ~0xFFu, page, sizeof page);
+}
+
+static int header_read(unsigned int sector, flash_log_rec_t *h) {
+    rec_read(sector, 0, h);
+    return rec_valid(h) && h->tag == FLASH_LOG_HEADER && h->value[0] == FLASH_LOG_MAGIC;
+}
+
+/*=============================================================================
+ * SECTOR SWITCH - erase the other sector, copy the live values, header last
+ *============================================================================*/
+static uint32_t start_sector(unsigned int sector) {
+    static const uint32_t magic[FLASH_LOG_WORDS] = { FLASH_LOG_MAGIC };
+    uint32_t status = iap_erase(sector, sector);
+    unsigned int tag, slot = 1;
+
+    for (tag = 0; tag < n_tags && status == IAP_CMD_SUCCESS; tag++) {
+        if (known[tag]) {
+            status = rec_write(sector, slot++, (uint16_t)tag, latest[tag]);
+        }
+    }
+    if (status == IAP_CMD_SUCCESS) {
+        status = rec_write(sector, 0, FLASH_LOG_HEADER, magic);
+    }
+    if (status == IAP_CMD_SUCCESS) {
+        active = sector;
+        next_slot = slot;
+    }
+    return status;
+}
+
+/*=============================================================================
+ * BOOT RECOVERY
+ *============================================================================*/
+uint32_t flash_log_init(unsigned int tags) {
+    flash_log_rec_t ha, hb, r;
+    int va = header_read(FLASH_LOG_SECTOR_A, &ha);
+    int vb = header_read(FLASH_LOG_SECTOR_B, &hb);
+    unsigned int lo, hi, slot, tag, i, found = 0, seq_found = 0;
+
+    n_tags = (tags < FLASH_LOG_TAGS) ? tags : FLASH_LOG_TAGS;
+    for (tag = 0; tag < FLASH_LOG_TAGS; tag++) {
+        known[tag] = 0;
+    }
+    if (!va && !vb) {                   // Blank, or never finished formatting
+        next_seq = 0;
+        return start_sector(FLASH_LOG_SECTOR_A);
+    }
+    if (va && (!vb || (int32_t)(ha.seq - hb.seq) > 0)) {
+        active = FLASH_LOG_SECTOR_A;
+        next_seq = ha.seq + 1;
+    } else {
+        active = FLASH_LOG_SECTOR_B;
+        next_seq = hb.seq + 1;
+    }
+
+    // Written slots form a prefix: binary search for the first blank one
+    lo = 1;
+    hi = FLASH_LOG_SLOTS;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        rec_read(active, mid, &r);
+        if (rec_blank(&r)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    next_slot = lo;
+
+    // Newest first: the first valid record of each tag is its value. The
+    // CRC is only worked out for records that can still change the result
+    for (slot = next_slot - 1; slot >= 1 && found < n_tags; slot--) {
+        rec_read(active, slot, &r);
+        if (seq_found && (r.tag >= n_tags || known[r.tag])) {
+            continue;                   // Older than what we have
+        }
+        if (!rec_valid(&r)) {
+            continue;                   // Torn by a power cut
+        }
+        if (!seq_found && (int32_t)(r.seq - next_seq) >= 0) {
+            next_seq = r.seq + 1;
+        }
+        seq_found = 1;
+        if (r.tag < n_tags && !known[r.tag]) {
+            for (i = 0; i < FLASH_LOG_WORDS; i++) {
+                latest[r.tag][i] = r.value[i];
+            }
+            known[r.tag] = 1;
+            found++;
+        }
+    }
+    return IAP_CMD_SUCCESS;
+}
+
+/*=============================================================================
+ * READ / WRITE
+ *============================================================================*/
+int flash_log_read(unsigned int tag, uint32_t *value) {
+    unsigned int i;
+
+    if (tag >= n_tags || !known[tag]) {
+        return 0;
+    }
+    for (i = 0; i < FLASH_LOG_WORDS; i++) {
+        value[i] = latest[tag][i];
+    }
+    return 1;
+}
+
+uint32_t flash_log_write(unsigned int tag, const uint32_t *value) {
+    uint32_t status;
+    unsigned int i;
+
+    if (tag >= n_tags) {
+        return FLASH_LOG_BAD_TAG;
+    }
+    if (known[tag]) {
+        for (i = 0; i < FLASH_LOG_WORDS && latest[tag][i] == value[i]; i++);
+        if (i == FLASH_LOG_WORDS) {
+            return IAP_CMD_SUCCESS;     // Unchanged: no flash wear
+        }
+    }
+    if (next_slot >= FLASH_LOG_SLOTS) {
+        status = start_sector(active == FLASH_LOG_SECTOR_A ? FLASH_LOG_SECTOR_B
+                                                           : FLASH_LOG_SECTOR_A);
+        if (status != IAP_CMD_SUCCESS) {
+            return status;
+        }
+    }
+    status = rec_write(active, next_slot++, (uint16_t)tag, value);
+    if (status == IAP_CMD_SUCCESS) {
+        for (i = 0; i < FLASH_LOG_WORDS; i++) {
+            latest[tag][i] = value[i];
+        }
+        known[tag] = 1;
+    }
+    return status;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * FILE: flash_log.h
+ * DESCRIPTION: Wear-levelled flash log - keeps a few small values (counter
+ *              states) across resets and power cuts in a reserved pair of
+ *              flash sectors, written through IAP
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   Each write appends one 16-byte record (one flash ECC line) holding a
+ *   sequence number, the value's tag, the value and a CRC-16. Slot 0 of a
+ *   sector is its header. When the active sector is full, the other one is
+ *   erased, the latest record of every tag is copied into it, and its
+ *   header is written last: a sector without a valid header is never
+ *   trusted, so a power cut during the switch leaves the old sector in
+ *   charge. A write cut short leaves a record whose CRC fails; it is
+ *   skipped and the previous value of that tag stays current.
+ *   Boot recovery (flash_log_init) reads the two headers, finds the end of
+ *   the active sector by binary search (12 reads) and scans back from there
+ *   until every tag is found. Compaction puts the live values at the front,
+ *   so the scan never leaves the active sector; only a tag that was never
+ *   written makes it reach slot 1. A CRC is computed only for the records
+ *   that can still change the result (about one per tag).
+ * WEAR: a write whose value is unchanged costs nothing. Otherwise each
+ *   sector takes (2047 - live tags) writes to fill, so at one write per
+ *   second each sector is erased about every 68 minutes (21 times a day):
+ *   10 000 erase cycles (datasheet minimum) last about 1.3 years, 100 000
+ *   (typical) about 13. Writing less often stretches that in proportion.
+ * TIMING: a write stalls the CPU with interrupts off for about 1 ms, a
+ *   sector switch for about 100 ms more (the erase). Call from main, not
+ *   from a handler.
+ ******************************************************************************/
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <LPC17xx.h>
+#include "iap.h"
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+#ifndef FLASH_LOG_SECTOR_A
+#define FLASH_LOG_SECTOR_A  28          // 0x00070000 - keep out of the program
+#define FLASH_LOG_SECTOR_B  29          // 0x00078000   (both must be 32 KB)
+#endif
+#define FLASH_LOG_TAGS      4           // Values kept, tags 0..FLASH_LOG_TAGS-1
+#define FLASH_LOG_WORDS     2           // 32-bit words per value
+
+#define FLASH_LOG_SLOTS     (0x8000 / 16)
+#define FLASH_LOG_HEADER    0xFFFE      // Tag of a sector header
+#define FLASH_LOG_MAGIC     0x464C4F47  // "FLOG" in a header's value[0]
+
+#define FLASH_LOG_BAD_TAG   0x100       // Status: tag out of range
+
+/* One record = one 16-byte flash line */
+typedef struct {
+    uint32_t seq;                       // Write order; all ones = blank slot
+    uint16_t tag;
+    uint16_t check;                     // CRC-16 of seq, tag and value
+    uint32_t value[FLASH_LOG_WORDS];
+} flash_log_rec_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES - statuses are IAP codes (0 = IAP_CMD_SUCCESS)
+ *============================================================================*/
+uint32_t flash_log_init(unsigned int tags);                 // Boot: recover
+int flash_log_read(unsigned int tag, uint32_t *value);      // 0 = never written
+uint32_t flash_log_write(unsigned int tag, const uint32_t *value);
+
+#endif /* FLASH_LOG_H */
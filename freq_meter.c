@@ -0,0 +1,158 @@
+/******************************************************************************
+ * FILE: freq_meter.c
+ * DESCRIPTION: Frequency / period measurement engine on TIMER0 capture
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "freq_meter.h"
+
+volatile freq_meter_t freq_meter;
+
+#define TIM0_IR_CR1     (1 << 5)        // Capture channel 1 interrupt flag
+#define CCR_CAP1_RISE   (1 << 3)        // Capture on CAP0.1 rising edge
+#define CCR_CAP1_INT    (1 << 5)        // Interrupt on CAP0.1 capture
+#define CTCR_COUNT_CAP1 ((1 << 2) | 1)  // Counter mode, rising edges of CAP0.1
+
+/*=============================================================================
+ * ENGINE INITIALIZATION
+ *============================================================================*/
+void fm_init(unsigned char auto_range) {
+    /* Step 1: POWER UP TIMER0, RUN IT FROM CCLK (PCLKSEL0 bits 3:2 = 01)
+     * for the finest timestamp resolution
+     */
+    LPC_SC->PCONP |= (1 << 1);
+    LPC_SC->PCLKSEL0 = (LPC_SC->PCLKSEL0 & ~(3 << 2)) | (1 << 2);
+    freq_meter.pclk = SystemCoreClock;
+
+    /* Step 2: ROUTE P1.27 TO CAP0.1 (PINSEL3 bits 23:22 = 11) */
+    LPC_PINCON->PINSEL3 |= (3 << 22);
+
+    /* Step 3: START IN RECIPROCAL MODE */
+    freq_meter.auto_range = auto_range;
+    freq_meter.freq_chz = 0;
+    freq_meter.readings = 0;
+    fm_set_mode(FM_MODE_RECIPROCAL);
+
+    /* Step 4: CAPTURE INTERRUPT. Timestamps are latched by hardware, so
+     * its latency does not affect accuracy.
+     */
+    NVIC_SetPriority(TIMER0_IRQn, 1);
+    NVIC_EnableIRQ(TIMER0_IRQn);
+
+    /* Step 5: SYSTICK GATE ABOVE THE CAPTURE INTERRUPT. An input faster
+     * than the capture ISR keeps TIMER0 permanently pending; the gate must
+     * still preempt it to publish a result and switch to gated mode.
+     */
+    SysTick_Config(SystemCoreClock / 1000 * FM_GATE_MS);
+    NVIC_SetPriority(SysTick_IRQn, 0);
+}
+
+/*=============================================================================
+ * MODE SELECTION - reprograms TIMER0 and restarts the measurement window
+ *============================================================================*/
+void fm_set_mode(unsigned char mode) {
+    LPC_TIM0->TCR = 0x02;                   // Hold in reset while reconfiguring
+    LPC_TIM0->PR = 0;                       // One tick per PCLK (or per edge)
+    LPC_TIM0->MCR = 0;                      // No match events, TC free-runs
+    LPC_TIM0->IR = 0x3F;                    // Clear stale flags
+
+    if (mode == FM_MODE_GATED) {
+        LPC_TIM0->CCR = 0;                  // No per-edge interrupts
+        LPC_TIM0->CTCR = CTCR_COUNT_CAP1;   // TC counts input edges
+    } else {
+        LPC_TIM0->CTCR = 0;                 // Timer mode
+        LPC_TIM0->CCR = CCR_CAP1_RISE | CCR_CAP1_INT;
+    }
+
+    freq_meter.mode = mode;
+    freq_meter.edges = 0;
+    freq_meter.gates = 0;
+    freq_meter.gate_edges = 0;
+    freq_meter.last_count = 0;
+    LPC_TIM0->TCR = 0x01;
+}
+
+/*=============================================================================
+ * CAPTURE INTERRUPT - reciprocal mode only; kept minimal because its
+ * duration sets the highest rate that can be timestamped
+ *============================================================================*/
+void fm_capture_isr(void) {
+    unsigned int t;
+
+    if (LPC_TIM0->IR & TIM0_IR_CR1) {
+        LPC_TIM0->IR = TIM0_IR_CR1;
+        t = LPC_TIM0->CR1;
+        if (freq_meter.edges == 0) {
+            freq_meter.t_first = t;
+        }
+        freq_meter.t_last = t;
+        freq_meter.edges++;
+    }
+}
+
+/*=============================================================================
+ * GATE INTERRUPT - computes a result every FM_GATE_MS and switches range
+ *============================================================================*/
+void fm_gate_isr(void) {
+    unsigned long long num;
+    unsigned int span, count;
+    unsigned long hz;
+
+    freq_meter.gates++;
+
+    if (freq_meter.mode == FM_MODE_GATED) {
+        /* GATED: edges counted by hardware over exactly one gate */
+        count = LPC_TIM0->TC;
+        hz = (count - freq_meter.last_count) * (1000 / FM_GATE_MS);
+        freq_meter.last_count = count;
+        freq_meter.freq_chz = hz * 100;
+        freq_meter.readings++;
+        if (freq_meter.auto_range && hz < FM_SWITCH_DOWN_HZ) {
+            fm_set_mode(FM_MODE_RECIPROCAL);
+        }
+        return;
+    }
+
+    /* RECIPROCAL: need two edges to measure at least one period.
+     * The window simply stays open across gates for slow inputs; the
+     * timeout only runs while no new edge arrives, so periods up to
+     * FM_TIMEOUT_GATES gates long are still measured.
+     */
+    if (freq_meter.edges != freq_meter.gate_edges) {
+        freq_meter.gate_edges = freq_meter.edges;
+        freq_meter.gates = 0;
+    }
+    if (freq_meter.edges < 2) {
+        if (freq_meter.gates >= FM_TIMEOUT_GATES) {
+            freq_meter.freq_chz = 0;        // Input stopped
+            freq_meter.readings++;
+            freq_meter.gates = 0;
+            freq_meter.edges = 0;
+            freq_meter.gate_edges = 0;
+        }
+        return;
+    }
+
+    __disable_irq();                        // Consistent edges/t_first/t_last
+    span = freq_meter.t_last - freq_meter.t_first;
+    num = (unsigned long long)(freq_meter.edges - 1) * freq_meter.pclk * 100;
+    freq_meter.t_first = freq_meter.t_last; // Next window starts at last edge
+    freq_meter.edges = 1;
+    freq_meter.gate_edges = 1;
+    __enable_irq();
+
+    freq_meter.freq_chz = (unsigned long)((num + span / 2) / span);
+    freq_meter.readings++;
+    freq_meter.gates = 0;
+
+    if (freq_meter.auto_range && freq_meter.freq_chz / 100 > FM_SWITCH_UP_HZ) {
+        fm_set_mode(FM_MODE_GATED);
+    }
+}
+
+/*=============================================================================
+ * LATEST FREQUENCY in whole Hz (rounded)
+ *============================================================================*/
+unsigned long fm_read_hz(void) {
+    return (freq_meter.freq_chz + 50) / 100;
+}
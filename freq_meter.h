@@ -0,0 +1,66 @@
+/******************************************************************************
+ * FILE: freq_meter.h
+ * DESCRIPTION: Frequency / period measurement engine on TIMER0 capture
+ *              input CAP0.1 with automatic reciprocal <-> gated switching
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * HARDWARE: Input pulse train on P1.27 (CAP0.1). CAP0.0 (P1.26) is not
+ *           used because it is the DIGIT_4 enable line of the 7-segment
+ *           display.
+ * OPERATION:
+ *   RECIPROCAL mode (low frequencies): TIMER0 free-runs at CCLK and every
+ *   rising edge is timestamped into CR1 by the capture interrupt. At each
+ *   gate tick f = (edges - 1) / (t_last - t_first), so resolution is one
+ *   timer tick over the whole measurement window, independent of f.
+ *   GATED mode (high frequencies): TIMER0 becomes a counter clocked by
+ *   CAP0.1 itself, so there is no interrupt per edge. f = counts per gate.
+ *   The gate is SysTick (FM_GATE_MS). The engine switches to gated above
+ *   FM_SWITCH_UP_HZ and back below FM_SWITCH_DOWN_HZ (hysteresis).
+ ******************************************************************************/
+
+#ifndef FREQ_METER_H
+#define FREQ_METER_H
+
+#include <LPC17xx.h>
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+#define FM_CAP_PORT         1           // P1.27 = CAP0.1
+#define FM_CAP_BIT          27
+#define FM_GATE_MS          100         // SysTick gate period
+#define FM_TIMEOUT_GATES    20          // No edge for 2 s -> report 0 Hz
+#define FM_SWITCH_UP_HZ     20000       // Reciprocal -> gated above this
+#define FM_SWITCH_DOWN_HZ   10000       // Gated -> reciprocal below this
+
+#define FM_MODE_RECIPROCAL  0
+#define FM_MODE_GATED       1
+
+/*=============================================================================
+ * ENGINE STATE (written in the interrupts, read by main)
+ *============================================================================*/
+typedef struct {
+    unsigned char mode;                 // FM_MODE_*
+    unsigned char auto_range;           // 0 = stay in the current mode
+    unsigned long pclk;                 // TIMER0 clock in Hz
+    unsigned long edges;                // Edges in the current window
+    unsigned int  t_first;              // Capture time of first edge in window
+    unsigned int  t_last;               // Capture time of latest edge
+    unsigned int  last_count;           // Gated mode: TC at previous gate
+    unsigned int  gates;                // Gates since the last edge arrived
+    unsigned long gate_edges;           // 'edges' seen at the previous gate
+    unsigned long freq_chz;             // Latest result in centi-Hz (fits 25 MHz)
+    unsigned long readings;             // Results published so far
+} freq_meter_t;
+
+extern volatile freq_meter_t freq_meter;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void fm_init(unsigned char auto_range);     // Timer, capture pin and SysTick gate
+void fm_set_mode(unsigned char mode);       // Force a measurement mode
+void fm_capture_isr(void);                  // Call from TIMER0_IRQHandler
+void fm_gate_isr(void);                     // Call from SysTick_Handler
+unsigned long fm_read_hz(void);             // Latest frequency, whole Hz
+
+#endif /* FREQ_METER_H */
@@ -0,0 +1,208 @@
+/******************************************************************************
+ * FILE: freq_meter_7seg.c
+ * DESCRIPTION: 4-digit frequency meter on the 7-segment display using the
+ *              capture-input engine in freq_meter.c
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * HARDWARE: Signal input on P1.27 (CAP0.1), 3.3 V logic levels.
+ *           Display wiring as in bcd_counter_7seg.c.
+ * DISPLAY FORMAT (the decimal points tell the range apart):
+ *   " 0.60"    below 10 Hz      -> Hz with two decimals
+ *   "9999"     10 Hz - 9999 Hz  -> whole Hz, no decimal point
+ *   "47.00"    10 kHz - 99.99   -> kHz, point after digit 2
+ *   "250.0"    100 - 999.9 kHz  -> kHz, point after digit 3
+ *   "4.50."    1 - 9.99 MHz     -> MHz, extra point on digit 4 marks MHz
+ *   "12.5."    10 MHz and up    -> MHz, extra point on digit 4 marks MHz
+ ******************************************************************************/
+
+#include <LPC17xx.h>
+#include "freq_meter.h"
+#include "seg7.h"
+
+/*=============================================================================
+ * HARDWARE PIN DEFINITIONS
+ * Based on ALS-SDA-ARMCTXM3-01 Board
+ *============================================================================*/
+#define DATA_PORT       LPC_GPIO0           // Segments a-h on P0.4-P0.11
+#define DATA_MASK       SEG7_MASK           // Pin map in seg7.h
+#define ENABLE_PORT     LPC_GPIO1           // Digit enables on P1.23-P1.26
+#define ENABLE_ALL      0x07800000
+
+#define SEG_BLANK       SEG7_WORD(SEG7_GLYPH_BLANK)
+
+/*=============================================================================
+ * GLOBAL VARIABLES
+ *============================================================================*/
+
+/* SEGMENT PORT WORDS currently shown, digit 1 (leftmost) first */
+uint32_t display_segments[4] = { SEG_BLANK, SEG_BLANK, SEG_BLANK, SEG7_WORD(SEG7_GLYPH_0) };
+
+/* 7-SEGMENT PORT WORDS for digits 0-9, A-F (seg7.h, built at compile time) */
+const uint32_t bcd_seg_words[16] = { SEG7_HEX_WORDS };
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void initialize_gpio(void);
+void format_frequency(unsigned long freq_chz);
+void display_pattern(unsigned char digit_position, uint32_t word);
+void delay_milliseconds(unsigned int ms);
+
+/*=============================================================================
+ * INTERRUPT HANDLERS - the measurement engine does all the work
+ *============================================================================*/
+void TIMER0_IRQHandler(void) {
+    fm_capture_isr();                       // One CAP0.1 edge timestamp
+}
+
+void SysTick_Handler(void) {
+    fm_gate_isr();                          // Publish a result every gate
+}
+
+/*=============================================================================
+ * MAIN FUNCTION - Program entry point
+ *============================================================================*/
+int main(void) {
+    unsigned long shown_readings = 0;
+    unsigned char i;
+
+    /* Step 1: SYSTEM INITIALIZATION */
+    SystemInit();
+    SystemCoreClockUpdate();
+
+    /* Step 2: DISPLAY LINES */
+    initialize_gpio();
+
+    /* Step 3: MEASUREMENT ENGINE with automatic range switching */
+    fm_init(1);
+
+    /* Step 4: MULTIPLEX FOREVER, reformatting only when a new result is in */
+    while (1) {
+        if (freq_meter.readings != shown_readings) {
+            shown_readings = freq_meter.readings;
+            format_frequency(freq_meter.freq_chz);
+        }
+
+        for (i = 0; i < 4; i++) {
+            display_pattern(i, display_segments[i]);
+            delay_milliseconds(2);          // 8 ms frame = 125 Hz refresh
+        }
+    }
+
+    return 0;
+}
+
+/*=============================================================================
+ * GPIO INITIALIZATION FUNCTION
+ *============================================================================*/
+void initialize_gpio(void) {
+    LPC_GPIO0->FIODIR |= DATA_MASK;         // Segment lines as outputs
+    LPC_GPIO1->FIODIR |= ENABLE_ALL;        // Digit enables as outputs
+    LPC_PINCON->PINSEL3 &= ~(0xFF << 14);   // P1.23-P1.26 as GPIO
+
+    DATA_PORT->FIOCLR = DATA_MASK;
+    ENABLE_PORT->FIOCLR = ENABLE_ALL;
+}
+
+/*=============================================================================
+ * FORMAT FREQUENCY FUNCTION
+ * Picks the range, scales the value to four digits and places the decimal
+ * point(s). See the table in the file header.
+ * Parameter: freq_chz - frequency in hundredths of a Hz
+ *============================================================================*/
+void format_frequency(unsigned long freq_chz) {
+    unsigned long value;
+    unsigned char dp_digit;                 // Digit carrying the point, 4 = none
+    unsigned char mhz = 0;
+    unsigned char lead_blank;               // Leading zeros that may be blanked
+    signed char i;
+
+    if (freq_chz < 1000UL) {                // < 10 Hz: " d.dd"
+        value = freq_chz;
+        dp_digit = 1;
+        lead_blank = 1;
+    } else if (freq_chz < 1000000UL) {      // < 10 kHz: "dddd"
+        value = (freq_chz + 50) / 100;
+        dp_digit = 4;
+        lead_blank = 3;
+    } else if (freq_chz < 10000000UL) {     // < 100 kHz: "dd.dd" kHz
+        value = (freq_chz + 500) / 1000;
+        dp_digit = 1;
+        lead_blank = 0;
+    } else if (freq_chz < 100000000UL) {    // < 1 MHz: "ddd.d" kHz
+        value = (freq_chz + 5000) / 10000;
+        dp_digit = 2;
+        lead_blank = 0;
+    } else if (freq_chz < 1000000000UL) {   // < 10 MHz: "d.dd." MHz
+        value = (freq_chz + 500000) / 1000000;
+        dp_digit = 1;
+        lead_blank = 1;
+        mhz = 1;
+    } else {                                // "dd.d." MHz
+        value = (freq_chz + 5000000) / 10000000;
+        dp_digit = 1;
+        lead_blank = 1;
+        mhz = 1;
+    }
+
+    /* MHz formats use three digits, right-aligned before the unit point */
+    if (mhz) {
+        if (value > 999) {
+            value = 999;
+        }
+        for (i = 2; i >= 0; i--) {
+            display_segments[i + 1] = bcd_seg_words[value % 10];
+            value /= 10;
+        }
+        display_segments[0] = SEG_BLANK;
+        if (freq_chz >= 1000000000UL) {     // Two digits before the point
+            display_segments[0] = display_segments[1];
+            display_segments[1] = display_segments[2];
+            display_segments[2] = display_segments[3];
+            display_segments[3] = SEG_BLANK;
+        }
+        display_segments[dp_digit] = SEG7_WITH_DP(display_segments[dp_digit]);
+        display_segments[3] = SEG7_WITH_DP(display_segments[3]);   // Unit marker
+        return;
+    }
+
+    if (value > 9999) {                     // Rounding carried past 4 digits
+        value = 9999;
+    }
+    for (i = 3; i >= 0; i--) {
+        display_segments[i] = bcd_seg_words[value % 10];
+        value /= 10;
+    }
+
+    /* Blank leading zeros, never past the point or the last digit */
+    for (i = 0; i < lead_blank && display_segments[i] == bcd_seg_words[0]; i++) {
+        display_segments[i] = SEG_BLANK;
+    }
+    if (dp_digit < 4) {
+        display_segments[dp_digit] = SEG7_WITH_DP(display_segments[dp_digit]);
+    }
+}
+
+/*=============================================================================
+ * DISPLAY PATTERN FUNCTION
+ * Shows a segment port word on one digit (position 0 = leftmost)
+ *============================================================================*/
+void display_pattern(unsigned char digit_position, uint32_t word) {
+    ENABLE_PORT->FIOCLR = ENABLE_ALL;       // Only one digit on at a time
+    DATA_PORT->FIOCLR = DATA_MASK;
+    DATA_PORT->FIOSET = word;               // Already on P0.4-P0.11
+    ENABLE_PORT->FIOSET = 0x00800000UL << digit_position;   // P1.23 + position
+}
+
+/*=============================================================================
+ * MILLISECOND DELAY - Approximate
+ *============================================================================*/
+void delay_milliseconds(unsigned int ms) {
+    unsigned int i, j;
+
+    for (i = 0; i < ms; i++) {
+        for (j = 0; j < 10000; j++) {
+            volatile int k = 0;
+            k = k + 1;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * FILE: iap.h
+ * DESCRIPTION: In-Application Programming - erase and program the on-chip
+ *              flash from the running program through the boot ROM
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   The boot ROM entry at 0x1FFF1FF1 takes a command array and fills a
+ *   result array whose first word is the status (UM10360 chapter 32).
+ *   Sectors must be prepared right before every erase or copy. Flash
+ *   cannot be read while a command runs, so interrupts (whose vectors and
+ *   handlers are in flash) are disabled around each call: about 1 ms per
+ *   256-byte copy and 100 ms per erase. The ROM also uses the top 32 bytes
+ *   of local RAM, so the stack must stay below 0x10007FE0.
+ *   Copy takes 256/512/1024/4096 bytes from word-aligned RAM to a 256-byte
+ *   aligned flash address. Each 16-byte flash line has its own ECC, so a
+ *   line may be programmed only once between erases; lines sent as all
+ *   0xFF are left alone, which lets a 256-byte page fill up a line at a
+ *   time.
+ *   FLASH_PTR() turns a flash address into a pointer for reading; the
+ *   host simulator maps both this and IAP_ENTRY onto its flash model.
+ ******************************************************************************/
+
+#ifndef IAP_H
+#define IAP_H
+
+#include <LPC17xx.h>
+
+#ifndef IAP_ENTRY
+#define IAP_ENTRY           ((void (*)(uint32_t *, uint32_t *))0x1FFF1FF1)
+#endif
+#ifndef FLASH_PTR
+#define FLASH_PTR(addr)     ((const void *)(addr))
+#endif
+
+/*=============================================================================
+ * COMMANDS AND STATUS CODES
+ *============================================================================*/
+#define IAP_PREPARE         50
+#define IAP_COPY_RAM        51
+#define IAP_ERASE           52
+#define IAP_BLANK_CHECK     53
+
+#define IAP_CMD_SUCCESS     0
+#define IAP_INVALID_COMMAND 1
+#define IAP_SRC_ADDR_ERROR  2
+#define IAP_DST_ADDR_ERROR  3
+#define IAP_COUNT_ERROR     6
+#define IAP_INVALID_SECTOR  7
+#define IAP_SECTOR_NOT_BLANK 8
+#define IAP_NOT_PREPARED    9
+#define IAP_BUSY            11
+
+/*=============================================================================
+ * SECTOR MAP - sectors 0-15 are 4 KB, sectors 16-29 are 32 KB
+ *============================================================================*/
+static inline uint32_t iap_sector_addr(unsigned int sector) {
+    return (sector < 16) ? sector << 12 : 0x10000u + ((sector - 16) << 15);
+}
+
+static inline uint32_t iap_sector_size(unsigned int sector) {
+    return (sector < 16) ? 0x1000u : 0x8000u;
+}
+
+/*=============================================================================
+ * CALLS - each returns the IAP status
+ *============================================================================*/
+static inline uint32_t iap_call(uint32_t *command) {
+    uint32_t result[5];
+
+    __disable_irq();
+    IAP_ENTRY(command, result);
+    __enable_irq();
+    return result[0];
+}
+
+static inline uint32_t iap_prepare(unsigned int first, unsigned int last) {
+    uint32_t command[5] = { IAP_PREPARE, first, last };
+
+    return iap_call(command);
+}
+
+static inline uint32_t iap_erase(unsigned int first, unsigned int last) {
+    uint32_t command[5] = { IAP_ERASE, first, last, SystemCoreClock / 1000 };
+    uint32_t status = iap_prepare(first, last);
+
+    return status ? status : iap_call(command);
+}
+
+/* 'src' must be word aligned (and static when run on the host simulator) */
+static inline uint32_t iap_copy(unsigned int sector, uint32_t dst,
+                                const void *src, uint32_t bytes) {
+    uint32_t command[5] = { IAP_COPY_RAM, dst, (uint32_t)(uintptr_t)src, bytes,
+                            SystemCoreClock / 1000 };
+    uint32_t status = iap_prepare(sector, sector);
+
+    return status ? status : iap_call(command);
+}
+
+#endif /* IAP_H */
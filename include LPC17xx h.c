@@ -1,23 +1,16 @@
 #include <LPC17xx.h>
+#include "clock.h"
 
 // Function prototypes
 void delay_ms(unsigned int ms);
 void display_BCD(unsigned int count);
 void init_timer0(void);
 
-// 7-segment display patterns for BCD (0-9, common cathode)
-const unsigned char seg_pattern[10] = {
-    0x3F, // 0
-    0x06, // 1
-    0x5B, // 2
-    0x4F, // 3
-    0x66, // 4
-    0x6D, // 5
-    0x7D, // 6
-    0x07, // 7
-    0x7F, // 8
-    0x6F  // 9
-};
+// 7-segment port words for 0-9 (and A-F), common cathode, segments a-g
+// on P1.0-P1.6 and the point on P1.7: generated by seg7.h at compile time
+#define SEG7_FIRST_PIN 0
+#include "seg7.h"
+const uint32_t seg_pattern[16] = { SEG7_HEX_WORDS };
 
 int main(void) {
     unsigned int counter = 9999;  // Start from 9999 (4-digit BCD max)
@@ -26,14 +19,15 @@ int main(void) {
     // Initialize GPIO for 7-segment display
     // Assuming segment pins on PORT1 (P1.0 to P1.6 for segments a-g, P1.7 for decimal point)
     // Assuming digit select pins on PORT2 (P2.0 to P2.3 for digits 1-4)
-    LPC_GPIO1->FIODIR = 0xFF;  // Set P1.0-P1.7 as output for segments
+    LPC_GPIO1->FIODIR = SEG7_MASK;  // Set P1.0-P1.7 as output for segments
     LPC_GPIO2->FIODIR = 0x0F;  // Set P2.0-P2.3 as output for digit selection
     
+    SystemInit();  // Initialize system clock (before anything is timed)
+    SystemCoreClockUpdate();
+    
     // Initialize Timer0 for delay
     init_timer0();
     
-    SystemInit();  // Initialize system clock
-    
     while(1) {
         // Extract BCD digits
         digit1 = (counter / 1000) % 10;    // Thousands digit
@@ -63,10 +57,10 @@ void init_timer0(void) {
     // Reset Timer0
     LPC_TIM0->TCR = 0x02;
     
-    // Set prescaler for 1ms tick (assuming 72MHz system clock)
-    // Prescaler = System Clock / (1000 * desired frequency in Hz)
-    // For 1ms: 72000000 / (1000 * 1) = 72000
-    LPC_TIM0->PR = 72000 - 1;  // Timer increments every 1ms
+    // Set prescaler for 1ms tick from the Timer0 clock (CCLK/4 after reset)
+    // Prescaler = Timer0 clock / (1000 * desired frequency in Hz)
+    // For 1ms at 100MHz: 25000000 / (1000 * 1) = 25000
+    LPC_TIM0->PR = clock_pclk(CLOCK_PCLK_TIMER0) / 1000 - 1;  // Timer increments every 1ms
     
     // Reset timer
     LPC_TIM0->TCR = 0x01;
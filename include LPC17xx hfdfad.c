@@ -1,16 +1,113 @@
 #include <LPC17xx.h>
+#include <stdio.h>
+#include "adc_filter.h"
+#include "adc_sampler.h"
+#include "display_gate.h"
+#include "clock.h"          // DELAY_LOOP_SKIP
+
+// Each displayed value averages 4^ADC_OS_BITS conversions: +ADC_OS_BITS bits
+#define ADC_OS_BITS   2
+#define ADC_VREF_MV   3300
+
+// Sampling is paced in hardware: TIMER1 MAT1.0 starts each conversion and
+// the ADC interrupt queues it (adc_sampler.c), CH4 and CH5 in turn, so each
+// channel is sampled at ADC_SAMPLE_RATE_HZ / 2 whatever the LCD is doing.
+// The LCD is only redrawn when a value moves more than DISP_HYST_MV or the
+// screen is older than DISP_MAX_AGE_MS
+#define ADC_SAMPLE_RATE_HZ 2000
+#define DISP_HYST_MV      4
+#define DISP_MAX_AGE_MS   2000
+
+// Build with DIFF_BAR defined (and lcd_glyph.c) to draw the difference as
+// a bar in the 6 cells after "CH4:xxxxmV" on the top line, 30 steps over
+// 0..ADC_VREF_MV; only the partial cell is a CGRAM glyph (lcd_glyph.c).
+// The bar goes out on its own pass after the text, so neither burst of
+// LCD writes outlasts the 32 ms the sample queue holds
+#ifdef DIFF_BAR
+#include "lcd_glyph.h"
+#define DIFF_BAR_COL      10
+#define DIFF_BAR_CELLS    6
+#endif
+
+// Build with PC_PROFILE defined to sample the PC at about 1 kHz from TIMER3
+// (pc_prof.c) and print the histogram over ITM every 10 s, for
+// sim/pc_prof_report to symbolise
+#ifdef PC_PROFILE
+#include "pc_prof.h"
+#define PC_PROF_RATE_HZ   1000
+#define PC_PROF_DUMP_MS   10000
+#endif
+
+// Build with STACK_WATERMARK defined to paint the stack at boot and print
+// its high-water mark (and the SysTick handler's share) over ITM every 10 s
+#ifdef STACK_WATERMARK
+#include "stack_paint.h"
+#define STACK_DUMP_MS     10000
+stack_isr_t systick_stack;
+stack_isr_t adc_stack;
+#endif
+
+volatile unsigned long ms_ticks = 0;     // 1 ms system tick
+display_gate_t disp_gate;                // samples vs. updates counters live here
+static const uint8_t adc_channels[2] = { 4, 5 };
+
+void SysTick_Handler(void) {
+#ifdef STACK_WATERMARK
+    STACK_ISR_ENTER(&systick_stack);
+#endif
+    ms_ticks++;
+#ifdef STACK_WATERMARK
+    STACK_ISR_EXIT(&systick_stack);
+#endif
+}
+
+void ADC_IRQHandler(void) {
+#ifdef STACK_WATERMARK
+    STACK_ISR_ENTER(&adc_stack);
+#endif
+    adc_sampler_isr();
+#ifdef STACK_WATERMARK
+    STACK_ISR_EXIT(&adc_stack);
+#endif
+}
+
+void lcd_delay(unsigned int r);
+#define LCD_DELAY_LOOP_CYCLES 8  // One lcd_delay() pass, roughly
+
+// LCD on the shared transport: 4-bit bus P0.23-P0.26, RS P0.27, EN P0.28
+#define LCD_BUS_PULSE_DELAY()  lcd_delay(25)
+#define LCD_BUS_SETTLE_DELAY() lcd_delay(5000)
+#include "lcd_bus.h"
+
+void lcd_delay(unsigned int r) {
+    if (DELAY_LOOP_SKIP(r, LCD_DELAY_LOOP_CYCLES)) return;
+    for(volatile unsigned int i=0; i<r; i++);
+}
+
+void lcd_cmd(unsigned char cmd) {
+    lcd_bus_write(cmd, 0);
+}
+
+void lcd_data(unsigned char data) {
+    lcd_bus_write(data, 1);
+}
 
 void lcd_init() {
     // LCD initialization commands (4-bit mode)
-    unsigned char init_cmds[] = {0x30,0x30,0x30,0x20,0x28,0x0C,0x06,0x01,0x80};
+    static const unsigned char init_cmds[] = {0x30,0x30,0x30,0x20,0x28,0x0C,0x06,0x01,0x80};
+    lcd_bus_init();
     for(int i=0; i<9; i++) {
-        // Send each command to LCD
+        // 0x30/0x20 are sent as a single high nibble while still in 8-bit mode
+        if(i < 4)
+            lcd_bus_transfer(init_cmds[i] >> 4, 0);
+        else
+            lcd_cmd(init_cmds[i]);
     }
 }
 
 void lcd_puts(char *str) {
     while(*str) {
-        // Send character to LCD
+        lcd_data(*str);
         str++;
     }
 }
@@ -18,14 +115,34 @@ void lcd_puts(char *str) {
 void lcd_gotoxy(int x, int y) {
     // Set LCD cursor position
     unsigned char addr = (y==0) ? (0x80+x) : (0xC0+x);
-    // Send command to LCD
+    lcd_cmd(addr);
 }
 
 int main(void) {
     unsigned int adc_ch4, adc_ch5, diff;
-    char buffer[16];
+    unsigned int raw4 = 0, raw5;
+    unsigned int shown[3];
+    adc_sample_t sample;
+    char buffer[20];
+    adc_filter_t filt4, filt5;
+#ifdef DIFF_BAR
+    int bar_due = 0;
+#endif
+    adc_mv_scale_t mv;
+#ifdef PC_PROFILE
+    unsigned long next_dump;
+#endif
+#ifdef STACK_WATERMARK
+    const stack_isr_t *const stack_isrs[] = { &systick_stack, &adc_stack };
+    unsigned long next_stack_dump;
+    
+    stack_paint();                       // Before any interrupt is enabled
+    stack_isr_reset(&systick_stack, "SysTick");
+    stack_isr_reset(&adc_stack, "ADC");
+#endif
     
     SystemInit();
+    SystemCoreClockUpdate();
     
     // 1. Power up ADC
     LPC_SC->PCONP |= (1 << 12);
@@ -35,32 +152,97 @@ int main(void) {
     
     // 3. Initialize LCD
     lcd_init();
+#ifdef DIFF_BAR
+    glyph_cache_init();
+#endif
+    
+    // 4. Filters: oversample + decimate, mV reciprocal for the output width
+    adc_filter_init(&filt4, ADC_FILTER_OVERSAMPLE, ADC_OS_BITS);
+    adc_filter_init(&filt5, ADC_FILTER_OVERSAMPLE, ADC_OS_BITS);
+    adc_mv_scale_init(&mv, ADC_VREF_MV, filt4.out_bits);
+    
+    // 5. Display gate + 1 ms tick, then the sampler (ADC clock <= 13 MHz)
+    display_gate_init(&disp_gate, 3, DISP_HYST_MV, DISP_MAX_AGE_MS);
+    SysTick_Config(SystemCoreClock / 1000);
+    adc_sampler_start(ADC_SAMPLE_RATE_HZ, adc_channels, 2);
+#ifdef PC_PROFILE
+    pc_prof_start(PC_PROF_RATE_HZ);
+    next_dump = ms_ticks + PC_PROF_DUMP_MS;
+#endif
+#ifdef STACK_WATERMARK
+    next_stack_dump = ms_ticks + STACK_DUMP_MS;
+#endif
     
     while(1) {
-        // 4. Read ADC channel 4
-        LPC_ADC->ADCR = (1<<4) | (1<<21) | (1<<24);  // Start CH4
-        while((LPC_ADC->ADGDR & (1<<31)) == 0);      // Wait for conversion
-        adc_ch4 = (LPC_ADC->ADGDR >> 4) & 0xFFF;     // Get 12-bit result
+        // 6. Sleep until a sample is queued (any interrupt wakes the core)
+        while(!adc_sampler_read(&sample))
+            __WFI();
+#ifdef PC_PROFILE
+        if((long)(ms_ticks - next_dump) >= 0) {
+            next_dump += PC_PROF_DUMP_MS;
+            pc_prof_dump();
+            pc_prof_reset();
+        }
+#endif
+#ifdef STACK_WATERMARK
+        if((long)(ms_ticks - next_stack_dump) >= 0) {
+            next_stack_dump += STACK_DUMP_MS;
+            stack_dump(stack_isrs, 2);
+        }
+#endif
+        
+        // 7. CH4 is taken first; a pair is complete with its CH5
+        if(sample.channel == 4) {
+            raw4 = sample.code;
+            continue;
+        }
         
-        // 5. Read ADC channel 5
-        LPC_ADC->ADCR = (1<<5) | (1<<21) | (1<<24);  // Start CH5
-        while((LPC_ADC->ADGDR & (1<<31)) == 0);
-        adc_ch5 = (LPC_ADC->ADGDR >> 4) & 0xFFF;
+        // 8. CH5, half a sample period after the CH4 just kept
+        raw5 = sample.code;
         
-        // 6. Calculate difference (absolute value)
+        // 9. Filter; both channels decimate in lock-step
+        adc_filter_push(&filt4, raw4, &adc_ch4);
+        if(!adc_filter_push(&filt5, raw5, &adc_ch5))
+            continue;                                // Output not ready yet
+        
+        // 10. Scale to millivolts and take the difference (absolute value)
+        adc_ch4 = adc_to_mv(&mv, adc_ch4);
+        adc_ch5 = adc_to_mv(&mv, adc_ch5);
         diff = (adc_ch5 > adc_ch4) ? (adc_ch5 - adc_ch4) : (adc_ch4 - adc_ch5);
         
-        // 7. Display on LCD
+        // 11. Only format and redraw when something visibly changed, and
+        //     not while samples wait: a redraw takes ~22 ms, so a backlog
+        //     is worked off first and the screen shows the newest value;
+        //     a skipped reading still counts as a gate sample
+        if(adc_sampler_pending()) {
+            display_gate_skip(&disp_gate);
+            continue;
+        }
+#ifdef DIFF_BAR
+        if(bar_due) {
+            bar_due = 0;
+            display_gate_skip(&disp_gate);
+            lcd_bargraph(0, DIFF_BAR_COL, DIFF_BAR_CELLS, diff, ADC_VREF_MV);
+            continue;
+        }
+#endif
+        shown[0] = adc_ch4;
+        shown[1] = adc_ch5;
+        shown[2] = diff;
+        if(!display_gate_check(&disp_gate, shown, ms_ticks))
+            continue;
+        
+        // 12. Display on LCD (values in mV, each line fits 16 characters)
         lcd_gotoxy(0, 0);
-        sprintf(buffer, "CH4:%04d", adc_ch4);
+        sprintf(buffer, "CH4:%04umV", adc_ch4);
         lcd_puts(buffer);
         
         lcd_gotoxy(0, 1);
-        sprintf(buffer, "CH5:%04d DIFF:%04d", adc_ch5, diff);
+        sprintf(buffer, "CH5:%04u D:%04u", adc_ch5, diff);
         lcd_puts(buffer);
-        
-        // 8. Delay before next reading
-        for(int i=0; i<1000000; i++);
+#ifdef DIFF_BAR
+        bar_due = 1;                     // With the next filter output
+#endif
     }
     
     return 0;
@@ -1,6 +1,8 @@
 #include <LPC17xx.h>
 #include <stdio.h>
 #include <string.h>
+#include "clock.h"  // DELAY_LOOP_SKIP
+#include "ram_place.h"  // RAMCONST
 
 // LCD Control Pins (Change according to your connection)
 #define LCD_DATA_PORT LPC_GPIO0  // PORT0 for data pins D0-D7
@@ -9,6 +11,27 @@
 #define RW (1 << 17)             // P1.17
 #define EN (1 << 18)             // P1.18
 
+// Shared LCD transport: 8-bit bus on P0.0-P0.7, RS/RW/EN on port 1
+// (RS is on a different port from the data, so it costs one extra store)
+#define LCD_BUS_WIDTH       8
+#define LCD_DATA_PORTNUM    0
+#define LCD_DATA_GPIO       LCD_DATA_PORT
+#define LCD_DATA_SHIFT      0
+#define LCD_CTRL_PORTNUM    1
+#define LCD_CTRL_GPIO       LCD_CTRL_PORT
+#define LCD_RS_BIT          16
+#define LCD_RW_BIT          17
+#define LCD_EN_BIT          18
+#ifdef CORO_KEYPAD
+// EN pulse from lcd_bus.h (lcd_bus_spin(25)); no settle time after it,
+// LCD_Command() / LCD_Data() wait for the controller instead
+#define LCD_BUS_SETTLE_DELAY()  ((void)0)
+#else
+#define LCD_BUS_PULSE_DELAY()   delay_ms(1)
+#define LCD_BUS_SETTLE_DELAY()  delay_ms(1)
+#endif
+#define DELAY_MS_LOOP_CYCLES    8   // One inner delay_ms() pass, roughly
+
 // Keypad definitions
 #define KEYPAD_PORT LPC_GPIO2
 #define ROW1 (1 << 19)  // P2.19
@@ -33,15 +56,80 @@ int BCD_To_Decimal(unsigned char bcd);
 unsigned char Decimal_To_BCD(int decimal);
 void Display_Result(int result);
 
+#include "lcd_bus.h"
+
+// Build with PERSIST_STATE defined to keep the last expression and result
+// across resets in the flash log (flash_log.c, sectors 28-29)
+#ifdef PERSIST_STATE
+#include "flash_log.h"
+#define TAG_LAST_CALC 0
+#endif
+
+// Build with PC_PROFILE defined to sample the PC at about 1 kHz from TIMER3
+// (pc_prof.c) and print the histogram over ITM after each result, for
+// sim/pc_prof_report to symbolise
+#ifdef PC_PROFILE
+#include "pc_prof.h"
+#define PC_PROF_RATE_HZ 1000
+#endif
+
+// Build with STACK_WATERMARK defined to paint the stack at boot and print
+// its high-water mark over ITM after each result (sprintf and the nested
+// LCD_* calls are the deep paths)
+#ifdef STACK_WATERMARK
+#include "stack_paint.h"
+#endif
+
+// Build with CORO_KEYPAD defined to run the keypad scan and the expression
+// entry as two coroutines (coro.c) instead of Get_Expression()'s blocking
+// loop. The scan posts each key as soon as it is pressed and awaits the row
+// settle time and the release instead of spinning in delay_ms(); the entry
+// takes keys from it with await_event() and awaits the LCD before each
+// echo. A 10 kHz SysTick wakes the core from __WFI() while nothing is due.
+// Keys pressed while a result is shown are dropped, as before; so is a key
+// that finds KEY_QUEUE keys still unread (counted in keys_dropped).
+#ifdef CORO_KEYPAD
+#include "coro.h"
+#define KEY_SETTLE_US   10000   // Per row, the old delay_ms(10)
+#define KEY_POLL_US     10000   // Release check while a key is held
+#define KEY_QUEUE       4       // Keys posted, not yet taken
+#define WAKE_TICK_HZ    10000   // __WFI() only for waits longer than a tick
+
+typedef struct {
+    coro_t co;
+    unsigned char row, col;
+} keypad_frame_t;
+
+typedef struct {
+    coro_t co;
+    char key;
+    unsigned char state;   // As in Get_Expression()
+} expr_frame_t;
+
+coro_event_t key_event;
+char key_queue[KEY_QUEUE];   // Slot = post count % KEY_QUEUE
+unsigned long keys_dropped;  // Pressed with the queue full
+
+static char keypad_co(coro_t *co);
+static char expr_co(coro_t *co);
+static void calc_idle(uint32_t wait_us);
+#endif
+
+void Result_Shown(void);
+
 // Global variables
 char expression[20];
 unsigned char first_operand = 0;
 unsigned char second_operand = 0;
 char operator = 0;
 int result = 0;
+#ifdef PERSIST_STATE
+uint32_t saved[FLASH_LOG_WORDS];
+#endif
 
-// Keypad matrix mapping
-const char keypad[4][3] = {
+// Keypad matrix mapping (copied to SRAM when built with RAM_HOT, see
+// ram_place.h)
+RAMCONST char keypad[4][3] = {
     {'1', '2', '3'},
     {'4', '5', '6'},
     {'7', '8', '9'},
@@ -49,7 +137,18 @@ const char keypad[4][3] = {
 };
 
 int main(void) {
+#ifdef STACK_WATERMARK
+    stack_paint();  // Before anything else runs
+#endif
     SystemInit();
+#ifdef PC_PROFILE
+    SystemCoreClockUpdate();  // Sampling period from the real PCLK
+    pc_prof_start(PC_PROF_RATE_HZ);
+#endif
+#ifdef CORO_KEYPAD
+    SystemCoreClockUpdate();
+    coro_init(SystemCoreClock);  // LCD_Command() times the controller with it
+#endif
     
     // Initialize LCD
     LCD_Init();
@@ -60,12 +159,34 @@ int main(void) {
     KEYPAD_PORT->FIOPIN |= (COL1 | COL2 | COL3);   // Enable pull-up
     
     LCD_String("Expression Calc");
+#ifdef PERSIST_STATE
+    SystemCoreClockUpdate();  // IAP needs the real CCLK
+    flash_log_init(1);
+    if (flash_log_read(TAG_LAST_CALC, saved)) {
+        // Show the last expression for 2 s before the first prompt
+        first_operand = saved[0] & 0xFF;
+        operator = (char)(saved[0] >> 8);
+        second_operand = (saved[0] >> 16) & 0xFF;
+        result = (int)saved[1];
+        Display_Result(result);
+        delay_ms(2000);
+        LCD_Clear();
+        LCD_String("Expression Calc");
+    }
+#endif
     LCD_SetCursor(1, 0);
     LCD_String("A op B =");
     
+#ifdef CORO_KEYPAD
+    SysTick_Config(SystemCoreClock / WAKE_TICK_HZ);
+    coro_spawn(keypad_co, "keypad", sizeof(keypad_frame_t));
+    coro_spawn(expr_co, "expression", sizeof(expr_frame_t));
+    coro_run(calc_idle);  // Never returns
+#endif
     while(1) {
         Get_Expression();
         Display_Result(result);
+        Result_Shown();
         delay_ms(3000);  // Display result for 3 seconds
         LCD_Clear();
         LCD_String("Enter New Expr:");
@@ -74,10 +195,29 @@ int main(void) {
     }
 }
 
+// Persist, profile and stack reports, once per result
+void Result_Shown(void) {
+#ifdef PERSIST_STATE
+    saved[0] = first_operand | ((uint32_t)(unsigned char)operator << 8) |
+               ((uint32_t)second_operand << 16);
+    saved[1] = (uint32_t)result;
+    flash_log_write(TAG_LAST_CALC, saved);  // About 1 ms
+#endif
+#ifdef PC_PROFILE
+    pc_prof_dump();  // One profile per expression
+    pc_prof_reset();
+#endif
+#ifdef STACK_WATERMARK
+    stack_dump(0, 0);  // No handlers to break down
+#endif
+#ifdef CORO_PROFILE
+    coro_dump();
+#endif
+}
+
 void LCD_Init(void) {
-    // Set data and control pins as output
-    LCD_DATA_PORT->FIODIR |= 0xFF;  // P0.0-P0.7 as output
-    LCD_CTRL_PORT->FIODIR |= (RS | RW | EN);  // Control pins as output
+    // Set data and control pins as output, RW low, FIOMASK on P0.0-P0.7
+    lcd_bus_init();
     
     delay_ms(20);  // Wait for LCD power up
     
@@ -90,22 +230,23 @@ void LCD_Init(void) {
 }
 
 void LCD_Command(unsigned char cmd) {
-    LCD_DATA_PORT->FIOPIN = cmd;
-    LCD_CTRL_PORT->FIOCLR = (RS | RW);  // RS=0, RW=0 (command mode)
-    LCD_CTRL_PORT->FIOSET = EN;         // Enable high
-    delay_ms(1);
-    LCD_CTRL_PORT->FIOCLR = EN;         // Enable low
-    delay_ms(1);
+#ifdef CORO_KEYPAD
+    while (!coro_lcd_idle());           // Coroutines await it before calling
+#endif
+    lcd_bus_write(cmd, 0);              // RS=0 (command mode)
+#ifdef CORO_KEYPAD
+    coro_lcd_busy(cmd < 0x04 ? CORO_LCD_CLEAR_US : CORO_LCD_EXEC_US);
+#endif
 }
 
 void LCD_Data(unsigned char data) {
-    LCD_DATA_PORT->FIOPIN = data;
-    LCD_CTRL_PORT->FIOSET = RS;         // RS=1 (data mode)
-    LCD_CTRL_PORT->FIOCLR = RW;         // RW=0 (write)
-    LCD_CTRL_PORT->FIOSET = EN;         // Enable high
-    delay_ms(1);
-    LCD_CTRL_PORT->FIOCLR = EN;         // Enable low
-    delay_ms(1);
+#ifdef CORO_KEYPAD
+    while (!coro_lcd_idle());
+#endif
+    lcd_bus_write(data, 1);             // RS=1 (data mode)
+#ifdef CORO_KEYPAD
+    coro_lcd_busy(CORO_LCD_EXEC_US);
+#endif
 }
 
 void LCD_String(char *str) {
@@ -131,6 +272,7 @@ void LCD_SetCursor(unsigned char row, unsigned char col) {
 }
 
 void delay_ms(unsigned int ms) {
+    if (DELAY_LOOP_SKIP(ms * 10000, DELAY_MS_LOOP_CYCLES)) return;
     for(unsigned int i = 0; i < ms; i++)
         for(unsigned int j = 0; j < 10000; j++);
 }
@@ -263,6 +405,140 @@ void Get_Expression(void) {
     }
 }
 
+#ifdef CORO_KEYPAD
+void SysTick_Handler(void) {
+    // Wake-up only: the coroutines keep time with coro_now_us()
+}
+
+static void calc_idle(uint32_t wait_us) {
+    if (wait_us > 1000000 / WAKE_TICK_HZ) {
+        __WFI();  // The next SysTick is sooner than the next deadline
+    }
+}
+
+// Read_Keypad() with awaits: one row per KEY_SETTLE_US, each key posted
+// when pressed, then polled until released
+static char keypad_co(coro_t *co) {
+    keypad_frame_t *f = (keypad_frame_t *)co;
+
+    CORO_BEGIN(co);
+    while(1) {
+        for(f->row = 0; f->row < 4; f->row++) {
+            KEYPAD_PORT->FIOSET = (ROW1 | ROW2 | ROW3 | ROW4);
+            KEYPAD_PORT->FIOCLR = ROW1 << f->row;
+            await_delay(co, KEY_SETTLE_US);
+
+            for(f->col = 0; f->col < 3; f->col++) {
+                if(!(KEYPAD_PORT->FIOPIN & (COL1 << f->col)))
+                    break;
+            }
+            if(f->col < 3) {
+                if(key_event.posted - key_event.taken < KEY_QUEUE) {
+                    key_queue[key_event.posted % KEY_QUEUE] = keypad[f->row][f->col];
+                    coro_post(&key_event);
+                }
+                else {
+                    keys_dropped++;  // Keep the unread keys
+                }
+                while(!(KEYPAD_PORT->FIOPIN & (COL1 << f->col)))
+                    await_delay(co, KEY_POLL_US);  // Wait for key release
+                break;  // Next scan from row 0, as Read_Keypad() returned
+            }
+        }
+    }
+    CORO_END(co);
+}
+
+// Get_Expression(), Display_Result() and the result time of main(), in
+// order: each state of Get_Expression() is now a place in this code
+static char expr_co(coro_t *co) {
+    expr_frame_t *f = (expr_frame_t *)co;
+
+    CORO_BEGIN(co);
+    while(1) {
+        LCD_SetCursor(1, 8);  // Set cursor to input position
+        first_operand = 0;
+        second_operand = 0;
+        operator = 0;
+        f->state = 0;
+
+        while(1) {
+            await_event(co, &key_event);
+            f->key = key_queue[(key_event.taken - 1) % KEY_QUEUE];
+
+            if(f->key >= '0' && f->key <= '9') {
+                if(f->state == 0 || f->state == 2) {
+                    if(f->state == 0)
+                        first_operand = f->key - '0';
+                    else
+                        second_operand = f->key - '0';
+                    await_lcd_idle(co);
+                    LCD_Data(f->key);
+                    f->state++;
+                }
+            }
+            else if(f->key == '+' || f->key == '-') {
+                if(f->state == 1) {
+                    operator = f->key;
+                    await_lcd_idle(co);
+                    LCD_Data(f->key);
+                    f->state = 2;
+                }
+            }
+            else if(f->key == '=') {
+                if(f->state == 3) {
+                    await_lcd_idle(co);
+                    LCD_Data('=');
+
+                    if(operator == '+') {
+                        result = BCD_To_Decimal(first_operand) + BCD_To_Decimal(second_operand);
+                    }
+                    else if(operator == '-') {
+                        result = BCD_To_Decimal(first_operand) - BCD_To_Decimal(second_operand);
+                    }
+
+                    if(result >= 0 && result <= 9) {
+                        break;  // Valid BCD result
+                    }
+                    LCD_SetCursor(1, 0);
+                    LCD_String("Error: Result>9");
+                    await_delay(co, 2000000);
+                    LCD_SetCursor(1, 0);
+                    LCD_String("A op B =       ");
+                    LCD_SetCursor(1, 8);
+                    first_operand = 0;
+                    second_operand = 0;
+                    operator = 0;
+                    f->state = 0;
+                }
+            }
+            else if(f->key == '*') {
+                // Clear/Reset
+                LCD_SetCursor(1, 0);
+                LCD_String("                ");
+                LCD_SetCursor(1, 0);
+                LCD_String("A op B =");
+                LCD_SetCursor(1, 8);
+                first_operand = 0;
+                second_operand = 0;
+                operator = 0;
+                f->state = 0;
+            }
+        }
+
+        Display_Result(result);
+        Result_Shown();
+        await_delay(co, 3000000);  // Display result for 3 seconds
+        key_event.taken = key_event.posted;  // Drop keys pressed meanwhile
+        LCD_Clear();
+        LCD_String("Enter New Expr:");
+        LCD_SetCursor(1, 0);
+        LCD_String("A op B =");
+    }
+    CORO_END(co);
+}
+#endif
+
 int BCD_To_Decimal(unsigned char bcd) {
     return bcd;  // Since we're using single digit, it's the same
 }
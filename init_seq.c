@@ -0,0 +1,48 @@
+/******************************************************************************
+ * FILE: init_seq.c
+ * DESCRIPTION: Deadline-driven init sequencer (see init_seq.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "init_seq.h"
+
+void init_chain(init_chain_t *c, const init_step_t *steps, unsigned int count,
+                uint32_t start_us) {
+    c->steps = steps;
+    c->count = count;
+    c->next = 0;
+    c->due_us = start_us;
+}
+
+/*=============================================================================
+ * RUN - earliest deadline first among the chains that are due
+ *============================================================================*/
+void init_seq_run(init_chain_t *chains, unsigned int n) {
+    for (;;) {
+        init_chain_t *best = 0;
+        uint32_t now = boot_now_us(), wait;
+        unsigned int i;
+
+        for (i = 0; i < n; i++) {
+            init_chain_t *c = &chains[i];
+            if (c->next >= c->count) {
+                continue;                               // Chain finished
+            }
+            if (!best || (int32_t)(c->due_us - best->due_us) < 0) {
+                best = c;
+            }
+        }
+        if (!best) {
+            return;
+        }
+        if ((int32_t)(best->due_us - now) > 0) {
+            continue;                                   // Nothing due yet: poll
+        }
+        wait = best->steps[best->next].run();
+        boot_mark(best->steps[best->next].name);
+        best->due_us = boot_now_us() + (wait & ~INIT_STEP_AGAIN);
+        if (!(wait & INIT_STEP_AGAIN)) {
+            best->next++;
+        }
+    }
+}
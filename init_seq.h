@@ -0,0 +1,51 @@
+/******************************************************************************
+ * FILE: init_seq.h
+ * DESCRIPTION: Deadline-driven init sequencer - runs several chains of
+ *              setup steps interleaved, so one device's mandatory wait
+ *              (e.g. LCD power-on) overlaps other devices' setup instead
+ *              of busy-waiting
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   A chain is an ordered list of steps. Each step does its piece of setup
+ *   and returns how many microseconds must pass before the next step of
+ *   the same chain may run. A chain can also start with a deadline (e.g.
+ *   "40 ms after reset" for an HD44780). init_seq_run() repeatedly runs
+ *   the due step whose deadline is earliest. It spins only when no chain
+ *   has a step due. Every step is timestamped with boot_mark(), so the
+ *   boot_prof.c timeline shows the interleaving.
+ *   Times are boot_now_us() values, so boot_prof_init() must run first.
+ *   Deadlines are compared as differences, (int32_t)(due - now), never as
+ *   plain numbers, so the 32-bit microsecond clock may wrap (after 71
+ *   minutes) without breaking the order.
+ *   A step that ORs INIT_STEP_AGAIN into its wait runs again after that
+ *   wait instead of moving on (e.g. one LCD character per step).
+ ******************************************************************************/
+
+#ifndef INIT_SEQ_H
+#define INIT_SEQ_H
+
+#include <LPC17xx.h>
+#include "boot_prof.h"
+
+#define INIT_STEP_AGAIN     0x80000000UL    // Wait flag: repeat this step
+
+typedef struct {
+    const char *name;                   // Shown in the boot timeline
+    uint32_t (*run)(void);              // Returns the wait before the next step, us
+} init_step_t;
+
+typedef struct {
+    const init_step_t *steps;
+    unsigned int count;
+    unsigned int next;                  // Index of the next step to run
+    uint32_t due_us;                    // Earliest boot_now_us() for that step
+} init_chain_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void init_chain(init_chain_t *c, const init_step_t *steps, unsigned int count,
+                uint32_t start_us);
+void init_seq_run(init_chain_t *chains, unsigned int n);   // Until all are done
+
+#endif /* INIT_SEQ_H */
@@ -0,0 +1,132 @@
+/******************************************************************************
+ * FILE: irq_latency.c
+ * DESCRIPTION: Interrupt latency histograms and synthetic load generator
+ *              (see irq_latency.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "irq_latency.h"
+#include "itm_print.h"
+
+static uint32_t load_busy;              // Cycles burnt per load interrupt
+
+/*=============================================================================
+ * DWT CYCLE COUNTER
+ * TRCENA powers the DWT; CYCCNT then counts every CPU clock and wraps
+ * after 2^32 cycles (43 s at 100 MHz). All differences are taken modulo
+ * 2^32, so wrap-around is harmless for intervals shorter than that.
+ *============================================================================*/
+void irq_lat_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void irq_lat_reset(irq_lat_t *s, const char *name) {
+    int i;
+
+    s->name = name;
+    s->count = 0;
+    s->lat_min = s->lat_max = 0;
+    s->exec_min = s->exec_max = 0;
+    for (i = 0; i < IRQ_LAT_BUCKETS; i++) {
+        s->lat_hist[i] = 0;
+        s->exec_hist[i] = 0;
+    }
+}
+
+/*=============================================================================
+ * LOG2 BUCKETING - CLZ gives the bucket in one instruction on the M3
+ *============================================================================*/
+void irq_lat_record(unsigned long *hist, uint32_t cycles) {
+    unsigned int k = cycles ? 31 - __CLZ(cycles) : 0;
+
+    if (k >= IRQ_LAT_BUCKETS) {
+        k = IRQ_LAT_BUCKETS - 1;
+    }
+    hist[k]++;
+}
+
+/*=============================================================================
+ * TIME SINCE A RESET-ON-MATCH TIMER EVENT
+ * The match interrupt is raised when TC reaches MR. TC stays at MR for one
+ * timer tick, then restarts from 0, so the number of whole ticks since the
+ * match is 0 while TC == MR and TC + 1 afterwards. PC adds the fraction.
+ * TC is read twice so a tick between the TC and PC reads is not mixed up.
+ *============================================================================*/
+uint32_t irq_lat_since_match(LPC_TIM_TypeDef *t, uint32_t mr, uint32_t cycles_per_tick) {
+    uint32_t tc, pc, pr, ticks;
+
+    pr = t->PR;
+    do {
+        tc = t->TC;
+        pc = t->PC;
+    } while (t->TC != tc);
+
+    ticks = (tc == mr) ? 0 : tc + 1;
+    return (ticks * (pr + 1) + pc) * cycles_per_tick;
+}
+
+/*=============================================================================
+ * SYNTHETIC LOAD on TIMER1 (PCLK = CCLK, so one tick = one cycle)
+ *============================================================================*/
+void irq_lat_load_start(uint32_t period, uint32_t busy, uint32_t priority) {
+    load_busy = busy;
+
+    LPC_SC->PCONP |= (1 << 2);                              // Power TIMER1
+    LPC_SC->PCLKSEL0 = (LPC_SC->PCLKSEL0 & ~(3 << 4)) | (1 << 4);
+    LPC_TIM1->TCR = 0x02;
+    LPC_TIM1->CTCR = 0;
+    LPC_TIM1->PR = 0;
+    LPC_TIM1->MR0 = period - 1;
+    LPC_TIM1->MCR = (1 << 0) | (1 << 1);                    // Interrupt + reset
+    LPC_TIM1->IR = 0x3F;
+    NVIC_SetPriority(TIMER1_IRQn, priority);
+    NVIC_EnableIRQ(TIMER1_IRQn);
+    LPC_TIM1->TCR = 0x01;
+}
+
+void irq_lat_load_stop(void) {
+    LPC_TIM1->TCR = 0x00;
+    NVIC_DisableIRQ(TIMER1_IRQn);
+}
+
+void irq_lat_load_isr(void) {
+    uint32_t start = DWT->CYCCNT;
+
+    LPC_TIM1->IR = (1 << 0);
+    while (DWT->CYCCNT - start < load_busy) {
+        ;                                                   // Burn CPU time
+    }
+}
+
+/*=============================================================================
+ * DUMP over ITM stimulus port 0
+ *============================================================================*/
+void irq_lat_dump(const irq_lat_t *s) {
+    int k;
+
+    itm_puts("IRQ ");
+    itm_puts(s->name);
+    itm_puts(": ");
+    itm_putu(s->count, 0);
+    itm_puts(" samples\r\n  latency min ");
+    itm_putu(s->lat_min, 0);
+    itm_puts(" max ");
+    itm_putu(s->lat_max, 0);
+    itm_puts("  exec min ");
+    itm_putu(s->exec_min, 0);
+    itm_puts(" max ");
+    itm_putu(s->exec_max, 0);
+    itm_puts(" cycles\r\n  cycles >=     latency        exec\r\n");
+    for (k = 0; k < IRQ_LAT_BUCKETS; k++) {
+        if (s->lat_hist[k] == 0 && s->exec_hist[k] == 0) {
+            continue;
+        }
+        itm_puts("  ");
+        itm_putu(k ? 1UL << k : 0, 9);
+        itm_putu(s->lat_hist[k], 12);
+        itm_putu(s->exec_hist[k], 12);
+        itm_puts("\r\n");
+    }
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * FILE: irq_latency.h
+ * DESCRIPTION: Interrupt latency and execution-time histograms using the
+ *              DWT cycle counter, with a synthetic interrupt load generator
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   Latency   = CPU cycles from the hardware event (e.g. a timer match) to
+ *               the irq_lat_enter() call at the top of the handler. It
+ *               includes exception stacking, any higher-priority handler
+ *               and any __disable_irq() section that delayed entry.
+ *   Execution = cycles from irq_lat_enter() to irq_lat_exit(), including
+ *               time spent in handlers that preempted this one.
+ *   Both are kept as log2 histograms: bucket k counts values in
+ *   [2^k, 2^(k+1)) cycles, bucket 0 also holds 0. The last bucket
+ *   collects everything larger.
+ *   irq_lat_dump() prints the tables on ITM stimulus port 0 (Keil
+ *   "Debug (printf) Viewer" / SWO), so no UART or LCD is disturbed.
+ ******************************************************************************/
+
+#ifndef IRQ_LATENCY_H
+#define IRQ_LATENCY_H
+
+#include <LPC17xx.h>
+
+#define IRQ_LAT_BUCKETS     16          // Up to 2^15 = 32768 cycles, then overflow
+
+/*=============================================================================
+ * PER-IRQ STATISTICS
+ *============================================================================*/
+typedef struct {
+    const char *name;
+    unsigned long count;
+    uint32_t lat_min, lat_max;
+    uint32_t exec_min, exec_max;
+    unsigned long lat_hist[IRQ_LAT_BUCKETS];
+    unsigned long exec_hist[IRQ_LAT_BUCKETS];
+    uint32_t t_entry;                   // CYCCNT at entry of the running instance
+} irq_lat_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void irq_lat_init(void);                                // Start DWT CYCCNT
+void irq_lat_reset(irq_lat_t *s, const char *name);
+void irq_lat_record(unsigned long *hist, uint32_t cycles);
+void irq_lat_dump(const irq_lat_t *s);                  // Print over ITM
+
+/* Cycles since timer 't' matched MR 'mr' with reset-on-match, from TC/PC.
+ * cycles_per_tick = CCLK / PCLK for that timer (1, 2, 4 or 8).
+ */
+uint32_t irq_lat_since_match(LPC_TIM_TypeDef *t, uint32_t mr, uint32_t cycles_per_tick);
+
+/* Synthetic load: TIMER1 fires every 'period' CPU cycles at 'priority'
+ * and burns 'busy' cycles. TIMER1_IRQHandler must call irq_lat_load_isr().
+ */
+void irq_lat_load_start(uint32_t period, uint32_t busy, uint32_t priority);
+void irq_lat_load_stop(void);
+void irq_lat_load_isr(void);
+
+/*=============================================================================
+ * HANDLER PROBES - first and last statements of the measured handler
+ *============================================================================*/
+static inline void irq_lat_enter(irq_lat_t *s, uint32_t latency) {
+    s->t_entry = DWT->CYCCNT;
+    if (s->count == 0 || latency < s->lat_min) s->lat_min = latency;
+    if (latency > s->lat_max) s->lat_max = latency;
+    irq_lat_record(s->lat_hist, latency);
+}
+
+static inline void irq_lat_exit(irq_lat_t *s) {
+    uint32_t exec = DWT->CYCCNT - s->t_entry;
+
+    if (s->count == 0 || exec < s->exec_min) s->exec_min = exec;
+    if (exec > s->exec_max) s->exec_max = exec;
+    irq_lat_record(s->exec_hist, exec);
+    s->count++;
+}
+
+#endif /* IRQ_LATENCY_H */
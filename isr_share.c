@@ -0,0 +1,67 @@
+/******************************************************************************
+ * FILE: isr_share.c
+ * DESCRIPTION: Single-producer single-consumer event ring for ISR -> main
+ *              messages (see isr_share.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "isr_share.h"
+
+/*=============================================================================
+ * RING INITIALIZATION
+ * size must be a power of two; one ring holds up to 'size' messages
+ *============================================================================*/
+void spsc_init(spsc_ring_t *r, uint32_t *storage, uint32_t size) {
+    r->head = 0;
+    r->tail = 0;
+    r->mask = size - 1;
+    r->buf = storage;
+    r->dropped = 0;
+}
+
+/*=============================================================================
+ * PUSH (producer side, normally an ISR)
+ * The message is stored before 'head' is published, so the consumer can
+ * never see an index that points at an unwritten slot.
+ *============================================================================*/
+int spsc_push(spsc_ring_t *r, uint32_t msg) {
+    uint32_t head = r->head;
+
+    if (head - r->tail > r->mask) {     // Full
+        atomic_add_u32(&r->dropped, 1);
+        return 0;
+    }
+    r->buf[head & r->mask] = msg;
+    __DMB();
+    r->head = head + 1;
+    return 1;
+}
+
+/*=============================================================================
+ * POP (consumer side, normally main)
+ * The slot is read before 'tail' is released back to the producer.
+ *============================================================================*/
+int spsc_pop(spsc_ring_t *r, uint32_t *msg) {
+    uint32_t tail = r->tail;
+
+    if (tail == r->head) {              // Empty
+        return 0;
+    }
+    __DMB();
+    *msg = r->buf[tail & r->mask];
+    __DMB();
+    r->tail = tail + 1;
+    return 1;
+}
+
+uint32_t spsc_count(const spsc_ring_t *r) {
+    return r->head - r->tail;
+}
+
+/*=============================================================================
+ * DROP COUNTER - the producer may bump it while main reads it, so the
+ * read-and-clear is a single exclusive swap
+ *============================================================================*/
+uint32_t spsc_take_dropped(spsc_ring_t *r) {
+    return atomic_swap_u32(&r->dropped, 0);
+}
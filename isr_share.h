@@ -0,0 +1,108 @@
+/******************************************************************************
+ * FILE: isr_share.h
+ * DESCRIPTION: Tear-free sharing of state between interrupts and main() -
+ *              seqlock snapshots, a lock-free single-producer single-consumer
+ *              event ring and LDREX/STREX atomic helpers
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   SEQLOCK: the writer (an ISR) bumps 'seq' to odd, updates the fields,
+ *   then bumps it to even. The reader (main) copies the fields and retries
+ *   if 'seq' was odd or changed meanwhile. Readers never block the ISR and
+ *   no interrupt is ever masked. The writer must run at a higher priority
+ *   than every reader - a reader that preempts a half-done write would spin.
+ *   SPSC RING: 'head' is written only by the producer, 'tail' only by the
+ *   consumer, so push and pop are a few loads and stores with no retry
+ *   loop. A full ring drops the new message and counts it.
+ *   On a single-core M3 the __DMB() calls cost one cycle; they keep the
+ *   compiler (and a future cached / multi-master system) from reordering
+ *   the data accesses around the sequence and index updates.
+ ******************************************************************************/
+
+#ifndef ISR_SHARE_H
+#define ISR_SHARE_H
+
+#include <LPC17xx.h>
+
+/*=============================================================================
+ * ATOMIC READ-MODIFY-WRITE (LDREX/STREX)
+ * Any exception between the load and the store clears the exclusive
+ * monitor, so STREX fails and the update is simply redone.
+ *============================================================================*/
+static inline uint32_t atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+    uint32_t n;
+
+    do {
+        n = __LDREXW(p) + v;
+    } while (__STREXW(n, p));
+    return n;
+}
+
+static inline uint32_t atomic_swap_u32(volatile uint32_t *p, uint32_t v) {
+    uint32_t old;
+
+    do {
+        old = __LDREXW(p);
+    } while (__STREXW(v, p));
+    return old;
+}
+
+/*=============================================================================
+ * SEQLOCK
+ *============================================================================*/
+typedef struct {
+    volatile uint32_t seq;              // Odd while a write is in progress
+} seqlock_t;
+
+static inline void seqlock_write_begin(seqlock_t *s) {
+    s->seq++;
+    __DMB();
+}
+
+static inline void seqlock_write_end(seqlock_t *s) {
+    __DMB();
+    s->seq++;
+}
+
+/* Usage:
+ *   do {
+ *       seq = seqlock_read_begin(&lock);
+ *       copy = shared;
+ *   } while (seqlock_read_retry(&lock, seq));
+ */
+static inline uint32_t seqlock_read_begin(const seqlock_t *s) {
+    uint32_t seq;
+
+    while ((seq = s->seq) & 1) {
+        ;                               // Only possible with a misprioritised writer
+    }
+    __DMB();
+    return seq;
+}
+
+static inline int seqlock_read_retry(const seqlock_t *s, uint32_t start) {
+    __DMB();
+    return s->seq != start;
+}
+
+/*=============================================================================
+ * SINGLE-PRODUCER SINGLE-CONSUMER EVENT RING (32-bit messages)
+ * 'head' and 'tail' are free-running; size must be a power of two.
+ *============================================================================*/
+typedef struct {
+    volatile uint32_t head;             // Next slot to write (producer only)
+    volatile uint32_t tail;             // Next slot to read (consumer only)
+    uint32_t mask;                      // size - 1
+    uint32_t *buf;
+    volatile uint32_t dropped;          // Pushes refused because full
+} spsc_ring_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void spsc_init(spsc_ring_t *r, uint32_t *storage, uint32_t size);
+int spsc_push(spsc_ring_t *r, uint32_t msg);        // Producer; 0 if full
+int spsc_pop(spsc_ring_t *r, uint32_t *msg);        // Consumer; 0 if empty
+uint32_t spsc_count(const spsc_ring_t *r);          // Messages waiting
+uint32_t spsc_take_dropped(spsc_ring_t *r);         // Read and clear drop count
+
+#endif /* ISR_SHARE_H */
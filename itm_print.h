@@ -0,0 +1,40 @@
+/******************************************************************************
+ * FILE: itm_print.h
+ * DESCRIPTION: Text and decimal numbers over ITM stimulus port 0, for the
+ *              dump functions of the profiling modules
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   ITM_SendChar() waits for the port to take each character and drops it
+ *   when no debugger has enabled the port, so a dump costs nothing without
+ *   a probe attached. Numbers are printed without any library support.
+ ******************************************************************************/
+
+#ifndef ITM_PRINT_H
+#define ITM_PRINT_H
+
+#include <LPC17xx.h>
+
+static inline void itm_puts(const char *s) {
+    while (*s) {
+        ITM_SendChar(*s++);
+    }
+}
+
+/* Right-aligned in 'width' characters; 0 for no padding */
+static inline void itm_putu(unsigned long v, int width) {
+    char buf[11];
+    int n = 0;
+
+    do {
+        buf[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v && n < 10);
+    while (width-- > n) {
+        ITM_SendChar(' ');
+    }
+    while (n) {
+        ITM_SendChar(buf[--n]);
+    }
+}
+
+#endif /* ITM_PRINT_H */
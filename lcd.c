@@ -1,21 +1,27 @@
-#include<lpc17xx.h>
+#include<LPC17xx.h>
+#include "clock.h"          //DELAY_LOOP_SKIP
 #define RS_CTRL  0x08000000  //P0.27
 #define EN_CTRL  0x10000000  //P0.28
 #define DT_CTRL  0x07800000  //P0.23 to P0.26 data lines
 
  unsigned long int temp1=0, temp2=0,i,j ;
  unsigned char flag1 =0, flag2 =0;
- unsigned char msg[] = {"WELCOME "};
+ const unsigned char msg[] = {"WELCOME "};  //Flash, not RAM
  
 void lcd_write(void);
 void port_write(void);
 void delay_lcd(unsigned int);
-unsigned long int init_command[] = {0x30,0x30,0x30,0x20,0x28,0x0c,0x06,0x01,0x80};
+#define LCD_DELAY_LOOP_CYCLES 8   //one delay_lcd() pass, roughly
+
+#define LCD_BUS_PULSE_DELAY()  delay_lcd(25)
+#define LCD_BUS_SETTLE_DELAY() delay_lcd(5000)
+#include "lcd_bus.h"         //Masked transport, default pin map = P0.23-P0.28
+const unsigned char init_command[] = {0x30,0x30,0x30,0x20,0x28,0x0c,0x06,0x01,0x80}; //9 bytes of flash (was 36 of RAM)
  int main(void)
  {
             SystemInit();
                   SystemCoreClockUpdate();
-                  LPC_GPIO0->FIODIR = DT_CTRL | RS_CTRL | EN_CTRL; //Config output
+                  lcd_bus_init(); //Config output, FIOMASK = LCD pins only
                   flag1 =0;//Command	
 	 for (i=0; i<9;i++)  
                            {	 
@@ -24,9 +30,9 @@ unsigned long int init_command[] = {0x30,0x30,0x30,0x20,0x28,0x0c,0x06,0x01,0x80
                             }
                    flag1 =1;//Data
 	 i =0;
-	 while (msg[i++] != '\0')
+	 while (msg[i] != '\0') //Stop before the terminator, first char included
                          {
-                         temp1 = msg[i];
+                         temp1 = msg[i++];
                          lcd_write();//Send data bytes
                         }
                  while(1);
@@ -43,24 +49,19 @@ unsigned long int init_command[] = {0x30,0x30,0x30,0x20,0x28,0x0c,0x06,0x01,0x80
 	   temp2 = temp2 << 23; 
 	   port_write(); // Output the lower digit on P0.26-P0.23
                    }
+                  if (!flag1 && temp1 < 0x04) //Clear display / return home run 1.52 ms, far past the settle delay
+                    delay_lcd(clock_loops(1640, LCD_DELAY_LOOP_CYCLES));
                  }
  void port_write(void)                        
  { 	 
-	LPC_GPIO0->FIOPIN = temp2;	
-          if (flag1 == 0)	   
-                        LPC_GPIO0->FIOCLR = RS_CTRL;  // Select command register
-          else
-                  	LPC_GPIO0->FIOSET = RS_CTRL; //Select data register
-	
-	LPC_GPIO0->FIOSET = EN_CTRL; //Apply -ve edge on Enable 
-	delay_lcd(25);
-	LPC_GPIO0->FIOCLR = EN_CTRL;
-   delay_lcd(5000);		 		
-  
+	// Data nibble + RS in one masked FIOPIN store, then the EN strobe
+	lcd_bus_transfer(temp2 >> 23, flag1);
   }
 void delay_lcd(unsigned int r1)
  {
   	unsigned int r;
+  	if (DELAY_LOOP_SKIP(r1, LCD_DELAY_LOOP_CYCLES))
+  	  return; //timed by the simulator
   	for(r=0;r<r1;r++);
     return;
  }
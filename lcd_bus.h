@@ -0,0 +1,162 @@
+/******************************************************************************
+ * FILE: lcd_bus.h
+ * DESCRIPTION: Shared HD44780 LCD transport - masked single-store port
+ *              writes with a compile-time pin map and 4/8-bit bus width
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * USAGE: Override any LCD_* setting below with #define BEFORE including
+ *        this header. Defaults match the ALS-SDA-ARMCTXM3-01 board:
+ *        4-bit bus on P0.23-P0.26, RS on P0.27, EN on P0.28.
+ ******************************************************************************/
+
+#ifndef LCD_BUS_H
+#define LCD_BUS_H
+
+#include <LPC17xx.h>
+
+/*=============================================================================
+ * PIN MAP (compile-time)
+ * LCD_DATA_PORTNUM / LCD_CTRL_PORTNUM are plain numbers so the
+ * preprocessor can tell whether RS shares the data port (single store).
+ * Override a port number together with its matching LCD_*_GPIO pointer.
+ *============================================================================*/
+#ifndef LCD_BUS_WIDTH
+#define LCD_BUS_WIDTH       4                   // 4 or 8 data lines
+#endif
+
+#ifndef LCD_DATA_PORTNUM
+#define LCD_DATA_PORTNUM    0
+#define LCD_DATA_GPIO       LPC_GPIO0
+#endif
+#ifndef LCD_DATA_SHIFT
+#define LCD_DATA_SHIFT      23                  // Bus D4 (or D0) on P0.23
+#endif
+
+#ifndef LCD_CTRL_PORTNUM
+#define LCD_CTRL_PORTNUM    0
+#define LCD_CTRL_GPIO       LPC_GPIO0
+#endif
+#ifndef LCD_RS_BIT
+#define LCD_RS_BIT          27                  // P0.27
+#endif
+#ifndef LCD_EN_BIT
+#define LCD_EN_BIT          28                  // P0.28
+#endif
+/* LCD_RW_BIT is optional: when defined, R/W is driven low once at init */
+
+/* Enable pulse width and post-pulse settle time. Programs normally map
+ * these onto their own delay routine, e.g. delay_lcd(25).
+ */
+#ifndef LCD_BUS_PULSE_DELAY
+#define LCD_BUS_PULSE_DELAY()   lcd_bus_spin(25)
+#endif
+#ifndef LCD_BUS_SETTLE_DELAY
+#define LCD_BUS_SETTLE_DELAY()  lcd_bus_spin(5000)
+#endif
+
+/*=============================================================================
+ * DERIVED MASKS
+ *============================================================================*/
+#define LCD_LANE_BITS       ((1U << LCD_BUS_WIDTH) - 1)
+#define LCD_DATA_MASK       (LCD_LANE_BITS << LCD_DATA_SHIFT)
+#define LCD_RS_PIN          (1U << LCD_RS_BIT)
+#define LCD_EN_PIN          (1U << LCD_EN_BIT)
+
+#if LCD_DATA_PORTNUM == LCD_CTRL_PORTNUM
+#define LCD_RS_SHARED       1                   // Data + RS in one FIOPIN store
+#define LCD_PORT_LANE       (LCD_DATA_MASK | LCD_RS_PIN | LCD_EN_PIN)
+#else
+#define LCD_RS_SHARED       0                   // RS needs its own store
+#define LCD_PORT_LANE       LCD_DATA_MASK
+#endif
+
+#if LCD_BUS_WIDTH != 4 && LCD_BUS_WIDTH != 8
+#error "LCD_BUS_WIDTH must be 4 or 8"
+#endif
+
+/* Built with RAM_HOT, the byte and nibble writers run from SRAM
+ * (ram_place.h) instead of being inlined into flash callers; the delays
+ * they call stay where the program put them.
+ */
+#ifdef RAM_HOT
+#include "ram_place.h"
+#define LCD_BUS_HOT         static RAMFUNC __attribute__((unused))
+#else
+#define LCD_BUS_HOT         static inline
+#endif
+
+/*=============================================================================
+ * DEFAULT SPIN DELAY (only used if the program supplies no delay mapping)
+ *============================================================================*/
+static inline void lcd_bus_spin(unsigned int r) {
+    volatile unsigned int n;
+    for (n = 0; n < r; n++);
+}
+
+#if !LCD_RS_SHARED
+static unsigned char lcd_bus_rs_state = 0xFF;   // Last RS level driven (split ports)
+#endif
+
+/*=============================================================================
+ * BUS INITIALIZATION
+ * Sets the LCD pins as outputs and programs FIOMASK on the data port so
+ * only the LCD lane responds to FIOPIN writes. From now on one FIOPIN
+ * store updates data + RS without disturbing the other pins of the port.
+ * NOTE: FIOMASK also hides the other pins of that port from FIOSET/FIOCLR/
+ * FIOPIN accesses; call lcd_bus_release() before driving them.
+ *============================================================================*/
+static inline void lcd_bus_init(void) {
+    LCD_DATA_GPIO->FIODIR |= LCD_DATA_MASK;
+    LCD_CTRL_GPIO->FIODIR |= LCD_RS_PIN | LCD_EN_PIN;
+#ifdef LCD_RW_BIT
+    LCD_CTRL_GPIO->FIODIR |= (1U << LCD_RW_BIT);
+    LCD_CTRL_GPIO->FIOCLR = (1U << LCD_RW_BIT); // Write-only: R/W tied low
+#endif
+    LCD_CTRL_GPIO->FIOCLR = LCD_EN_PIN;
+    LCD_DATA_GPIO->FIOMASK = ~LCD_PORT_LANE;    // 0 = pin accessible
+}
+
+/* Hand the data port back to other code (clears FIOMASK) */
+static inline void lcd_bus_release(void) {
+    LCD_DATA_GPIO->FIOMASK = 0;
+}
+
+/*=============================================================================
+ * RAW TRANSFER - one EN strobe
+ * 'bits' are the lane value (a nibble in 4-bit mode, a byte in 8-bit mode)
+ * 'rs'   is 0 for the command register, 1 for the data register
+ * Stores per strobe: 3 (FIOPIN, EN set, EN clear) when RS shares the data
+ * port; one extra RS store on split ports, skipped when RS is unchanged.
+ *============================================================================*/
+LCD_BUS_HOT void lcd_bus_transfer(unsigned int bits, unsigned char rs) {
+#if LCD_RS_SHARED
+    LCD_DATA_GPIO->FIOPIN = ((bits & LCD_LANE_BITS) << LCD_DATA_SHIFT)
+                          | (rs ? LCD_RS_PIN : 0);
+#else
+    LCD_DATA_GPIO->FIOPIN = (bits & LCD_LANE_BITS) << LCD_DATA_SHIFT;
+    if (rs != lcd_bus_rs_state) {
+        if (rs)
+            LCD_CTRL_GPIO->FIOSET = LCD_RS_PIN;
+        else
+            LCD_CTRL_GPIO->FIOCLR = LCD_RS_PIN;
+        lcd_bus_rs_state = rs;
+    }
+#endif
+    LCD_CTRL_GPIO->FIOSET = LCD_EN_PIN;         // EN high (RS/data already set up)
+    LCD_BUS_PULSE_DELAY();
+    LCD_CTRL_GPIO->FIOCLR = LCD_EN_PIN;         // Falling edge latches the bus
+    LCD_BUS_SETTLE_DELAY();
+}
+
+/*=============================================================================
+ * BYTE WRITE - splits into two nibbles (high first) on a 4-bit bus
+ *============================================================================*/
+LCD_BUS_HOT void lcd_bus_write(unsigned char value, unsigned char rs) {
+#if LCD_BUS_WIDTH == 4
+    lcd_bus_transfer(value >> 4, rs);
+    lcd_bus_transfer(value & 0x0F, rs);
+#else
+    lcd_bus_transfer(value, rs);
+#endif
+}
+
+#endif /* LCD_BUS_H */
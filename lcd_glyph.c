@@ -0,0 +1,154 @@
+/******************************************************************************
+ * FILE: lcd_glyph.c
+ * DESCRIPTION: CGRAM custom-glyph cache with LRU slot management
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION: Logical glyphs are uploaded to one of the 8 CGRAM slots only
+ *            on a cache miss. When all slots are taken the least recently
+ *            used glyph is replaced. Hits cost no bus traffic at all.
+ ******************************************************************************/
+
+#include "lcd_glyph.h"
+
+/*=============================================================================
+ * GLYPH BITMAPS (5x8 font, one byte per pixel row, bits 4..0 = columns)
+ *============================================================================*/
+static const unsigned char glyph_rom[GLYPH_COUNT][8] = {
+    {0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x00},  // GLYPH_BAR_1
+    {0x18,0x18,0x18,0x18,0x18,0x18,0x18,0x00},  // GLYPH_BAR_2
+    {0x1C,0x1C,0x1C,0x1C,0x1C,0x1C,0x1C,0x00},  // GLYPH_BAR_3
+    {0x1E,0x1E,0x1E,0x1E,0x1E,0x1E,0x1E,0x00},  // GLYPH_BAR_4
+    {0x04,0x0E,0x15,0x04,0x04,0x04,0x04,0x00},  // GLYPH_ARROW_UP
+    {0x04,0x04,0x04,0x04,0x15,0x0E,0x04,0x00},  // GLYPH_ARROW_DOWN
+    {0x0C,0x12,0x12,0x0C,0x00,0x00,0x00,0x00},  // GLYPH_DEGREE
+    {0x04,0x0E,0x0E,0x0E,0x1F,0x00,0x04,0x00},  // GLYPH_BELL
+    {0x1F,0x11,0x0A,0x04,0x0A,0x11,0x1F,0x00}   // GLYPH_HOURGLASS
+};
+
+glyph_cache_t glyph_cache;
+
+/*=============================================================================
+ * BUS WRAPPERS
+ * Every byte the cache puts on the LCD goes through here so bytes_sent is
+ * an exact measure of the traffic it generates.
+ *============================================================================*/
+static void glyph_cmd(unsigned char cmd) {
+    lcd_cmd(cmd);
+    glyph_cache.bytes_sent++;
+}
+
+static void glyph_data(unsigned char data) {
+    lcd_data(data);
+    glyph_cache.bytes_sent++;
+}
+
+/*=============================================================================
+ * CACHE INITIALIZATION
+ * CGRAM content is undefined after power-up, so every slot starts empty.
+ *============================================================================*/
+void glyph_cache_init(void) {
+    unsigned char s;
+
+    for (s = 0; s < GLYPH_SLOTS; s++) {
+        glyph_cache.slot_glyph[s] = GLYPH_NONE;
+        glyph_cache.slot_used[s] = 0;
+    }
+    glyph_cache.use_clock = 0;
+    glyph_cache.hits = 0;
+    glyph_cache.misses = 0;
+    glyph_cache.bytes_sent = 0;
+}
+
+/*=============================================================================
+ * GLYPH LOOKUP
+ * Returns the CGRAM character code (0-7) that displays the logical glyph.
+ * On a miss the glyph is uploaded into a free slot, or into the least
+ * recently used one. An upload leaves the LCD address counter pointing
+ * into CGRAM, so callers must set the DDRAM address (0x80 | addr) AFTER
+ * all lookups for a frame and BEFORE writing characters.
+ * An ID past GLYPH_COUNT has no bitmap: GLYPH_MISSING is returned instead,
+ * without touching CGRAM, so the misuse shows as '?' on the screen.
+ *============================================================================*/
+unsigned char glyph_cache_get(unsigned char glyph) {
+    unsigned char s, victim = 0, row;
+
+    if (glyph >= GLYPH_COUNT) {
+        return GLYPH_MISSING;
+    }
+    glyph_cache.use_clock++;
+
+    /* STEP 1: HIT? Scan the 8 slots; remember the LRU one on the way */
+    for (s = 0; s < GLYPH_SLOTS; s++) {
+        if (glyph_cache.slot_glyph[s] == glyph) {
+            glyph_cache.slot_used[s] = glyph_cache.use_clock;
+            glyph_cache.hits++;
+            return s;
+        }
+        if (glyph_cache.slot_used[s] < glyph_cache.slot_used[victim]) {
+            victim = s;                 // Empty slots have slot_used = 0
+        }
+    }
+
+    /* STEP 2: MISS - upload the 8 pixel rows into the victim slot
+     * Set CGRAM address command = 0x40 | (slot * 8)
+     */
+    glyph_cache.misses++;
+    glyph_cmd(0x40 | (victim << 3));
+    for (row = 0; row < 8; row++) {
+        glyph_data(glyph_rom[glyph][row]);
+    }
+
+    glyph_cache.slot_glyph[victim] = glyph;
+    glyph_cache.slot_used[victim] = glyph_cache.use_clock;
+    return victim;
+}
+
+/*=============================================================================
+ * HIT RATE in percent, 0 when nothing was looked up yet
+ *============================================================================*/
+unsigned int glyph_cache_hit_rate(void) {
+    unsigned long total = glyph_cache.hits + glyph_cache.misses;
+
+    if (total == 0) {
+        return 0;
+    }
+    return (unsigned int)((glyph_cache.hits * 100) / total);
+}
+
+/*=============================================================================
+ * HORIZONTAL BAR GRAPH
+ * Draws value/full_scale as a bar 'cells' characters wide starting at
+ * (row, col). Resolution is 5 pixel columns per cell, e.g. 80 steps on a
+ * 16-character line. Only the partial cell uses CGRAM, so one frame costs
+ * 1 address command + 'cells' data bytes once its glyph is cached.
+ *============================================================================*/
+void lcd_bargraph(unsigned char row, unsigned char col, unsigned char cells,
+                  unsigned int value, unsigned int full_scale) {
+    unsigned long columns;
+    unsigned char full, partial, code = BAR_CHAR_EMPTY, c;
+
+    /* STEP 1: SCALE VALUE TO PIXEL COLUMNS */
+    if (full_scale == 0 || value >= full_scale) {
+        columns = (unsigned long)cells * BAR_COLS_PER_CELL;
+    } else {
+        columns = ((unsigned long)value * cells * BAR_COLS_PER_CELL) / full_scale;
+    }
+    full = columns / BAR_COLS_PER_CELL;
+    partial = columns % BAR_COLS_PER_CELL;
+
+    /* STEP 2: LOOK UP THE PARTIAL GLYPH (may upload to CGRAM) */
+    if (partial != 0) {
+        code = glyph_cache_get(GLYPH_BAR_1 + partial - 1);
+    }
+
+    /* STEP 3: POSITION CURSOR IN DDRAM AND WRITE THE CELLS */
+    glyph_cmd(((row == 0) ? 0x80 : 0xC0) + col);
+    for (c = 0; c < cells; c++) {
+        if (c < full) {
+            glyph_data(BAR_CHAR_FULL);
+        } else if (c == full && partial != 0) {
+            glyph_data(code);
+        } else {
+            glyph_data(BAR_CHAR_EMPTY);
+        }
+    }
+}
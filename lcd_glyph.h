@@ -0,0 +1,75 @@
+/******************************************************************************
+ * FILE: lcd_glyph.h
+ * DESCRIPTION: CGRAM custom-glyph cache with LRU slot management and a
+ *              horizontal bar-graph renderer built on top of it
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * HARDWARE: 16x2 HD44780 character LCD (8 CGRAM slots, char codes 0-7)
+ ******************************************************************************/
+
+#ifndef LCD_GLYPH_H
+#define LCD_GLYPH_H
+
+/*=============================================================================
+ * LCD COMMAND PATH
+ * The cache sends everything through the usual command/data writers
+ * (lcd_cmd() / lcd_data() as in q29.c). Any program linking this module
+ * must provide both.
+ *============================================================================*/
+void lcd_cmd(unsigned char cmd);
+void lcd_data(unsigned char data);
+
+/*=============================================================================
+ * LOGICAL GLYPH IDS
+ * These index glyph_rom[] in lcd_glyph.c. A logical ID is what the
+ * application asks for; the cache decides which CGRAM slot holds it.
+ *============================================================================*/
+#define GLYPH_BAR_1         0           // Bar cell, 1 column filled
+#define GLYPH_BAR_2         1           // Bar cell, 2 columns filled
+#define GLYPH_BAR_3         2           // Bar cell, 3 columns filled
+#define GLYPH_BAR_4         3           // Bar cell, 4 columns filled
+#define GLYPH_ARROW_UP      4           // Up arrow (counting up, value rising)
+#define GLYPH_ARROW_DOWN    5           // Down arrow
+#define GLYPH_DEGREE        6           // Degree sign
+#define GLYPH_BELL          7           // Alarm bell
+#define GLYPH_HOURGLASS     8           // Busy indicator
+#define GLYPH_COUNT         9           // Number of glyphs in glyph_rom[]
+
+#define GLYPH_SLOTS         8           // HD44780 has 8 CGRAM slots (5x8 font)
+#define GLYPH_NONE          0xFF        // Marks an empty CGRAM slot
+#define GLYPH_MISSING       0x3F        // ROM '?': code returned for an unknown ID
+
+/* Bar graph geometry: every character cell is 5 pixel columns wide.
+ * Full and empty cells use the ROM characters 0xFF (solid block) and
+ * 0x20 (space), so only the single partial cell needs a CGRAM glyph.
+ */
+#define BAR_COLS_PER_CELL   5
+#define BAR_CHAR_FULL       0xFF
+#define BAR_CHAR_EMPTY      0x20
+
+/*=============================================================================
+ * CACHE STATE
+ * slot_glyph[s]  = logical glyph currently uploaded in CGRAM slot s
+ * slot_used[s]   = value of use_clock when slot s was last referenced
+ * The statistics let the application report hit rate and bus traffic.
+ *============================================================================*/
+typedef struct {
+    unsigned char slot_glyph[GLYPH_SLOTS];
+    unsigned long slot_used[GLYPH_SLOTS];
+    unsigned long use_clock;            // Bumped on every lookup (LRU clock)
+    unsigned long hits;                 // Lookups served from CGRAM
+    unsigned long misses;               // Lookups that needed an upload
+    unsigned long bytes_sent;           // Command + data bytes put on the LCD bus
+} glyph_cache_t;
+
+extern glyph_cache_t glyph_cache;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void glyph_cache_init(void);                        // Forget all slots, clear stats
+unsigned char glyph_cache_get(unsigned char glyph); // Logical ID -> char code 0-7
+unsigned int glyph_cache_hit_rate(void);            // Hit rate in percent (0-100)
+void lcd_bargraph(unsigned char row, unsigned char col, unsigned char cells,
+                  unsigned int value, unsigned int full_scale);
+
+#endif /* LCD_GLYPH_H */
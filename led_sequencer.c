@@ -0,0 +1,142 @@
+/******************************************************************************
+ * FILE: led_sequencer.c
+ * DESCRIPTION: Timer-triggered GPDMA LED pattern sequencer
+ *              (see led_sequencer.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "led_sequencer.h"
+
+#define SEQ_TIMER           LPC_TIM2
+#define SEQ_DMACH           LPC_GPDMACH7
+#define SEQ_DMACH_BIT       (1 << 7)
+#define SEQ_DMA_LINE        12                  // MAT2.0 when DMAREQSEL bit 4 = 1
+
+/* DMACCControl: TransferSize | SBSize = DBSize = 1 | SWidth = DWidth = word | SI */
+#define SEQ_DMA_CONTROL(n)  ((n) | (0 << 12) | (0 << 15) | (2 << 18) | (2 << 21) | (1 << 26))
+
+/* DMACCConfig: enable | destination = timer match line | memory to peripheral */
+#define SEQ_DMA_CONFIG      ((1 << 0) | (SEQ_DMA_LINE << 6) | (1 << 11))
+
+static led_seq_lli_t seq_lli;                   // Points back at itself
+static LPC_GPIO_TypeDef *seq_port;
+
+/*=============================================================================
+ * PATTERN BUILDERS
+ *============================================================================*/
+unsigned int led_seq_ring(uint32_t *words, unsigned int leds, unsigned int shift) {
+    unsigned int i;
+
+    for (i = 0; i < leds; i++) {
+        words[i] = 1UL << (shift + i);
+    }
+    return leds;
+}
+
+/* Fill from the bottom, then empty from the bottom: 2 * leds states */
+unsigned int led_seq_johnson(uint32_t *words, unsigned int leds, unsigned int shift) {
+    uint32_t all = ((1UL << leds) - 1) << shift;
+    unsigned int i;
+
+    for (i = 0; i < leds; i++) {
+        words[i] = ((2UL << i) - 1) << shift;
+        words[leds + i] = all & ~(((2UL << i) - 1) << shift);
+    }
+    return 2 * leds;
+}
+
+/* One LED walking up and back down, without repeating the end LEDs; one
+ * LED (or none) has nothing to walk back over */
+unsigned int led_seq_bounce(uint32_t *words, unsigned int leds, unsigned int shift) {
+    unsigned int i, n = 0;
+
+    for (i = 0; i < leds; i++) {
+        words[n++] = 1UL << (shift + i);
+    }
+    if (leds < 2) {
+        return n;
+    }
+    for (i = leds - 2; i > 0; i--) {
+        words[n++] = 1UL << (shift + i);
+    }
+    return n;
+}
+
+/* User table: one byte per step, bit 0 = lowest LED */
+unsigned int led_seq_from_bytes(uint32_t *words, const unsigned char *pattern,
+                                unsigned int n, unsigned int shift) {
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        words[i] = (uint32_t)pattern[i] << shift;
+    }
+    return n;
+}
+
+/*=============================================================================
+ * START
+ * The DMA channel is set up before the timer runs, and the timer's stale
+ * MR0 DMA request is cleared by writing its IR bit, so the first step
+ * lands exactly one period after the start.
+ *============================================================================*/
+void led_seq_start(LPC_GPIO_TypeDef *port, uint32_t mask,
+                   const uint32_t *words, unsigned int n, uint32_t step_hz) {
+    if (n == 0 || n > LED_SEQ_MAX_WORDS) {
+        return;
+    }
+    led_seq_stop();
+    seq_port = port;
+    port->FIODIR |= mask;
+    port->FIOMASK = ~mask;                      // DMA writes touch the LEDs only
+
+    /* STEP 1: TIMER2 at PCLK = CCLK, reset on MR0, no interrupt */
+    LPC_SC->PCONP |= (1 << 22);
+    LPC_SC->PCLKSEL1 = (LPC_SC->PCLKSEL1 & ~(3 << 12)) | (1 << 12);
+    SEQ_TIMER->TCR = 0x02;
+    SEQ_TIMER->CTCR = 0;
+    SEQ_TIMER->PR = 0;
+    SEQ_TIMER->MR0 = SystemCoreClock / step_hz - 1;
+    SEQ_TIMER->MCR = (1 << 1);
+    SEQ_TIMER->IR = (1 << 0);                   // Drop any stale DMA request
+    LPC_SC->DMAREQSEL |= (1 << 4);              // Line 12 = MAT2.0
+
+    /* STEP 2: GPDMA channel, circular through one linked-list item */
+    LPC_SC->PCONP |= (1 << 29);
+    LPC_GPDMA->DMACConfig = 0x01;               // Controller on, little-endian
+    LPC_GPDMA->DMACIntTCClear = SEQ_DMACH_BIT;
+    LPC_GPDMA->DMACIntErrClr = SEQ_DMACH_BIT;
+    seq_lli.src = (uint32_t)(uintptr_t)words;
+    seq_lli.dst = (uint32_t)(uintptr_t)&port->FIOPIN;
+    seq_lli.next = (uint32_t)(uintptr_t)&seq_lli;
+    seq_lli.control = SEQ_DMA_CONTROL(n);
+    SEQ_DMACH->DMACCSrcAddr = seq_lli.src;
+    SEQ_DMACH->DMACCDestAddr = seq_lli.dst;
+    SEQ_DMACH->DMACCLLI = seq_lli.next;
+    SEQ_DMACH->DMACCControl = seq_lli.control;
+    SEQ_DMACH->DMACCConfig = SEQ_DMA_CONFIG;
+
+    /* STEP 3: go */
+    SEQ_TIMER->TCR = 0x01;
+}
+
+/* New rate from the next step on; TC is restarted if it is already past
+ * the new match value, which would otherwise run to 2^32
+ */
+void led_seq_set_rate(uint32_t step_hz) {
+    uint32_t mr = SystemCoreClock / step_hz - 1;
+
+    SEQ_TIMER->MR0 = mr;
+    if (SEQ_TIMER->TC >= mr) {
+        SEQ_TIMER->TC = 0;
+    }
+}
+
+void led_seq_stop(void) {
+    SEQ_TIMER->TCR = 0x02;
+    SEQ_DMACH->DMACCConfig = 0;
+    LPC_SC->DMAREQSEL &= ~(1 << 4);
+    if (seq_port) {
+        seq_port->FIOMASK = 0;
+        seq_port = 0;
+    }
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * FILE: led_sequencer.h
+ * DESCRIPTION: LED pattern sequencer driven entirely by hardware - a timer
+ *              match requests GPDMA, which copies the next precomputed port
+ *              word into the LED port, so the CPU does no work per step
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   TIMER2 runs from PCLK = CCLK and resets on MR0, so MR0 + 1 cycles pass
+ *   per step. Each MR0 match raises DMA request line 12 (DMAREQSEL bit 4
+ *   selects MAT2.0 instead of UART3 TX). GPDMA channel 7 answers it by
+ *   moving one 32-bit word from the pattern buffer to FIOPIN of the LED
+ *   port. FIOMASK leaves only the LED pins writable, so the other pins of
+ *   the port keep their levels. At the end of the buffer, the channel
+ *   reloads its registers from a linked-list item that points back to
+ *   itself, so the pattern repeats forever.
+ *   The pattern buffer is read by the DMA at run time: keep it static and
+ *   do not change it while the sequencer runs, except word by word.
+ *   Code that later writes the same port with FIOPIN sees the mask too;
+ *   led_seq_stop() clears it.
+ * MAX STEP RATE (simulated, sim/sim_led_sequencer.c): every step is exact
+ *   down to 14 CPU cycles per step (7.1 M steps/s). Down to 10 cycles
+ *   (10 M steps/s) no step is lost, but the step after each buffer wrap
+ *   is late by the linked-list reload. Below that the GPDMA cannot keep up
+ *   and timer requests merge. The LEDs themselves need no more than a few
+ *   hundred steps/s to be seen.
+ ******************************************************************************/
+
+#ifndef LED_SEQUENCER_H
+#define LED_SEQUENCER_H
+
+#include <LPC17xx.h>
+
+#define LED_SEQ_MAX_WORDS   4095        // GPDMA TransferSize limit per item
+
+/* GPDMA linked-list item, in the order the controller fetches it */
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t next;
+    uint32_t control;
+} led_seq_lli_t;
+
+/*=============================================================================
+ * PATTERN BUILDERS - fill 'words' with port words for 'leds' LEDs starting
+ * at port bit 'shift'; return the number of words (the pattern length).
+ * 'words' needs room for leds (ring), 2 * leds (Johnson), 2 * leds - 2
+ * (bounce, at least leds) or n (table) words.
+ *============================================================================*/
+unsigned int led_seq_ring(uint32_t *words, unsigned int leds, unsigned int shift);
+unsigned int led_seq_johnson(uint32_t *words, unsigned int leds, unsigned int shift);
+unsigned int led_seq_bounce(uint32_t *words, unsigned int leds, unsigned int shift);
+unsigned int led_seq_from_bytes(uint32_t *words, const unsigned char *pattern,
+                                unsigned int n, unsigned int shift);
+
+/*=============================================================================
+ * CONTROL
+ *============================================================================*/
+void led_seq_start(LPC_GPIO_TypeDef *port, uint32_t mask,
+                   const uint32_t *words, unsigned int n, uint32_t step_hz);
+void led_seq_set_rate(uint32_t step_hz);
+void led_seq_stop(void);
+
+#endif /* LED_SEQUENCER_H */
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * FILE: pc_prof.c
+ * DESCRIPTION: Statistical PC-sampling profiler (see pc_prof.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "pc_prof.h"
+#include "itm_print.h"
+#include "clock.h"
+
+static uint16_t hist[PC_PROF_BUCKETS];
+static uint32_t samples;
+static uint32_t outside;                // PC below PC_PROF_LOW or above HIGH
+static uint32_t period;                 // TIMER3 ticks per sample
+static uint32_t rng = 0x2545F491u;      // xorshift32 for the dither
+
+void pc_prof_tick(uint32_t pc);
+
+/*=============================================================================
+ * SAMPLING INTERRUPT
+ * The entry code finds the exception frame (MSP or PSP, from bit 2 of
+ * EXC_RETURN in LR), loads the stacked PC (frame word 6) and branches to
+ * pc_prof_tick() with LR untouched, so its return is the exception return.
+ *============================================================================*/
+#if defined(EXC_STACKED_PC)
+void TIMER3_IRQHandler(void) {
+    pc_prof_tick(EXC_STACKED_PC());
+}
+#elif defined(__CC_ARM)
+__asm void TIMER3_IRQHandler(void) {
+    IMPORT  pc_prof_tick
+    TST     LR, #4
+    ITE     EQ
+    MRSEQ   R0, MSP
+    MRSNE   R0, PSP
+    LDR     R0, [R0, #24]
+    B       pc_prof_tick
+}
+#else
+__attribute__((naked)) void TIMER3_IRQHandler(void) {
+    __asm volatile(
+        "tst    lr, #4          \n"
+        "ite    eq              \n"
+        "mrseq  r0, msp         \n"
+        "mrsne  r0, psp         \n"
+        "ldr    r0, [r0, #24]   \n"
+        "b      pc_prof_tick    \n");
+}
+#endif
+
+void pc_prof_tick(uint32_t pc) {
+    uint32_t spread = period / 4;
+
+    LPC_TIM3->IR = (1 << 0);
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    LPC_TIM3->MR0 = period - 1 - spread / 2 + rng % (spread + 1);
+    pc_prof_sample(pc);
+}
+
+/*=============================================================================
+ * HISTOGRAM
+ *============================================================================*/
+void pc_prof_sample(uint32_t pc) {
+    uint32_t b = (pc - PC_PROF_LOW) >> PC_PROF_SHIFT;    // Below LOW wraps high
+
+    samples++;
+    if (b >= PC_PROF_BUCKETS) {
+        outside++;
+    } else if (hist[b] != 0xFFFF) {
+        hist[b]++;
+    }
+}
+
+void pc_prof_reset(void) {
+    uint32_t b;
+
+    for (b = 0; b < PC_PROF_BUCKETS; b++) {
+        hist[b] = 0;
+    }
+    samples = 0;
+    outside = 0;
+}
+
+uint32_t pc_prof_samples(void) {
+    return samples;
+}
+
+/*=============================================================================
+ * TIMER3 - match 0 interrupts and resets the counter once per sample
+ *============================================================================*/
+void pc_prof_start(uint32_t rate_hz) {
+    LPC_SC->PCONP |= (1 << 23);             // Power up TIMER3
+    period = clock_pclk(PC_PROF_PCLK) / rate_hz;
+    LPC_TIM3->TCR = 0x02;                   // Hold in reset
+    LPC_TIM3->CTCR = 0x00;
+    LPC_TIM3->PR = 0;
+    LPC_TIM3->MR0 = period - 1;
+    LPC_TIM3->MCR = (1 << 0) | (1 << 1);    // Interrupt + reset on MR0
+    LPC_TIM3->IR = 0x3F;
+    NVIC_SetPriority(TIMER3_IRQn, PC_PROF_PRIO);
+    NVIC_EnableIRQ(TIMER3_IRQn);
+    LPC_TIM3->TCR = 0x01;
+}
+
+void pc_prof_stop(void) {
+    NVIC_DisableIRQ(TIMER3_IRQn);
+    LPC_TIM3->TCR = 0x00;
+}
+
+/*=============================================================================
+ * DUMP over ITM stimulus port 0
+ *============================================================================*/
+static void itm_puthex(uint32_t v) {
+    int k;
+
+    for (k = 28; k >= 0; k -= 4) {
+        ITM_SendChar("0123456789abcdef"[(v >> k) & 0xF]);
+    }
+}
+
+void pc_prof_dump(void) {
+    uint32_t b;
+
+    itm_puts("PCPROF ");
+    itm_puthex(PC_PROF_LOW);
+    itm_puts(" ");
+    itm_putu(PC_PROF_BYTES, 0);
+    itm_puts(" ");
+    itm_putu(samples, 0);
+    itm_puts(" ");
+    itm_putu(outside, 0);
+    itm_puts("\r\n");
+    for (b = 0; b < PC_PROF_BUCKETS; b++) {
+        if (hist[b]) {
+            itm_puthex(PC_PROF_LOW + (b << PC_PROF_SHIFT));
+            itm_puts(" ");
+            itm_putu(hist[b], 0);
+            itm_puts("\r\n");
+        }
+    }
+    itm_puts("END\r\n");
+}
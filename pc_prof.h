@@ -0,0 +1,55 @@
+/******************************************************************************
+ * FILE: pc_prof.h
+ * DESCRIPTION: Statistical profiler - samples the interrupted program
+ *              counter from a high-priority timer interrupt into a
+ *              histogram of code addresses, printed over ITM for
+ *              sim/pc_prof_report to turn into a flat profile per function
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   TIMER3 interrupts at the sampling rate with the highest priority, so
+ *   samples also land inside other handlers (but not inside code that
+ *   masks interrupts: that time shows up at the instruction that unmasks
+ *   them). The handler takes the PC from the exception frame the core
+ *   stacked on entry and counts it in the bucket of PC_PROF_BYTES bytes
+ *   of code that holds it. Each period is dithered by up to +-1/8 so that
+ *   sampling cannot lock step with a loop of the same period (the 1 ms
+ *   SysTick of the ADC program, for one).
+ *   Cost: about 30 cycles per sample, 0.3% of the CPU at 1 kHz and 100 MHz.
+ *   RAM: 2 bytes per bucket, 4 KB for the default 32 KB of code.
+ *   pc_prof_dump() prints non-empty buckets as "address count" lines
+ *   between a "PCPROF low bytes samples outside" header and "END";
+ *   sim/pc_prof_report symbolises them against the program's ELF file.
+ *   Counts saturate at 65535; pc_prof_reset() starts again.
+ *   Under the host simulator the stacked PC comes from EXC_STACKED_PC():
+ *   the call site of the peripheral access the interrupt was taken in.
+ ******************************************************************************/
+
+#ifndef PC_PROF_H
+#define PC_PROF_H
+
+#include <LPC17xx.h>
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+#ifndef PC_PROF_LOW
+#define PC_PROF_LOW         0x00000000UL    // First code address counted
+#define PC_PROF_HIGH        0x00008000UL    // End of the range (32 KB)
+#endif
+#define PC_PROF_SHIFT       4               // 16-byte buckets, 4-8 instructions
+#define PC_PROF_BYTES       (1UL << PC_PROF_SHIFT)
+#define PC_PROF_BUCKETS     ((PC_PROF_HIGH - PC_PROF_LOW) >> PC_PROF_SHIFT)
+#define PC_PROF_PRIO        0               // Above every lab interrupt
+#define PC_PROF_PCLK        (32 + 14)       // TIMER3 field in PCLKSEL1
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void pc_prof_start(uint32_t rate_hz);       // Power up TIMER3 and sample
+void pc_prof_stop(void);
+void pc_prof_reset(void);                   // Empty the histogram
+void pc_prof_sample(uint32_t pc);           // Count one PC (the handler calls it)
+uint32_t pc_prof_samples(void);
+void pc_prof_dump(void);                    // Histogram over ITM
+
+#endif /* PC_PROF_H */
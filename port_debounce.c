@@ -0,0 +1,28 @@
+/******************************************************************************
+ * FILE: port_debounce.c
+ * DESCRIPTION: Vertical-counter port debouncer - setup and edge hand-off
+ *              to main() (see port_debounce.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "port_debounce.h"
+
+void port_debounce_init(port_debounce_t *d, uint32_t active_low, uint32_t pins) {
+    d->active_low = active_low;
+    d->state = pins ^ active_low;
+    d->cnt0 = d->cnt1 = 0xFFFFFFFF;     // All counters at 3
+    d->pressed = 0;
+    d->released = 0;
+}
+
+/*=============================================================================
+ * EDGE HAND-OFF - read and clear in one exclusive access, so an edge added
+ * by the tick between the read and the clear is kept for the next call
+ *============================================================================*/
+uint32_t port_debounce_take_pressed(port_debounce_t *d) {
+    return atomic_swap_u32(&d->pressed, 0);
+}
+
+uint32_t port_debounce_take_released(port_debounce_t *d) {
+    return atomic_swap_u32(&d->released, 0);
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * FILE: port_debounce.h
+ * DESCRIPTION: Parallel debouncer for all 32 pins of a GPIO port using
+ *              vertical counters - one FIOPIN read per tick, every bit
+ *              debounced at once
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   Each pin has a 2-bit counter, but the counters are stored "vertically":
+ *   cnt0 holds bit 0 of all 32 counters and cnt1 holds bit 1. A pin whose
+ *   sample differs from its debounced state counts down 3, 2, 1, 0; any
+ *   sample equal to the state reloads it to 3. The state flips when the
+ *   counter rolls over, i.e. after 4 consecutive differing samples. The
+ *   whole update is ten or so AND/EOR/MVN instructions, the same for 1 pin
+ *   as for 32.
+ *   Call port_debounce_tick() from a periodic interrupt. With a 5 ms tick
+ *   a pin settles 15-20 ms after its last bounce, and a glitch shorter
+ *   than three ticks is never seen.
+ *   'active_low' flips the pins that read 0 when pressed (switches to
+ *   ground with pull-ups), so a set bit in 'state' always means pressed.
+ *   Edges accumulate in 'pressed' / 'released' until main() takes them;
+ *   port_debounce_take_*() clears them with LDREX/STREX, so an edge that
+ *   arrives from the tick while main() is reading is never lost.
+ * CYCLES (Thumb-2, counted from the instruction sequence, excluding the
+ *   FIOPIN load): about 30 per tick regardless of pin count. A per-pin
+ *   counter loop costs about 8 per pin, so 1 pin ~10 and 32 pins ~260.
+ ******************************************************************************/
+
+#ifndef PORT_DEBOUNCE_H
+#define PORT_DEBOUNCE_H
+
+#include <LPC17xx.h>
+#include "isr_share.h"
+
+/*=============================================================================
+ * DEBOUNCER STATE - one per port
+ *============================================================================*/
+typedef struct {
+    uint32_t active_low;                // Pins inverted before debouncing
+    uint32_t state;                     // Debounced level, 1 = pressed
+    uint32_t cnt0, cnt1;                // Vertical 2-bit counters
+    volatile uint32_t pressed;          // 0 -> 1 edges not yet taken
+    volatile uint32_t released;         // 1 -> 0 edges not yet taken
+} port_debounce_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+/* Starts with 'state' = the current pin levels, so the pins already
+ * pressed at boot do not report an edge
+ */
+void port_debounce_init(port_debounce_t *d, uint32_t active_low, uint32_t pins);
+uint32_t port_debounce_take_pressed(port_debounce_t *d);
+uint32_t port_debounce_take_released(port_debounce_t *d);
+
+/*=============================================================================
+ * TICK - call with the raw FIOPIN word; returns the pins that changed
+ *============================================================================*/
+static inline uint32_t port_debounce_tick(port_debounce_t *d, uint32_t pins) {
+    uint32_t delta, toggle;
+
+    delta = (pins ^ d->active_low) ^ d->state;  // Differs from debounced state
+    d->cnt0 = ~(d->cnt0 & delta);               // Count down, or reload to 3
+    d->cnt1 = d->cnt0 ^ (d->cnt1 & delta);
+    toggle = delta & d->cnt0 & d->cnt1;         // Rolled over from 0 to 3
+    d->state ^= toggle;
+    if (toggle) {
+        d->pressed |= toggle & d->state;
+        d->released |= toggle & ~d->state;
+    }
+    return toggle;
+}
+
+#endif /* PORT_DEBOUNCE_H */
@@ -2,68 +2,307 @@
 #define EN_CTRL (1 << 28)     // P0.28
 #define DT_CTRL (0xF << 23)   // P0.23P0.26
 
-#include <lpc17xx.h>
+#include <LPC17xx.h>
 
 unsigned long temp1, temp2,i,r,d;
 unsigned char flag1;
-unsigned char msg[] = "WELCOME";
+const unsigned char msg[] = "WELCOME";   // Flash, not RAM
 
 void lcd_send_nibble(unsigned int nib);
 void lcd_cmd(unsigned char cmd);
 void lcd_data(unsigned char data);
 void delay_lcd(unsigned int r);
 
-void lcd_init(void);
+// Enable pulse / settle time in microseconds; lcd_delays_calibrate() turns
+// it into delay_lcd() passes for the clock the CPU is running at
+#include "clock.h"
+#define LCD_DELAY_LOOP_CYCLES 8   // one delay_lcd() pass, roughly
+#define LCD_PULSE_US 16           // = delay_lcd(200) at 100 MHz
+unsigned int lcd_pulse_loops = 200;
+
+#define LCD_BUS_PULSE_DELAY()  delay_lcd(lcd_pulse_loops)
+#define LCD_BUS_SETTLE_DELAY() delay_lcd(lcd_pulse_loops)
+#include "lcd_bus.h"   // masked single-store transport (P0.23-P0.28)
+
+// Boot: deadline-driven init, timeline over ITM when built with -DBOOT_PROFILE
+#include "boot_prof.h"
+#include "init_seq.h"
+
+// Build with CORO_INIT defined to write the LCD init as one coroutine
+// (coro.c) in datasheet order, each wait an await_delay() or
+// await_lcd_idle(), instead of the step table below; a second coroutine
+// sets up the pins meanwhile
+#ifdef CORO_INIT
+#include "coro.h"
+#endif
+
+#define LCD_POWER_ON_US 40000   // HD44780: 40 ms after Vcc reaches 2.7 V
+
+// With -DCLOCK_SCALING the init waits run at CLOCK_IDLE_HZ and the text is
+// written at CLOCK_FAST_HZ; the hook keeps the microsecond clock behind the
+// init deadlines and the enable-pulse loops right at either rate
+void lcd_delays_calibrate(void);
+#ifdef CLOCK_SCALING
+static void lcd_clock_changed(uint32_t cclk);
+#endif
+
+#ifdef CORO_INIT
+typedef struct {
+    coro_t co;
+    unsigned char k;   // message character
+} lcd_init_frame_t;
+
+static char board_co(coro_t *co);
+static char lcd_init_co(coro_t *co);
+#else
+static uint32_t step_lcd_bus(void);
+static uint32_t step_wake1(void);
+static uint32_t step_wake2(void);
+static uint32_t step_wake3(void);
+static uint32_t step_4bit(void);
+static uint32_t step_function_set(void);
+static uint32_t step_display_on(void);
+static uint32_t step_entry_mode(void);
+static uint32_t step_clear(void);
+static uint32_t step_welcome(void);
+
+static const init_step_t board_steps[] = {
+    { "lcd bus pins",     step_lcd_bus },
+};
+
+static const init_step_t lcd_steps[] = {
+    { "lcd wake 1",       step_wake1 },
+    { "lcd wake 2",       step_wake2 },
+    { "lcd wake 3",       step_wake3 },
+    { "lcd 4-bit",        step_4bit },
+    { "lcd function set", step_function_set },
+    { "lcd display on",   step_display_on },
+    { "lcd entry mode",   step_entry_mode },
+    { "lcd clear",        step_clear },
+    { "first text",       step_welcome },
+};
+#endif
 
 int main(void)
 {
+#ifndef CORO_INIT
+    init_chain_t chains[2];
+#endif
+
+    boot_prof_init(BOOT_IRC_HZ);   // timeline starts here, CPU still on the IRC
     SystemInit();
     SystemCoreClockUpdate();
+    boot_prof_clock(SystemCoreClock);
+    boot_mark("SystemInit");
+#ifdef CORO_INIT
+    coro_init(SystemCoreClock);   // after boot_prof_init(): that one clears CYCCNT
+#endif
+#ifdef CLOCK_SCALING
+    clock_on_change(lcd_clock_changed);   // runs once now, then on each change
+    clock_set(CLOCK_IDLE_HZ);
+#else
+    lcd_delays_calibrate();
+#endif
 
-    LPC_GPIO0->FIODIR |= (RS_CTRL | EN_CTRL | DT_CTRL);
-
-    lcd_init();
-
-    for (i = 0; msg[i] != '\0'; i++)
-        lcd_data(msg[i]);
+#ifdef CORO_INIT
+    coro_spawn(board_co, "board", sizeof(coro_t));
+    coro_spawn(lcd_init_co, "lcd init", sizeof(lcd_init_frame_t));
+    coro_run(0);   // spins between awaits, nothing else to do
+#else
+    // The LCD chain waits out its power-on time while the board chain sets
+    // up the pins; after that each LCD step waits only its datasheet time
+    init_chain(&chains[0], board_steps,
+               sizeof board_steps / sizeof board_steps[0], 0);
+    init_chain(&chains[1], lcd_steps,
+               sizeof lcd_steps / sizeof lcd_steps[0], LCD_POWER_ON_US);
+    init_seq_run(chains, 2);
+#endif
 
+#ifdef BOOT_PROFILE
+    boot_prof_dump();
+#endif
+#if defined(CORO_INIT) && defined(CORO_PROFILE)
+    coro_dump();
+#endif
     while (1);
 }
 
-void lcd_init(void)
+#ifdef CORO_INIT
+/*
+ * The same sequence as the step table, in order. lcd_cmd() and lcd_data()
+ * note the HD44780 execution time (coro_lcd_busy()), so after them the
+ * coroutine just awaits the controller; the wake-up nibbles have their
+ * own waits. The power-on time counts from coro_init(), a little after
+ * boot: it can only come late.
+ */
+static char board_co(coro_t *co)
 {
+    CORO_BEGIN(co);
+    lcd_bus_init();   // outputs + FIOMASK on the LCD lane
+    boot_mark("lcd bus pins");
+    CORO_END(co);
+}
+
+static char lcd_init_co(coro_t *co)
+{
+    lcd_init_frame_t *f = (lcd_init_frame_t *)co;
+
+    CORO_BEGIN(co);
+    await_until_us(co, LCD_POWER_ON_US);
+
     flag1 = 0; // command mode
+    lcd_send_nibble(0x03);
+    boot_mark("lcd wake 1");
+    await_delay(co, 4100);
+    lcd_send_nibble(0x03);
+    boot_mark("lcd wake 2");
+    await_delay(co, 100);
+    lcd_send_nibble(0x03);
+    boot_mark("lcd wake 3");
+    await_delay(co, 100);
+    lcd_send_nibble(0x02); // Now enter 4-bit mode
+    boot_mark("lcd 4-bit");
+    await_delay(co, 100);
+
+    lcd_cmd(0x28); // 4-bit, 2 line, 5x7 font
+    boot_mark("lcd function set");
+    await_lcd_idle(co);
+    lcd_cmd(0x0C); // Display on, cursor off
+    boot_mark("lcd display on");
+    await_lcd_idle(co);
+    lcd_cmd(0x06); // Entry mode
+    boot_mark("lcd entry mode");
+    await_lcd_idle(co);
+    lcd_cmd(0x01); // Clear display
+    boot_mark("lcd clear");
+    await_lcd_idle(co);
+
+#ifdef CLOCK_SCALING
+    clock_set(CLOCK_FAST_HZ);   // burst of writes
+#endif
+    for (f->k = 0; msg[f->k] != '\0'; f->k++)
+    {
+        lcd_data(msg[f->k]);
+        await_lcd_idle(co);
+    }
+#ifdef CLOCK_SCALING
+    clock_set(CLOCK_IDLE_HZ);
+#endif
+    boot_mark("first text");
+    CORO_END(co);
+}
+#else
+
+/*
+ * Init steps: each returns the microseconds the LCD needs before the next
+ * step of its chain (HD44780 "initializing by instruction", 4-bit). They
+ * replace the fixed delay_lcd(500000)/delay_lcd(50000) waits.
+ */
+static uint32_t step_lcd_bus(void)
+{
+    lcd_bus_init();   // outputs + FIOMASK on the LCD lane
+    return 0;
+}
 
-    delay_lcd(500000);
+static uint32_t step_wake1(void)
+{
+    flag1 = 0; // command mode
 
     // --- RAW INITIALIZATION SEQUENCE (DO NOT USE lcd_write HERE!) --
     lcd_send_nibble(0x03);
-    delay_lcd(50000);
+    return 4100;
+}
 
+static uint32_t step_wake2(void)
+{
     lcd_send_nibble(0x03);
-    delay_lcd(50000);
+    return 100;
+}
 
+static uint32_t step_wake3(void)
+{
     lcd_send_nibble(0x03);
-    delay_lcd(50000);
+    return 100;
+}
 
+static uint32_t step_4bit(void)
+{
     // Now enter 4-bit mode
     lcd_send_nibble(0x02);
-    delay_lcd(50000);
+    return 100;
+}
 
-    // Now normal commands
+static uint32_t step_function_set(void)
+{
     lcd_cmd(0x28); // 4-bit, 2 line, 5x7 font
+    return 40;
+}
+
+static uint32_t step_display_on(void)
+{
     lcd_cmd(0x0C); // Display on, cursor off
+    return 40;
+}
+
+static uint32_t step_entry_mode(void)
+{
     lcd_cmd(0x06); // Entry mode
+    return 40;
+}
+
+static uint32_t step_clear(void)
+{
     lcd_cmd(0x01); // Clear display
-    delay_lcd(50000);
+    return 1640;
+}
+
+// One character per step, like lcd_init_co(): the 40 us write time is a
+// deadline, not a blocking wait between characters
+static uint32_t step_welcome(void)
+{
+    static unsigned char k;   // message character
+
+#ifdef CLOCK_SCALING
+    if (k == 0)
+        clock_set(CLOCK_FAST_HZ);   // burst of writes
+#endif
+    lcd_data(msg[k++]);
+    if (msg[k] != '\0')
+        return 40 | INIT_STEP_AGAIN;
+    k = 0;
+#ifdef CLOCK_SCALING
+    clock_set(CLOCK_IDLE_HZ);
+#endif
+    return 0;
 }
 
+#endif
+
+void lcd_delays_calibrate(void)
+{
+    lcd_pulse_loops = clock_loops(LCD_PULSE_US, LCD_DELAY_LOOP_CYCLES);
+}
+
+#ifdef CLOCK_SCALING
+static void lcd_clock_changed(uint32_t cclk)
+{
+    boot_prof_clock(cclk);   // init_seq deadlines are in microseconds
+#ifdef CORO_INIT
+    coro_clock(cclk);
+#endif
+    lcd_delays_calibrate();
+}
+#endif
+
 void lcd_cmd(unsigned char cmd)
 {
     flag1 = 0;
 
     lcd_send_nibble(cmd >> 4);
     lcd_send_nibble(cmd & 0x0F);
+#ifdef CORO_INIT
+    coro_lcd_busy(cmd < 0x04 ? CORO_LCD_CLEAR_US : CORO_LCD_EXEC_US);
+#endif
 }
 
 void lcd_data(unsigned char data)
@@ -72,27 +311,20 @@ void lcd_data(unsigned char data)
 
     lcd_send_nibble(data >> 4);
     lcd_send_nibble(data & 0x0F);
+#ifdef CORO_INIT
+    coro_lcd_busy(CORO_LCD_EXEC_US);
+#endif
 }
 
 void lcd_send_nibble(unsigned int nib)
 {
-    LPC_GPIO0->FIOCLR = DT_CTRL;
-
-    temp2 = (nib & 0x0F) << 23;
-    LPC_GPIO0->FIOSET = temp2;
-
-    if (flag1 == 0)
-        LPC_GPIO0->FIOCLR = RS_CTRL;
-    else
-        LPC_GPIO0->FIOSET = RS_CTRL;
-
-    LPC_GPIO0->FIOSET = EN_CTRL;
-    delay_lcd(200);
-    LPC_GPIO0->FIOCLR = EN_CTRL;
-    delay_lcd(200);
+    // data + RS in one store, then EN high/low
+    lcd_bus_transfer(nib, flag1);
 }
 
 void delay_lcd(unsigned int r)
 {
+    if (DELAY_LOOP_SKIP(r, LCD_DELAY_LOOP_CYCLES))
+        return;   // timed by the simulator
     for (d = 0; d < r; d++);
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * FILE: ram_place.c
+ * DESCRIPTION: Cycle statistics for functions placed in flash or SRAM
+ *              (see ram_place.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "ram_place.h"
+#include "itm_print.h"
+
+/*=============================================================================
+ * DWT CYCLE COUNTER
+ * Started without clearing it, so it can be shared with boot_prof.c or
+ * irq_latency.c; every probe takes a difference modulo 2^32.
+ *============================================================================*/
+void ram_place_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void ram_place_reset(ram_place_t *s, const char *name, uintptr_t addr) {
+    s->name = name;
+    s->addr = addr & ~(uintptr_t)1;     // Thumb bit of a function pointer
+    s->calls = 0;
+    s->min = s->max = 0;
+    s->total = 0;
+}
+
+/*=============================================================================
+ * DUMP over ITM stimulus port 0
+ *============================================================================*/
+static void itm_puthex(uintptr_t v) {
+    int shift;
+
+    for (shift = 28; shift >= 0; shift -= 4) {
+        ITM_SendChar("0123456789ABCDEF"[(v >> shift) & 0xF]);
+    }
+}
+
+void ram_place_dump(ram_place_t *const *list, unsigned int n) {
+    unsigned int i;
+
+    itm_puts("PLACE function          address  where    calls   min  mean   max cycles\r\n");
+    for (i = 0; i < n; i++) {
+        const ram_place_t *s = list[i];
+        int pad;
+
+        itm_puts("  ");
+        itm_puts(s->name);
+        for (pad = 0; s->name[pad] && pad < 22; pad++) {
+        }
+        while (pad++ < 22) {
+            ITM_SendChar(' ');
+        }
+        itm_puthex(s->addr);
+        itm_puts(RAM_PLACE_IN_SRAM(s->addr) ? "  SRAM " : "  flash");
+        itm_putu(s->calls, 9);
+        itm_putu(s->min, 6);
+        itm_putu(s->calls ? (unsigned long)(s->total / s->calls) : 0, 6);
+        itm_putu(s->max, 6);
+        itm_puts("\r\n");
+    }
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * FILE: ram_place.h
+ * DESCRIPTION: Runs selected functions and lookup tables from SRAM instead
+ *              of flash, and times them with the DWT cycle counter wherever
+ *              they were placed
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * USAGE: Mark a hot function RAMFUNC and a table it reads RAMCONST (in
+ *        place of const):
+ *            RAMFUNC void display_digit(unsigned char pos, unsigned char v);
+ *            RAMCONST uint32_t bcd_seg_words[16] = { ... };
+ *        They only move in a build with RAM_HOT defined. Without it
+ *        RAMFUNC is empty and RAMCONST is const, so the same source gives
+ *        the flash build to compare against.
+ * LINKING: RAMFUNC code goes in section .ramfunc and RAMCONST tables in
+ *          .ramdata. The linker has to load both into flash and have them
+ *          copied to SRAM with the initialised data before main():
+ *            Keil, scatter file (Options > Linker, untick "Use Memory
+ *            Layout from Target Dialog"):
+ *                RW_IRAM1 0x10000000 0x00008000 {
+ *                    *(.ramfunc)
+ *                    *(.ramdata)
+ *                    .ANY (+RW +ZI)
+ *                }
+ *            GNU ld, first lines of the .data output section (the one
+ *            placed "> RAM AT > FLASH" that the startup code copies):
+ *                *(.ramfunc*)
+ *                *(.ramdata*)
+ *          A script without these lines leaves the code in flash without
+ *          an error. sim/mem_report lists what each object file asks to
+ *          move, and ram_place_dump() prints where each timed function
+ *          really is.
+ * OPERATION:
+ *   At 100 MHz a flash read takes 5 CPU clocks (FLASHCFG FLASHTIM = 4).
+ *   The flash accelerator hides this on straight-line code by prefetching
+ *   the next 128-bit line, but a taken branch to a line it does not hold,
+ *   or a table read, waits the 4 clocks. The local SRAM at 0x10000000 is
+ *   in the Code region, so the core fetches from it over the I-code bus
+ *   with no wait states.
+ *   Calls between flash and SRAM are out of BL range (16 MB); the linker
+ *   adds a veneer, a few cycles per call. RAMFUNC implies noinline, or the
+ *   compiler could copy the body back into a flash caller.
+ *   Every moved byte is counted twice: flash for the load image and SRAM
+ *   for the copy.
+ ******************************************************************************/
+
+#ifndef RAM_PLACE_H
+#define RAM_PLACE_H
+
+#include <LPC17xx.h>
+#include <stdint.h>
+
+/*=============================================================================
+ * PLACEMENT
+ *============================================================================*/
+#ifdef RAM_HOT
+#define RAMFUNC     __attribute__((section(".ramfunc"), noinline))
+#define RAMCONST    __attribute__((section(".ramdata")))    // Writable copy
+#else
+#define RAMFUNC
+#define RAMCONST    const
+#endif
+
+/* Local SRAM and the two AHB SRAM banks */
+#define RAM_PLACE_IN_SRAM(addr) \
+    (((addr) >= 0x10000000UL && (addr) < 0x10008000UL) || \
+     ((addr) >= 0x2007C000UL && (addr) < 0x20084000UL))
+
+/*=============================================================================
+ * CYCLE STATISTICS - one per timed function
+ *============================================================================*/
+typedef struct {
+    const char *name;
+    uintptr_t addr;                     // Where the linker put it
+    uint32_t calls;
+    uint32_t min, max;                  // Cycles per call
+    unsigned long long total;
+} ram_place_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void ram_place_init(void);                                  // Start DWT CYCCNT
+void ram_place_reset(ram_place_t *s, const char *name, uintptr_t addr);
+void ram_place_dump(ram_place_t *const *list, unsigned int n);  // Print over ITM
+
+/*=============================================================================
+ * PROBES - around a call, or the body of a handler
+ *============================================================================*/
+static inline uint32_t ram_place_start(void) {
+    return DWT->CYCCNT;
+}
+
+static inline void ram_place_stop(ram_place_t *s, uint32_t start) {
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    if (s->calls == 0 || cycles < s->min) s->min = cycles;
+    if (cycles > s->max) s->max = cycles;
+    s->total += cycles;
+    s->calls++;
+}
+
+#define RAM_PLACE_TIME(s, call)                                             \
+    do {                                                                    \
+        uint32_t ram_place_t0_ = ram_place_start();                         \
+        call;                                                               \
+        ram_place_stop((s), ram_place_t0_);                                 \
+    } while (0)
+
+#endif /* RAM_PLACE_H */
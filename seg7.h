@@ -0,0 +1,196 @@
+/******************************************************************************
+ * FILE: seg7.h
+ * DESCRIPTION: 7-segment glyphs and compile-time port words for any
+ *              segment wiring and polarity
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * USAGE: Override the pin map and polarity with #define BEFORE including
+ *        this header. Defaults match the ALS-SDA-ARMCTXM3-01 board:
+ *        segments a-g and the point (h) on P0.4-P0.11, common cathode
+ *        (segment lit when its pin is high).
+ * OPERATION: A glyph is a pattern with bit 0 = a ... bit 6 = g, bit 7 =
+ *            point. SEG7_WORD() turns a pattern into the port word that
+ *            lights it - each segment bit moved to its pin, inverted for
+ *            common anode - as a constant expression, so a table of words
+ *            costs nothing at run time and a refresh writes a word as is:
+ *                DATA_PORT->FIOCLR = SEG7_MASK;
+ *                DATA_PORT->FIOSET = word;
+ *            Segment layout:      a
+ *                               f   b
+ *                                 g
+ *                               e   c
+ *                                 d   h
+ ******************************************************************************/
+
+#ifndef SEG7_H
+#define SEG7_H
+
+#include <stdint.h>
+
+/*=============================================================================
+ * PIN MAP (compile-time) - bit numbers on the segment port
+ * Consecutive wiring only needs SEG7_FIRST_PIN; any other order sets the
+ * SEG7_PIN_* it changes.
+ *============================================================================*/
+#ifndef SEG7_FIRST_PIN
+#define SEG7_FIRST_PIN      4                   // Segment a on P0.4
+#endif
+#ifndef SEG7_PIN_A
+#define SEG7_PIN_A          (SEG7_FIRST_PIN + 0)
+#endif
+#ifndef SEG7_PIN_B
+#define SEG7_PIN_B          (SEG7_FIRST_PIN + 1)
+#endif
+#ifndef SEG7_PIN_C
+#define SEG7_PIN_C          (SEG7_FIRST_PIN + 2)
+#endif
+#ifndef SEG7_PIN_D
+#define SEG7_PIN_D          (SEG7_FIRST_PIN + 3)
+#endif
+#ifndef SEG7_PIN_E
+#define SEG7_PIN_E          (SEG7_FIRST_PIN + 4)
+#endif
+#ifndef SEG7_PIN_F
+#define SEG7_PIN_F          (SEG7_FIRST_PIN + 5)
+#endif
+#ifndef SEG7_PIN_G
+#define SEG7_PIN_G          (SEG7_FIRST_PIN + 6)
+#endif
+#ifndef SEG7_PIN_DP
+#define SEG7_PIN_DP         (SEG7_FIRST_PIN + 7)
+#endif
+
+#ifndef SEG7_ACTIVE_LOW
+#define SEG7_ACTIVE_LOW     0                   // 1 = common anode
+#endif
+
+/*=============================================================================
+ * SEGMENTS AND GLYPHS (patterns, independent of the wiring)
+ *============================================================================*/
+#define SEG7_SEG_A          0x01
+#define SEG7_SEG_B          0x02
+#define SEG7_SEG_C          0x04
+#define SEG7_SEG_D          0x08
+#define SEG7_SEG_E          0x10
+#define SEG7_SEG_F          0x20
+#define SEG7_SEG_G          0x40
+#define SEG7_SEG_DP         0x80
+
+/* Hex digits */
+#define SEG7_GLYPH_0        0x3F
+#define SEG7_GLYPH_1        0x06
+#define SEG7_GLYPH_2        0x5B
+#define SEG7_GLYPH_3        0x4F
+#define SEG7_GLYPH_4        0x66
+#define SEG7_GLYPH_5        0x6D
+#define SEG7_GLYPH_6        0x7D
+#define SEG7_GLYPH_7        0x07
+#define SEG7_GLYPH_8        0x7F
+#define SEG7_GLYPH_9        0x6F
+#define SEG7_GLYPH_A        0x77
+#define SEG7_GLYPH_B        0x7C                // b
+#define SEG7_GLYPH_C        0x39
+#define SEG7_GLYPH_D        0x5E                // d
+#define SEG7_GLYPH_E        0x79
+#define SEG7_GLYPH_F        0x71
+
+/* Other letters that read unambiguously (case as shown) */
+#define SEG7_GLYPH_G        0x3D
+#define SEG7_GLYPH_H        0x76
+#define SEG7_GLYPH_h        0x74
+#define SEG7_GLYPH_I        0x30                // Left-hand 1
+#define SEG7_GLYPH_J        0x1E
+#define SEG7_GLYPH_L        0x38
+#define SEG7_GLYPH_n        0x54
+#define SEG7_GLYPH_o        0x5C
+#define SEG7_GLYPH_P        0x73
+#define SEG7_GLYPH_q        0x67
+#define SEG7_GLYPH_r        0x50
+#define SEG7_GLYPH_S        0x6D                // Same as 5
+#define SEG7_GLYPH_t        0x78
+#define SEG7_GLYPH_U        0x3E
+#define SEG7_GLYPH_u        0x1C
+#define SEG7_GLYPH_y        0x6E
+#define SEG7_GLYPH_c        0x58
+
+/* Symbols */
+#define SEG7_GLYPH_BLANK    0x00
+#define SEG7_GLYPH_MINUS    0x40
+#define SEG7_GLYPH_UNDER    0x08
+#define SEG7_GLYPH_OVER     0x01
+#define SEG7_GLYPH_EQUALS   0x48
+#define SEG7_GLYPH_DEGREE   0x63
+
+/* Pattern for a character constant, for tables and constant strings (a
+ * chain of compares, so not for characters only known at run time).
+ * Letters without a clear 7-segment form are blank. */
+#define SEG7_CHAR(c) (                                                      \
+    ((c) >= '0' && (c) <= '9') ? SEG7_DIGIT((c) - '0') :                    \
+    ((c) == 'A' || (c) == 'a') ? SEG7_GLYPH_A :                             \
+    ((c) == 'B' || (c) == 'b') ? SEG7_GLYPH_B :                             \
+    ((c) == 'C')               ? SEG7_GLYPH_C :                             \
+    ((c) == 'c')               ? SEG7_GLYPH_c :                             \
+    ((c) == 'D' || (c) == 'd') ? SEG7_GLYPH_D :                             \
+    ((c) == 'E' || (c) == 'e') ? SEG7_GLYPH_E :                             \
+    ((c) == 'F' || (c) == 'f') ? SEG7_GLYPH_F :                             \
+    ((c) == 'G' || (c) == 'g') ? SEG7_GLYPH_G :                             \
+    ((c) == 'H')               ? SEG7_GLYPH_H :                             \
+    ((c) == 'h')               ? SEG7_GLYPH_h :                             \
+    ((c) == 'I' || (c) == 'i') ? SEG7_GLYPH_I :                             \
+    ((c) == 'J' || (c) == 'j') ? SEG7_GLYPH_J :                             \
+    ((c) == 'L' || (c) == 'l') ? SEG7_GLYPH_L :                             \
+    ((c) == 'N' || (c) == 'n') ? SEG7_GLYPH_n :                             \
+    ((c) == 'O')               ? SEG7_GLYPH_0 :                             \
+    ((c) == 'o')               ? SEG7_GLYPH_o :                             \
+    ((c) == 'P' || (c) == 'p') ? SEG7_GLYPH_P :                             \
+    ((c) == 'Q' || (c) == 'q') ? SEG7_GLYPH_q :                             \
+    ((c) == 'R' || (c) == 'r') ? SEG7_GLYPH_r :                             \
+    ((c) == 'S' || (c) == 's') ? SEG7_GLYPH_S :                             \
+    ((c) == 'T' || (c) == 't') ? SEG7_GLYPH_t :                             \
+    ((c) == 'U')               ? SEG7_GLYPH_U :                             \
+    ((c) == 'u')               ? SEG7_GLYPH_u :                             \
+    ((c) == 'Y' || (c) == 'y') ? SEG7_GLYPH_y :                             \
+    ((c) == '-')               ? SEG7_GLYPH_MINUS :                         \
+    ((c) == '_')               ? SEG7_GLYPH_UNDER :                         \
+    ((c) == '=')               ? SEG7_GLYPH_EQUALS :                        \
+    ((c) == '\'')              ? SEG7_SEG_F :                               \
+    SEG7_GLYPH_BLANK)
+
+#define SEG7_DIGIT(d) (                                                     \
+    ((d) == 0) ? SEG7_GLYPH_0 : ((d) == 1) ? SEG7_GLYPH_1 :                 \
+    ((d) == 2) ? SEG7_GLYPH_2 : ((d) == 3) ? SEG7_GLYPH_3 :                 \
+    ((d) == 4) ? SEG7_GLYPH_4 : ((d) == 5) ? SEG7_GLYPH_5 :                 \
+    ((d) == 6) ? SEG7_GLYPH_6 : ((d) == 7) ? SEG7_GLYPH_7 :                 \
+    ((d) == 8) ? SEG7_GLYPH_8 : SEG7_GLYPH_9)
+
+/*=============================================================================
+ * PORT WORDS
+ *============================================================================*/
+#define SEG7_BIT(p, seg, pin)   ((((uint32_t)(p) >> (seg)) & 1u) << (pin))
+
+/* Pins of the segments set in pattern p */
+#define SEG7_PINS(p)    (SEG7_BIT(p, 0, SEG7_PIN_A) | SEG7_BIT(p, 1, SEG7_PIN_B) | \
+                         SEG7_BIT(p, 2, SEG7_PIN_C) | SEG7_BIT(p, 3, SEG7_PIN_D) | \
+                         SEG7_BIT(p, 4, SEG7_PIN_E) | SEG7_BIT(p, 5, SEG7_PIN_F) | \
+                         SEG7_BIT(p, 6, SEG7_PIN_G) | SEG7_BIT(p, 7, SEG7_PIN_DP))
+
+#define SEG7_MASK       SEG7_PINS(0xFF)         // Every segment line
+
+/* Levels of all segment lines that show pattern p */
+#define SEG7_WORD(p)    (SEG7_PINS(p) ^ (SEG7_ACTIVE_LOW ? SEG7_MASK : 0u))
+
+/* A word with the point lit as well, for either polarity */
+#define SEG7_WITH_DP(w) (((w) & ~SEG7_PINS(SEG7_SEG_DP)) | \
+                         (SEG7_WORD(SEG7_SEG_DP) & SEG7_PINS(SEG7_SEG_DP)))
+
+/* Initializer for a table of the words for 0-9, A-F:
+ *     const uint32_t seg_words[16] = { SEG7_HEX_WORDS };
+ */
+#define SEG7_HEX_WORDS                                                      \
+    SEG7_WORD(SEG7_GLYPH_0), SEG7_WORD(SEG7_GLYPH_1), SEG7_WORD(SEG7_GLYPH_2), \
+    SEG7_WORD(SEG7_GLYPH_3), SEG7_WORD(SEG7_GLYPH_4), SEG7_WORD(SEG7_GLYPH_5), \
+    SEG7_WORD(SEG7_GLYPH_6), SEG7_WORD(SEG7_GLYPH_7), SEG7_WORD(SEG7_GLYPH_8), \
+    SEG7_WORD(SEG7_GLYPH_9), SEG7_WORD(SEG7_GLYPH_A), SEG7_WORD(SEG7_GLYPH_B), \
+    SEG7_WORD(SEG7_GLYPH_C), SEG7_WORD(SEG7_GLYPH_D), SEG7_WORD(SEG7_GLYPH_E), \
+    SEG7_WORD(SEG7_GLYPH_F)
+
+#endif /* SEG7_H */
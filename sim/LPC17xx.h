@@ -0,0 +1,353 @@
+/******************************************************************************
+ * FILE: sim/LPC17xx.h
+ * DESCRIPTION: Host stand-in for the CMSIS LPC17xx.h device header
+ * OPERATION: Lab sources compiled with -Isim pick this header up instead of
+ *            the Keil one. Register names and layouts match CMSIS, but each
+ *            peripheral macro (LPC_GPIO0, LPC_TIM0, ...) calls into the
+ *            simulator. That call settles the previous register write,
+ *            charges the access cost to the virtual clock and may run
+ *            pending interrupt handlers before the access goes ahead.
+ * LIMITS: Write-1-to-clear IR registers carry a marker in bit 31 so writes
+ *         can be told apart from reads; code must not compare whole IR
+ *         values. ADGDR DONE clears when the next conversion starts, not on
+ *         read. GPDMA addresses are 32-bit, so DMA buffers and descriptors
+ *         must be static (they share the upper address bits of the
+ *         simulator's own data on a 64-bit host). The same holds for the
+ *         RAM source buffer of an IAP copy. Flash is not mapped at its
+ *         real addresses: firmware reads it through FLASH_PTR(addr).
+ *         The board leaves reset with the clocks SystemInit() sets up
+ *         (PLL0 from the 12 MHz crystal, CCLK 100 MHz), not on the IRC.
+ *         Too few FLASHCFG wait states for CCLK stop the simulation.
+         Bit-band aliases and the AHB SRAM are reached through
+         BITBAND_ALIAS_PTR() / BITBAND_WORD_PTR() (see bitband.h); a store
+         through an alias lands when the next peripheral access settles
+         it, like a register write.
+ ******************************************************************************/
+
+#ifndef SIM_LPC17XX_H
+#define SIM_LPC17XX_H
+
+#include <stdint.h>
+
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+
+/*=============================================================================
+ * INTERRUPT NUMBERS (same values as CMSIS)
+ *============================================================================*/
+typedef enum {
+    SysTick_IRQn    = -1,
+    WDT_IRQn        = 0,
+    TIMER0_IRQn     = 1,
+    TIMER1_IRQn     = 2,
+    TIMER2_IRQn     = 3,
+    TIMER3_IRQn     = 4,
+    EINT3_IRQn      = 21,
+    ADC_IRQn        = 22,
+    DMA_IRQn        = 26,
+    SIM_IRQ_COUNT   = 35
+} IRQn_Type;
+
+/*=============================================================================
+ * PERIPHERAL REGISTER LAYOUTS
+ *============================================================================*/
+typedef struct {
+    __IO uint32_t FIODIR;
+    uint32_t RESERVED0[3];
+    __IO uint32_t FIOMASK;
+    __IO uint32_t FIOPIN;
+    __IO uint32_t FIOSET;
+    __O  uint32_t FIOCLR;
+} LPC_GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t IR;
+    __IO uint32_t TCR;
+    __IO uint32_t TC;
+    __IO uint32_t PR;
+    __IO uint32_t PC;
+    __IO uint32_t MCR;
+    __IO uint32_t MR0;
+    __IO uint32_t MR1;
+    __IO uint32_t MR2;
+    __IO uint32_t MR3;
+    __IO uint32_t CCR;
+    __I  uint32_t CR0;
+    __I  uint32_t CR1;
+    uint32_t RESERVED0[2];
+    __IO uint32_t EMR;
+    uint32_t RESERVED1[12];
+    __IO uint32_t CTCR;
+} LPC_TIM_TypeDef;
+
+typedef struct {
+    __IO uint32_t FLASHCFG;
+    uint32_t RESERVED0[31];
+    __IO uint32_t PLL0CON;
+    __IO uint32_t PLL0CFG;
+    __I  uint32_t PLL0STAT;
+    __O  uint32_t PLL0FEED;
+    uint32_t RESERVED1[12];
+    __IO uint32_t PCON;
+    __IO uint32_t PCONP;
+    uint32_t RESERVED3[15];
+    __IO uint32_t CCLKCFG;
+    __IO uint32_t USBCLKCFG;
+    __IO uint32_t CLKSRCSEL;
+    uint32_t RESERVED4[12];
+    __IO uint32_t EXTINT;
+    uint32_t RESERVED5;
+    __IO uint32_t EXTMODE;
+    __IO uint32_t EXTPOLAR;
+    uint32_t RESERVED6[12];
+    __IO uint32_t RSID;
+    uint32_t RESERVED7[7];
+    __IO uint32_t SCS;
+    __IO uint32_t IRCTRIM;
+    __IO uint32_t PCLKSEL0;
+    __IO uint32_t PCLKSEL1;
+    uint32_t RESERVED8[4];
+    __IO uint32_t USBIntSt;
+    __IO uint32_t DMAREQSEL;
+    __IO uint32_t CLKOUTCFG;
+} LPC_SC_TypeDef;
+
+typedef struct {
+    __IO uint32_t PINSEL0;
+    __IO uint32_t PINSEL1;
+    __IO uint32_t PINSEL2;
+    __IO uint32_t PINSEL3;
+    __IO uint32_t PINSEL4;
+    __IO uint32_t PINSEL5;
+    __IO uint32_t PINSEL6;
+    __IO uint32_t PINSEL7;
+    __IO uint32_t PINSEL8;
+    __IO uint32_t PINSEL9;
+    __IO uint32_t PINSEL10;
+    uint32_t RESERVED0[5];
+    __IO uint32_t PINMODE0;
+    __IO uint32_t PINMODE1;
+    __IO uint32_t PINMODE2;
+    __IO uint32_t PINMODE3;
+    __IO uint32_t PINMODE4;
+    __IO uint32_t PINMODE5;
+    __IO uint32_t PINMODE6;
+    __IO uint32_t PINMODE7;
+    __IO uint32_t PINMODE8;
+    __IO uint32_t PINMODE9;
+    __IO uint32_t PINMODE_OD0;
+    __IO uint32_t PINMODE_OD1;
+    __IO uint32_t PINMODE_OD2;
+    __IO uint32_t PINMODE_OD3;
+    __IO uint32_t PINMODE_OD4;
+    __IO uint32_t I2CPADCFG;
+} LPC_PINCON_TypeDef;
+
+typedef struct {
+    __IO uint32_t ADCR;
+    __IO uint32_t ADGDR;
+    uint32_t RESERVED0;
+    __IO uint32_t ADINTEN;
+    __I  uint32_t ADDR0;
+    __I  uint32_t ADDR1;
+    __I  uint32_t ADDR2;
+    __I  uint32_t ADDR3;
+    __I  uint32_t ADDR4;
+    __I  uint32_t ADDR5;
+    __I  uint32_t ADDR6;
+    __I  uint32_t ADDR7;
+    __I  uint32_t ADSTAT;
+    __IO uint32_t ADTRM;
+} LPC_ADC_TypeDef;
+
+typedef struct {
+    __I  uint32_t DMACIntStat;
+    __I  uint32_t DMACIntTCStat;
+    __O  uint32_t DMACIntTCClear;
+    __I  uint32_t DMACIntErrStat;
+    __O  uint32_t DMACIntErrClr;
+    __I  uint32_t DMACRawIntTCStat;
+    __I  uint32_t DMACRawIntErrStat;
+    __I  uint32_t DMACEnbldChns;
+    __IO uint32_t DMACSoftBReq;
+    __IO uint32_t DMACSoftSReq;
+    __IO uint32_t DMACSoftLBReq;
+    __IO uint32_t DMACSoftLSReq;
+    __IO uint32_t DMACConfig;
+    __IO uint32_t DMACSync;
+} LPC_GPDMA_TypeDef;
+
+typedef struct {
+    __IO uint32_t DMACCSrcAddr;
+    __IO uint32_t DMACCDestAddr;
+    __IO uint32_t DMACCLLI;
+    __IO uint32_t DMACCControl;
+    __IO uint32_t DMACCConfig;
+} LPC_GPDMACH_TypeDef;
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __I  uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DHCSR;
+    __O  uint32_t DCRSR;
+    __IO uint32_t DCRDR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk          (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk      (1UL << 24)
+
+/*=============================================================================
+ * MEMORY MAP (same names as CMSIS) - for address arithmetic only; the
+ * simulator decodes these in BITBAND_ALIAS_PTR() / BITBAND_WORD_PTR()
+ *============================================================================*/
+#define LPC_AHBRAM0_BASE    (0x2007C000UL)
+#define LPC_AHBRAM1_BASE    (0x20080000UL)
+#define LPC_GPIO_BASE       (0x2009C000UL)
+#define LPC_APB0_BASE       (0x40000000UL)
+#define LPC_APB1_BASE       (0x40080000UL)
+
+#define LPC_GPIO0_BASE      (LPC_GPIO_BASE + 0x00000)
+#define LPC_GPIO1_BASE      (LPC_GPIO_BASE + 0x00020)
+#define LPC_GPIO2_BASE      (LPC_GPIO_BASE + 0x00040)
+#define LPC_GPIO3_BASE      (LPC_GPIO_BASE + 0x00060)
+#define LPC_GPIO4_BASE      (LPC_GPIO_BASE + 0x00080)
+#define LPC_TIM0_BASE       (LPC_APB0_BASE + 0x04000)
+#define LPC_TIM1_BASE       (LPC_APB0_BASE + 0x08000)
+#define LPC_PINCON_BASE     (LPC_APB0_BASE + 0x2C000)
+#define LPC_ADC_BASE        (LPC_APB0_BASE + 0x34000)
+#define LPC_TIM2_BASE       (LPC_APB1_BASE + 0x10000)
+#define LPC_TIM3_BASE       (LPC_APB1_BASE + 0x14000)
+#define LPC_SC_BASE         (LPC_APB1_BASE + 0x7C000)
+
+/*=============================================================================
+ * PERIPHERAL ACCESS - every use goes through the simulator
+ *============================================================================*/
+LPC_GPIO_TypeDef   *sim_gpio(int port);
+LPC_TIM_TypeDef    *sim_tim(int n);
+LPC_SC_TypeDef     *sim_sc(void);
+LPC_PINCON_TypeDef *sim_pincon(void);
+LPC_ADC_TypeDef    *sim_adc(void);
+LPC_GPDMA_TypeDef  *sim_gpdma(void);
+LPC_GPDMACH_TypeDef *sim_gpdmach(int n);
+SysTick_Type       *sim_systick(void);
+DWT_Type           *sim_dwt(void);
+CoreDebug_Type     *sim_coredebug(void);
+
+#define LPC_GPIO0       (sim_gpio(0))
+#define LPC_GPIO1       (sim_gpio(1))
+#define LPC_GPIO2       (sim_gpio(2))
+#define LPC_GPIO3       (sim_gpio(3))
+#define LPC_GPIO4       (sim_gpio(4))
+#define LPC_TIM0        (sim_tim(0))
+#define LPC_TIM1        (sim_tim(1))
+#define LPC_TIM2        (sim_tim(2))
+#define LPC_TIM3        (sim_tim(3))
+#define LPC_SC          (sim_sc())
+#define LPC_PINCON      (sim_pincon())
+#define LPC_ADC         (sim_adc())
+#define LPC_GPDMA       (sim_gpdma())
+#define LPC_GPDMACH0    (sim_gpdmach(0))
+#define LPC_GPDMACH1    (sim_gpdmach(1))
+#define LPC_GPDMACH2    (sim_gpdmach(2))
+#define LPC_GPDMACH3    (sim_gpdmach(3))
+#define LPC_GPDMACH4    (sim_gpdmach(4))
+#define LPC_GPDMACH5    (sim_gpdmach(5))
+#define LPC_GPDMACH6    (sim_gpdmach(6))
+#define LPC_GPDMACH7    (sim_gpdmach(7))
+#define SysTick         (sim_systick())
+#define DWT             (sim_dwt())
+#define CoreDebug       (sim_coredebug())
+
+/*=============================================================================
+ * CORE / CMSIS FUNCTIONS
+ *============================================================================*/
+extern _Thread_local uint32_t SystemCoreClock;  // Per board, see sim.c
+void SystemInit(void);
+void SystemCoreClockUpdate(void);
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+uint32_t SysTick_Config(uint32_t ticks);
+uint32_t ITM_SendChar(uint32_t ch);         // Debug channel -> host stdout
+
+void __WFI(void);
+void __enable_irq(void);
+void __disable_irq(void);
+void __NOP(void);
+uint32_t __LDREXW(volatile uint32_t *addr);
+uint32_t __STREXW(uint32_t value, volatile uint32_t *addr);
+void __CLREX(void);
+#define __CLZ(x)        ((uint32_t)((x) ? __builtin_clz(x) : 32))
+#define __DMB()         __asm__ volatile("" ::: "memory")
+#define __DSB()         __asm__ volatile("" ::: "memory")
+#define __ISB()         __asm__ volatile("" ::: "memory")
+
+/*=============================================================================
+ * ON-CHIP FLASH - IAP boot ROM entry and flash reads (see iap.h)
+ *============================================================================*/
+void sim_iap(uint32_t *command, uint32_t *result);
+const void *sim_flash_ptr(uint32_t addr);   // Charges one flash line read
+
+#define IAP_ENTRY       sim_iap
+#define FLASH_PTR(addr) sim_flash_ptr(addr)
+
+/*=============================================================================
+ * BIT-BAND - alias words and the AHB SRAM they cover (see bitband.h)
+ *============================================================================*/
+volatile uint32_t *sim_bitband_alias(uint32_t alias);  // Reads 0/1, stores bit 0
+volatile uint32_t *sim_bitband_word(uint32_t addr);    // AHB SRAM or register
+
+#define BITBAND_ALIAS_PTR(alias)    sim_bitband_alias(alias)
+#define BITBAND_WORD_PTR(addr)      sim_bitband_word(addr)
+
+/*=============================================================================
+ * EXCEPTION FRAME - the PC an interrupt stacked (see pc_prof.c): the call
+ * site of the simulated access it was taken in, as a link-time address
+ * of the host program
+ *============================================================================*/
+uint32_t sim_stacked_pc(void);
+
+#define EXC_STACKED_PC()    sim_stacked_pc()
+
+/*=============================================================================
+ * STACK - the host stack, for stack_paint.c: the top is the frame of
+ * stack_paint(), and the margin clears the x86-64 red zone
+ *============================================================================*/
+#define STACK_SIZE          0x00010000UL
+#define STACK_TOP()         ((uintptr_t)__builtin_frame_address(0))
+#if defined(__x86_64__)
+#define STACK_SP()          ({ uintptr_t sp_; __asm__ volatile("mov %%rsp, %0" : "=r"(sp_)); sp_; })
+#else
+#define STACK_SP()          ((uintptr_t)__builtin_frame_address(0))
+#endif
+#define STACK_PAINT_MARGIN  256
+
+/*=============================================================================
+ * DELAY LOOPS - see sim_delay_mode() in sim.h
+ *============================================================================*/
+typedef enum { SIM_DELAY_NATIVE, SIM_DELAY_PASSES, SIM_DELAY_FAST } sim_delay_mode_t;
+
+int sim_delay_loop(uint32_t passes, uint32_t loop_cycles);  // 1 = loop already timed
+
+#define DELAY_LOOP_SKIP(passes, loop_cycles)    sim_delay_loop((passes), (loop_cycles))
+
+/* Inline "nop" in the lab delay loops costs one virtual cycle */
+#define __asm(x)        __NOP()
+
+#endif /* SIM_LPC17XX_H */
@@ -0,0 +1,146 @@
+/******************************************************************************
+ * FILE: sim/bench_coro.c
+ * DESCRIPTION: Host benchmark for coro.c - cost of one coroutine resume
+ *              through coro_run() against calling a hand-flattened switch
+ *              state machine, the cost of passing over coroutines that are
+ *              still waiting, and the frame sizes
+ * BUILD: gcc -O2 -Isim -I. -DCORO_ARENA_BYTES=1024 sim/sim.c coro.c
+ *            sim/bench_coro.c -o bench_coro
+ * NOTE: coro_now_us() reads the simulated DWT, a host function call, once
+ *       per scheduler pass; it is in the coro_run() figures. Sizes are the
+ *       host's; on the Cortex-M3 coro_t is 28 bytes (48 with CORO_PROFILE).
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sim.h"
+#include "coro.h"
+
+#define RESUMES         20000000UL  // Per run, over all coroutines
+#define COROUTINES      8
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile uint32_t sink;
+
+/*=============================================================================
+ * COROUTINE: four steps per round, a yield after each
+ *============================================================================*/
+typedef struct {
+    coro_t co;
+    uint32_t n;
+} step_frame_t;
+
+static uint32_t rounds;
+static int steppers_left;
+
+static char stepper(coro_t *co) {
+    step_frame_t *f = (step_frame_t *)co;
+
+    CORO_BEGIN(co);
+    for (f->n = 0; f->n < rounds; f->n++) {
+        sink += 1;
+        CORO_YIELD(co);
+        sink += 2;
+        CORO_YIELD(co);
+        sink += 3;
+        CORO_YIELD(co);
+        sink += 4;
+        CORO_YIELD(co);
+    }
+    steppers_left--;
+    CORO_END(co);
+}
+
+/* Wakes once a millisecond (of simulated time) until the steppers end:
+ * almost every pass the scheduler only checks its deadline */
+static char sleeper(coro_t *co) {
+    CORO_BEGIN(co);
+    while (steppers_left) {
+        await_delay(co, 1000);
+    }
+    CORO_END(co);
+}
+
+/*=============================================================================
+ * REFERENCE: the same steps as a switch on a state variable
+ *============================================================================*/
+typedef struct {
+    unsigned char state;
+    uint32_t n;
+} step_machine_t;
+
+static __attribute__((noinline)) int machine_step(step_machine_t *m) {
+    switch (m->state) {
+    case 0: sink += 1; m->state = 1; break;
+    case 1: sink += 2; m->state = 2; break;
+    case 2: sink += 3; m->state = 3; break;
+    case 3: sink += 4; m->state = 0; m->n++; break;
+    }
+    return m->n < rounds;
+}
+
+/*=============================================================================
+ * RUNS - ns per resume (or step)
+ *============================================================================*/
+static void spawn(coro_fn_t fn, const char *name, unsigned int bytes) {
+    if (!coro_spawn(fn, name, bytes)) {
+        fprintf(stderr, "arena full: build with -DCORO_ARENA_BYTES=1024\n");
+        exit(1);
+    }
+}
+
+static double run_coro(int active, int waiting) {
+    double t;
+    int k;
+
+    rounds = RESUMES / 4 / active;
+    steppers_left = active;
+    coro_init(100000000UL);
+    for (k = 0; k < waiting; k++) {
+        spawn(sleeper, "sleep", sizeof(coro_t));
+    }
+    for (k = 0; k < active; k++) {
+        spawn(stepper, "step", sizeof(step_frame_t));
+    }
+    t = now_seconds();
+    coro_run(0);
+    return (now_seconds() - t) * 1e9 / (4.0 * rounds * active);
+}
+
+static double run_machine(int active) {
+    step_machine_t m[COROUTINES] = { { 0, 0 } };
+    double t;
+    int k, live;
+
+    rounds = RESUMES / 4 / active;
+    t = now_seconds();
+    do {
+        live = 0;
+        for (k = 0; k < active; k++) {
+            live |= machine_step(&m[k]);
+        }
+    } while (live);
+    return (now_seconds() - t) * 1e9 / (4.0 * rounds * active);
+}
+
+int main(void) {
+    sim_reset();
+
+    printf("Host ns per resume (per step for the switch)\n");
+    printf("  running  waiting  coro_run  switch\n");
+    printf("  1        0        %8.2f  %6.2f\n", run_coro(1, 0), run_machine(1));
+    printf("  %-8d 0        %8.2f  %6.2f\n", COROUTINES, run_coro(COROUTINES, 0),
+           run_machine(COROUTINES));
+    printf("  1        %-8d %8.2f       -\n", COROUTINES - 1, run_coro(1, COROUTINES - 1));
+
+    printf("\nFrame bytes (host)\n");
+    printf("  coro_t %zu, with a uint32_t local %zu, arena %d\n", sizeof(coro_t),
+           sizeof(step_frame_t), CORO_ARENA_BYTES);
+    return 0;
+}
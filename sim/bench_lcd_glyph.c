@@ -0,0 +1,140 @@
+/******************************************************************************
+ * FILE: sim/bench_lcd_glyph.c
+ * DESCRIPTION: Host benchmark for lcd_glyph.c - LCD bytes per frame of an
+ *              animated bar graph drawn through the CGRAM glyph cache,
+ *              against re-uploading the bar glyphs every frame
+ * BUILD: gcc -O2 -I. lcd_glyph.c sim/bench_lcd_glyph.c -lm -o bench_lcd_glyph
+ * SCHEMES:
+ *   cached      lcd_bargraph(): the partial cell's glyph is uploaded only
+ *               on a cache miss
+ *   naive all   every frame uploads the 4 bar glyphs (4 x 9 bytes), then
+ *               positions the cursor and writes the cells
+ *   naive used  every frame uploads only the glyph the partial cell needs
+ *               (9 bytes when there is one), then the cells
+ * ANIMATIONS:
+ *   sweep  16 cells, 0..80..0 columns one step per frame, 10 times
+ *   adc    the DIFF_BAR layout of "include LPC17xx hfdfad.c": 6 cells,
+ *          0..3300 mV, the difference moving along a sine of 500 frames
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include "lcd_glyph.h"
+
+#define SWEEP_CELLS     16
+#define SWEEP_REPEATS   10
+#define ADC_CELLS       6
+#define ADC_FULL_MV     3300
+#define ADC_FRAMES      5000
+#define ADC_PERIOD      500
+
+/*=============================================================================
+ * LCD STUB - counts the bytes put on the bus
+ *============================================================================*/
+static unsigned long bus_bytes;
+
+void lcd_cmd(unsigned char cmd) {
+    (void)cmd;
+    bus_bytes++;
+}
+
+void lcd_data(unsigned char data) {
+    (void)data;
+    bus_bytes++;
+}
+
+/*=============================================================================
+ * NAIVE RENDERERS - same cells as lcd_bargraph(), no cache
+ *============================================================================*/
+static void upload(unsigned char slot) {
+    unsigned char row;
+
+    lcd_cmd(0x40 | (slot << 3));
+    for (row = 0; row < 8; row++) {
+        lcd_data(0);                    // Bitmap does not change the count
+    }
+}
+
+static void naive_bargraph(int all, unsigned char cells,
+                           unsigned int value, unsigned int full_scale) {
+    unsigned long columns = (value >= full_scale)
+                          ? (unsigned long)cells * BAR_COLS_PER_CELL
+                          : ((unsigned long)value * cells * BAR_COLS_PER_CELL) / full_scale;
+    unsigned char partial = columns % BAR_COLS_PER_CELL, slot, c;
+
+    if (all) {
+        for (slot = 0; slot < 4; slot++) {
+            upload(slot);
+        }
+    } else if (partial != 0) {
+        upload(partial - 1);
+    }
+    lcd_cmd(0x80);
+    for (c = 0; c < cells; c++) {
+        lcd_data(BAR_CHAR_EMPTY);
+    }
+}
+
+/*=============================================================================
+ * ANIMATIONS - the value of frame f, or -1 past the end
+ *============================================================================*/
+static long sweep_value(unsigned long f) {
+    unsigned long steps = SWEEP_CELLS * BAR_COLS_PER_CELL, period = 2 * steps;
+
+    if (f >= SWEEP_REPEATS * period) {
+        return -1;
+    }
+    f %= period;
+    return (long)(f <= steps ? f : period - f);
+}
+
+static long adc_value(unsigned long f) {
+    if (f >= ADC_FRAMES) {
+        return -1;
+    }
+    return lround(ADC_FULL_MV * 0.5 * (1.0 - cos(6.283185307179586 * f / ADC_PERIOD)));
+}
+
+/*=============================================================================
+ * RUNS - bytes per frame for one scheme
+ *============================================================================*/
+enum { CACHED, NAIVE_ALL, NAIVE_USED };
+
+static double run(int scheme, long (*value)(unsigned long), unsigned char cells,
+                  unsigned int full_scale, unsigned long *frames) {
+    unsigned long f;
+    long v;
+
+    glyph_cache_init();
+    bus_bytes = 0;
+    for (f = 0; (v = value(f)) >= 0; f++) {
+        if (scheme == CACHED) {
+            lcd_bargraph(0, 0, cells, (unsigned int)v, full_scale);
+        } else {
+            naive_bargraph(scheme == NAIVE_ALL, cells, (unsigned int)v, full_scale);
+        }
+    }
+    *frames = f;
+    return (double)bus_bytes / f;
+}
+
+static void report(const char *name, long (*value)(unsigned long),
+                   unsigned char cells, unsigned int full_scale) {
+    unsigned long frames;
+    double cached = run(CACHED, value, cells, full_scale, &frames);
+    unsigned long misses = glyph_cache.misses;
+    unsigned int hit_rate = glyph_cache_hit_rate();
+    double all = run(NAIVE_ALL, value, cells, full_scale, &frames);
+    double used = run(NAIVE_USED, value, cells, full_scale, &frames);
+
+    printf("  %-6s %5lu  %5u  %7.2f  %6lu  %3u %%  %9.2f  %10.2f\n", name, frames,
+           cells, cached, misses, hit_rate, all, used);
+}
+
+int main(void) {
+    printf("LCD bytes per frame\n");
+    printf("  run    frames  cells   cached  misses   hits  naive all  naive used\n");
+    report("sweep", sweep_value, SWEEP_CELLS, SWEEP_CELLS * BAR_COLS_PER_CELL);
+    report("adc", adc_value, ADC_CELLS, ADC_FULL_MV);
+    return 0;
+}
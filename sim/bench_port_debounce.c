@@ -0,0 +1,172 @@
+/******************************************************************************
+ * FILE: sim/bench_port_debounce.c
+ * DESCRIPTION: Host benchmark for port_debounce.h - cost per tick of the
+ *              vertical-counter debouncer against a per-pin counter loop
+ *              for 1 and 32 pins, and a check that 32 independently
+ *              bouncing pins each report every press exactly once
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c port_debounce.c sim/bench_port_debounce.c -o bench_port_debounce
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+#include "port_debounce.h"
+
+#define BENCH_TICKS     50000000UL  // Throughput run length
+#define CHECK_TICKS     2000000UL   // Correctness run length (5 ms ticks)
+#define PIN_SAMPLES     4           // Per-pin method: samples to accept a level
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rand32(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/*=============================================================================
+ * REFERENCE: one saturating counter per pin, the usual loop
+ *============================================================================*/
+typedef struct {
+    uint32_t state, pressed;
+    unsigned char count[32];
+} pin_debounce_t;
+
+static uint32_t pin_debounce_tick(pin_debounce_t *d, uint32_t pins, int npins) {
+    uint32_t toggle = 0;
+    int i;
+
+    for (i = 0; i < npins; i++) {
+        uint32_t bit = 1u << i;
+        if ((pins ^ d->state) & bit) {
+            if (++d->count[i] >= PIN_SAMPLES) {
+                d->count[i] = 0;
+                toggle |= bit;
+            }
+        } else {
+            d->count[i] = 0;
+        }
+    }
+    d->state ^= toggle;
+    d->pressed |= toggle & d->state;
+    return toggle;
+}
+
+/*=============================================================================
+ * THROUGHPUT - input words come from a table of random bounce-like data
+ *============================================================================*/
+static uint32_t input[4096];
+
+static double bench_vertical(uint32_t mask) {
+    port_debounce_t d;
+    volatile uint32_t sink = 0;
+    unsigned long n;
+    double t0;
+
+    port_debounce_init(&d, 0, 0);
+    t0 = now_seconds();
+    for (n = 0; n < BENCH_TICKS; n++) {
+        sink ^= port_debounce_tick(&d, input[n & 4095] & mask);
+    }
+    (void)sink;
+    return (now_seconds() - t0) * 1e9 / BENCH_TICKS;
+}
+
+static double bench_per_pin(int npins) {
+    static pin_debounce_t d;
+    volatile uint32_t sink = 0;
+    unsigned long n;
+    double t0;
+
+    t0 = now_seconds();
+    for (n = 0; n < BENCH_TICKS; n++) {
+        sink ^= pin_debounce_tick(&d, input[n & 4095], npins);
+    }
+    (void)sink;
+    return (now_seconds() - t0) * 1e9 / BENCH_TICKS;
+}
+
+/*=============================================================================
+ * CORRECTNESS - every pin is pressed and released at random; each level
+ * change is preceded by 0-2 ticks of random chatter. Every press must give
+ * exactly one 'pressed' edge, no later than 4 ticks after the chatter ends.
+ *============================================================================*/
+static int check_edges(void) {
+    port_debounce_t d;
+    uint32_t level = 0, pins, edges;
+    unsigned long t, presses[32] = { 0 }, seen[32] = { 0 };
+    unsigned long settle_at[32] = { 0 }, late = 0, total_presses = 0, total_seen = 0;
+    unsigned char chatter[32] = { 0 };
+    int i, errors = 0;
+
+    port_debounce_init(&d, 0xFFFFFFFF, 0xFFFFFFFF);     // All active-low, idle high
+    for (t = 0; t < CHECK_TICKS; t++) {
+        for (i = 0; i < 32; i++) {
+            if (chatter[i] == 0 && t >= settle_at[i] + 8 && (rand32() & 63) == 0) {
+                level ^= 1u << i;                       // Next press or release
+                if (level & (1u << i)) {
+                    presses[i]++;
+                }
+                chatter[i] = 1 + rand32() % 3;
+            }
+        }
+        pins = ~level;
+        for (i = 0; i < 32; i++) {
+            if (chatter[i]) {
+                if (--chatter[i] && (rand32() & 1)) {
+                    pins ^= 1u << i;                    // Bounce
+                }
+                if (chatter[i] == 0) {
+                    settle_at[i] = t;
+                }
+            }
+        }
+        port_debounce_tick(&d, pins);
+        edges = port_debounce_take_pressed(&d);
+        for (i = 0; i < 32; i++) {
+            if (edges & (1u << i)) {
+                seen[i]++;
+                if (t > settle_at[i] + 4) {
+                    late++;
+                }
+            }
+        }
+    }
+    for (i = 0; i < 32; i++) {
+        if (seen[i] + 1 < presses[i] || seen[i] > presses[i]) {
+            errors++;                       // A press may still be settling at the end
+        }
+        total_presses += presses[i];
+        total_seen += seen[i];
+    }
+    printf("  32 pins, %lu ticks: %lu presses, %lu edges, %lu late, %d pins wrong\n",
+           CHECK_TICKS, total_presses, total_seen, late, errors);
+    return errors || late;
+}
+
+int main(void) {
+    unsigned int n;
+    double v1, v32, p1, p32;
+
+    for (n = 0; n < 4096; n++) {
+        input[n] = rand32() & rand32() & rand32();      // Sparse toggling bits
+    }
+
+    v1 = bench_vertical(1u << 12);
+    v32 = bench_vertical(0xFFFFFFFF);
+    p1 = bench_per_pin(1);
+    p32 = bench_per_pin(32);
+    printf("Host ns per tick (relative to vertical, 1 pin)\n");
+    printf("  vertical counters   1 pin %6.2f (%4.1fx)   32 pins %6.2f (%4.1fx)\n",
+           v1, 1.0, v32, v32 / v1);
+    printf("  per-pin counters    1 pin %6.2f (%4.1fx)   32 pins %6.2f (%4.1fx)\n",
+           p1, p1 / v1, p32, p32 / v1);
+    printf("\nEdge check\n");
+    return check_edges();
+}
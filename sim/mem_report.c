@@ -0,0 +1,273 @@
+/******************************************************************************
+ * FILE: sim/mem_report.c
+ * DESCRIPTION: Flash and RAM use per module, from the object files of a
+ *              build (armcc / arm-none-eabi-gcc .o, or host objects), with
+ *              the largest RAM objects and the room left for the stack
+ * BUILD: gcc -O2 sim/mem_report.c -o mem_report
+ * USAGE: mem_report [-r ram_bytes] [-s stack_bytes] [-h heap_bytes] file.o...
+ *        -r  RAM the data, bss, stack and heap share (default 32768, the
+ *            LPC1768 local SRAM; the AHB SRAM banks are separate)
+ *        -s, -h  stack and heap reservations, when the startup object
+ *            (whose STACK / HEAP areas are recognised) is not listed
+ * OPERATION: allocated sections are sorted by their flags: executable =
+ *            code, read-only = const, writable with contents = data (in
+ *            flash and copied to RAM at start-up), writable without =
+ *            bss. Common symbols (tentative definitions) count as bss.
+ *            Sizes are before linking: alignment padding and library code
+ *            (printf, division helpers) are not included. Build host
+ *            objects with -fno-pie -fno-common, or const tables holding
+ *            pointers show up as writable (relro) data.
+ *            Code and tables moved to SRAM (ram_place.h: sections
+ *            .ramfunc and .ramdata) count as data, since they take flash
+ *            for the load image and RAM for the copy, and are listed by
+ *            name.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#define TOP_OBJECTS         10
+
+typedef struct {
+    const char *name;
+    unsigned long code, rodata, data, bss, reserved;
+} module_t;
+
+typedef struct {
+    const char *module, *name;
+    unsigned long size;
+    int zero;                           // bss rather than data
+} object_t;
+
+static object_t *objects;
+static size_t n_objects;
+static object_t *moved;                 // In .ramfunc / .ramdata; zero = function
+static size_t n_moved;
+
+/*=============================================================================
+ * OBJECT FILES - 32- or 64-bit, little-endian ELF
+ *============================================================================*/
+static unsigned char *load_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    unsigned char *buf;
+    long n;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc((size_t)n);
+    if (!buf || fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        fprintf(stderr, "%s: read failed\n", path);
+        exit(1);
+    }
+    fclose(f);
+    *len = (size_t)n;
+    return buf;
+}
+
+static void add_to(object_t **list, size_t *n, size_t *room, const char *module,
+                   const char *name, unsigned long size, int zero) {
+    if (*n == *room) {
+        *room = *room ? 2 * *room : 256;
+        *list = realloc(*list, *room * sizeof **list);
+    }
+    (*list)[*n].module = module;
+    (*list)[*n].name = name;
+    (*list)[*n].size = size;
+    (*list)[*n].zero = zero;
+    (*n)++;
+}
+
+static void add_object(const char *module, const char *name, unsigned long size, int zero) {
+    static size_t room;
+
+    add_to(&objects, &n_objects, &room, module, name, size, zero);
+}
+
+static void add_moved(const char *module, const char *name, unsigned long size, int func) {
+    static size_t room;
+
+    add_to(&moved, &n_moved, &room, module, name, size, func);
+}
+
+static int is_ram_placed(const char *name) {
+    return !strncmp(name, ".ramfunc", 8) || !strncmp(name, ".ramdata", 8);
+}
+
+static int is_reservation(const char *name) {
+    return !strcmp(name, "STACK") || !strcmp(name, "HEAP") || !strcmp(name, ".stack") ||
+           !strcmp(name, ".heap") || !strcmp(name, ".stack_dummy");
+}
+
+#define READ_SECTIONS(Ehdr, Shdr, Sym, ST_TYPE)                             \
+    do {                                                                    \
+        const Ehdr *eh = (const Ehdr *)img;                                 \
+        const Shdr *sh = (const Shdr *)(img + eh->e_shoff);                 \
+        const char *names = (const char *)(img + sh[eh->e_shstrndx].sh_offset); \
+        int i;                                                              \
+        for (i = 0; i < eh->e_shnum; i++) {                                 \
+            unsigned long size = (unsigned long)sh[i].sh_size;              \
+            if (!(sh[i].sh_flags & SHF_ALLOC)) continue;                    \
+            if (is_reservation(names + sh[i].sh_name)) {                    \
+                m->reserved += size;                                        \
+            } else if (is_ram_placed(names + sh[i].sh_name)) {              \
+                m->data += size;                                            \
+            } else if (sh[i].sh_flags & SHF_EXECINSTR) {                    \
+                m->code += size;                                            \
+            } else if (!(sh[i].sh_flags & SHF_WRITE)) {                     \
+                m->rodata += size;                                          \
+            } else if (sh[i].sh_type == SHT_NOBITS) {                       \
+                m->bss += size;                                             \
+            } else {                                                        \
+                m->data += size;                                            \
+            }                                                               \
+        }                                                                   \
+        for (i = 0; i < eh->e_shnum; i++) {                                 \
+            const Sym *sym;                                                 \
+            const char *str;                                                \
+            size_t k, n;                                                    \
+            if (sh[i].sh_type != SHT_SYMTAB) continue;                      \
+            sym = (const Sym *)(img + sh[i].sh_offset);                     \
+            str = (const char *)(img + sh[sh[i].sh_link].sh_offset);        \
+            n = sh[i].sh_size / sizeof(Sym);                                \
+            for (k = 0; k < n; k++) {                                       \
+                const Shdr *in;                                             \
+                if (ST_TYPE(sym[k].st_info) == STT_FUNC && sym[k].st_size && \
+                    sym[k].st_shndx < eh->e_shnum &&                        \
+                    is_ram_placed(names + sh[sym[k].st_shndx].sh_name)) {   \
+                    add_moved(m->name, str + sym[k].st_name, (unsigned long)sym[k].st_size, 1); \
+                }                                                           \
+                if (ST_TYPE(sym[k].st_info) != STT_OBJECT || !sym[k].st_size) continue; \
+                if (sym[k].st_shndx == SHN_COMMON) {                        \
+                    m->bss += (unsigned long)sym[k].st_size;                \
+                    add_object(m->name, str + sym[k].st_name, (unsigned long)sym[k].st_size, 1); \
+                    continue;                                               \
+                }                                                           \
+                if (sym[k].st_shndx == SHN_UNDEF || sym[k].st_shndx >= eh->e_shnum) continue; \
+                in = &sh[sym[k].st_shndx];                                  \
+                if (is_ram_placed(names + in->sh_name)) {                   \
+                    add_moved(m->name, str + sym[k].st_name, (unsigned long)sym[k].st_size, 0); \
+                }                                                           \
+                if ((in->sh_flags & (SHF_ALLOC | SHF_WRITE)) == (SHF_ALLOC | SHF_WRITE) && \
+                    !is_reservation(names + in->sh_name)) {                 \
+                    add_object(m->name, str + sym[k].st_name, (unsigned long)sym[k].st_size, \
+                               in->sh_type == SHT_NOBITS);                  \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+static void read_module(module_t *m) {
+    size_t len;
+    unsigned char *img = load_file(m->name, &len);
+
+    if (len < EI_NIDENT || memcmp(img, ELFMAG, SELFMAG) != 0 ||
+        img[EI_DATA] != ELFDATA2LSB) {
+        fprintf(stderr, "%s: not a little-endian ELF file\n", m->name);
+        exit(1);
+    }
+    if (img[EI_CLASS] == ELFCLASS32) {
+        READ_SECTIONS(Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, ELF32_ST_TYPE);
+    } else {
+        READ_SECTIONS(Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, ELF64_ST_TYPE);
+    }
+}
+
+/*=============================================================================
+ * REPORT
+ *============================================================================*/
+static int by_size(const void *a, const void *b) {
+    const object_t *x = a, *y = b;
+
+    return (x->size < y->size) - (x->size > y->size);
+}
+
+int main(int argc, char **argv) {
+    unsigned long ram_size = 32768, stack = 0, heap = 0;
+    module_t *mods, total = { "total", 0, 0, 0, 0, 0 };
+    int i, n = 0;
+    size_t k;
+    long left;
+
+    mods = calloc((size_t)argc, sizeof *mods);
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && !strcmp(argv[i], "-r")) {
+            ram_size = strtoul(argv[++i], 0, 0);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            stack = strtoul(argv[++i], 0, 0);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-h")) {
+            heap = strtoul(argv[++i], 0, 0);
+        } else {
+            mods[n].name = argv[i];
+            read_module(&mods[n++]);
+        }
+    }
+    if (n == 0) {
+        fprintf(stderr, "usage: %s [-r ram_bytes] [-s stack_bytes] [-h heap_bytes] file.o...\n",
+                argv[0]);
+        return 2;
+    }
+
+    printf("%-28s %7s %7s %7s %7s   %7s %7s\n", "module", "code", "const", "data", "bss",
+           "flash", "RAM");
+    for (i = 0; i < n; i++) {
+        module_t *m = &mods[i];
+        printf("%-28s %7lu %7lu %7lu %7lu   %7lu %7lu\n", m->name, m->code, m->rodata,
+               m->data, m->bss, m->code + m->rodata + m->data, m->data + m->bss);
+        total.code += m->code;
+        total.rodata += m->rodata;
+        total.data += m->data;
+        total.bss += m->bss;
+        total.reserved += m->reserved;
+    }
+    printf("%-28s %7lu %7lu %7lu %7lu   %7lu %7lu\n\n", total.name, total.code,
+           total.rodata, total.data, total.bss, total.code + total.rodata + total.data,
+           total.data + total.bss);
+
+    if (total.reserved) {
+        stack = total.reserved;             // Startup object: its areas hold both
+        heap = 0;
+        printf("RAM %lu bytes: data+bss %lu, stack+heap areas %lu",
+               ram_size, total.data + total.bss, stack);
+    } else {
+        printf("RAM %lu bytes: data+bss %lu, stack %lu, heap %lu",
+               ram_size, total.data + total.bss, stack, heap);
+    }
+    left = (long)ram_size - (long)(total.data + total.bss + stack + heap);
+    printf(", unused %ld\n", left);
+    if (left > 0) {
+        printf("  the stack could grow to %lu bytes\n", stack + (unsigned long)left);
+    } else if (left < 0) {
+        printf("  over budget by %ld bytes\n", -left);
+    }
+
+    if (n_objects) {
+        qsort(objects, n_objects, sizeof *objects, by_size);
+        printf("\nlargest RAM objects:\n");
+        for (k = 0; k < n_objects && k < TOP_OBJECTS; k++) {
+            printf("  %7lu  %-4s %-24s %s\n", objects[k].size, objects[k].zero ? "bss" : "data",
+                   objects[k].name, objects[k].module);
+        }
+    }
+
+    if (n_moved) {
+        unsigned long code = 0, tables = 0;
+
+        printf("\nmoved to SRAM (RAMFUNC / RAMCONST):\n");
+        for (k = 0; k < n_moved; k++) {
+            printf("  %7lu  %-5s %-24s %s\n", moved[k].size, moved[k].zero ? "code" : "table",
+                   moved[k].name, moved[k].module);
+            if (moved[k].zero) code += moved[k].size;
+            else tables += moved[k].size;
+        }
+        printf("  %7lu  bytes: code %lu, tables %lu (in the data column)\n", code + tables,
+               code, tables);
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/******************************************************************************
+ * FILE: sim/pc_prof_report.c
+ * DESCRIPTION: Flat profile from pc_prof_dump() output - maps each sampled
+ *              code bucket to the function holding it, using the symbol
+ *              table of the program's ELF file (the target .axf / .elf, or
+ *              a host simulator build)
+ * BUILD: gcc -O2 sim/pc_prof_report.c -o pc_prof_report
+ * USAGE: pc_prof_report program.elf [dump.txt]   (dump on stdin if omitted)
+ *        Lines outside PCPROF ... END blocks are skipped, so the whole ITM
+ *        log can be passed in; each block gives one profile.
+ * NOTE: a bucket is charged to the function its first byte belongs to, so
+ *       with 16-byte buckets a few samples can land on the neighbour of a
+ *       short function. ARM symbols have the Thumb bit cleared.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#define MAX_LINE            256
+
+typedef struct {
+    uint64_t addr, size;
+    const char *name;
+    unsigned long count;
+} func_t;
+
+static func_t *funcs;
+static size_t n_funcs;
+static unsigned long unknown;
+
+/*=============================================================================
+ * ELF SYMBOL TABLE - 32- or 64-bit, little-endian
+ *============================================================================*/
+static unsigned char *load_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    unsigned char *buf;
+    long n;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc((size_t)n);
+    if (!buf || fread(buf, 1, (size_t)n, f) != (size_t)n) {
+        fprintf(stderr, "%s: read failed\n", path);
+        exit(1);
+    }
+    fclose(f);
+    *len = (size_t)n;
+    return buf;
+}
+
+static void add_func(uint64_t addr, uint64_t size, const char *name) {
+    static size_t room;
+
+    if (n_funcs == room) {
+        room = room ? 2 * room : 256;
+        funcs = realloc(funcs, room * sizeof *funcs);
+    }
+    funcs[n_funcs].addr = addr;
+    funcs[n_funcs].size = size;
+    funcs[n_funcs].name = name;
+    funcs[n_funcs].count = 0;
+    n_funcs++;
+}
+
+#define READ_SYMBOLS(Ehdr, Shdr, Sym, ST_TYPE)                              \
+    do {                                                                    \
+        const Ehdr *eh = (const Ehdr *)img;                                 \
+        const Shdr *sh = (const Shdr *)(img + eh->e_shoff);                 \
+        int i, pick = -1;                                                   \
+        for (i = 0; i < eh->e_shnum; i++) {                                 \
+            if (sh[i].sh_type == SHT_SYMTAB) pick = i;                      \
+            if (sh[i].sh_type == SHT_DYNSYM && pick < 0) pick = i;          \
+        }                                                                   \
+        if (pick >= 0) {                                                    \
+            const Sym *sym = (const Sym *)(img + sh[pick].sh_offset);       \
+            const char *str = (const char *)(img + sh[sh[pick].sh_link].sh_offset); \
+            size_t k, n = sh[pick].sh_size / sizeof(Sym);                   \
+            for (k = 0; k < n; k++) {                                       \
+                if (ST_TYPE(sym[k].st_info) == STT_FUNC && sym[k].st_shndx != SHN_UNDEF) { \
+                    add_func(sym[k].st_value & thumb_mask, sym[k].st_size,  \
+                             str + sym[k].st_name);                         \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+static int by_addr(const void *a, const void *b) {
+    const func_t *x = a, *y = b;
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static void load_symbols(const char *path) {
+    size_t len, i;
+    unsigned char *img = load_file(path, &len);
+    uint64_t thumb_mask = ~(uint64_t)0;
+
+    if (len < EI_NIDENT || memcmp(img, ELFMAG, SELFMAG) != 0 ||
+        img[EI_DATA] != ELFDATA2LSB) {
+        fprintf(stderr, "%s: not a little-endian ELF file\n", path);
+        exit(1);
+    }
+    if (img[EI_CLASS] == ELFCLASS32) {
+        if (((const Elf32_Ehdr *)img)->e_machine == EM_ARM) {
+            thumb_mask = ~(uint64_t)1;
+        }
+        READ_SYMBOLS(Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, ELF32_ST_TYPE);
+    } else {
+        READ_SYMBOLS(Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, ELF64_ST_TYPE);
+    }
+    if (n_funcs == 0) {
+        fprintf(stderr, "%s: no function symbols (stripped?)\n", path);
+        exit(1);
+    }
+    qsort(funcs, n_funcs, sizeof *funcs, by_addr);
+    for (i = 0; i + 1 < n_funcs; i++) {     // Size 0 (hand-written asm): up to the next
+        if (funcs[i].size == 0) funcs[i].size = funcs[i + 1].addr - funcs[i].addr;
+    }
+}
+
+static func_t *find_func(uint64_t addr) {
+    size_t lo = 0, hi = n_funcs;
+
+    while (lo < hi) {                       // Last function starting at or below addr
+        size_t mid = (lo + hi) / 2;
+        if (funcs[mid].addr <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0 || addr >= funcs[lo - 1].addr + funcs[lo - 1].size) {
+        return 0;
+    }
+    return &funcs[lo - 1];
+}
+
+/*=============================================================================
+ * FLAT PROFILE
+ *============================================================================*/
+static int by_count(const void *a, const void *b) {
+    const func_t *x = *(func_t *const *)a, *y = *(func_t *const *)b;
+
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+static void report(unsigned int block, unsigned long samples, unsigned long outside) {
+    func_t **order = malloc(n_funcs * sizeof *order);
+    size_t i, n = 0;
+    double cum = 0;
+
+    for (i = 0; i < n_funcs; i++) {
+        if (funcs[i].count) order[n++] = &funcs[i];
+    }
+    qsort(order, n, sizeof *order, by_count);
+    printf("profile %u: %lu samples\n", block, samples);
+    printf("      %%    cum %%   samples  function\n");
+    for (i = 0; i < n; i++) {
+        cum += 100.0 * order[i]->count / samples;
+        printf("  %6.2f  %6.2f  %8lu  %s\n", 100.0 * order[i]->count / samples, cum,
+               order[i]->count, order[i]->name);
+        order[i]->count = 0;
+    }
+    if (unknown) {
+        printf("  %6.2f          %8lu  (no symbol)\n", 100.0 * unknown / samples, unknown);
+    }
+    if (outside) {
+        printf("  %6.2f          %8lu  (outside the profiled range)\n",
+               100.0 * outside / samples, outside);
+    }
+    printf("\n");
+    unknown = 0;
+    free(order);
+}
+
+int main(int argc, char **argv) {
+    char line[MAX_LINE];
+    FILE *in = stdin;
+    unsigned long samples = 0, outside = 0, count;
+    unsigned long long addr;
+    unsigned int bytes = 0, blocks = 0;
+    int inside = 0;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s program.elf [dump.txt]\n", argv[0]);
+        return 2;
+    }
+    load_symbols(argv[1]);
+    if (argc == 3 && !(in = fopen(argv[2], "r"))) {
+        perror(argv[2]);
+        return 1;
+    }
+    while (fgets(line, sizeof line, in)) {
+        if (sscanf(line, "PCPROF %llx %u %lu %lu", &addr, &bytes, &samples, &outside) == 4) {
+            inside = 1;
+        } else if (inside && strncmp(line, "END", 3) == 0) {
+            inside = 0;
+            if (samples) report(++blocks, samples, outside);
+        } else if (inside && sscanf(line, "%llx %lu", &addr, &count) == 2) {
+            func_t *f = find_func(addr);
+            if (f) {
+                f->count += count;
+            } else {
+                unknown += count;
+            }
+        }
+    }
+    if (blocks == 0) {
+        fprintf(stderr, "no PCPROF ... END block in the input\n");
+        return 1;
+    }
+    return 0;
+}
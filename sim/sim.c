@@ -0,0 +1,1989 @@
+/******************************************************************************
+ * FILE: sim/sim.c
+ * DESCRIPTION: Host board simulator for the LPC1768 lab programs
+ * MODELS: GPIO0-4 (FIOMASK, FIOSET/FIOCLR/FIOPIN, external inputs),
+ *         TIMER0-3 (prescaler, 4 match registers, 2 capture channels,
+ *         counter mode, external match outputs), SysTick, single ADC
+ *         conversions started by software or a timer match edge, GPDMA
+ *         channels fed by timer match requests (M2P/P2M, linked lists),
+ *         NVIC priorities/nesting and PRIMASK, on-chip flash with the
+ *         IAP erase/program commands, PLL0 (feed sequence, lock time),
+ *         CCLKCFG, CLKSRCSEL and the FLASHCFG wait states, the AHB SRAM
+ *         and bit-band aliases over it, GPIO and the APB registers. The
+ *         stacked PC of an exception is the firmware call site of the
+ *         access (or __WFI / sim_charge) the interrupt was taken in.
+ * TIMING: One virtual cycle = one CCLK cycle. Peripherals advance in exact
+ *         steps between "interesting" instants (timer matches, SysTick
+ *         underflow, ADC done, scheduled events), so interrupts are
+ *         dispatched at the cycle they become pending. When the firmware
+ *         changes CCLK, real time (sim_ns) is rebased at that cycle.
+ ******************************************************************************/
+
+#define _GNU_SOURCE                         // dl_iterate_phdr()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <link.h>
+#include "sim.h"
+
+#define SIM_MAX_EVENTS      4096
+#define SIM_MAX_BOUNCE      8               // Input pins with a bounce profile
+#define SIM_IR_MARK         0x80000000u     // Marks IR values published by the sim
+#define SIM_NEVER           ((sim_time_t)-1)
+#define SIM_THREAD_PRIO     256             // Execution priority of thread mode
+#define SIM_IRQ_INDEX(irq)  ((int)(irq) + 1)
+#define SIM_DISPATCH_LIMIT  1000000         // Handler never clears its source?
+#define SIM_AHBRAM_SIZE     0x8000u         // AHB SRAM banks 0 and 1
+#define SIM_BITBAND_SLOTS   8               // Alias words live at once
+
+/* Sim-side write access to registers that are read-only for firmware */
+#define SIM_RO(reg)         (*(volatile uint32_t *)&(reg))
+
+/* Firmware call site of the access under way: the PC that an interrupt
+ * taken during it would stack */
+#define SIM_CALLER()        (sim->pc = (uintptr_t)__builtin_return_address(0))
+
+#define PCONP_RESET         0x042887DEu     // LPC1768 PCONP after reset
+#define PCONP_TIM0          (1u << 1)
+#define PCONP_TIM1          (1u << 2)
+#define PCONP_ADC           (1u << 12)
+#define PCONP_TIM2          (1u << 22)
+#define PCONP_TIM3          (1u << 23)
+#define PCONP_GPDMA         (1u << 29)
+
+/* Clocks as Keil's SystemInit() leaves them: 12 MHz crystal, PLL0 M = 100,
+ * N = 6 (FCCO 400 MHz), CCLKCFG 3 -> 100 MHz, 5 flash clocks */
+#define SIM_IRC_HZ          4000000u
+#define SIM_XTAL_HZ         12000000u
+#define SIM_RTC_HZ          32768u
+#define SIM_PLL_LOCK_NS     100000u         // PLOCK about 100 us after a change
+#define PLL0CFG_BOOT        0x00050063u
+#define CCLKCFG_BOOT        3u
+#define FLASHCFG_BOOT       0x0000403Au
+#define PLLSTAT_ENABLED     (1u << 24)
+#define PLLSTAT_CONNECTED   (1u << 25)
+#define PLLSTAT_LOCK        (1u << 26)
+
+/*=============================================================================
+ * BOARD STATE
+ *============================================================================*/
+typedef struct {
+    sim_time_t when;
+    unsigned long seq;                      // FIFO order for equal times
+    sim_event_fn fn;
+    void *arg;
+} sim_event_t;
+
+typedef struct {
+    LPC_GPIO_TypeDef regs;                  // What the firmware sees
+    uint32_t latch;                         // Output latch
+    uint32_t inputs;                        // Externally driven levels
+    uint32_t pins;                          // Resolved pin levels
+    uint32_t seen;                          // FIOPIN value last published
+} sim_gpio_t;
+
+typedef struct {
+    int port, bit;
+    sim_bounce_t profile;
+    uint32_t rng;                           // xorshift32 state
+    int target;                             // Level the contact settles at
+    unsigned int gen;                       // Bumped per edge; stale events drop
+    sim_time_t burst_end;                   // Contact chatter until this time
+} sim_bounce_pin_t;
+
+typedef struct {
+    LPC_TIM_TypeDef regs;
+    uint32_t ir;                            // Real interrupt flags
+    uint32_t frac;                          // CCLK cycles short of a PCLK tick
+    uint8_t reset_pending;                  // Match-reset takes effect on next tick
+    uint8_t dma_req;                        // MR0/MR1 DMA request flags
+} sim_tim_t;
+
+/* One bit-band alias word handed to the firmware. A store to 'slot' is
+ * applied to the target bit when the next access settles it */
+typedef struct {
+    uint32_t alias;
+    volatile uint32_t *word;                // Register or AHB SRAM word
+    uint32_t bit;
+    uint32_t slot;                          // What the firmware reads / writes
+    uint32_t seen;                          // Bit value last published to slot
+    int w1c;                                // Target is a write-1-to-clear IR
+} sim_bitband_t;
+
+typedef struct {
+    sim_time_t now;
+    uint32_t cclk;
+    sim_time_t ns_cycle;                    // Virtual time of the last CCLK change
+    uint64_t ns_base;                       // Real time (ns) at that cycle
+
+    uint32_t pll_con;                       // PLL0CON / PLL0CFG as last fed
+    uint32_t pll_cfg;
+    uint64_t pll_lock_ns;                   // PLOCK from this real time
+    int pll_fed;                            // 0xAA seen, 0x55 must follow
+
+    sim_gpio_t gpio[5];
+    sim_tim_t tim[4];
+    LPC_SC_TypeDef sc;
+    LPC_PINCON_TypeDef pincon;
+
+    LPC_ADC_TypeDef adc;
+    uint32_t adcr_seen;
+    sim_time_t adc_done_at;                 // SIM_NEVER when idle
+    int adc_channel;
+    uint8_t adc_pending;
+    uint8_t adc_triggered;                  // Match edge seen, START = 100-111
+
+    LPC_GPDMA_TypeDef dma;
+    LPC_GPDMACH_TypeDef dmach[8];
+    sim_time_t dma_due;                     // Next request service, SIM_NEVER if none
+    sim_time_t dma_busy_until;              // Engine still moving the previous burst
+
+    SysTick_Type systick;
+    uint32_t systick_val_seen;
+    uint8_t systick_pending;
+
+    DWT_Type dwt;
+    CoreDebug_Type coredebug;
+    uint32_t cyccnt_seen;
+    sim_time_t cyccnt_base;                 // Virtual time at CYCCNT == 0
+    int cyccnt_running;
+
+    uint8_t irq_enabled[SIM_IRQ_COUNT + 1];
+    uint8_t irq_sw_pending[SIM_IRQ_COUNT + 1];
+    uint8_t irq_prio[SIM_IRQ_COUNT + 1];
+    uintptr_t pc;                           // Last firmware call site (SIM_CALLER)
+    uintptr_t stacked_pc;                   // Its value when the running handler began
+    int primask;
+    int exclusive;                          // Local exclusive monitor armed
+    int active_prio;
+    int sleeping;
+    sim_time_t handler_cycles;              // Thread mode held up by exceptions
+    sim_delay_mode_t delay_mode;            // How DELAY_LOOP_SKIP() loops run
+
+    sim_event_t events[SIM_MAX_EVENTS];
+    int n_events;
+    unsigned long event_seq;
+    unsigned long events_run;
+    sim_time_t stop_at;                     // Harness deadline (sim_advance)
+
+    sim_bounce_pin_t bounce[SIM_MAX_BOUNCE];
+    int n_bounce;
+
+    uint32_t ahbram[SIM_AHBRAM_SIZE / 4];
+    sim_bitband_t bitband[SIM_BITBAND_SLOTS];
+    int n_bitband;
+    int next_bitband;                       // Round-robin reuse once all are taken
+
+    sim_cpu_stats_t stats;
+    sim_gpio_hook_fn gpio_hook;
+    sim_adc_source_fn adc_source;
+} sim_board_t;
+
+/* One board per host thread, so a farm of threads (sim_farm.h) runs
+ * independent boards; a single-threaded tool sees one board as before.
+ * A tool that never calls sim_reset() still needs a clock to divide by. */
+static _Thread_local sim_board_t sim_board = { .cclk = SIM_DEFAULT_CCLK };
+#define sim (&sim_board)
+
+_Thread_local uint32_t SystemCoreClock = SIM_DEFAULT_CCLK;
+
+/*=============================================================================
+ * INTERRUPT HANDLERS - weak, so a program only links the ones it defines
+ *============================================================================*/
+extern void SysTick_Handler(void) __attribute__((weak));
+extern void TIMER0_IRQHandler(void) __attribute__((weak));
+extern void TIMER1_IRQHandler(void) __attribute__((weak));
+extern void TIMER2_IRQHandler(void) __attribute__((weak));
+extern void TIMER3_IRQHandler(void) __attribute__((weak));
+extern void EINT3_IRQHandler(void) __attribute__((weak));
+extern void ADC_IRQHandler(void) __attribute__((weak));
+extern void DMA_IRQHandler(void) __attribute__((weak));
+
+static void (*sim_handler(int index))(void) {
+    switch (index - 1) {
+        case SysTick_IRQn:  return SysTick_Handler;
+        case TIMER0_IRQn:   return TIMER0_IRQHandler;
+        case TIMER1_IRQn:   return TIMER1_IRQHandler;
+        case TIMER2_IRQn:   return TIMER2_IRQHandler;
+        case TIMER3_IRQn:   return TIMER3_IRQHandler;
+        case EINT3_IRQn:    return EINT3_IRQHandler;
+        case ADC_IRQn:      return ADC_IRQHandler;
+        case DMA_IRQn:      return DMA_IRQHandler;
+        default:            return 0;
+    }
+}
+
+static void sim_step(sim_time_t cycles);
+static void cpu_charge(unsigned int cycles);
+static void sim_dispatch(void);
+static void sim_flash_power_on(void);
+static void sc_commit(void);
+
+/*=============================================================================
+ * CLOCK DIVIDERS
+ *============================================================================*/
+static uint32_t pclk_div(uint32_t pclksel, int shift) {
+    static const uint32_t div[4] = {4, 1, 2, 8};
+    return div[(pclksel >> shift) & 3];
+}
+
+static uint32_t tim_div(int n) {
+    switch (n) {
+        case 0:  return pclk_div(sim->sc.PCLKSEL0, 2);
+        case 1:  return pclk_div(sim->sc.PCLKSEL0, 4);
+        case 2:  return pclk_div(sim->sc.PCLKSEL1, 12);
+        default: return pclk_div(sim->sc.PCLKSEL1, 14);
+    }
+}
+
+static int tim_powered(int n) {
+    static const uint32_t bit[4] = {PCONP_TIM0, PCONP_TIM1, PCONP_TIM2, PCONP_TIM3};
+    return (sim->sc.PCONP & bit[n]) != 0;
+}
+
+/*=============================================================================
+ * GPIO MODEL
+ *============================================================================*/
+static void gpio_resolve(int p) {
+    sim_gpio_t *g = &sim->gpio[p];
+    uint32_t old = g->pins;
+
+    g->pins = (g->latch & g->regs.FIODIR) | (g->inputs & ~g->regs.FIODIR);
+    g->regs.FIOPIN = g->pins & ~g->regs.FIOMASK;    // Masked bits read as 0
+    g->seen = g->regs.FIOPIN;
+    if (g->pins != old && sim->gpio_hook) {
+        sim->gpio_hook(p, old, g->pins, sim->now);
+    }
+}
+
+/* Apply whatever the firmware stored since the last publish */
+static void gpio_commit(int p) {
+    sim_gpio_t *g = &sim->gpio[p];
+    uint32_t open = ~g->regs.FIOMASK;
+
+    if (g->regs.FIOPIN != g->seen) {
+        g->latch = (g->latch & ~open) | (g->regs.FIOPIN & open);
+    }
+    if (g->regs.FIOSET) {
+        g->latch |= g->regs.FIOSET & open;
+        g->regs.FIOSET = 0;
+    }
+    if (g->regs.FIOCLR) {
+        g->latch &= ~(g->regs.FIOCLR & open);
+        g->regs.FIOCLR = 0;
+    }
+    gpio_resolve(p);
+}
+
+/*=============================================================================
+ * TIMER MODEL
+ *============================================================================*/
+static void tim_publish(int n) {
+    sim->tim[n].regs.IR = sim->tim[n].ir | SIM_IR_MARK;
+}
+
+static void tim_commit(int n) {
+    sim_tim_t *t = &sim->tim[n];
+
+    if (!(t->regs.IR & SIM_IR_MARK)) {      // Firmware wrote IR: clear those bits
+        t->ir &= ~t->regs.IR;
+        t->dma_req &= ~t->regs.IR;          // ...and the matching DMA requests
+    }
+    if (t->regs.TCR & 2) {                  // Counter reset held
+        t->regs.TC = 0;
+        t->regs.PC = 0;
+        t->reset_pending = 0;
+    }
+    tim_publish(n);
+}
+
+static int tim_running(int n) {
+    return tim_powered(n) && (sim->tim[n].regs.TCR & 3) == 1;
+}
+
+/* MR0/MR1 matches raise DMA requests whether or not MCR acts on them,
+ * but only requests routed to the GPDMA by DMAREQSEL are worth stopping for
+ */
+static int tim_dma_selected(int n, int m) {
+    return m < 2 && (sim->sc.DMAREQSEL & (1u << (2 * n + m)));
+}
+
+/* ADCR START values 100-111: conversion on an edge of MAT0.1, MAT0.3,
+ * MAT1.0 or MAT1.1 (EDGE, bit 27: 0 = rising) */
+static void adc_match_edge(int n, int m, int rising) {
+    static const struct { int timer, match; } src[4] = { {0, 1}, {0, 3}, {1, 0}, {1, 1} };
+    uint32_t adcr = sim->adcr_seen;
+    uint32_t start = (adcr >> 24) & 7;
+
+    if (start >= 4 && src[start - 4].timer == n && src[start - 4].match == m &&
+        rising == !(adcr & (1u << 27))) {
+        sim->adc_triggered = 1;
+    }
+}
+
+/* External match output m: EMR bits 5:4 (m = 0) ... 11:10 (m = 3) say
+ * whether a match clears, sets or toggles EMR bit m */
+static void tim_external_match(int n, int m) {
+    sim_tim_t *t = &sim->tim[n];
+    uint32_t emc = (t->regs.EMR >> (4 + 2 * m)) & 3;
+    uint32_t bit = 1u << m, was = t->regs.EMR & bit;
+
+    switch (emc) {
+        case 1:  t->regs.EMR &= ~bit; break;
+        case 2:  t->regs.EMR |= bit;  break;
+        case 3:  t->regs.EMR ^= bit;  break;
+        default: return;
+    }
+    if ((t->regs.EMR & bit) != was) {
+        adc_match_edge(n, m, !was);
+    }
+}
+
+/* One TC increment, with match actions for the new value */
+static void tim_increment(int n) {
+    sim_tim_t *t = &sim->tim[n];
+    int m;
+
+    if (t->reset_pending) {
+        t->regs.TC = 0;
+        t->reset_pending = 0;
+    } else {
+        t->regs.TC++;
+    }
+    for (m = 0; m < 4; m++) {
+        uint32_t mr = (&t->regs.MR0)[m];
+        uint32_t mcr = (t->regs.MCR >> (3 * m)) & 7;
+        if (t->regs.TC != mr) {
+            continue;
+        }
+        if (m < 2) t->dma_req |= 1u << m;           // DMA request on match
+        if (mcr & 1) t->ir |= 1u << m;              // Interrupt on match
+        if (mcr & 2) t->reset_pending = 1;          // Reset on match
+        if (mcr & 4) t->regs.TCR &= ~1u;            // Stop on match
+        tim_external_match(n, m);
+    }
+}
+
+/* Number of TC increments until the next one that does something */
+static uint32_t tim_increments_to_event(int n) {
+    sim_tim_t *t = &sim->tim[n];
+    uint32_t best = 0xFFFFFFFFu;
+    int m;
+
+    if (t->reset_pending) {
+        return 1;
+    }
+    for (m = 0; m < 4; m++) {
+        uint32_t d;
+        if (((t->regs.MCR >> (3 * m)) & 7) == 0 && !tim_dma_selected(n, m) &&
+            ((t->regs.EMR >> (4 + 2 * m)) & 3) == 0) {
+            continue;
+        }
+        d = (&t->regs.MR0)[m] - t->regs.TC;
+        if (d != 0 && d < best) {
+            best = d;
+        }
+    }
+    return best;
+}
+
+static int tim_timer_mode(int n) {
+    return (sim->tim[n].regs.CTCR & 3) == 0;
+}
+
+static void tim_advance(int n, sim_time_t cycles) {
+    sim_tim_t *t = &sim->tim[n];
+    uint32_t div = tim_div(n), per;
+    uint64_t ticks, k, skip;
+
+    if (!tim_running(n) || !tim_timer_mode(n)) {
+        return;
+    }
+    ticks = (t->frac + cycles) / div;
+    t->frac = (uint32_t)((t->frac + cycles) % div);
+    per = t->regs.PR + 1;
+    while (ticks) {
+        uint64_t need = per - t->regs.PC;
+        if (ticks < need) {
+            t->regs.PC += (uint32_t)ticks;
+            break;
+        }
+        ticks -= need;
+        t->regs.PC = 0;
+        tim_increment(n);
+        if (!tim_running(n)) {
+            break;
+        }
+        /* Jump over increments where nothing can happen */
+        skip = tim_increments_to_event(n) - 1;
+        k = ticks / per;
+        if (k > skip) k = skip;
+        t->regs.TC += (uint32_t)k;
+        ticks -= k * per;
+    }
+}
+
+/* CPU cycles until this timer next raises a flag or resets */
+static sim_time_t tim_next_delta(int n) {
+    sim_tim_t *t = &sim->tim[n];
+    uint64_t per, incs, ticks, cycles;
+    uint32_t div;
+
+    if (!tim_running(n) || !tim_timer_mode(n)) {
+        return SIM_NEVER;
+    }
+    incs = tim_increments_to_event(n);
+    if (incs == 0xFFFFFFFFu) {
+        return SIM_NEVER;
+    }
+    div = tim_div(n);
+    per = t->regs.PR + 1;
+    ticks = (per - t->regs.PC) + (incs - 1) * per;
+    cycles = ticks * div - t->frac;
+    return cycles ? cycles : 1;
+}
+
+/* Capture pin map: CAPn.ch -> port/bit */
+static const struct { int port, bit, timer, ch; } cap_pins[] = {
+    {1, 26, 0, 0}, {1, 27, 0, 1}, {1, 18, 1, 0}, {1, 19, 1, 1},
+    {0, 4,  2, 0}, {0, 5,  2, 1}, {0, 23, 3, 0}, {0, 24, 3, 1},
+};
+
+static int pin_function(int port, int bit) {
+    uint32_t sel = (&sim->pincon.PINSEL0)[port * 2 + (bit >= 16)];
+    return (sel >> ((bit % 16) * 2)) & 3;
+}
+
+static void tim_capture_edge(int port, int bit, int rising) {
+    unsigned int i;
+
+    for (i = 0; i < sizeof cap_pins / sizeof cap_pins[0]; i++) {
+        int n = cap_pins[i].timer, ch = cap_pins[i].ch;
+        sim_tim_t *t = &sim->tim[n];
+        uint32_t ccr, ctcr;
+
+        if (cap_pins[i].port != port || cap_pins[i].bit != bit) continue;
+        if (pin_function(port, bit) != 3 || !tim_powered(n)) continue;
+
+        ctcr = t->regs.CTCR;
+        if ((ctcr & 3) != 0) {
+            /* Counter mode: selected CAP input clocks the TC */
+            if (((ctcr >> 2) & 3) == (uint32_t)ch && (t->regs.TCR & 3) == 1 &&
+                ((rising && (ctcr & 1)) || (!rising && (ctcr & 2)))) {
+                tim_increment(n);
+            }
+        }
+        ccr = (t->regs.CCR >> (3 * ch)) & 7;
+        if ((rising && (ccr & 1)) || (!rising && (ccr & 2))) {
+            SIM_RO((&t->regs.CR0)[ch]) = t->regs.TC;
+            if (ccr & 4) {
+                t->ir |= 1u << (4 + ch);
+            }
+        }
+        tim_publish(n);
+    }
+}
+
+/*=============================================================================
+ * SYSTICK MODEL
+ *============================================================================*/
+static void systick_commit(void) {
+    if (sim->systick.VAL != sim->systick_val_seen) {    // Any write clears VAL
+        sim->systick.VAL = 0;
+        sim->systick.CTRL &= ~(1u << 16);
+    }
+    sim->systick_val_seen = sim->systick.VAL;
+}
+
+static void systick_advance(sim_time_t cycles) {
+    SysTick_Type *s = &sim->systick;
+
+    if (!(s->CTRL & 1)) {
+        return;
+    }
+    while (cycles) {
+        if (s->VAL == 0) {                  // Reload on the cycle after zero
+            s->VAL = s->LOAD & 0xFFFFFF;
+            cycles--;
+            continue;
+        }
+        if (cycles >= s->VAL) {
+            cycles -= s->VAL;
+            s->VAL = 0;
+            s->CTRL |= 1u << 16;            // COUNTFLAG
+            if (s->CTRL & 2) {
+                sim->systick_pending = 1;
+            }
+        } else {
+            s->VAL -= (uint32_t)cycles;
+            cycles = 0;
+        }
+    }
+    sim->systick_val_seen = s->VAL;
+}
+
+static sim_time_t systick_next_delta(void) {
+    SysTick_Type *s = &sim->systick;
+
+    if (!(s->CTRL & 1) || !(s->CTRL & 2)) {
+        return SIM_NEVER;
+    }
+    return s->VAL ? s->VAL : (sim_time_t)(s->LOAD & 0xFFFFFF) + 1;
+}
+
+/*=============================================================================
+ * ADC MODEL - single conversions (no burst), started by software (START =
+ * 001) or by an edge of a timer match output (START = 100-111). A
+ * hardware start keeps its START bits; an edge during a conversion is
+ * ignored.
+ *============================================================================*/
+/* Starts converting the lowest selected channel; 0 if the ADC is off */
+static int adc_start(void) {
+    LPC_ADC_TypeDef *a = &sim->adc;
+    uint32_t div, clkdiv;
+    int ch;
+
+    if (!(a->ADCR & (1u << 21)) || !(sim->sc.PCONP & PCONP_ADC)) {
+        return 0;
+    }
+    for (ch = 0; ch < 8 && !(a->ADCR & (1u << ch)); ch++);
+    if (ch == 8) {
+        return 0;
+    }
+    /* 65 ADC clocks; ADC clock = PCLK_ADC / (CLKDIV + 1) */
+    div = pclk_div(sim->sc.PCLKSEL0, 24);
+    clkdiv = ((a->ADCR >> 8) & 0xFF) + 1;
+    sim->adc_channel = ch;
+    sim->adc_done_at = sim->now + 65ull * div * clkdiv;
+    a->ADGDR &= ~(1u << 31);
+    return 1;
+}
+
+static void adc_commit(void) {
+    LPC_ADC_TypeDef *a = &sim->adc;
+
+    if (a->ADCR == sim->adcr_seen) {
+        return;
+    }
+    sim->adcr_seen = a->ADCR;
+    if (((a->ADCR >> 24) & 7) != 1 || !adc_start()) {
+        return;
+    }
+    a->ADCR &= ~(7u << 24);                 // START bits read back as 0
+    sim->adcr_seen = a->ADCR;
+}
+
+static void adc_advance(void) {
+    LPC_ADC_TypeDef *a = &sim->adc;
+    unsigned int code;
+    uint32_t result;
+
+    if (sim->adc_done_at != SIM_NEVER && sim->now >= sim->adc_done_at) {
+        sim->adc_done_at = SIM_NEVER;
+        code = sim->adc_source ? sim->adc_source(sim->adc_channel, sim->now) : 0;
+        result = (1u << 31) | ((uint32_t)sim->adc_channel << 24) | ((code & 0xFFF) << 4);
+        a->ADGDR = result;
+        SIM_RO((&a->ADDR0)[sim->adc_channel]) = result;
+        SIM_RO(a->ADSTAT) |= 1u << sim->adc_channel;
+        if (a->ADINTEN & ((1u << sim->adc_channel) | (1u << 8))) {
+            sim->adc_pending = 1;
+        }
+    }
+    if (sim->adc_triggered) {               // Match edge at this instant
+        sim->adc_triggered = 0;
+        if (sim->adc_done_at == SIM_NEVER) {
+            adc_start();
+        }
+    }
+}
+
+/*=============================================================================
+ * GPDMA MODEL
+ * Peripheral-requested transfers only: a channel in M2P or P2M mode moves
+ * one burst per request from its line. Lines 8-15 are the timer MR0/MR1
+ * matches when selected in DMAREQSEL (the UARTs are not modelled). Channel
+ * 0 has the highest priority. Addresses are rebuilt from the 32 bits the
+ * firmware wrote plus the upper bits of this thread's board (registers) or
+ * of the program's static data (firmware buffers).
+ *============================================================================*/
+static char dma_anchor;
+
+static void *dma_ptr(uint32_t addr) {
+    uintptr_t board = (uintptr_t)sim;
+    uintptr_t base = (addr - (uint32_t)board < sizeof *sim) ? board : (uintptr_t)&dma_anchor;
+
+    return (void *)((base & ~(uintptr_t)0xFFFFFFFFu) | addr);
+}
+
+static uint32_t dma_request_lines(void) {
+    uint32_t lines = 0;
+    int n, m;
+
+    for (n = 0; n < 4; n++) {
+        for (m = 0; m < 2; m++) {
+            if ((sim->tim[n].dma_req & (1u << m)) && tim_dma_selected(n, m)) {
+                lines |= 1u << (8 + 2 * n + m);
+            }
+        }
+    }
+    return lines;
+}
+
+static int dma_channel_line(int ch) {
+    uint32_t cfg = sim->dmach[ch].DMACCConfig;
+
+    switch ((cfg >> 11) & 7) {
+        case 1:  return (int)((cfg >> 6) & 31);     // M2P: destination peripheral
+        case 2:  return (int)((cfg >> 1) & 31);     // P2M: source peripheral
+        default: return -1;
+    }
+}
+
+static int dma_channel_ready(int ch) {
+    uint32_t cfg = sim->dmach[ch].DMACCConfig;
+    return (cfg & 1) && !(cfg & (1u << 18));        // Enabled and not halted
+}
+
+/* Requests that an enabled channel is waiting for */
+static uint32_t dma_serviceable(void) {
+    uint32_t lines, want = 0;
+    int ch;
+
+    if (!(sim->dma.DMACConfig & 1) || !(sim->sc.PCONP & PCONP_GPDMA)) {
+        return 0;
+    }
+    lines = dma_request_lines();
+    for (ch = 0; ch < 8 && lines; ch++) {
+        int line = dma_channel_line(ch);
+        if (line >= 0 && dma_channel_ready(ch)) {
+            want |= lines & (1u << line);
+        }
+    }
+    return want;
+}
+
+static void dma_publish(void) {
+    LPC_GPDMA_TypeDef *d = &sim->dma;
+    uint32_t itc = 0, enabled = 0;
+    int ch;
+
+    for (ch = 0; ch < 8; ch++) {
+        uint32_t cfg = sim->dmach[ch].DMACCConfig;
+        if (cfg & 1) enabled |= 1u << ch;
+        if (cfg & (1u << 15)) itc |= 1u << ch;
+    }
+    SIM_RO(d->DMACEnbldChns) = enabled;
+    SIM_RO(d->DMACIntTCStat) = d->DMACRawIntTCStat & itc;
+    SIM_RO(d->DMACIntStat) = d->DMACIntTCStat | d->DMACIntErrStat;
+}
+
+static void dma_commit(void) {
+    LPC_GPDMA_TypeDef *d = &sim->dma;
+
+    if (d->DMACIntTCClear) {
+        SIM_RO(d->DMACRawIntTCStat) &= ~d->DMACIntTCClear;
+        d->DMACIntTCClear = 0;
+    }
+    if (d->DMACIntErrClr) {
+        SIM_RO(d->DMACRawIntErrStat) &= ~d->DMACIntErrClr;
+        SIM_RO(d->DMACIntErrStat) &= ~d->DMACIntErrClr;
+        d->DMACIntErrClr = 0;
+    }
+    dma_publish();
+}
+
+static uint32_t dma_read(uint32_t addr, uint32_t width) {
+    void *p = dma_ptr(addr);
+    return (width == 4) ? *(volatile uint32_t *)p :
+           (width == 2) ? *(volatile uint16_t *)p : *(volatile uint8_t *)p;
+}
+
+static void dma_write(uint32_t addr, uint32_t width, uint32_t v) {
+    void *p = dma_ptr(addr);
+    if (width == 4)      *(volatile uint32_t *)p = v;
+    else if (width == 2) *(volatile uint16_t *)p = (uint16_t)v;
+    else                 *(volatile uint8_t *)p = (uint8_t)v;
+}
+
+/* One burst on channel ch; returns the engine cycles it took */
+static uint32_t dma_burst(int ch) {
+    static const uint32_t burst_len[8] = {1, 4, 8, 16, 32, 64, 128, 256};
+    LPC_GPDMACH_TypeDef *c = &sim->dmach[ch];
+    uint32_t ctl = c->DMACCControl, count = ctl & 0xFFF, n, i, cost;
+    uint32_t sw = 1u << ((ctl >> 18) & 7), dw = 1u << ((ctl >> 21) & 7);
+    int p = 0;
+
+    n = burst_len[(((c->DMACCConfig >> 11) & 7) == 1) ? (ctl >> 15) & 7 : (ctl >> 12) & 7];
+    if (n > count) n = count;
+    for (i = 0; i < n; i++) {
+        dma_write(c->DMACCDestAddr, dw, dma_read(c->DMACCSrcAddr, sw));
+        if (ctl & (1u << 26)) c->DMACCSrcAddr += sw;
+        if (ctl & (1u << 27)) c->DMACCDestAddr += dw;
+    }
+    for (p = 0; p < 5; p++) gpio_commit(p);         // The destination may be a port
+    cost = n * SIM_DMA_XFER_CYCLES;
+    count -= n;
+    c->DMACCControl = (ctl & ~0xFFFu) | count;
+    if (count == 0) {                               // Terminal count
+        if (ctl & (1u << 31)) {
+            SIM_RO(sim->dma.DMACRawIntTCStat) |= 1u << ch;
+        }
+        if (c->DMACCLLI) {
+            const uint32_t *lli = dma_ptr(c->DMACCLLI & ~3u);
+            c->DMACCSrcAddr = lli[0];
+            c->DMACCDestAddr = lli[1];
+            c->DMACCLLI = lli[2];
+            c->DMACCControl = lli[3];
+            cost += SIM_DMA_LLI_CYCLES;
+        } else {
+            c->DMACCConfig &= ~1u;
+        }
+        dma_publish();
+    }
+    return cost;
+}
+
+static void dma_advance(void) {
+    uint32_t want = dma_serviceable();
+    int ch;
+
+    if (!want) {
+        sim->dma_due = SIM_NEVER;
+        return;
+    }
+    if (sim->dma_due == SIM_NEVER) {                // New request: synchronise first
+        sim->dma_due = sim->now + SIM_DMA_REQ_CYCLES;
+        if (sim->dma_due < sim->dma_busy_until) sim->dma_due = sim->dma_busy_until;
+    }
+    if (sim->now < sim->dma_due) {
+        return;
+    }
+    for (ch = 0; ch < 8; ch++) {
+        int line = dma_channel_line(ch);
+        if (line >= 8 && dma_channel_ready(ch) && (want & (1u << line))) {
+            sim->tim[(line - 8) / 2].dma_req &= ~(1u << ((line - 8) & 1));
+            sim->dma_busy_until = sim->now + dma_burst(ch);
+            break;
+        }
+    }
+    sim->dma_due = dma_serviceable() ? sim->dma_busy_until : SIM_NEVER;
+}
+
+/*=============================================================================
+ * GLOBAL SYNC / ADVANCE
+ *============================================================================*/
+/*=============================================================================
+ * DWT CYCLE COUNTER - derived from the virtual clock on demand
+ *============================================================================*/
+static int dwt_enabled(void) {
+    return (sim->dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) &&
+           (sim->coredebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+}
+
+static void dwt_publish(void) {
+    if (sim->cyccnt_running) {
+        sim->dwt.CYCCNT = (uint32_t)(sim->now - sim->cyccnt_base);
+    }
+    sim->cyccnt_seen = sim->dwt.CYCCNT;
+}
+
+static void dwt_commit(void) {
+    uint32_t count = sim->dwt.CYCCNT;
+
+    if (count == sim->cyccnt_seen && sim->cyccnt_running) {
+        count = (uint32_t)(sim->now - sim->cyccnt_base);   // Not written: keep counting
+    }
+    sim->cyccnt_running = dwt_enabled();
+    sim->cyccnt_base = sim->now - count;
+    sim->dwt.CYCCNT = count;
+    sim->cyccnt_seen = count;
+}
+
+/* Alias stores first: they act on the registers the other commits read */
+static void bitband_commit(void) {
+    int i;
+
+    for (i = 0; i < sim->n_bitband; i++) {
+        sim_bitband_t *b = &sim->bitband[i];
+        uint32_t v = b->slot & 1;
+
+        if (b->slot == b->seen) {
+            continue;
+        }
+        if (b->w1c) {
+            fprintf(stderr, "sim: bit-band store to a timer IR at cycle %llu "
+                    "(would clear every pending flag)\n", (unsigned long long)sim->now);
+            exit(1);
+        }
+        *b->word = (*b->word & ~(1u << b->bit)) | (v << b->bit);
+        b->slot = b->seen = v;
+    }
+}
+
+static void sim_sync(void) {
+    int i;
+
+    bitband_commit();
+    for (i = 0; i < 5; i++) gpio_commit(i);
+    for (i = 0; i < 4; i++) tim_commit(i);
+    sc_commit();
+    systick_commit();
+    dwt_commit();
+    adc_commit();
+    dma_commit();
+}
+
+static void periph_advance(sim_time_t cycles) {
+    int i;
+
+    if (cycles == 0) {
+        return;
+    }
+    for (i = 0; i < 4; i++) {
+        tim_advance(i, cycles);
+        tim_publish(i);
+    }
+    systick_advance(cycles);
+    sim->now += cycles;
+    adc_advance();
+    dma_advance();
+}
+
+static sim_time_t periph_next_delta(void) {
+    sim_time_t best = SIM_NEVER, d;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        d = tim_next_delta(i);
+        if (d < best) best = d;
+    }
+    d = systick_next_delta();
+    if (d < best) best = d;
+    if (sim->adc_done_at != SIM_NEVER) {
+        d = (sim->adc_done_at > sim->now) ? sim->adc_done_at - sim->now : 1;
+        if (d < best) best = d;
+    }
+    if (sim->dma_due != SIM_NEVER) {
+        d = (sim->dma_due > sim->now) ? sim->dma_due - sim->now : 1;
+        if (d < best) best = d;
+    }
+    return best;
+}
+
+/* Min-heap of scheduled events */
+static void event_pop(sim_event_t *out) {
+    sim_event_t *e = sim->events;
+    int i = 0, n = --sim->n_events;
+
+    *out = e[0];
+    e[0] = e[n];
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        sim_event_t tmp;
+        if (l < n && (e[l].when < e[m].when ||
+                      (e[l].when == e[m].when && e[l].seq < e[m].seq))) m = l;
+        if (r < n && (e[r].when < e[m].when ||
+                      (e[r].when == e[m].when && e[r].seq < e[m].seq))) m = r;
+        if (m == i) break;
+        tmp = e[i]; e[i] = e[m]; e[m] = tmp;
+        i = m;
+    }
+}
+
+int sim_schedule(sim_time_t when, sim_event_fn fn, void *arg) {
+    sim_event_t *e = sim->events;
+    int i;
+
+    if (sim->n_events >= SIM_MAX_EVENTS) {
+        return -1;
+    }
+    if (when < sim->now) {
+        when = sim->now;
+    }
+    i = sim->n_events++;
+    e[i].when = when;
+    e[i].seq = sim->event_seq++;
+    e[i].fn = fn;
+    e[i].arg = arg;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        sim_event_t tmp;
+        if (e[p].when < e[i].when || (e[p].when == e[i].when && e[p].seq < e[i].seq)) break;
+        tmp = e[i]; e[i] = e[p]; e[p] = tmp;
+        i = p;
+    }
+    return 0;
+}
+
+static void sim_step(sim_time_t cycles) {
+    sim_time_t target = sim->now + cycles;
+
+    sim_sync();
+    for (;;) {
+        sim_time_t next = target, d;
+
+        if (sim->n_events && sim->events[0].when < next) {
+            next = sim->events[0].when;
+        }
+        d = periph_next_delta();
+        if (d != SIM_NEVER && sim->now + d < next) {
+            next = sim->now + d;
+        }
+        if (next > sim->now) {
+            periph_advance(next - sim->now);
+        }
+        while (sim->n_events && sim->events[0].when <= sim->now) {
+            sim_event_t ev;
+            event_pop(&ev);
+            sim->events_run++;
+            ev.fn(ev.arg);
+            sim_sync();
+        }
+        sim_dispatch();
+        if (sim->now >= target) {
+            break;
+        }
+    }
+}
+
+/*=============================================================================
+ * NVIC
+ *============================================================================*/
+static int irq_source_pending(int index) {
+    int irq = index - 1;
+
+    if (sim->irq_sw_pending[index]) return 1;
+    switch (irq) {
+        case SysTick_IRQn:  return sim->systick_pending;
+        case TIMER0_IRQn:
+        case TIMER1_IRQn:
+        case TIMER2_IRQn:
+        case TIMER3_IRQn:   return sim->tim[irq - TIMER0_IRQn].ir != 0;
+        case ADC_IRQn:      return sim->adc_pending;
+        case DMA_IRQn:      return sim->dma.DMACIntStat != 0;
+        default:            return 0;
+    }
+}
+
+static void sim_dispatch(void) {
+    unsigned long guard = 0, events_seen = sim->events_run;
+
+    while (!sim->primask) {
+        int i, best = -1, saved;
+        void (*handler)(void);
+        uintptr_t saved_pc;
+        sim_time_t start;
+
+        /* An input faster than its ISR keeps thread mode starved forever;
+         * hand control back to the harness between handlers once its
+         * deadline has passed instead of spinning here.
+         */
+        if (sim->active_prio == SIM_THREAD_PRIO && sim->now >= sim->stop_at) {
+            return;
+        }
+
+        for (i = 0; i <= SIM_IRQ_COUNT; i++) {
+            int enabled = (i == 0) ? 1 : sim->irq_enabled[i];
+            if (!enabled || sim->irq_prio[i] >= sim->active_prio || !irq_source_pending(i)) {
+                continue;
+            }
+            if (best < 0 || sim->irq_prio[i] < sim->irq_prio[best]) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            return;
+        }
+        if (sim->events_run != events_seen) {  // New stimulus: not stuck
+            events_seen = sim->events_run;
+            guard = 0;
+        }
+        if (++guard > SIM_DISPATCH_LIMIT) {
+            fprintf(stderr, "sim: IRQ %d never clears its source\n", best - 1);
+            exit(1);
+        }
+        sim->irq_sw_pending[best] = 0;
+        if (best == SIM_IRQ_INDEX(SysTick_IRQn)) sim->systick_pending = 0;
+        if (best == SIM_IRQ_INDEX(ADC_IRQn)) sim->adc_pending = 0;
+
+        handler = sim_handler(best);
+        saved = sim->active_prio;
+        start = sim->now;
+        saved_pc = sim->stacked_pc;
+        sim->active_prio = sim->irq_prio[best];
+        sim->stacked_pc = sim->pc;          // Where the interrupted code was
+        sim->stats.irq_count[best]++;
+        sim->exclusive = 0;                 // Exception entry clears the monitor
+        cpu_charge(SIM_COST_IRQ_ENTRY);
+        if (handler) {
+            handler();
+        }
+        sim_sync();
+        cpu_charge(SIM_COST_IRQ_EXIT);
+        sim->exclusive = 0;                 // ...and so does exception return
+        sim->active_prio = saved;
+        if (saved == SIM_THREAD_PRIO) {
+            sim->handler_cycles += sim->now - start;
+        }
+        sim->pc = sim->stacked_pc;
+        sim->stacked_pc = saved_pc;
+    }
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+    SIM_CALLER();
+    if (irq >= 0) sim->irq_enabled[SIM_IRQ_INDEX(irq)] = 1;
+    cpu_charge(SIM_COST_CORE);
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+    SIM_CALLER();
+    if (irq >= 0) sim->irq_enabled[SIM_IRQ_INDEX(irq)] = 0;
+    cpu_charge(SIM_COST_CORE);
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+    SIM_CALLER();
+    sim->irq_prio[SIM_IRQ_INDEX(irq)] = (uint8_t)(priority & 0x1F);
+    cpu_charge(SIM_COST_CORE);
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type irq) {
+    return sim->irq_prio[SIM_IRQ_INDEX(irq)];
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+    SIM_CALLER();
+    sim->irq_sw_pending[SIM_IRQ_INDEX(irq)] = 1;
+    cpu_charge(SIM_COST_CORE);
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+    SIM_CALLER();
+    sim->irq_sw_pending[SIM_IRQ_INDEX(irq)] = 0;
+    cpu_charge(SIM_COST_CORE);
+}
+
+void __enable_irq(void) {
+    SIM_CALLER();
+    sim->primask = 0;
+    cpu_charge(SIM_COST_CORE);
+}
+
+void __disable_irq(void) {
+    SIM_CALLER();
+    sim->primask = 1;
+    cpu_charge(SIM_COST_CORE);
+}
+
+void __NOP(void) {
+    SIM_CALLER();
+    cpu_charge(1);
+}
+
+/* Exclusive access: an exception between LDREX and STREX makes STREX fail */
+uint32_t __LDREXW(volatile uint32_t *addr) {
+    uint32_t v;
+
+    SIM_CALLER();
+    cpu_charge(2);
+    v = *addr;
+    sim->exclusive = 1;
+    return v;
+}
+
+uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) {
+    SIM_CALLER();
+    cpu_charge(2);
+    if (!sim->exclusive) {
+        return 1;
+    }
+    *addr = value;
+    sim->exclusive = 0;
+    return 0;
+}
+
+void __CLREX(void) {
+    SIM_CALLER();
+    sim->exclusive = 0;
+    cpu_charge(1);
+}
+
+/* Sleep until something can wake the core, then run the handler(s) */
+void __WFI(void) {
+    sim_time_t d, next = SIM_NEVER;
+    int i;
+
+    SIM_CALLER();
+    sim_sync();
+    for (i = 0; i <= SIM_IRQ_COUNT; i++) {
+        if ((i == 0 || sim->irq_enabled[i]) && irq_source_pending(i)) {
+            cpu_charge(1);                  // Already pending: no sleep
+            return;
+        }
+    }
+    if (sim->n_events) {
+        next = sim->events[0].when;
+    }
+    d = periph_next_delta();
+    if (d != SIM_NEVER && sim->now + d < next) {
+        next = sim->now + d;
+    }
+    if (next == SIM_NEVER) {
+        fprintf(stderr, "sim: __WFI() with no wake-up source at cycle %llu\n",
+                (unsigned long long)sim->now);
+        exit(1);
+    }
+    sim->sleeping = 1;
+    sim->stats.idle += next - sim->now;
+    sim_step(next - sim->now);
+    sim->sleeping = 0;
+}
+
+uint32_t ITM_SendChar(uint32_t ch) {
+    if (ch != '\r') {
+        putchar((int)ch);
+    }
+    return ch;
+}
+
+uint32_t SysTick_Config(uint32_t ticks) {
+    SIM_CALLER();
+    if (ticks - 1 > 0xFFFFFF) {
+        return 1;
+    }
+    sim->systick.LOAD = ticks - 1;
+    sim->systick.VAL = 0;
+    sim->systick_val_seen = 0;
+    sim->systick.CTRL = 7;
+    sim->irq_prio[SIM_IRQ_INDEX(SysTick_IRQn)] = 31;
+    cpu_charge(3 * SIM_COST_CORE);
+    return 0;
+}
+
+/*=============================================================================
+ * SYSTEM CLOCKS - PLL0, CCLKCFG and CLKSRCSEL decide CCLK
+ *============================================================================*/
+uint64_t sim_ns(void) {
+    sim_time_t d = sim->now - sim->ns_cycle;
+
+    return sim->ns_base + d / sim->cclk * 1000000000ull +
+           d % sim->cclk * 1000000000ull / sim->cclk;
+}
+
+static uint32_t clk_source(void) {
+    switch (sim->sc.CLKSRCSEL & 3) {
+        case 1:  return SIM_XTAL_HZ;
+        case 2:  return SIM_RTC_HZ;
+        default: return SIM_IRC_HZ;
+    }
+}
+
+static int pll_locked(void) {
+    if (!(sim->pll_con & 1)) return 0;
+    if (sim->pll_lock_ns <= sim->ns_base) return 1;     // Locked before the last change
+    return sim_ns() >= sim->pll_lock_ns;
+}
+
+static uint32_t cclk_from_regs(void) {
+    uint32_t src = clk_source(), div = (sim->sc.CCLKCFG & 0xFF) + 1;
+    uint64_t fcco;
+
+    if ((sim->pll_con & 3) != 3 || !pll_locked()) {
+        return src / div;
+    }
+    fcco = 2ull * ((sim->pll_cfg & 0x7FFF) + 1) * src / (((sim->pll_cfg >> 16) & 0xFF) + 1);
+    return (uint32_t)(fcco / div);
+}
+
+/* A feed (0xAA then 0x55) makes PLL0CON/PLL0CFG take effect */
+static void pll_feed(void) {
+    uint32_t con = sim->sc.PLL0CON & 3, cfg = sim->sc.PLL0CFG & 0x00FF7FFF;
+
+    if ((con & 1) && (!(sim->pll_con & 1) || cfg != sim->pll_cfg)) {
+        sim->pll_lock_ns = sim_ns() + SIM_PLL_LOCK_NS;     // (Re)locking
+    }
+    sim->pll_cfg = cfg;
+    sim->pll_con = con & 1;
+    if ((con & 2) && pll_locked()) {        // Connecting needs a lock
+        sim->pll_con = con;
+    }
+}
+
+static void sc_commit(void) {
+    LPC_SC_TypeDef *s = &sim->sc;
+    uint32_t feed = s->PLL0FEED, cclk, ws;
+
+    if (feed) {
+        s->PLL0FEED = 0;
+        if (feed == 0xAA) {
+            sim->pll_fed = 1;
+        } else {
+            if (feed == 0x55 && sim->pll_fed) pll_feed();
+            sim->pll_fed = 0;
+        }
+    }
+    SIM_RO(s->PLL0STAT) = sim->pll_cfg | (sim->pll_con & 1 ? PLLSTAT_ENABLED : 0) |
+                          (sim->pll_con & 2 ? PLLSTAT_CONNECTED : 0) |
+                          (pll_locked() ? PLLSTAT_LOCK : 0);
+
+    cclk = cclk_from_regs();
+    if (cclk != sim->cclk) {
+        sim->ns_base = sim_ns();
+        sim->ns_cycle = sim->now;
+        sim->cclk = cclk;
+    }
+    /* One flash access per 20 MHz or part of it (UM10360 table 48) */
+    ws = (sim->cclk - 1) / 20000000u;
+    if (((s->FLASHCFG >> 12) & 0xF) < ws) {
+        fprintf(stderr, "sim: CCLK %u Hz with FLASHTIM %u (needs %u) at cycle %llu\n",
+                sim->cclk, (s->FLASHCFG >> 12) & 0xF, ws, (unsigned long long)sim->now);
+        exit(1);
+    }
+}
+
+static void sc_clock_boot(void) {
+    sim->sc.CLKSRCSEL = 1;
+    sim->sc.PLL0CFG = sim->pll_cfg = PLL0CFG_BOOT;
+    sim->sc.PLL0CON = sim->pll_con = 3;
+    sim->sc.CCLKCFG = CCLKCFG_BOOT;
+    sim->sc.FLASHCFG = FLASHCFG_BOOT;
+    sim->pll_lock_ns = 0;
+    sim->pll_fed = 0;
+    sc_commit();
+}
+
+/* Keil's SystemInit() sets up the same clocks again from whatever state */
+void SystemInit(void) {
+    SIM_CALLER();
+    sc_clock_boot();
+    SystemCoreClock = sim->cclk;
+}
+
+void SystemCoreClockUpdate(void) {
+    SIM_CALLER();
+    sim_sync();
+    SystemCoreClock = cclk_from_regs();
+}
+
+/*=============================================================================
+ * PERIPHERAL ACCESS (called through the LPC_* macros)
+ *============================================================================*/
+static void cpu_charge(unsigned int cycles) {
+    sim->stats.busy += cycles;
+    sim_step(cycles);
+}
+
+void sim_charge(unsigned int cycles) {
+    SIM_CALLER();
+    cpu_charge(cycles);
+}
+
+/* Thread-mode work of 'cycles': interrupts taken meanwhile add their own
+ * time on top, as they stretch a delay loop on the chip */
+static void cpu_delay(sim_time_t cycles) {
+    while (cycles) {
+        sim_time_t start = sim->now, held = sim->handler_cycles, done;
+
+        sim_step(cycles);
+        done = (sim->now - start) - (sim->handler_cycles - held);
+        if (done > cycles) done = cycles;
+        sim->stats.busy += done;
+        cycles -= done;
+    }
+}
+
+/*=============================================================================
+ * DELAY LOOPS (DELAY_LOOP_SKIP in clock.h)
+ *============================================================================*/
+void sim_delay_mode(sim_delay_mode_t mode) {
+    sim->delay_mode = mode;
+}
+
+int sim_delay_loop(uint32_t passes, uint32_t loop_cycles) {
+    uint32_t n;
+
+    SIM_CALLER();
+    switch (sim->delay_mode) {
+        case SIM_DELAY_PASSES:
+            for (n = 0; n < passes; n++) {
+                cpu_delay(loop_cycles);
+            }
+            return 1;
+        case SIM_DELAY_FAST:
+            cpu_delay((sim_time_t)passes * loop_cycles);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* The main program's load offset: link-time address = host address - bias */
+static int load_bias(struct dl_phdr_info *info, size_t size, void *bias) {
+    (void)size;
+    *(uintptr_t *)bias = info->dlpi_addr;
+    return 1;                               // The first entry is the program
+}
+
+uint32_t sim_stacked_pc(void) {
+    static _Thread_local uintptr_t bias;
+    static _Thread_local int bias_known;
+
+    if (!bias_known) {
+        dl_iterate_phdr(load_bias, &bias);
+        bias_known = 1;
+    }
+    return (uint32_t)(sim->stacked_pc - bias);
+}
+
+LPC_GPIO_TypeDef *sim_gpio(int port) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_GPIO);
+    return &sim->gpio[port].regs;
+}
+
+LPC_TIM_TypeDef *sim_tim(int n) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_APB);
+    return &sim->tim[n].regs;
+}
+
+LPC_SC_TypeDef *sim_sc(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_APB);
+    return &sim->sc;
+}
+
+LPC_PINCON_TypeDef *sim_pincon(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_APB);
+    return &sim->pincon;
+}
+
+LPC_ADC_TypeDef *sim_adc(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_APB);
+    return &sim->adc;
+}
+
+LPC_GPDMA_TypeDef *sim_gpdma(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_GPIO);
+    return &sim->dma;
+}
+
+LPC_GPDMACH_TypeDef *sim_gpdmach(int n) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_GPIO);
+    return &sim->dmach[n];
+}
+
+SysTick_Type *sim_systick(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_CORE);
+    return &sim->systick;
+}
+
+DWT_Type *sim_dwt(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_CORE);
+    dwt_publish();
+    return &sim->dwt;
+}
+
+CoreDebug_Type *sim_coredebug(void) {
+    SIM_CALLER();
+    cpu_charge(SIM_COST_CORE);
+    return &sim->coredebug;
+}
+
+/*=============================================================================
+ * BIT-BAND (called through BITBAND_ALIAS_PTR / BITBAND_WORD_PTR)
+ *============================================================================*/
+static volatile uint32_t *bus_periph(uint32_t addr, uint32_t base, void *regs,
+                                     uint32_t size) {
+    return (addr - base < size) ? (volatile uint32_t *)regs + (addr - base) / 4 : 0;
+}
+
+/* Host word behind a target address, and what a load or store of it costs */
+static volatile uint32_t *bus_word(uint32_t addr, unsigned int *cost, int *w1c) {
+    static const uint32_t tim_base[4] = {
+        LPC_TIM0_BASE, LPC_TIM1_BASE, LPC_TIM2_BASE, LPC_TIM3_BASE
+    };
+    volatile uint32_t *w = 0;
+    int i;
+
+    *w1c = 0;
+    *cost = SIM_COST_APB;
+    if (addr & 3) {
+        w = 0;
+    } else if (addr - LPC_AHBRAM0_BASE < SIM_AHBRAM_SIZE) {
+        *cost = SIM_COST_AHBRAM;
+        w = &sim->ahbram[(addr - LPC_AHBRAM0_BASE) / 4];
+    } else if (addr - LPC_GPIO_BASE < 5 * 0x20u) {
+        *cost = SIM_COST_GPIO;
+        w = bus_periph(addr & 0x1F, 0, &sim->gpio[(addr - LPC_GPIO_BASE) / 0x20].regs,
+                       sizeof(LPC_GPIO_TypeDef));
+    } else {
+        for (i = 0; i < 4 && !w; i++) {
+            w = bus_periph(addr, tim_base[i], &sim->tim[i].regs, sizeof(LPC_TIM_TypeDef));
+            *w1c = (addr == tim_base[i]);
+        }
+        if (!w) w = bus_periph(addr, LPC_SC_BASE, &sim->sc, sizeof sim->sc);
+        if (!w) w = bus_periph(addr, LPC_PINCON_BASE, &sim->pincon, sizeof sim->pincon);
+        if (!w) w = bus_periph(addr, LPC_ADC_BASE, &sim->adc, sizeof sim->adc);
+    }
+    if (!w) {
+        fprintf(stderr, "sim: no model behind address 0x%08X\n", addr);
+        exit(1);
+    }
+    return w;
+}
+
+/* alias = region + 0x02000000 + byte offset * 32 + bit * 4, region
+ * 0x20000000 (SRAM, GPIO) or 0x40000000 (APB) */
+volatile uint32_t *sim_bitband_alias(uint32_t alias) {
+    uint32_t region = alias & 0xFE000000u;
+    uint32_t addr = (region - 0x02000000u) + (((alias & 0x01FFFFFFu) >> 5) & ~3u);
+    volatile uint32_t *word;
+    sim_bitband_t *b = 0;
+    unsigned int cost;
+    int i, w1c;
+
+    SIM_CALLER();
+    if ((region != 0x22000000u && region != 0x42000000u) || (alias & 3)) {
+        fprintf(stderr, "sim: 0x%08X is not a bit-band alias\n", alias);
+        exit(1);
+    }
+    word = bus_word(addr, &cost, &w1c);
+    cpu_charge(cost + SIM_COST_BITBAND);    // Settles earlier alias stores too
+
+    for (i = 0; i < sim->n_bitband && !b; i++) {
+        if (sim->bitband[i].alias == alias) b = &sim->bitband[i];
+    }
+    if (!b && sim->n_bitband < SIM_BITBAND_SLOTS) {
+        b = &sim->bitband[sim->n_bitband++];
+    } else if (!b) {
+        b = &sim->bitband[sim->next_bitband];
+        sim->next_bitband = (sim->next_bitband + 1) % SIM_BITBAND_SLOTS;
+    }
+    b->alias = alias;
+    b->word = word;
+    b->bit = (alias >> 2) & 31;
+    b->w1c = w1c;
+    b->slot = b->seen = (*word >> b->bit) & 1;
+    return &b->slot;
+}
+
+volatile uint32_t *sim_bitband_word(uint32_t addr) {
+    volatile uint32_t *word;
+    unsigned int cost;
+    int w1c;
+
+    SIM_CALLER();
+    word = bus_word(addr, &cost, &w1c);
+    cpu_charge(cost);
+    return word;
+}
+
+/*=============================================================================
+ * HARNESS API
+ *============================================================================*/
+void sim_reset(void) {
+    int i;
+
+    memset(sim, 0, sizeof *sim);
+    sim->cclk = SIM_DEFAULT_CCLK;
+    sc_clock_boot();
+    SystemCoreClock = sim->cclk;
+    sim->sc.PCONP = PCONP_RESET;
+    sim->active_prio = SIM_THREAD_PRIO;
+    sim->adc_done_at = SIM_NEVER;
+    sim->dma_due = SIM_NEVER;
+    sim->stop_at = SIM_NEVER;
+    sim_flash_power_on();
+    sim->adc.ADCR = 1u << 0;
+    sim->adcr_seen = sim->adc.ADCR;
+    for (i = 0; i < 5; i++) {
+        sim->gpio[i].inputs = 0xFFFFFFFFu;  // Pull-ups enabled after reset
+        gpio_resolve(i);
+    }
+    for (i = 0; i < 4; i++) {
+        tim_publish(i);
+    }
+}
+
+sim_time_t sim_now(void) {
+    return sim->now;
+}
+
+uint32_t sim_cclk(void) {
+    return sim->cclk;
+}
+
+void sim_advance(sim_time_t cycles) {
+    sim->stop_at = sim->now + cycles;
+    sim_step(cycles);
+    sim->stop_at = SIM_NEVER;
+}
+
+void sim_run_until(sim_time_t when) {
+    if (when > sim->now) {
+        sim_advance(when - sim->now);
+    }
+}
+
+void sim_raise_irq(IRQn_Type irq) {
+    sim->irq_sw_pending[SIM_IRQ_INDEX(irq)] = 1;
+    sim_dispatch();
+}
+
+static void pin_drive(int port, int bit, int level) {
+    sim_gpio_t *g = &sim->gpio[port];
+    uint32_t bitmask = 1u << bit;
+    int old;
+
+    sim_sync();
+    old = (g->inputs & bitmask) != 0;
+    if (level) g->inputs |= bitmask;
+    else       g->inputs &= ~bitmask;
+    gpio_resolve(port);
+    if (old != (level != 0) && !(g->regs.FIODIR & bitmask)) {
+        tim_capture_edge(port, bit, level != 0);
+    }
+    sim_dispatch();
+}
+
+/*=============================================================================
+ * CONTACT BOUNCE
+ * Each edge on a bounced pin becomes the new level followed by chatter:
+ * alternating pulses of random width in [glitch_min, glitch_max] until
+ * burst_cycles have passed, then the final level. Isolated noise spikes
+ * can also hit a settled line. Events carry (pin, level, generation) so a
+ * new edge cancels the rest of an earlier burst.
+ *============================================================================*/
+static uint32_t bounce_rand(sim_bounce_pin_t *b, uint32_t lo, uint32_t hi) {
+    uint32_t x = b->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    b->rng = x;
+    return (hi > lo) ? lo + x % (hi - lo + 1) : lo;
+}
+
+static void *bounce_arg(int index, int level, unsigned int gen) {
+    return (void *)(uintptr_t)((gen << 4) | ((unsigned int)index << 1) | (level != 0));
+}
+
+static void bounce_event(void *arg) {
+    uintptr_t a = (uintptr_t)arg;
+    sim_bounce_pin_t *b = &sim->bounce[(a >> 1) & 7];
+
+    if ((unsigned int)(a >> 4) == (b->gen & 0x0FFFFFFFu)) {
+        pin_drive(b->port, b->bit, (int)(a & 1));
+    }
+}
+
+static void bounce_noise(void *arg) {
+    int index = (int)(uintptr_t)arg;
+    sim_bounce_pin_t *b = &sim->bounce[index];
+    const sim_bounce_t *p = &b->profile;
+
+    if (sim->now >= b->burst_end) {
+        pin_drive(b->port, b->bit, !b->target);
+        sim_schedule(sim->now + p->noise_width, bounce_event,
+                     bounce_arg(index, b->target, b->gen & 0x0FFFFFFFu));
+    }
+    sim_schedule(sim->now + 1 + bounce_rand(b, 0, 2 * p->noise_interval),
+                 bounce_noise, arg);
+}
+
+void sim_bounce(int port, int bit, const sim_bounce_t *profile) {
+    sim_bounce_pin_t *b;
+    int i;
+
+    for (i = 0; i < sim->n_bounce; i++) {
+        if (sim->bounce[i].port == port && sim->bounce[i].bit == bit) break;
+    }
+    if (i == sim->n_bounce) {
+        if (i == SIM_MAX_BOUNCE) {
+            fprintf(stderr, "sim: too many bounced pins\n");
+            exit(1);
+        }
+        sim->n_bounce++;
+    }
+    b = &sim->bounce[i];
+    b->port = port;
+    b->bit = bit;
+    b->profile = *profile;
+    b->rng = profile->seed ? profile->seed : 1;
+    b->target = (sim->gpio[port].inputs >> bit) & 1;
+    b->gen++;
+    b->burst_end = 0;
+    if (profile->noise_interval) {
+        sim_schedule(sim->now + 1 + bounce_rand(b, 0, 2 * profile->noise_interval),
+                     bounce_noise, (void *)(uintptr_t)i);
+    }
+}
+
+void sim_set_input(int port, int bit, int level) {
+    int i, lvl;
+    sim_time_t t;
+
+    level = level != 0;
+    for (i = 0; i < sim->n_bounce; i++) {
+        sim_bounce_pin_t *b = &sim->bounce[i];
+        const sim_bounce_t *p = &b->profile;
+        unsigned int gen;
+
+        if (b->port != port || b->bit != bit) continue;
+
+        gen = ++b->gen & 0x0FFFFFFFu;
+        b->target = level;
+        b->burst_end = sim->now + p->burst_cycles;
+        pin_drive(port, bit, level);                // First contact
+        lvl = level;
+        t = sim->now;
+        for (;;) {
+            t += bounce_rand(b, p->glitch_min ? p->glitch_min : 1, p->glitch_max);
+            if (t >= b->burst_end) break;
+            lvl = !lvl;
+            sim_schedule(t, bounce_event, bounce_arg(i, lvl, gen));
+        }
+        if (lvl != level) {
+            sim_schedule(b->burst_end, bounce_event, bounce_arg(i, level, gen));
+        }
+        return;
+    }
+    pin_drive(port, bit, level);
+}
+
+/* Same as firmware that reads the pin every poll_cycles until it reads
+ * 'level', but jumps straight from one possible pin change (event, timer,
+ * interrupt) to the next instead of simulating every read
+ */
+int sim_poll_input(int port, int bit, int level, uint32_t poll_cycles, sim_time_t until) {
+    SIM_CALLER();
+    for (;;) {
+        sim_time_t next, d;
+
+        cpu_charge(poll_cycles);
+        if ((int)((sim->gpio[port].pins >> bit) & 1) == (level != 0)) {
+            return 1;
+        }
+        if (sim->now >= until) {
+            return 0;
+        }
+        next = until;
+        if (sim->n_events && sim->events[0].when < next) {
+            next = sim->events[0].when;
+        }
+        d = periph_next_delta();
+        if (d != SIM_NEVER && sim->now + d < next) {
+            next = sim->now + d;
+        }
+        if (next > sim->now + poll_cycles) {
+            sim_time_t skip = ((next - sim->now) / poll_cycles - 1) * poll_cycles;
+            if (skip > 0x40000000u) {
+                skip = (0x40000000u / poll_cycles) * poll_cycles;
+            }
+            cpu_charge((uint32_t)skip);
+        }
+    }
+}
+
+uint32_t sim_pins(int port) {
+    sim_sync();
+    return sim->gpio[port].pins;
+}
+
+void sim_gpio_hook(sim_gpio_hook_fn fn) {
+    sim->gpio_hook = fn;
+}
+
+void sim_adc_source(sim_adc_source_fn fn) {
+    sim->adc_source = fn;
+}
+
+const sim_cpu_stats_t *sim_cpu_stats(void) {
+    return &sim->stats;
+}
+
+/*=============================================================================
+ * FLASH + IAP
+ * Kept outside the board state so it survives sim_reset(), one per thread
+ * like the board. IAP commands
+ * follow UM10360 (Prepare 50, Copy 51, Erase 52, Blank check 53) with the
+ * same status codes. Erase and copy stall the CPU for their datasheet time;
+ * a power cut inside that time leaves the operation part done: a copy has
+ * programmed its lines in order up to the cut and some bits of the line
+ * at the cut, an erase has set a random part of the bits.
+ *============================================================================*/
+#define IAP_SUCCESS         0
+#define IAP_INVALID_COMMAND 1
+#define IAP_SRC_ADDR_ERROR  2
+#define IAP_DST_ADDR_ERROR  3
+#define IAP_COUNT_ERROR     6
+#define IAP_INVALID_SECTOR  7
+#define IAP_NOT_BLANK       8
+#define IAP_NOT_PREPARED    9
+
+#define FLASH_LINE          16
+
+typedef struct {
+    uint8_t mem[SIM_FLASH_SIZE];
+    uint8_t written[SIM_FLASH_SIZE / FLASH_LINE];   // Programmed since erase
+    uint32_t prepared;                      // Sector bits armed by Prepare
+    sim_time_t cut_at;                      // Power cut, SIM_NEVER if none
+    uint32_t rng;
+    int ready;                              // Erased once at first use
+    sim_flash_stats_t stats;
+} sim_flash_t;
+
+static _Thread_local sim_flash_t sim_flash;
+
+static void flash_ready(void) {
+    if (!sim_flash.ready) {
+        sim_flash_wipe();
+    }
+}
+
+/* Power-up: flash contents stay, the Prepare state and any cut do not */
+static void sim_flash_power_on(void) {
+    flash_ready();
+    sim_flash.prepared = 0;
+    sim_flash.cut_at = SIM_NEVER;
+}
+
+static uint32_t flash_rand(void) {
+    uint32_t x = sim_flash.rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim_flash.rng = x;
+    return x;
+}
+
+static uint32_t flash_sector_base(uint32_t s) {
+    return (s < 16) ? s << 12 : 0x10000u + ((s - 16) << 15);
+}
+
+static uint32_t flash_sector_of(uint32_t addr) {
+    return (addr < 0x10000u) ? addr >> 12 : 16 + ((addr - 0x10000u) >> 15);
+}
+
+/* Stall the CPU for an IAP operation; returns how much of it completes
+ * before a power cut (all of it when there is none) */
+static sim_time_t iap_span(sim_time_t cycles) {
+    if (sim_flash.cut_at > sim->now && sim_flash.cut_at < sim->now + cycles) {
+        sim_flash.stats.torn++;
+        return sim_flash.cut_at - sim->now;
+    }
+    return cycles;
+}
+
+static sim_time_t iap_cycles(uint32_t us) {
+    return (sim_time_t)us * (sim->cclk / 1000000u);
+}
+
+static void iap_erase(uint32_t first, uint32_t last) {
+    sim_time_t cycles = iap_cycles(SIM_IAP_ERASE_US), done = iap_span(cycles);
+    uint32_t start = flash_sector_base(first);
+    uint32_t end = flash_sector_base(last + 1), a;
+    uint32_t s;
+
+    for (s = first; s <= last; s++) {
+        sim_flash.stats.erases[s]++;
+    }
+    if (done == cycles) {
+        memset(&sim_flash.mem[start], 0xFF, end - start);
+        memset(&sim_flash.written[start / FLASH_LINE], 0, (end - start) / FLASH_LINE);
+    } else {
+        for (a = start; a < end; a++) {     // Part way: some bits back to 1
+            sim_flash.mem[a] |= (uint8_t)(flash_rand() & flash_rand());
+        }
+        memset(&sim_flash.written[start / FLASH_LINE], 1, (end - start) / FLASH_LINE);
+    }
+    cpu_charge((uint32_t)cycles);
+}
+
+static void flash_program_line(uint32_t dst, const uint8_t *src, uint8_t keep) {
+    int i;
+
+    for (i = 0; i < FLASH_LINE; i++) {
+        if (src[i] != 0xFF) break;
+    }
+    if (i == FLASH_LINE) {
+        return;                             // All ones: line left as it is
+    }
+    if (sim_flash.written[dst / FLASH_LINE]) {
+        sim_flash.stats.lines_reprogrammed++;
+    }
+    sim_flash.written[dst / FLASH_LINE] = 1;
+    sim_flash.stats.lines_programmed++;
+    for (i = 0; i < FLASH_LINE; i++) {
+        sim_flash.mem[dst + i] &= src[i] | (keep ? (uint8_t)flash_rand() : 0);
+    }
+}
+
+static void iap_copy(uint32_t dst, const uint8_t *src, uint32_t bytes) {
+    sim_time_t cycles = iap_cycles(SIM_IAP_WRITE_US * (bytes / 256));
+    sim_time_t done = iap_span(cycles);
+    uint32_t lines = bytes / FLASH_LINE;
+    uint32_t full = (uint32_t)(done * lines / cycles), i;
+
+    for (i = 0; i < full; i++) {
+        flash_program_line(dst + i * FLASH_LINE, src + i * FLASH_LINE, 0);
+    }
+    if (full < lines) {                     // The line being written at the cut
+        flash_program_line(dst + full * FLASH_LINE, src + full * FLASH_LINE, 1);
+    }
+    cpu_charge((uint32_t)cycles);
+}
+
+static uint32_t iap_sectors_prepared(uint32_t first, uint32_t last) {
+    uint32_t s;
+
+    for (s = first; s <= last; s++) {
+        if (!(sim_flash.prepared & (1u << s))) return 0;
+    }
+    return 1;
+}
+
+void sim_iap(uint32_t *command, uint32_t *result) {
+    uint32_t first = command[1], last = command[2], s, a;
+
+    SIM_CALLER();
+    flash_ready();
+    sim_flash.stats.iap_calls++;
+    switch (command[0]) {
+        case 50:                            // Prepare sectors
+        case 52:                            // Erase sectors
+        case 53:                            // Blank check sectors
+            if (first > last || last >= SIM_FLASH_SECTORS) {
+                result[0] = IAP_INVALID_SECTOR;
+                return;
+            }
+            break;
+        case 51:                            // Copy RAM to flash
+            break;
+        default:
+            result[0] = IAP_INVALID_COMMAND;
+            return;
+    }
+
+    switch (command[0]) {
+        case 50:
+            for (s = first; s <= last; s++) {
+                sim_flash.prepared |= 1u << s;
+            }
+            cpu_charge((uint32_t)iap_cycles(SIM_IAP_CMD_US));
+            result[0] = IAP_SUCCESS;
+            break;
+        case 51: {
+            uint32_t dst = command[1], src = command[2], bytes = command[3];
+
+            if (dst % 256 || dst >= SIM_FLASH_SIZE) {
+                result[0] = IAP_DST_ADDR_ERROR;
+            } else if (src % 4) {
+                result[0] = IAP_SRC_ADDR_ERROR;
+            } else if ((bytes != 256 && bytes != 512 && bytes != 1024 && bytes != 4096) ||
+                       dst + bytes > SIM_FLASH_SIZE) {
+                result[0] = IAP_COUNT_ERROR;
+            } else if (!iap_sectors_prepared(flash_sector_of(dst),
+                                             flash_sector_of(dst + bytes - 1))) {
+                result[0] = IAP_NOT_PREPARED;
+            } else {
+                iap_copy(dst, (const uint8_t *)dma_ptr(src), bytes);
+                sim_flash.prepared = 0;
+                result[0] = IAP_SUCCESS;
+            }
+            break;
+        }
+        case 52:
+            if (!iap_sectors_prepared(first, last)) {
+                result[0] = IAP_NOT_PREPARED;
+                break;
+            }
+            iap_erase(first, last);
+            sim_flash.prepared = 0;
+            result[0] = IAP_SUCCESS;
+            break;
+        case 53:
+            cpu_charge((uint32_t)iap_cycles(SIM_IAP_CMD_US));
+            result[0] = IAP_SUCCESS;
+            for (a = flash_sector_base(first); a < flash_sector_base(last + 1); a += 4) {
+                uint32_t w;
+                memcpy(&w, &sim_flash.mem[a], 4);
+                if (w != 0xFFFFFFFFu) {
+                    result[0] = IAP_NOT_BLANK;
+                    result[1] = a;
+                    result[2] = w;
+                    break;
+                }
+            }
+            break;
+    }
+}
+
+const void *sim_flash_ptr(uint32_t addr) {
+    SIM_CALLER();
+    flash_ready();
+    cpu_charge(SIM_COST_FLASH);
+    sim_flash.stats.line_reads++;
+    return &sim_flash.mem[addr % SIM_FLASH_SIZE];
+}
+
+void sim_flash_wipe(void) {
+    memset(&sim_flash, 0, sizeof sim_flash);
+    memset(sim_flash.mem, 0xFF, sizeof sim_flash.mem);
+    sim_flash.cut_at = SIM_NEVER;
+    sim_flash.rng = 0x2545F491u;
+    sim_flash.ready = 1;
+}
+
+const sim_flash_stats_t *sim_flash_stats(void) {
+    return &sim_flash.stats;
+}
+
+void sim_flash_power_cut(sim_time_t when, sim_event_fn fn, void *arg) {
+    flash_ready();
+    sim_flash.cut_at = when;
+    sim_schedule(when, fn, arg);
+}
+
+/*=============================================================================
+ * CHECKPOINTS - a plain copy: events keep their callbacks and arguments,
+ * so a checkpoint is only good in the process (and thread) that made it
+ *============================================================================*/
+struct sim_checkpoint {
+    sim_board_t board;
+    sim_flash_t flash;
+    uint32_t core_clock;                    // SystemCoreClock as firmware set it
+};
+
+sim_checkpoint_t *sim_checkpoint(void) {
+    sim_checkpoint_t *cp = malloc(sizeof *cp);
+
+    if (!cp) {
+        fprintf(stderr, "sim: no memory for a checkpoint\n");
+        exit(1);
+    }
+    sim_sync();
+    memcpy(&cp->board, sim, sizeof *sim);   // Read-only registers: no plain copy
+    cp->flash = sim_flash;
+    cp->core_clock = SystemCoreClock;
+    return cp;
+}
+
+void sim_restore(const sim_checkpoint_t *cp) {
+    memcpy(sim, &cp->board, sizeof *sim);
+    sim_flash = cp->flash;
+    SystemCoreClock = cp->core_clock;
+}
+
+void sim_checkpoint_free(sim_checkpoint_t *cp) {
+    free(cp);
+}
@@ -0,0 +1,176 @@
+/******************************************************************************
+ * FILE: sim/sim.h
+ * DESCRIPTION: Host board simulator API - virtual clock, event queue,
+ *              GPIO input/output, ADC sources and CPU accounting
+ * OPERATION: Firmware compiled against sim/LPC17xx.h runs natively. Time
+ *            only advances when the firmware touches a peripheral, calls
+ *            __WFI()/__NOP(), or a harness calls sim_advance(). All times
+ *            are in CPU (CCLK) cycles since sim_reset(); once firmware
+ *            changes CCLK, cycles no longer map to time at a fixed rate
+ *            and sim_ns() gives the real time.
+ *            The board is per host thread: every thread that calls
+ *            sim_reset() gets its own (see sim_farm.h).
+ ******************************************************************************/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "LPC17xx.h"
+
+/*=============================================================================
+ * COST MODEL (CPU cycles charged per access)
+ *============================================================================*/
+#define SIM_COST_GPIO       2       // AHB fast GPIO load/store
+#define SIM_COST_APB        4       // APB peripheral (timers, ADC, SC, PINCON)
+#define SIM_COST_CORE       1       // SysTick / core registers
+#define SIM_COST_AHBRAM     2       // AHB SRAM load/store
+#define SIM_COST_BITBAND    1       // Alias access: extra bus read before the write
+#define SIM_COST_IRQ_ENTRY  12      // Exception entry (stacking + vector fetch)
+#define SIM_COST_IRQ_EXIT   10      // Exception return (unstacking)
+
+/* GPDMA engine timing (bus cycles, never charged to the CPU) */
+#define SIM_DMA_REQ_CYCLES  4       // Peripheral request to first bus access
+#define SIM_DMA_XFER_CYCLES 6       // One item: source read + destination write
+#define SIM_DMA_LLI_CYCLES  8       // Loading the next linked-list descriptor
+
+/* Flash and IAP (LPC1768 datasheet: erase 95-105 ms per command, about
+ * 1 ms to program 256 bytes); the CPU is stalled in the boot ROM meanwhile */
+#define SIM_COST_FLASH      6       // One 16-byte line read through FLASH_PTR()
+#define SIM_IAP_ERASE_US    100000  // Erase command, any number of sectors
+#define SIM_IAP_WRITE_US    1000    // Copy RAM to flash, per 256 bytes
+#define SIM_IAP_CMD_US      5       // Prepare / blank check
+
+#define SIM_DEFAULT_CCLK    100000000UL   // Keil system_LPC17xx.c default
+
+typedef uint64_t sim_time_t;
+
+/* Event callback: runs at its scheduled virtual time */
+typedef void (*sim_event_fn)(void *arg);
+
+/* GPIO output observer: called whenever a port's driven pins change */
+typedef void (*sim_gpio_hook_fn)(int port, uint32_t old_pins, uint32_t new_pins,
+                                 sim_time_t when);
+
+/* ADC source: returns the 12-bit code for a channel at a given time */
+typedef unsigned int (*sim_adc_source_fn)(int channel, sim_time_t when);
+
+/*=============================================================================
+ * BOARD CONTROL
+ *============================================================================*/
+void sim_reset(void);                       // Power-on reset of the whole board
+sim_time_t sim_now(void);                   // Current virtual time (cycles)
+uint32_t sim_cclk(void);                    // Current CPU clock in Hz
+uint64_t sim_ns(void);                      // Real time since reset (ns)
+void sim_advance(sim_time_t cycles);        // Let 'cycles' pass (events, IRQs)
+void sim_run_until(sim_time_t when);        // Advance to an absolute time
+
+/*=============================================================================
+ * EVENTS
+ *============================================================================*/
+int sim_schedule(sim_time_t when, sim_event_fn fn, void *arg);
+
+/*=============================================================================
+ * INTERRUPTS
+ *============================================================================*/
+void sim_raise_irq(IRQn_Type irq);          // Pend an IRQ from the harness (free)
+
+/*=============================================================================
+ * GPIO
+ *============================================================================*/
+void sim_set_input(int port, int bit, int level);   // Drive an input pin now
+
+/* Contact bounce for a mechanical switch input (all times in cycles).
+ * After sim_bounce(), every sim_set_input() on that pin chatters for
+ * burst_cycles before settling; noise_interval > 0 also adds isolated
+ * spikes of noise_width on the settled line about that often.
+ */
+typedef struct {
+    uint32_t burst_cycles;          // Chatter duration after each edge
+    uint32_t glitch_min;            // Shortest contact / break pulse
+    uint32_t glitch_max;            // Longest contact / break pulse
+    uint32_t noise_interval;        // Mean gap between spikes (0 = none)
+    uint32_t noise_width;           // Spike width
+    uint32_t seed;                  // Random sequence (0 = default)
+} sim_bounce_t;
+
+void sim_bounce(int port, int bit, const sim_bounce_t *profile);
+uint32_t sim_pins(int port);                        // Current pin levels
+int sim_poll_input(int port, int bit, int level,    // Fast busy-wait on a pin
+                   uint32_t poll_cycles, sim_time_t until);
+void sim_gpio_hook(sim_gpio_hook_fn fn);            // Observe output changes
+
+/*=============================================================================
+ * ADC
+ *============================================================================*/
+void sim_adc_source(sim_adc_source_fn fn);
+
+/*=============================================================================
+ * FLASH - 512 KB with the LPC1768 sector map (16 x 4 KB, then 14 x 32 KB),
+ * written through IAP_ENTRY and read through FLASH_PTR(). The contents
+ * survive sim_reset() as the real array survives a power cycle;
+ * sim_flash_wipe() returns it to the erased factory state with no wear.
+ * The part keeps ECC per 16-byte line, so a line must be programmed only
+ * once between erases: the model counts repeats and stores old AND new.
+ *============================================================================*/
+#define SIM_FLASH_SIZE      0x80000
+#define SIM_FLASH_SECTORS   30
+
+typedef struct {
+    unsigned long erases[SIM_FLASH_SECTORS];    // Erase operations per sector
+    unsigned long lines_programmed;             // 16-byte lines written
+    unsigned long lines_reprogrammed;           // Written again without an erase
+    unsigned long line_reads;                   // FLASH_PTR() accesses
+    unsigned long iap_calls;
+    unsigned long torn;                         // Erases/copies cut by power loss
+} sim_flash_stats_t;
+
+void sim_flash_wipe(void);
+const sim_flash_stats_t *sim_flash_stats(void);
+
+/* Power fails at 'when': an erase or copy running at that moment is left
+ * part done (some lines/bits written), then fn(arg) runs. fn normally
+ * longjmps back into the harness, which calls sim_reset() to power up. */
+void sim_flash_power_cut(sim_time_t when, sim_event_fn fn, void *arg);
+
+/*=============================================================================
+ * DELAY LOOPS - a firmware busy-wait loop is plain C: it costs no virtual
+ * time unless it starts with DELAY_LOOP_SKIP(passes, cycles_per_pass)
+ * (clock.h). The tool picks how such a loop runs:
+ *   SIM_DELAY_NATIVE  the host runs the loop, in no virtual time (default)
+ *   SIM_DELAY_PASSES  every pass charged on its own, as an instruction-level
+ *                     simulator would step it (the slow reference)
+ *   SIM_DELAY_FAST    all passes in one step: time jumps from one timer
+ *                     match, IRQ or event to the next, like __WFI()
+ * In both charged modes interrupts taken inside the loop stretch it by
+ * their own time, so the two give the same cycles.
+ *============================================================================*/
+void sim_delay_mode(sim_delay_mode_t mode);         // Board setting, reset clears it
+
+/*=============================================================================
+ * CHECKPOINTS - the whole board: registers, time, pending events, bounce
+ * state, flash contents and SystemCoreClock. Firmware and harness
+ * variables live in the host program; save them alongside.
+ *============================================================================*/
+typedef struct sim_checkpoint sim_checkpoint_t;
+
+sim_checkpoint_t *sim_checkpoint(void);
+void sim_restore(const sim_checkpoint_t *cp);       // Same process and thread
+void sim_checkpoint_free(sim_checkpoint_t *cp);
+
+/*=============================================================================
+ * CPU ACCOUNTING
+ * busy = cycles charged to firmware (accesses, nops, handlers)
+ * idle = cycles skipped while sleeping in __WFI()
+ * irq_count[n] counts handler invocations per IRQ (index irq + 1)
+ *============================================================================*/
+typedef struct {
+    sim_time_t busy;
+    sim_time_t idle;
+    unsigned long irq_count[SIM_IRQ_COUNT + 1];
+} sim_cpu_stats_t;
+
+const sim_cpu_stats_t *sim_cpu_stats(void);
+void sim_charge(unsigned int cycles);        // Charge firmware work explicitly
+
+#endif /* SIM_H */
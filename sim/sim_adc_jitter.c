@@ -0,0 +1,172 @@
+/******************************************************************************
+ * FILE: sim/sim_adc_jitter.c
+ * DESCRIPTION: Sample-interval jitter of the ADC display program ("include
+ *              LPC17xx hfdfad.c"): conversions started by TIMER1 MAT1.0
+ *              (adc_sampler.c) against the SysTick-paced software-start
+ *              loop it replaced, with a quiet input and with one that
+ *              keeps the LCD redrawing
+ * BUILD: gcc -O2 -pthread -Isim -I. sim/sim.c sim/sim_farm.c adc_filter.c
+ *        adc_sampler.c display_gate.c clock.c sim/sim_adc_jitter.c
+ *        -o sim_adc_jitter
+ * OPERATION: each run powers up the board and stops after RUN_MS. Both
+ *            schemes sample CH4 once per millisecond; every CH4 conversion
+ *            is timed as the simulated ADC finishes it, and the intervals
+ *            between them are compared with 1 ms. lcd_delay() is timed in
+ *            one step (SIM_DELAY_FAST), so a redraw holds the foreground
+ *            for as long as it would on the board.
+ * NOTE: "loop" is the program's main loop before the sampler, kept here
+ *       as written then: sleep to the next 1 ms SysTick slot, start CH4 by
+ *       software and poll DONE, the same for CH5, then filter and redraw.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "sim_farm.h"
+
+/* The ADC program itself */
+#define main adc_main
+#include "include LPC17xx hfdfad.c"
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define RUN_MS              10000
+#define MAX_SAMPLES         (2 * RUN_MS)
+
+/*=============================================================================
+ * SOFTWARE-START LOOP - the SysTick-paced main() the sampler replaced
+ *============================================================================*/
+static int loop_main(void) {
+    unsigned int adc_ch4, adc_ch5, diff;
+    unsigned int raw4, raw5;
+    unsigned int shown[3];
+    unsigned long next_sample;
+    char buffer[20];
+    adc_filter_t filt4, filt5;
+    adc_mv_scale_t mv;
+    uint32_t adc_clkdiv;
+
+    SystemInit();
+    SystemCoreClockUpdate();
+    adc_clkdiv = clock_adc_clkdiv() << 8;
+    LPC_SC->PCONP |= (1 << 12);
+    LPC_PINCON->PINSEL3 |= (0x5 << 28);
+    lcd_init();
+    adc_filter_init(&filt4, ADC_FILTER_OVERSAMPLE, ADC_OS_BITS);
+    adc_filter_init(&filt5, ADC_FILTER_OVERSAMPLE, ADC_OS_BITS);
+    adc_mv_scale_init(&mv, ADC_VREF_MV, filt4.out_bits);
+    display_gate_init(&disp_gate, 3, DISP_HYST_MV, DISP_MAX_AGE_MS);
+    SysTick_Config(SystemCoreClock / 1000);
+    next_sample = ms_ticks;
+
+    while (1) {
+        while ((long)(ms_ticks - next_sample) < 0)
+            __WFI();
+        next_sample += 1;
+
+        LPC_ADC->ADCR = (1<<4) | adc_clkdiv | (1<<21) | (1<<24);
+        while ((LPC_ADC->ADGDR & (1<<31)) == 0);
+        raw4 = (LPC_ADC->ADGDR >> 4) & 0xFFF;
+
+        LPC_ADC->ADCR = (1<<5) | adc_clkdiv | (1<<21) | (1<<24);
+        while ((LPC_ADC->ADGDR & (1<<31)) == 0);
+        raw5 = (LPC_ADC->ADGDR >> 4) & 0xFFF;
+
+        adc_filter_push(&filt4, raw4, &adc_ch4);
+        if (!adc_filter_push(&filt5, raw5, &adc_ch5))
+            continue;
+        adc_ch4 = adc_to_mv(&mv, adc_ch4);
+        adc_ch5 = adc_to_mv(&mv, adc_ch5);
+        diff = (adc_ch5 > adc_ch4) ? (adc_ch5 - adc_ch4) : (adc_ch4 - adc_ch5);
+        shown[0] = adc_ch4;
+        shown[1] = adc_ch5;
+        shown[2] = diff;
+        if (!display_gate_check(&disp_gate, shown, ms_ticks))
+            continue;
+
+        lcd_gotoxy(0, 0);
+        sprintf(buffer, "CH4:%04umV", adc_ch4);
+        lcd_puts(buffer);
+        lcd_gotoxy(0, 1);
+        sprintf(buffer, "CH5:%04u D:%04u", adc_ch5, diff);
+        lcd_puts(buffer);
+    }
+
+    return 0;
+}
+
+/*=============================================================================
+ * INPUTS - CH4 conversions are timed here, as each one finishes
+ *============================================================================*/
+static sim_time_t taken[MAX_SAMPLES];
+static size_t n_taken;
+static int moving;                          // Input that keeps the LCD busy
+static jmp_buf stop_jump;
+
+static unsigned int adc_input(int channel, sim_time_t when) {
+    unsigned int t = (unsigned int)((when / (CCLK_MS / 10)) % 2000);   // 200 ms triangle
+    unsigned int tri = (t < 1000) ? t : 2000 - t;
+
+    if (channel == 4 && n_taken < MAX_SAMPLES) {
+        taken[n_taken++] = when;
+    }
+    if (!moving) {
+        return (channel == 4) ? 1861 : 2482;        // 1.5 V and 2 V
+    }
+    return (channel == 4) ? 1000 + 2 * tri : 3000 - tri;
+}
+
+static void stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+/*=============================================================================
+ * REPORT
+ *============================================================================*/
+static void report(const char *name, int input, unsigned long dropped) {
+    static double dev[MAX_SAMPLES];
+    double sum = 0, min = 1e9, max = 0;
+    sim_pct_t p;
+    size_t i;
+
+    for (i = 1; i < n_taken; i++) {
+        double us = (double)(taken[i] - taken[i - 1]) * 1000.0 / CCLK_MS;
+
+        sum += us;
+        if (us < min) min = us;
+        if (us > max) max = us;
+        dev[i - 1] = (us > 1000.0) ? us - 1000.0 : 1000.0 - us;
+    }
+    sim_percentiles(dev, n_taken ? n_taken - 1 : 0, &p);
+    printf("  %-6s %-7s %7zu %9.2f %9.2f %9.2f %9.2f %9.2f %8lu %8lu\n", name,
+           input ? "moving" : "steady", n_taken, n_taken > 1 ? sum / (n_taken - 1) : 0.0,
+           min, max, p.p99, p.max, disp_gate.updates, dropped);
+}
+
+static void run(const char *name, int (*fn)(void), int input) {
+    sim_reset();
+    sim_delay_mode(SIM_DELAY_FAST);
+    sim_adc_source(adc_input);
+    moving = input;
+    n_taken = 0;
+    sim_schedule((sim_time_t)RUN_MS * CCLK_MS, stop, 0);
+    if (!setjmp(stop_jump)) {
+        fn();
+    }
+    report(name, input, (fn == adc_main) ? (unsigned long)adc_sampler.dropped : 0ul);
+}
+
+int main(void) {
+    int input;
+
+    printf("CH4 sample intervals over %d ms (nominal 1000 us; about %d samples after\n"
+           "lcd_init()), in us\n", RUN_MS, RUN_MS - 5);
+    printf("  %-6s %-7s %7s %9s %9s %9s %9s %9s %8s %8s\n", "scheme", "input", "samples",
+           "mean", "min", "max", "dev99", "devmax", "redraws", "dropped");
+    for (input = 0; input < 2; input++) {
+        run("loop", loop_main, input);
+        run("timer", adc_main, input);
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+/******************************************************************************
+ * FILE: sim/sim_bitband.c
+ * DESCRIPTION: Checks bitband.h against the simulated alias regions (flag
+ *              word, GPIO, timer and SC registers), then has main() and an
+ *              interrupt at random cycles each toggle their own bit of one
+ *              shared word, four ways: plain read-modify-write, RMW with
+ *              interrupts masked, LDREX/STREX, and bit-band stores
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c sim/sim_bitband.c -o sim_bitband
+ * NOTE: loads and stores of the flag word go through BITBAND_WORD_PTR()
+ *       and are charged like AHB SRAM accesses; each ALU instruction
+ *       (ORR/BIC/UBFX) is charged one cycle here. The instruction counts
+ *       printed are the Thumb-2 hand counts from bitband.h.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "sim.h"
+#include "bitband.h"
+
+#define ITERATIONS      1000000UL
+#define MAIN_BIT        0
+#define ISR_BIT         1
+
+#define ALU()           sim_charge(1)       // ORR / BIC / UBFX
+
+/*=============================================================================
+ * ALIAS MAP - every kind of target the simulator decodes
+ *============================================================================*/
+static unsigned int checks, wrong;
+
+static void check(const char *what, uint32_t got, uint32_t want) {
+    checks++;
+    if (got != want) {
+        if (wrong++ < 5) {
+            printf("  %s: 0x%08X, expected 0x%08X\n", what, got, want);
+        }
+    }
+}
+
+static void alias_map(void) {
+    bb_bit_t dir = BB_GPIO(LPC_GPIO0_BASE, BB_FIODIR, 4);
+    bb_bit_t pin = BB_GPIO(LPC_GPIO0_BASE, BB_FIOPIN, 4);
+    bb_bit_t sw = BB_GPIO(LPC_GPIO2_BASE, BB_FIOPIN, 12);
+    bb_bit_t mcr = BB_BIT(LPC_TIM0_BASE + offsetof(LPC_TIM_TypeDef, MCR), 1);
+    bb_bit_t pconp = BB_BIT(LPC_SC_BASE + offsetof(LPC_SC_TypeDef, PCONP), 22);
+    unsigned int n;
+
+    sim_reset();
+    check("alias of 0x2009C054 bit 12", BB_BIT(LPC_GPIO2_BASE + BB_FIOPIN, 12).alias,
+          0x23380AB0u);
+    check("alias of 0x400FC0C4 bit 22", pconp.alias, 0x43F818D8u);
+
+    bb_flags_init(0);
+    for (n = 0; n < 32; n++) {
+        bb_set(BB_FLAG(n));
+        check("flag word after set", bb_flags(), (uint32_t)((2ull << n) - 1));
+        check("flag read", bb_read(BB_FLAG(n)), 1);
+    }
+    for (n = 0; n < 32; n += 2) {
+        bb_write(BB_FLAG(n), 0x10);         // Bit 0 of the value only: clears
+    }
+    check("flag word after clears", bb_flags(), 0xAAAAAAAAu);
+
+    bb_set(dir);
+    check("FIODIR", LPC_GPIO0->FIODIR, 1u << 4);
+    bb_set(pin);
+    check("P0.4 driven high", (sim_pins(0) >> 4) & 1, 1);
+    bb_set(BB_GPIO(LPC_GPIO0_BASE, BB_FIOCLR, 4));
+    check("P0.4 after FIOCLR alias", (sim_pins(0) >> 4) & 1, 0);
+    bb_set(BB_GPIO(LPC_GPIO0_BASE, BB_FIOSET, 4));
+    check("P0.4 after FIOSET alias", (sim_pins(0) >> 4) & 1, 1);
+    bb_clear(pin);
+    check("P0.4 driven low", (sim_pins(0) >> 4) & 1, 0);
+
+    sim_set_input(2, 12, 0);
+    check("SW2 pressed", bb_read(sw), 0);
+    sim_set_input(2, 12, 1);
+    check("SW2 released", bb_read(sw), 1);
+
+    LPC_TIM0->MCR = 1;
+    bb_set(mcr);
+    check("T0MCR", LPC_TIM0->MCR, 3);
+    bb_clear(pconp);
+    check("PCONP bit 22", LPC_SC->PCONP & (1u << 22), 0);
+
+    printf("alias map: %u checks, %u wrong\n\n", checks, wrong);
+}
+
+/*=============================================================================
+ * UPDATE METHODS - one bit of the shared flag word
+ *============================================================================*/
+typedef struct {
+    const char *name;
+    unsigned int instructions;              // Thumb-2, set or clear
+    uint32_t (*read)(unsigned int bit);
+    void (*write)(unsigned int bit, uint32_t v);
+} method_t;
+
+static uint32_t read_word(unsigned int bit) {
+    uint32_t w = *BITBAND_WORD_PTR(BB_FLAGS_ADDR);
+
+    ALU();
+    return (w >> bit) & 1;
+}
+
+static void write_plain(unsigned int bit, uint32_t v) {
+    uint32_t w = *BITBAND_WORD_PTR(BB_FLAGS_ADDR);
+
+    ALU();
+    w = v ? (w | (1u << bit)) : (w & ~(1u << bit));
+    *BITBAND_WORD_PTR(BB_FLAGS_ADDR) = w;
+}
+
+static void write_masked(unsigned int bit, uint32_t v) {
+    __disable_irq();
+    write_plain(bit, v);
+    __enable_irq();
+}
+
+static void write_exclusive(unsigned int bit, uint32_t v) {
+    volatile uint32_t *p = BITBAND_WORD_PTR(BB_FLAGS_ADDR);   // LDR =address
+    uint32_t w;
+
+    do {
+        w = __LDREXW(p);
+        ALU();
+        w = v ? (w | (1u << bit)) : (w & ~(1u << bit));
+    } while (__STREXW(w, p));
+}
+
+static uint32_t read_bitband(unsigned int bit) {
+    return bb_read(BB_FLAG(bit));
+}
+
+static void write_bitband(unsigned int bit, uint32_t v) {
+    bb_write(BB_FLAG(bit), v);
+}
+
+static const method_t methods[] = {
+    { "plain RMW",         4, read_word,    write_plain     },
+    { "RMW, IRQs masked",  6, read_word,    write_masked    },
+    { "LDREX/STREX",       6, read_word,    write_exclusive },
+    { "bit-band store",    3, read_bitband, write_bitband   },
+};
+
+/*=============================================================================
+ * RACE - main() and TIMER1 each own one bit and check it before toggling
+ *============================================================================*/
+static const method_t *method;
+static uint32_t isr_bit;
+static unsigned long isr_runs, isr_lost;
+static sim_time_t raised_at, latency_sum, latency_max;
+static int raised;
+
+void TIMER1_IRQHandler(void) {
+    sim_time_t lat = sim_now() - raised_at; // Includes exception entry
+
+    raised = 0;
+    latency_sum += lat;
+    if (lat > latency_max) latency_max = lat;
+    isr_runs++;
+    if (method->read(ISR_BIT) != isr_bit) {
+        isr_lost++;                         // main() wrote back a stale copy
+    }
+    isr_bit ^= 1;
+    method->write(ISR_BIT, isr_bit);
+}
+
+/* Interrupt 1..96 cycles after the previous one; one outstanding at a time */
+static void irq_event(void *arg) {
+    (void)arg;
+    if (!raised) {
+        raised = 1;
+        raised_at = sim_now();
+        sim_raise_irq(TIMER1_IRQn);
+    }
+    sim_schedule(sim_now() + 1 + (sim_time_t)(rand() % 96), irq_event, 0);
+}
+
+static void race(const method_t *m) {
+    unsigned long i, main_lost = 0;
+    uint32_t main_bit = 0;
+    sim_time_t t0, cost;
+
+    sim_reset();
+    method = m;
+    bb_flags_init(0);
+
+    // Cost of one update on its own
+    t0 = sim_now();
+    m->write(MAIN_BIT, 1);
+    cost = sim_now() - t0;
+    m->write(MAIN_BIT, 0);
+
+    srand(1);
+    isr_bit = 0;
+    isr_runs = isr_lost = 0;
+    latency_sum = latency_max = 0;
+    raised = 0;
+    NVIC_SetPriority(TIMER1_IRQn, 1);
+    NVIC_EnableIRQ(TIMER1_IRQn);
+    sim_schedule(sim_now() + 1, irq_event, 0);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        if (m->read(MAIN_BIT) != main_bit) {
+            main_lost++;
+        }
+        main_bit ^= 1;
+        m->write(MAIN_BIT, main_bit);
+    }
+
+    printf("  %-18s %5u %8llu %9lu %8lu %8.1f %6llu\n", m->name, m->instructions,
+           (unsigned long long)cost, isr_runs, isr_lost + main_lost,
+           (double)latency_sum / isr_runs, (unsigned long long)latency_max);
+}
+
+int main(void) {
+    unsigned int i;
+
+    alias_map();
+    printf("shared flag word, %lu main() toggles, interrupt every 1-96 cycles\n",
+           ITERATIONS);
+    printf("  %-18s %5s %8s %9s %8s %8s %6s\n", "update", "instr", "cycles",
+           "IRQs", "lost", "lat avg", "max");
+    for (i = 0; i < sizeof methods / sizeof methods[0]; i++) {
+        race(&methods[i]);
+    }
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+ * FILE: sim/sim_boot.c
+ * DESCRIPTION: Time from reset to the first character on the LCD, for the
+ *              old blocking init of q29.c and for the deadline-driven init
+ *              (boot_prof.c + init_seq.c), with a check of every HD44780
+ *              wait time on the bus
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c boot_prof.c init_seq.c sim/sim_boot.c -o sim_boot
+ * SEQUENCES:
+ *   blocking  transcribed from q29.c before init_seq: delay_lcd(500000)
+ *             power-on wait, delay_lcd(50000) after each wake nibble,
+ *             4-bit switch and clear, no wait after other commands
+ *   deadline  q29.c as it is now: its step tables run by init_seq_run(),
+ *             LCD chain due 40 ms after boot, datasheet waits per step
+ *   coroutine in place of deadline when built with -DCORO_INIT (and
+ *             coro.c): q29.c's init written in order as one coroutine,
+ *             run by coro_run()
+ * NOTE: delay_lcd() is an uncalibrated loop; at roughly 8 cycles per
+ *       iteration it is modelled as 8 cycles each at 100 MHz. The two
+ *       delay_lcd(200) around each enable pulse are plain C inside q29.c,
+ *       so they are added to the latch times afterwards (32 us per nibble,
+ *       in both sequences alike).
+ ******************************************************************************/
+
+#include <stdio.h>
+#include "sim.h"
+
+/* q29.c itself, for its LCD routines and init step tables */
+#define main q29_main
+#include "q29.c"
+#undef main
+
+#define CCLK_US             100             // Cycles per microsecond
+#define DELAY_LOOP_CYCLES   8               // Cycles per delay_lcd() iteration
+#define PULSE_CYCLES        (200 * DELAY_LOOP_CYCLES)   // Each delay_lcd(200)
+#define MAX_WRITES          64
+
+/*=============================================================================
+ * BUS OBSERVER - every nibble the LCD latches (EN falling edge)
+ *============================================================================*/
+static sim_time_t write_at[MAX_WRITES];
+static unsigned char write_rs[MAX_WRITES], write_nib[MAX_WRITES];
+static unsigned int writes;
+static int en_pulsed;                   // EN rose since the last latch
+
+static void bus_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    if (port != 0) {
+        return;
+    }
+    if (!(old_pins & EN_CTRL) && (new_pins & EN_CTRL)) {
+        en_pulsed = 1;
+    }
+    // A pulled-up EN being driven low by lcd_bus_init() is not a write
+    if (en_pulsed && !(new_pins & EN_CTRL) && writes < MAX_WRITES) {
+        en_pulsed = 0;
+        // Pulse delays before this one: settle of each earlier nibble + own pulse
+        write_at[writes] = when + (2 * writes + 1) * PULSE_CYCLES;
+        write_rs[writes] = (new_pins & RS_CTRL) != 0;
+        write_nib[writes] = (new_pins >> 23) & 0xF;
+        writes++;
+    }
+}
+
+/*=============================================================================
+ * HD44780 TIMING CHECK - each latched write must come at least the
+ * datasheet time after the previous instruction. Short waits are counted
+ * apart: after the power-on / wake / clear instructions (the init
+ * sequence's job) and between back-to-back bytes (the bus delays' job).
+ *============================================================================*/
+typedef struct {
+    sim_time_t first_char;              // Low nibble of the first character
+    sim_time_t message;                 // Low nibble of the last character
+    unsigned int short_init;
+    unsigned int short_byte;
+} boot_result_t;
+
+static void check_timing(boot_result_t *r) {
+    unsigned int w, chars = 0, need_us = 40000;    // Power-on
+    static const unsigned int wake_us[4] = { 4100, 100, 37, 37 };
+    sim_time_t ready = (sim_time_t)need_us * CCLK_US;
+
+    r->first_char = r->message = 0;
+    r->short_init = r->short_byte = 0;
+    for (w = 0; w < writes; w++) {
+        if (write_at[w] < ready) {
+            if (need_us > 37) {
+                r->short_init++;
+            } else {
+                r->short_byte++;
+            }
+        }
+        if (w < 4) {
+            need_us = wake_us[w];                       // Single wake nibbles
+        } else if ((w - 4) % 2 == 0) {
+            continue;                                   // High nibble of a byte
+        } else {
+            unsigned char byte = (write_nib[w - 1] << 4) | write_nib[w];
+            need_us = (!write_rs[w] && byte == 0x01) ? 1520 : 37;
+            if (write_rs[w] && ++chars == 1) {
+                r->first_char = write_at[w];
+            }
+            if (write_rs[w] && chars == sizeof msg - 1) {
+                r->message = write_at[w];
+            }
+        }
+        ready = write_at[w] + (sim_time_t)need_us * CCLK_US;
+    }
+}
+
+/*=============================================================================
+ * SEQUENCES
+ *============================================================================*/
+static void delay_loop(unsigned int r) {
+    sim_charge(r * DELAY_LOOP_CYCLES);
+}
+
+static void boot_blocking(void) {
+    SystemInit();
+    SystemCoreClockUpdate();
+    lcd_bus_init();
+
+    flag1 = 0;
+    delay_loop(500000);
+    lcd_send_nibble(0x03);
+    delay_loop(50000);
+    lcd_send_nibble(0x03);
+    delay_loop(50000);
+    lcd_send_nibble(0x03);
+    delay_loop(50000);
+    lcd_send_nibble(0x02);
+    delay_loop(50000);
+    lcd_cmd(0x28);
+    lcd_cmd(0x0C);
+    lcd_cmd(0x06);
+    lcd_cmd(0x01);
+    delay_loop(50000);
+
+    for (i = 0; msg[i] != '\0'; i++)
+        lcd_data(msg[i]);
+}
+
+#ifdef CORO_INIT
+static void boot_coroutine(void) {
+    boot_prof_init(BOOT_IRC_HZ);
+    SystemInit();
+    SystemCoreClockUpdate();
+    boot_prof_clock(SystemCoreClock);
+    boot_mark("SystemInit");
+    coro_init(SystemCoreClock);
+    lcd_delays_calibrate();
+
+    coro_spawn(board_co, "board", sizeof(coro_t));
+    coro_spawn(lcd_init_co, "lcd init", sizeof(lcd_init_frame_t));
+    coro_run(0);
+}
+#else
+static void boot_deadline(void) {
+    init_chain_t chains[2];
+
+    boot_prof_init(BOOT_IRC_HZ);
+    SystemInit();
+    SystemCoreClockUpdate();
+    boot_prof_clock(SystemCoreClock);
+    boot_mark("SystemInit");
+    lcd_delays_calibrate();
+
+    init_chain(&chains[0], board_steps,
+               sizeof board_steps / sizeof board_steps[0], 0);
+    init_chain(&chains[1], lcd_steps,
+               sizeof lcd_steps / sizeof lcd_steps[0], LCD_POWER_ON_US);
+    init_seq_run(chains, 2);
+}
+#endif
+
+static void run(const char *name, void (*boot)(void)) {
+    boot_result_t r;
+
+    sim_reset();
+    sim_gpio_hook(bus_hook);
+    writes = 0;
+    en_pulsed = 0;
+    boot();
+    sim_advance(CCLK_US);               // Commit the last EN store
+    check_timing(&r);
+    printf("%-9s %10.2f %12.2f %8u %10u %10u\n", name,
+           r.first_char / (double)(1000 * CCLK_US), r.message / (double)(1000 * CCLK_US),
+           writes, r.short_init, r.short_byte);
+}
+
+int main(void) {
+    printf("sequence  first char ms  message ms  writes  short init  short byte\n");
+    run("blocking", boot_blocking);
+#ifdef CORO_INIT
+    run("coroutine", boot_coroutine);
+
+    printf("\ncoroutine timeline (boot_prof_dump):\n");
+#else
+    run("deadline", boot_deadline);
+
+    printf("\ndeadline timeline (boot_prof_dump):\n");
+#endif
+    boot_prof_dump();
+    return 0;
+}
@@ -0,0 +1,319 @@
+/******************************************************************************
+ * FILE: sim/sim_clock.c
+ * DESCRIPTION: Runs clock.c on the simulated PLL0: the 1 s tick, the q29.c
+ *              LCD timing and the ADC clock while the CPU clock keeps
+ *              changing, with and without the recalibration hooks
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c clock.c boot_prof.c init_seq.c sim/sim_clock.c -o sim_clock
+ * TESTS:
+ *   tick  Timer0 set up like initialize_timer0() in bcd_counter_7seg.c
+ *         (1 ms prescale, MR0 = 999, PR from clock_pclk) and its
+ *         CLOCK_SCALING hook; the clock jumps every 20-300 ms between
+ *         rates reached by CCLKCFG alone and rates that need a relock.
+ *         Every tick is timed in real time (sim_ns).
+ *   lcd   q29.c built with CLOCK_SCALING: init waits at 4 MHz, text at
+ *         100 MHz, plus a run where a third init chain changes the clock
+ *         every 1-3 ms. Every HD44780 wait is checked in real time.
+ *   adc   One conversion at each rate with CLKDIV from clock_adc_clkdiv()
+ *         and with the CLKDIV worked out once at 100 MHz.
+ * NOTE: only the Timer0 code of bcd_counter_7seg.c is used, transcribed
+ *       here. delay_lcd() is plain C; its time is added to the
+ *       latch times at ~8 cycles per pass at the clock of the moment.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+
+/* q29.c itself, for its LCD routines, init steps and clock hook */
+#define CLOCK_SCALING
+#define main q29_main
+#include "q29.c"
+#undef main
+
+#define TICK_SECONDS        120
+#define MAX_TICKS           (TICK_SECONDS + 8)
+#define MAX_WRITES          64
+
+/* Reached by CCLKCFG alone (FCCO 400 MHz) and by reprogramming PLL0 */
+static const uint32_t rates[] = {
+    100000000, 4000000, 12500000, 25000000, 50000000,   // 400 MHz / 4..100
+    60000000, 72000000, 30000000,                       // Need a relock
+};
+#define N_RATES             (sizeof rates / sizeof rates[0])
+
+static uint64_t ns_per_cycle_x(uint32_t cclk, uint64_t cycles) {
+    return cycles * 1000000000ull / cclk;
+}
+
+/* Let 'us' of real time pass at whatever clock is running */
+static void wait_us(uint32_t us) {
+    sim_advance((sim_time_t)us * sim_cclk() / 1000000u);
+}
+
+/*=============================================================================
+ * TICK - Timer0 as in bcd_counter_7seg.c
+ *============================================================================*/
+static uint64_t tick_ns[MAX_TICKS];
+static unsigned int ticks;
+
+void TIMER0_IRQHandler(void) {
+    if (LPC_TIM0->IR & (1 << 0)) {
+        LPC_TIM0->IR = (1 << 0);
+        if (ticks < MAX_TICKS) {
+            tick_ns[ticks++] = sim_ns();
+        }
+    }
+}
+
+static void tick_timer_init(void) {
+    LPC_SC->PCONP |= (1 << 1);
+    LPC_TIM0->CTCR = 0x00;
+    LPC_TIM0->PR = clock_pclk(CLOCK_PCLK_TIMER0) / 1000 - 1;
+    LPC_TIM0->MR0 = 999;                // TC runs 0..MR0: 1000 ms
+    LPC_TIM0->MCR = (1 << 0) | (1 << 1);
+    LPC_TIM0->TCR = 0x02;
+    LPC_TIM0->TCR = 0x01;
+    NVIC_EnableIRQ(TIMER0_IRQn);
+    NVIC_SetPriority(TIMER0_IRQn, 3);
+}
+
+static void tick_clock_changed(uint32_t cclk) {
+    (void)cclk;
+    clock_timer_retune(LPC_TIM0, clock_pclk(CLOCK_PCLK_TIMER0), 1000);
+}
+
+static void tick_run(const char *name, int recalibrate) {
+    uint64_t start, worst = 0, end_ns = (uint64_t)TICK_SECONDS * 1000000000ull;
+    unsigned int n, changes = 0, refused = 0;
+    int64_t drift;
+
+    sim_reset();
+    srand(7);
+    SystemInit();
+    SystemCoreClockUpdate();
+    ticks = 0;
+    tick_timer_init();
+    start = sim_ns();
+    if (recalibrate) {
+        clock_on_change(tick_clock_changed);
+    }
+    while (sim_ns() - start < end_ns) {
+        wait_us(20000 + (uint32_t)(rand() % 280) * 1000);
+        if (clock_set(rates[rand() % N_RATES])) {
+            changes++;
+        } else {
+            refused++;
+        }
+    }
+    for (n = 1; n < ticks; n++) {
+        uint64_t p = tick_ns[n] - tick_ns[n - 1];
+        uint64_t e = p > 1000000000ull ? p - 1000000000ull : 1000000000ull - p;
+        if (e > worst) worst = e;
+    }
+    drift = ticks > 1 ? (int64_t)(tick_ns[ticks - 1] - tick_ns[0]) -
+                        (int64_t)(ticks - 1) * 1000000000ll : 0;
+    printf("  %-20s %6u %6u %8u %14.3f %14.3f\n", name, changes, refused, ticks,
+           worst / 1e6, drift / 1e6);
+}
+
+/*=============================================================================
+ * LCD - q29.c init sequence, every latched nibble timed in real time
+ *============================================================================*/
+static uint64_t write_at[MAX_WRITES], offset_ns, min_pulse_ns, max_pulse_ns;
+static unsigned char write_rs[MAX_WRITES], write_nib[MAX_WRITES];
+static unsigned int writes;
+static int en_pulsed;
+
+/* Each nibble: delay_lcd() with EN high (pulse), then again after (settle) */
+static void bus_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    uint64_t pulse;
+
+    (void)when;
+    if (port != 0) {
+        return;
+    }
+    if (!(old_pins & EN_CTRL) && (new_pins & EN_CTRL)) {
+        en_pulsed = 1;
+    }
+    if (en_pulsed && !(new_pins & EN_CTRL) && writes < MAX_WRITES) {
+        en_pulsed = 0;
+        pulse = ns_per_cycle_x(sim_cclk(), (uint64_t)lcd_pulse_loops * LCD_DELAY_LOOP_CYCLES);
+        if (pulse < min_pulse_ns) min_pulse_ns = pulse;
+        if (pulse > max_pulse_ns) max_pulse_ns = pulse;
+        write_at[writes] = sim_ns() + offset_ns + pulse;
+        offset_ns += 2 * pulse;
+        write_rs[writes] = (new_pins & RS_CTRL) != 0;
+        write_nib[writes] = (new_pins >> 23) & 0xF;
+        writes++;
+    }
+}
+
+typedef struct {
+    uint64_t first_char;
+    unsigned int short_init, short_byte;
+} lcd_result_t;
+
+/* Same rules as sim_boot.c, in nanoseconds */
+static void check_timing(lcd_result_t *r) {
+    static const unsigned int wake_us[4] = { 4100, 100, 37, 37 };
+    unsigned int w, need_us = 40000;
+    uint64_t ready = (uint64_t)need_us * 1000;
+
+    r->first_char = 0;
+    r->short_init = r->short_byte = 0;
+    for (w = 0; w < writes; w++) {
+        if (write_at[w] < ready) {
+            if (need_us > 37) {
+                r->short_init++;
+            } else {
+                r->short_byte++;
+            }
+        }
+        if (w < 4) {
+            need_us = wake_us[w];
+        } else if ((w - 4) % 2 == 0) {
+            continue;
+        } else {
+            unsigned char byte = (write_nib[w - 1] << 4) | write_nib[w];
+            need_us = (!write_rs[w] && byte == 0x01) ? 1520 : 37;
+            if (write_rs[w] && !r->first_char) {
+                r->first_char = write_at[w];
+            }
+        }
+        ready = write_at[w] + (uint64_t)need_us * 1000;
+    }
+}
+
+/* Third init chain for the stress run: a new clock every 1-3 ms */
+static unsigned int jumps;
+
+static uint32_t step_clock_jump(void) {
+    clock_set(rates[rand() % N_RATES]);
+    jumps++;
+    return 1000 + (uint32_t)(rand() % 2000);
+}
+
+static const init_step_t jump_steps[] = {
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+    { "clock", step_clock_jump }, { "clock", step_clock_jump },
+};
+
+#define LCD_FIXED       0               // 100 MHz throughout (sim_boot.c)
+#define LCD_SCALED      1               // q29.c main() with CLOCK_SCALING
+#define LCD_JUMPS       2               // ...and a clock change every 1-3 ms
+
+/* 'setup_hz': clock when boot_prof and the delay loops are calibrated */
+static void lcd_run(const char *name, int mode, int add_hook, uint32_t setup_hz) {
+    init_chain_t chains[3];
+    lcd_result_t r;
+
+    sim_reset();
+    srand(11);
+    sim_gpio_hook(bus_hook);
+    writes = 0;
+    en_pulsed = 0;
+    offset_ns = 0;
+    min_pulse_ns = (uint64_t)-1;
+    max_pulse_ns = 0;
+    jumps = 0;
+
+    boot_prof_init(BOOT_IRC_HZ);
+    SystemInit();
+    SystemCoreClockUpdate();
+    clock_set(setup_hz);
+    boot_prof_clock(SystemCoreClock);
+    boot_mark("SystemInit");
+    lcd_delays_calibrate();
+    if (mode != LCD_FIXED) {
+        if (add_hook) {
+            clock_on_change(lcd_clock_changed);
+        }
+        clock_set(CLOCK_IDLE_HZ);
+    }
+    init_chain(&chains[0], board_steps, sizeof board_steps / sizeof board_steps[0], 0);
+    init_chain(&chains[1], lcd_steps, sizeof lcd_steps / sizeof lcd_steps[0],
+               LCD_POWER_ON_US);
+    init_chain(&chains[2], jump_steps, sizeof jump_steps / sizeof jump_steps[0], 500);
+    init_seq_run(chains, mode == LCD_JUMPS ? 3 : 2);
+    wait_us(10);                        // Commit the last EN store
+    sim_gpio_hook(0);
+
+    check_timing(&r);
+    printf("  %-30s %6u %10.2f %7.2f %7.2f %10u %10u\n", name, jumps, r.first_char / 1e6,
+           min_pulse_ns / 1e3, max_pulse_ns / 1e3, r.short_init, r.short_byte);
+}
+
+/*=============================================================================
+ * ADC - conversion time and ADC clock at each rate
+ *============================================================================*/
+static double adc_convert_us(uint32_t clkdiv) {
+    uint64_t t0;
+
+    t0 = sim_ns();
+    LPC_ADC->ADCR = (1 << 0) | (clkdiv << 8) | (1 << 21) | (1 << 24);
+    while ((LPC_ADC->ADGDR & (1u << 31)) == 0);
+    return (sim_ns() - t0) / 1e3;
+}
+
+static void adc_table(void) {
+    uint32_t fixed_div, div;
+    unsigned int k;
+
+    sim_reset();
+    SystemInit();
+    SystemCoreClockUpdate();
+    LPC_SC->PCONP |= (1 << 12);
+    fixed_div = clock_adc_clkdiv();     // Worked out once at 100 MHz
+    for (k = 0; k < N_RATES; k++) {
+        clock_set(rates[k]);
+        div = clock_adc_clkdiv();
+        printf("  %9.1f MHz  %6u %9.2f MHz %9.1f us  %6u %9.2f MHz %9.1f us\n",
+               rates[k] / 1e6, div, clock_pclk(CLOCK_PCLK_ADC) / (div + 1) / 1e6,
+               adc_convert_us(div), fixed_div,
+               clock_pclk(CLOCK_PCLK_ADC) / (fixed_div + 1) / 1e6, adc_convert_us(fixed_div));
+    }
+    /* The other way round: CLKDIV set at 4 MHz, then back to full speed */
+    clock_set(CLOCK_IDLE_HZ);
+    fixed_div = clock_adc_clkdiv();
+    clock_set(CLOCK_FAST_HZ);
+    printf("  CLKDIV %u set at 4 MHz, used at 100 MHz: ADC clock %.2f MHz (limit 13)\n",
+           fixed_div, clock_pclk(CLOCK_PCLK_ADC) / (fixed_div + 1) / 1e6);
+}
+
+/* clock.c keeps its hooks across sim_reset(), as firmware would across a
+ * soft reset of the simulated board: runs without a hook come first */
+int main(void) {
+    printf("lcd: q29.c init + \"%s\", waits checked against the HD44780 datasheet\n", msg);
+    printf("  %-30s %6s %10s %15s %10s %10s\n", "", "clocks", "first char", "EN high us",
+           "short init", "short byte");
+    printf("  %-30s %6s %10s %7s %7s\n", "", "", "ms", "min", "max");
+    lcd_run("100 MHz (no scaling)", LCD_FIXED, 0, CLOCK_FAST_HZ);
+    lcd_run("4 MHz waits, no hook", LCD_SCALED, 0, CLOCK_FAST_HZ);
+    lcd_run("jumps, no hook", LCD_JUMPS, 0, CLOCK_FAST_HZ);
+    lcd_run("jumps, no hook, set up at 4 MHz", LCD_JUMPS, 0, CLOCK_IDLE_HZ);
+    lcd_run("4 MHz waits, hook", LCD_SCALED, 1, CLOCK_FAST_HZ);
+    lcd_run("jumps, hook", LCD_JUMPS, 0, CLOCK_FAST_HZ);        // Hook stays
+    lcd_run("jumps, hook, set up at 4 MHz", LCD_JUMPS, 0, CLOCK_IDLE_HZ);
+
+    printf("\ntick: %d s of Timer0 1 s ticks, clock changed every 20-300 ms\n", TICK_SECONDS);
+    printf("  %-20s %6s %6s %8s %14s %14s\n", "", "clock", "none", "ticks",
+           "worst tick ms", "drift ms");
+    tick_run("fixed PR", 0);
+    tick_run("clock_timer_retune", 1);
+
+    printf("\nadc: one conversion, CLKDIV recalculated | CLKDIV fixed at 100 MHz\n");
+    printf("  %13s  %6s %13s %12s  %6s %13s %12s\n", "CCLK", "CLKDIV", "ADC clock",
+           "convert", "CLKDIV", "ADC clock", "convert");
+    adc_table();
+    return 0;
+}
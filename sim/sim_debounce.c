@@ -0,0 +1,271 @@
+/******************************************************************************
+ * FILE: sim/sim_debounce.c
+ * DESCRIPTION: Scores the labs' switch debounce methods against simulated
+ *              contact bounce: detection latency, missed presses, false
+ *              presses and CPU time
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c port_debounce.c sim/sim_debounce.c -o sim_debounce
+ * METHODS (the lab programs' own code, main() renamed, delay_ms() timed in
+ *          one step with SIM_DELAY_FAST):
+ *   ring_counter  "FILE ring counter led.c" from its main():
+ *                 is_button_pressed() edge, delay_ms(20), re-read; then
+ *                 wait for release polling every 10 ms, delay_ms(100). A
+ *                 press is detected when update_leds() lights the next LED
+ *   keypad        Read_Keypad() of the calculator, called until it returns
+ *                 a key as Get_Expression() does: per row drive +
+ *                 delay_ms(10), column low -> key, spin until release. A
+ *                 press is detected when the key is returned, after the
+ *                 release. The switch is wired to COL1, so whichever row
+ *                 is being scanned sees it; the release spin runs read by
+ *                 read and takes most of the run time
+ *   sampled       reference: 1 ms SysTick samples into a 0..5 integrator,
+ *                 core sleeps in __WFI() between samples
+ *   vertical      port_debounce.c from a 5 ms SysTick, whole port 2
+ *   main_simple() of the ring counter file is commented out in the lab
+ *   source, so it cannot be built in and is not scored.
+ * NOTE: the labs' delay_ms() is an uncalibrated loop of 10000 iterations.
+ *       At roughly 8 cycles per iteration (DELAY_MS_LOOP_CYCLES) that is
+ *       0.8 ms per "ms" at 100 MHz.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "port_debounce.h"
+
+/* The two programs, with their main() renamed; each has its own delay_ms() */
+#define main ring_main
+#define delay_ms ring_delay_ms
+#include "FILE ring counter led.c"
+#undef delay_ms
+#undef main
+#define main calc_main
+#define delay_ms calc_delay_ms
+#include "include LPCfdsfsdf17xx h include.c"
+#undef delay_ms
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per real millisecond
+#define PRESSES             150
+#define MATCH_WINDOW        (600 * CCLK_MS) // Later than this = not that press
+
+#define SW_PORT             2
+#define SW_BIT              12              // SW2, P2.12
+#define COL_BIT             23              // Keypad COL1, P2.23
+
+/*=============================================================================
+ * SCENARIO - press times and what each method reported
+ *============================================================================*/
+static sim_time_t press_at[PRESSES], release_at[PRESSES];
+static sim_time_t detect_at[4 * PRESSES];
+static int detects;
+static sim_time_t run_end;
+static int input_bit;
+static jmp_buf stop_jump;
+
+static void detect(void) {
+    if (detects < 4 * PRESSES) {
+        detect_at[detects++] = sim_now();
+    }
+}
+
+static int running(void) {
+    return sim_now() < run_end;
+}
+
+static void ev_press(void *arg)   { (void)arg; sim_set_input(SW_PORT, input_bit, 0); }
+static void ev_release(void *arg) { (void)arg; sim_set_input(SW_PORT, input_bit, 1); }
+
+static void ev_stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+static void make_scenario(unsigned int seed) {
+    sim_time_t t = 50 * CCLK_MS;
+    int i;
+
+    srand(seed);
+    for (i = 0; i < PRESSES; i++) {
+        press_at[i] = t;
+        release_at[i] = t + (40 + rand() % 360) * CCLK_MS;     // Hold 40-400 ms
+        t = release_at[i] + (60 + rand() % 640) * CCLK_MS;     // Gap 60-700 ms
+    }
+    run_end = t;
+}
+
+/*=============================================================================
+ * METHODS UNDER TEST
+ *============================================================================*/
+/* The ring counter's main() never returns: a press is the LED pattern
+ * update_leds() sets, the first one (at boot) excepted, and the run ends
+ * by a jump out of the program at run_end
+ */
+static int ring_boot_pattern;
+
+static void ring_leds(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    (void)when;
+    if (port != 0 || (old_pins & LED_MASK) || !(new_pins & LED_MASK)) {
+        return;
+    }
+    if (ring_boot_pattern) {
+        ring_boot_pattern = 0;
+    } else {
+        detect();
+    }
+}
+
+static void method_ring_counter(void) {
+    ring_counter = 0x01;
+    prev_switch_state = 1;
+    ring_boot_pattern = 1;
+    sim_gpio_hook(ring_leds);
+    sim_schedule(run_end, ev_stop, 0);
+    if (!setjmp(stop_jump)) {
+        ring_main();
+    }
+    sim_gpio_hook(0);
+}
+
+/* Read_Keypad() with the keypad set up as the calculator's main() does */
+static void method_keypad(void) {
+    KEYPAD_PORT->FIODIR &= ~(COL1 | COL2 | COL3);
+    KEYPAD_PORT->FIODIR |= (ROW1 | ROW2 | ROW3 | ROW4);
+    while (running()) {
+        if (Read_Keypad()) {
+            detect();
+        }
+    }
+}
+
+/* Reference: timer-sampled integrator */
+static int switch_level(void) {
+    return (LPC_GPIO2->FIOPIN >> input_bit) & 1;
+}
+
+static volatile unsigned char integ, integ_state;
+static port_debounce_t port2;
+static int use_vertical;
+
+void SysTick_Handler(void) {
+    if (use_vertical) {
+        if (port_debounce_tick(&port2, LPC_GPIO2->FIOPIN) & port2.state & (1u << input_bit)) {
+            detect();
+        }
+        return;
+    }
+    if (!switch_level()) {
+        if (integ < 5 && ++integ == 5 && !integ_state) {
+            integ_state = 1;
+            detect();
+        }
+    } else if (integ > 0 && --integ == 0) {
+        integ_state = 0;
+    }
+}
+
+static void method_sampled(void) {
+    integ = 0;
+    integ_state = 0;
+    SysTick_Config(SystemCoreClock / 1000);
+    while (running()) {
+        __WFI();
+    }
+    SysTick->CTRL = 0;
+}
+
+/* port_debounce.c: the tick reports the edge, as the lab's main loop
+ * would see it from port_debounce_take_pressed()
+ */
+static void method_vertical(void) {
+    port_debounce_init(&port2, 1u << input_bit, LPC_GPIO2->FIOPIN);
+    use_vertical = 1;
+    SysTick_Config(SystemCoreClock / 200);
+    while (running()) {
+        __WFI();
+    }
+    SysTick->CTRL = 0;
+    use_vertical = 0;
+}
+
+/*=============================================================================
+ * SCORING - a detection belongs to the last press that started before it,
+ * if that press is not already taken and started less than MATCH_WINDOW
+ * earlier; anything else is a false press
+ *============================================================================*/
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    int bit;
+} method_t;
+
+static void score(const method_t *m, const sim_bounce_t *bounce) {
+    static unsigned char matched[PRESSES];
+    const sim_cpu_stats_t *st;
+    double lat_sum = 0, lat_max = 0, busy;
+    int i, p = 0, hits = 0, falses = 0;
+
+    sim_reset();
+    sim_delay_mode(SIM_DELAY_FAST);
+    SystemInit();
+    input_bit = m->bit;
+    sim_bounce(SW_PORT, input_bit, bounce);
+    for (i = 0; i < PRESSES; i++) {
+        sim_schedule(press_at[i], ev_press, 0);
+        sim_schedule(release_at[i], ev_release, 0);
+        matched[i] = 0;
+    }
+    detects = 0;
+    m->run();
+    st = sim_cpu_stats();
+    busy = 100.0 * (double)st->busy / (double)sim_now();
+
+    for (i = 0; i < detects; i++) {
+        sim_time_t d = detect_at[i];
+        while (p + 1 < PRESSES && press_at[p + 1] <= d) {
+            p++;
+        }
+        if (press_at[p] <= d && d < press_at[p] + MATCH_WINDOW && !matched[p]) {
+            double lat = (double)(d - press_at[p]) / CCLK_MS;
+            matched[p] = 1;
+            hits++;
+            lat_sum += lat;
+            if (lat > lat_max) lat_max = lat;
+        } else {
+            falses++;
+        }
+    }
+    printf("  %-13s %8.1f %8.1f %7d %7d %7.1f\n", m->name,
+           hits ? lat_sum / hits : 0.0, lat_max, PRESSES - hits, falses, busy);
+}
+
+int main(void) {
+    static const method_t methods[] = {
+        { "ring_counter", method_ring_counter, SW_BIT },
+        { "keypad",       method_keypad,       COL_BIT },
+        { "sampled",      method_sampled,      SW_BIT },
+        { "vertical",     method_vertical,     SW_BIT },
+    };
+    static const struct { const char *name; sim_bounce_t b; } profiles[] = {
+        { "clean contact",
+          { 0, 0, 0, 0, 0, 1 } },
+        { "typical: 5 ms bursts, 20-500 us pulses",
+          { 5 * CCLK_MS, 2000, 50000, 0, 0, 7 } },
+        { "worn: 15 ms bursts, 10 us-2 ms pulses, 10 us spikes every ~300 ms",
+          { 15 * CCLK_MS, 1000, 200000, 300 * CCLK_MS, 1000, 11 } },
+    };
+    unsigned int i, j;
+
+    make_scenario(2024);
+    printf("%d presses, holds 40-400 ms, gaps 60-700 ms, %.1f s total\n",
+           PRESSES, (double)run_end / (1000.0 * CCLK_MS));
+    for (j = 0; j < sizeof profiles / sizeof profiles[0]; j++) {
+        printf("\n%s\n", profiles[j].name);
+        printf("  %-13s %8s %8s %7s %7s %7s\n", "method", "lat ms", "max ms",
+               "missed", "false", "cpu %");
+        for (i = 0; i < sizeof methods / sizeof methods[0]; i++) {
+            score(&methods[i], &profiles[j].b);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+/******************************************************************************
+ * FILE: sim/sim_farm.c
+ * DESCRIPTION: Work-stealing thread pool for simulated boards and
+ *              percentile helpers (see sim_farm.h)
+ * OPERATION: A worker's slice of job numbers is one 64-bit atomic word,
+ *            next job in the high half and end in the low half. The owner
+ *            claims one job by a compare-and-swap of next + 1, a thief
+ *            claims the back half by one of end - half, so a job is taken
+ *            exactly once with no lock. Jobs are never added, so a worker
+ *            that finds every slice empty is done.
+ ******************************************************************************/
+
+#define _GNU_SOURCE                         // sysconf(_SC_NPROCESSORS_ONLN)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim_farm.h"
+
+#define SLICE(next, end)    (((uint64_t)(next) << 32) | (uint32_t)(end))
+#define SLICE_NEXT(s)       ((uint32_t)((s) >> 32))
+#define SLICE_END(s)        ((uint32_t)(s))
+
+typedef struct farm farm_t;
+
+typedef struct {
+    _Atomic uint64_t slice;
+    farm_t *farm;
+    unsigned int index;
+    unsigned long jobs;
+    unsigned long steals;
+    pthread_t thread;
+} farm_worker_t;
+
+struct farm {
+    farm_worker_t *workers;
+    unsigned int n_workers;
+    sim_job_fn fn;
+    void *ctx;
+};
+
+unsigned int sim_farm_cores(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (n < 1) ? 1 : (unsigned int)n;
+}
+
+/*=============================================================================
+ * WORK STEALING
+ *============================================================================*/
+/* Claims the next job of the worker's own slice; -1 when it is empty */
+static long take_own(farm_worker_t *w) {
+    uint64_t s = atomic_load(&w->slice);
+
+    while (SLICE_NEXT(s) < SLICE_END(s)) {
+        if (atomic_compare_exchange_weak(&w->slice, &s, SLICE(SLICE_NEXT(s) + 1, SLICE_END(s)))) {
+            return (long)SLICE_NEXT(s);
+        }
+    }
+    return -1;
+}
+
+/* Moves the back half of the fullest other slice into w's (empty) slice;
+ * 0 when there is nothing left anywhere */
+static int steal(farm_worker_t *w) {
+    farm_t *f = w->farm;
+
+    for (;;) {
+        farm_worker_t *victim = 0;
+        uint64_t s = 0;
+        uint32_t most = 0, half;
+        unsigned int k;
+
+        for (k = 1; k < f->n_workers; k++) {
+            farm_worker_t *v = &f->workers[(w->index + k) % f->n_workers];
+            uint64_t vs = atomic_load(&v->slice);
+            uint32_t left = (SLICE_NEXT(vs) < SLICE_END(vs)) ? SLICE_END(vs) - SLICE_NEXT(vs) : 0;
+            if (left > most) {
+                most = left;
+                victim = v;
+                s = vs;
+            }
+        }
+        if (!victim) {
+            return 0;
+        }
+        half = (most + 1) / 2;
+        if (atomic_compare_exchange_strong(&victim->slice, &s,
+                                           SLICE(SLICE_NEXT(s), SLICE_END(s) - half))) {
+            atomic_store(&w->slice, SLICE(SLICE_END(s) - half, SLICE_END(s)));
+            w->steals++;
+            return 1;
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    farm_worker_t *w = arg;
+    long job;
+
+    for (;;) {
+        job = take_own(w);
+        if (job < 0) {
+            if (!steal(w)) {
+                break;
+            }
+            continue;
+        }
+        w->farm->fn((unsigned int)job, w->farm->ctx);
+        w->jobs++;
+    }
+    return 0;
+}
+
+static double wall_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+void sim_farm_run(unsigned int jobs, unsigned int threads, sim_job_fn fn, void *ctx,
+                  sim_farm_stats_t *stats) {
+    farm_t f;
+    double t0;
+    unsigned int k;
+
+    if (threads < 1) threads = 1;
+    if (threads > SIM_FARM_MAX_THREADS) threads = SIM_FARM_MAX_THREADS;
+    f.workers = calloc(threads, sizeof *f.workers);
+    if (!f.workers) {
+        fprintf(stderr, "sim_farm: out of memory\n");
+        exit(1);
+    }
+    f.n_workers = threads;
+    f.fn = fn;
+    f.ctx = ctx;
+    for (k = 0; k < threads; k++) {
+        f.workers[k].farm = &f;
+        f.workers[k].index = k;
+        atomic_init(&f.workers[k].slice,
+                    SLICE((uint64_t)jobs * k / threads, (uint64_t)jobs * (k + 1) / threads));
+    }
+
+    t0 = wall_seconds();
+    for (k = 0; k < threads; k++) {
+        if (pthread_create(&f.workers[k].thread, 0, worker_main, &f.workers[k]) != 0) {
+            fprintf(stderr, "sim_farm: cannot start worker %u\n", k);
+            exit(1);
+        }
+    }
+    for (k = 0; k < threads; k++) {
+        pthread_join(f.workers[k].thread, 0);
+    }
+
+    if (stats) {
+        stats->threads = threads;
+        stats->seconds = wall_seconds() - t0;
+        stats->steals = 0;
+        stats->most_jobs = 0;
+        stats->least_jobs = (unsigned long)-1;
+        for (k = 0; k < threads; k++) {
+            farm_worker_t *w = &f.workers[k];
+            stats->steals += w->steals;
+            if (w->jobs > stats->most_jobs) stats->most_jobs = w->jobs;
+            if (w->jobs < stats->least_jobs) stats->least_jobs = w->jobs;
+        }
+    }
+    free(f.workers);
+}
+
+/*=============================================================================
+ * PERCENTILES - nearest rank: the smallest value with at least p of the
+ * samples at or below it
+ *============================================================================*/
+static int by_value(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double rank(const double *v, size_t n, double p) {
+    size_t r = (size_t)(p * (double)n + 0.999999);
+
+    return v[(r < 1) ? 0 : (r > n) ? n - 1 : r - 1];
+}
+
+void sim_percentiles(double *v, size_t n, sim_pct_t *out) {
+    double sum = 0;
+    size_t i;
+
+    out->n = n;
+    if (n == 0) {
+        out->mean = out->p50 = out->p90 = out->p99 = out->max = 0;
+        return;
+    }
+    qsort(v, n, sizeof *v, by_value);
+    for (i = 0; i < n; i++) {
+        sum += v[i];
+    }
+    out->mean = sum / (double)n;
+    out->p50 = rank(v, n, 0.50);
+    out->p90 = rank(v, n, 0.90);
+    out->p99 = rank(v, n, 0.99);
+    out->max = v[n - 1];
+}
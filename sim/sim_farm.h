@@ -0,0 +1,49 @@
+/******************************************************************************
+ * FILE: sim/sim_farm.h
+ * DESCRIPTION: Simulation farm - runs many independent simulated boards in
+ *              one process, one per host thread, and turns their results
+ *              into percentile tables
+ * OPERATION: The board behind the LPC_* macros, the flash model and
+ *            SystemCoreClock are thread-local in sim.c, so every worker
+ *            thread has its own registers, clock and event queue. A job
+ *            calls sim_reset(), runs its scenario and stores its results
+ *            in a slot of its own (indexed by the job number); the results
+ *            are then the same for any thread count. Firmware and harness
+ *            state the job touches must be per job or _Thread_local too.
+ *            Work stealing: each worker starts with an equal slice of the
+ *            job numbers and takes from its front; a worker that runs dry
+ *            takes the back half of the fullest slice left.
+ ******************************************************************************/
+
+#ifndef SIM_FARM_H
+#define SIM_FARM_H
+
+#include <stddef.h>
+
+#define SIM_FARM_MAX_THREADS    256
+
+/* One job: runs on some worker thread with a freshly owned board */
+typedef void (*sim_job_fn)(unsigned int job, void *ctx);
+
+typedef struct {
+    unsigned int threads;
+    double seconds;                     // Wall-clock time of the whole run
+    unsigned long steals;               // Slices taken from other workers
+    unsigned long most_jobs;            // Busiest and idlest worker
+    unsigned long least_jobs;
+} sim_farm_stats_t;
+
+typedef struct {
+    size_t n;
+    double mean, p50, p90, p99, max;
+} sim_pct_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+unsigned int sim_farm_cores(void);              // Online host CPUs
+void sim_farm_run(unsigned int jobs, unsigned int threads, sim_job_fn fn, void *ctx,
+                  sim_farm_stats_t *stats);     // stats may be 0
+void sim_percentiles(double *v, size_t n, sim_pct_t *out);  // Sorts v in place
+
+#endif /* SIM_FARM_H */
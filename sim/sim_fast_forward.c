@@ -0,0 +1,342 @@
+/******************************************************************************
+ * FILE: sim/sim_fast_forward.c
+ * DESCRIPTION: Wall-clock cost of the lab delay loops under the simulator,
+ *              every pass charged on its own against the loop timed in one
+ *              step (sim_delay_mode), and a full 0000 -> 9999 -> 0000 run
+ *              of bcd_counter_7seg.c at its real 1 s tick
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c sim/sim_fast_forward.c -o sim_fast_forward
+ * TESTS:
+ *   bcd     bcd_counter_7seg.c: its Timer0 tick, update_bcd_counter() and
+ *           display loop (4 x delay_milliseconds(2) + delay_microseconds(100)
+ *           per frame). 3 s in both modes with the GPIO traces compared,
+ *           then 10000 ticks in fast mode: every value shown must be the
+ *           BCD successor of the one before and the count must end at 0000.
+ *           A checkpoint at 9990 is restored twice: once with SW2 pressed
+ *           (counts down to 9970), once as before (same trace again).
+ *   lcd     lcd.c: main() up to its final while(1) (init commands, then
+ *           the message), delay_lcd(25) / delay_lcd(5000) around each EN
+ *           pulse, in both modes with the bus traces compared
+ * NOTE: the display loop of main() is transcribed (bcd_frames below) so
+ *       the tool gets control back between frames; everything it calls
+ *       is the program's own code. The same for lcd.c's main().
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+#include "sim.h"
+
+/* The two programs, with their main() renamed */
+#define main bcd_main
+#include "FILE bcd counter 7seg.c"
+#undef main
+#define main lcd_main
+#include "lcd.c"
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define WINDOW_MS           3000            // Compared in both modes
+#define FULL_TICKS          10000           // 0000 -> 9999 -> 0000
+#define CHECKPOINT_TICK     9990
+#define REPLAY_TICKS        20
+#define LCD_FAST_RUNS       1000            // Repeats for a readable time
+
+static double wall_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* FNV-1a over a GPIO change */
+static uint64_t trace_add(uint64_t h, int port, uint32_t pins, sim_time_t when) {
+    uint64_t v[3];
+    const unsigned char *p = (const unsigned char *)v;
+    size_t k;
+
+    v[0] = (uint64_t)port;
+    v[1] = pins;
+    v[2] = when;
+    for (k = 0; k < sizeof v; k++) {
+        h = (h ^ p[k]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+/*=============================================================================
+ * BCD COUNTER - what the display shows, checked frame by frame
+ *============================================================================*/
+typedef struct {
+    uint64_t trace;
+    unsigned int value;                     // Digits collected this frame
+    unsigned int shown;                     // Last complete value shown
+    int counting_up;                        // Expected direction
+    unsigned long frames, frames_this;      // Frames in all / of 'shown'
+    unsigned long frames_min, frames_max;   // Per value, whole seconds only
+    unsigned long values, wrong, unreadable;
+} display_t;
+
+static display_t disp;
+
+static unsigned int bcd_to_int(unsigned int b) {
+    return ((b >> 12) & 0xF) * 1000 + ((b >> 8) & 0xF) * 100 + ((b >> 4) & 0xF) * 10 + (b & 0xF);
+}
+
+static unsigned int int_to_bcd(unsigned int n) {
+    return ((n / 1000) << 12) | (((n / 100) % 10) << 8) | (((n / 10) % 10) << 4) | (n % 10);
+}
+
+static unsigned int bcd_next(unsigned int b, int up) {
+    return int_to_bcd((bcd_to_int(b) + (up ? 1 : 9999)) % 10000);
+}
+
+static void display_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    uint32_t lit = new_pins & ~old_pins & ENABLE_ALL;
+    unsigned int pos, seg, d;
+
+    disp.trace = trace_add(disp.trace, port, new_pins, when);
+    if (port != 1 || !lit) {
+        return;
+    }
+    pos = (unsigned int)__builtin_ctz(lit) - 23;
+    seg = sim_pins(0) & DATA_MASK;
+    for (d = 0; d < 10 && bcd_seg_words[d] != seg; d++) {
+        continue;
+    }
+    if (d == 10) {
+        disp.unreadable++;
+    }
+    disp.value = (pos == 0) ? d : (disp.value << 4) | d;
+    if (pos != 3) {
+        return;
+    }
+    disp.frames++;
+    if (disp.value == disp.shown) {
+        disp.frames_this++;
+        return;
+    }
+    if (disp.value != bcd_next(disp.shown, disp.counting_up)) {
+        disp.wrong++;
+    }
+    if (disp.values > 0) {                  // The first value was shown from boot
+        if (disp.frames_this < disp.frames_min) disp.frames_min = disp.frames_this;
+        if (disp.frames_this > disp.frames_max) disp.frames_max = disp.frames_this;
+    }
+    disp.values++;
+    disp.shown = disp.value;
+    disp.frames_this = 1;
+}
+
+/* main() up to its display loop */
+static void bcd_boot(sim_delay_mode_t mode) {
+    sim_reset();
+    sim_delay_mode(mode);
+    sim_gpio_hook(display_hook);
+    bcd_counter = 0x0000;
+    counting_direction = 1;
+    counter_lock.seq = 0;
+    disp = (display_t){ 0 };
+    disp.trace = 0xCBF29CE484222325ull;
+    disp.counting_up = 1;
+    disp.frames_min = (unsigned long)-1;
+
+    SystemInit();
+    SystemCoreClockUpdate();
+    calibrate_delays();
+    initialize_gpio();
+    initialize_timer0();
+    DATA_PORT->FIOCLR = DATA_MASK;
+    ENABLE_PORT->FIOCLR = ENABLE_ALL;
+}
+
+/* main()'s display loop, one frame at a time until 'until' */
+static void bcd_frames(sim_time_t until) {
+    unsigned char i, digit_value;
+    unsigned int frame_counter;
+    uint32_t seq;
+
+    while (sim_now() < until) {
+        do {
+            seq = seqlock_read_begin(&counter_lock);
+            frame_counter = bcd_counter;
+        } while (seqlock_read_retry(&counter_lock, seq));
+        for (i = 0; i < 4; i++) {
+            digit_value = extract_bcd_digit(frame_counter, i);
+            display_digit(i, digit_value);
+            delay_milliseconds(2);
+        }
+        delay_microseconds(100);
+    }
+}
+
+/* Firmware variables that go with a board checkpoint */
+typedef struct {
+    unsigned int bcd_counter;
+    unsigned char counting_direction;
+    uint32_t lock_seq;
+    display_t disp;
+} bcd_saved_t;
+
+static void bcd_save(bcd_saved_t *s) {
+    s->bcd_counter = bcd_counter;
+    s->counting_direction = counting_direction;
+    s->lock_seq = counter_lock.seq;
+    s->disp = disp;
+}
+
+static void bcd_load(const bcd_saved_t *s) {
+    bcd_counter = s->bcd_counter;
+    counting_direction = s->counting_direction;
+    counter_lock.seq = s->lock_seq;
+    disp = s->disp;
+}
+
+/* Just after tick n (the tick lands at n seconds after the timer start) */
+static sim_time_t after_tick(sim_time_t start, unsigned int n) {
+    return start + (sim_time_t)n * 1000 * CCLK_MS + 500 * CCLK_MS;
+}
+
+static double bcd_window(sim_delay_mode_t mode, uint64_t *trace, sim_time_t *end) {
+    double t0 = wall_seconds();
+
+    bcd_boot(mode);
+    bcd_frames(sim_now() + (sim_time_t)WINDOW_MS * CCLK_MS);
+    *trace = disp.trace;
+    *end = sim_now();
+    return wall_seconds() - t0;
+}
+
+static void bcd_test(void) {
+    double t_pass, t_fast, t_full, t_replay;
+    uint64_t tr_pass, tr_fast, tr_replay;
+    sim_time_t end_pass, end_fast, start;
+    sim_checkpoint_t *cp;
+    bcd_saved_t saved;
+    display_t up;
+    int ok;
+
+    printf("bcd_counter_7seg.c, first %d ms\n", WINDOW_MS);
+    t_pass = bcd_window(SIM_DELAY_PASSES, &tr_pass, &end_pass);
+    t_fast = bcd_window(SIM_DELAY_FAST, &tr_fast, &end_fast);
+    printf("  %-22s %9.3f s wall   %llu cycles\n", "every pass charged", t_pass,
+           (unsigned long long)end_pass);
+    printf("  %-22s %9.3f s wall   %llu cycles   speedup %.0fx\n", "loops in one step",
+           t_fast, (unsigned long long)end_fast, t_pass / t_fast);
+    printf("  GPIO traces %s\n", (tr_pass == tr_fast && end_pass == end_fast) ? "identical" : "DIFFER");
+
+    // The whole cycle, fast only
+    t_full = wall_seconds();
+    bcd_boot(SIM_DELAY_FAST);
+    start = sim_now();
+    bcd_frames(after_tick(start, CHECKPOINT_TICK));
+    cp = sim_checkpoint();
+    bcd_save(&saved);
+    bcd_frames(after_tick(start, FULL_TICKS));
+    t_full = wall_seconds() - t_full;
+    up = disp;
+    ok = up.wrong == 0 && up.unreadable == 0 && up.values == FULL_TICKS && up.shown == 0x0000 &&
+         bcd_counter == 0x0000;
+    printf("\n%d ticks (%.1f s simulated), loops in one step: %.2f s wall\n", FULL_TICKS,
+           (double)sim_now() / (1000.0 * CCLK_MS), t_full);
+    printf("  every pass charged would take about %.0f s (%.1f h): speedup %.0fx\n",
+           t_pass * FULL_TICKS * 1000.0 / WINDOW_MS, t_pass * FULL_TICKS / WINDOW_MS / 3.6,
+           t_pass * FULL_TICKS * 1000.0 / WINDOW_MS / t_full);
+    printf("  %lu values shown, %lu out of sequence, %lu unreadable digits, ends at %04X\n",
+           up.values, up.wrong, up.unreadable, up.shown);
+    printf("  %lu frames, %lu-%lu per value (%.0f Hz refresh)\n", up.frames, up.frames_min,
+           up.frames_max, (double)up.frames * 1000.0 * CCLK_MS / (double)sim_now());
+
+    // Back to 9990: SW2 pressed counts down, released replays the wrap
+    t_replay = wall_seconds();
+    sim_restore(cp);
+    bcd_load(&saved);
+    disp.counting_up = 0;
+    sim_set_input(2, 12, 0);
+    bcd_frames(after_tick(start, CHECKPOINT_TICK + REPLAY_TICKS));
+    printf("  restored at %04X, SW2 pressed, %d ticks: %04X (%s)\n", saved.bcd_counter,
+           REPLAY_TICKS, bcd_counter, (bcd_counter == int_to_bcd(CHECKPOINT_TICK - REPLAY_TICKS) &&
+                                       !disp.wrong) ? "ok" : "WRONG");
+    ok = ok && bcd_counter == int_to_bcd(CHECKPOINT_TICK - REPLAY_TICKS) && !disp.wrong;
+
+    sim_restore(cp);
+    bcd_load(&saved);
+    bcd_frames(after_tick(start, FULL_TICKS));
+    tr_replay = disp.trace;
+    t_replay = wall_seconds() - t_replay;
+    printf("  restored again, released: trace to the wrap %s the first run's (%.3f s wall for both)\n",
+           (tr_replay == up.trace) ? "identical to" : "DIFFERS from", t_replay);
+    ok = ok && tr_replay == up.trace;
+    printf("  %s\n", ok ? "PASS" : "FAIL");
+    sim_checkpoint_free(cp);
+}
+
+/*=============================================================================
+ * LCD INIT - lcd.c
+ *============================================================================*/
+static uint64_t lcd_trace;
+static unsigned int lcd_latches;
+static sim_time_t lcd_last;
+
+static void lcd_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    lcd_trace = trace_add(lcd_trace, port, new_pins, when);
+    if (port == 0 && (old_pins & EN_CTRL) && !(new_pins & EN_CTRL)) {
+        lcd_latches++;
+        lcd_last = when;
+    }
+}
+
+/* lcd.c main() without its final while(1) */
+static void lcd_init_path(sim_delay_mode_t mode) {
+    sim_reset();
+    sim_delay_mode(mode);
+    sim_gpio_hook(lcd_hook);
+    lcd_trace = 0xCBF29CE484222325ull;
+    lcd_latches = 0;
+
+    SystemInit();
+    SystemCoreClockUpdate();
+    lcd_bus_init();
+    flag1 = 0;
+    for (i = 0; i < 9; i++) {
+        temp1 = init_command[i];
+        lcd_write();
+    }
+    flag1 = 1;
+    i = 0;
+    while (msg[i] != '\0') {
+        temp1 = msg[i++];
+        lcd_write();
+    }
+}
+
+static void lcd_test(void) {
+    double t_pass, t_fast;
+    uint64_t tr_pass;
+    sim_time_t last_pass;
+    unsigned int n, latches;
+
+    t_pass = wall_seconds();
+    lcd_init_path(SIM_DELAY_PASSES);
+    t_pass = wall_seconds() - t_pass;
+    tr_pass = lcd_trace;
+    last_pass = lcd_last;
+    latches = lcd_latches;
+
+    t_fast = wall_seconds();
+    for (n = 0; n < LCD_FAST_RUNS; n++) {
+        lcd_init_path(SIM_DELAY_FAST);
+    }
+    t_fast = (wall_seconds() - t_fast) / LCD_FAST_RUNS;
+
+    printf("\nlcd.c init + message: %u nibbles latched, last at %.3f ms\n", latches,
+           (double)last_pass / CCLK_MS);
+    printf("  %-22s %9.3f ms wall\n", "every pass charged", 1000.0 * t_pass);
+    printf("  %-22s %9.3f ms wall   speedup %.0fx\n", "loops in one step", 1000.0 * t_fast,
+           t_pass / t_fast);
+    printf("  bus traces %s\n", (tr_pass == lcd_trace && last_pass == lcd_last) ? "identical" : "DIFFER");
+}
+
+int main(void) {
+    bcd_test();
+    lcd_test();
+    return 0;
+}
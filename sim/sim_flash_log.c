@@ -0,0 +1,194 @@
+/******************************************************************************
+ * FILE: sim/sim_flash_log.c
+ * DESCRIPTION: Runs flash_log.c on the simulated flash: erase wear for a
+ *              once-per-second counter, recovery after thousands of power
+ *              cuts at random instants (also inside erases and writes),
+ *              and boot recovery time
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c flash_log.c sim/sim_flash_log.c -o sim_flash_log
+ * NOTE: recovery time counts the IAP stalls and SIM_COST_FLASH per record
+ *       read; the CRC and loop code around them are plain C and free here
+ *       (flash_log_init() runs the CRC on about one record per tag).
+ *       The power-cut test writes back to back, so nearly every cut lands
+ *       inside an IAP erase or copy - the worst case, not the usual one.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "flash_log.h"
+
+#define CCLK_US             100         // Cycles per microsecond
+#define TAG_COUNT           0           // Once per second, like bcd_counter
+#define TAG_MODE            1           // Now and then, like a setting
+#define TAGS                2
+#define DAY                 86400UL
+#define CUTS                3000
+
+static uint32_t value[2];               // Scratch for flash_log_read()
+
+static uint32_t recovered(unsigned int tag) {
+    return flash_log_read(tag, value) ? value[0] : 0;
+}
+
+static uint32_t write_value(unsigned int tag, uint32_t v) {
+    uint32_t words[FLASH_LOG_WORDS] = { v, ~v };
+
+    return flash_log_write(tag, words);
+}
+
+/*=============================================================================
+ * WEAR - one day of one-per-second updates
+ *============================================================================*/
+static void wear(void) {
+    const sim_flash_stats_t *st = sim_flash_stats();
+    unsigned long n, erases;
+    uint32_t fails = 0;
+    double per_day;
+
+    sim_flash_wipe();
+    sim_reset();
+    flash_log_init(TAGS);
+    for (n = 1; n <= DAY; n++) {
+        fails += write_value(TAG_COUNT, n) != IAP_CMD_SUCCESS;
+        fails += write_value(TAG_MODE, n / 3600) != IAP_CMD_SUCCESS;   // Changes hourly
+        fails += write_value(TAG_MODE, n / 3600) != IAP_CMD_SUCCESS;   // Unchanged: free
+    }
+    sim_reset();
+    flash_log_init(TAGS);
+
+    erases = st->erases[FLASH_LOG_SECTOR_A];
+    if (st->erases[FLASH_LOG_SECTOR_B] > erases) {
+        erases = st->erases[FLASH_LOG_SECTOR_B];
+    }
+    per_day = (double)erases;
+    printf("wear: %lu writes/day, sector erases A %lu B %lu, lines programmed %lu, "
+           "programmed twice %lu, failed writes %u\n",
+           DAY + DAY / 3600, st->erases[FLASH_LOG_SECTOR_A], st->erases[FLASH_LOG_SECTOR_B],
+           st->lines_programmed, st->lines_reprogrammed, fails);
+    printf("      after reboot: count %u (expect %lu), mode %u (expect %lu)\n",
+           recovered(TAG_COUNT), DAY, recovered(TAG_MODE), DAY / 3600);
+    printf("      life at 10 000 erases %.1f years, at 100 000 %.1f years\n\n",
+           10000.0 / per_day / 365.0, 100000.0 / per_day / 365.0);
+}
+
+/*=============================================================================
+ * POWER CUTS - keep writing, cut power at a random instant, boot, check
+ * that each value is the last one written or the one being written
+ *============================================================================*/
+static jmp_buf cut_jump;
+static uint32_t committed[TAGS], in_flight[TAGS];
+static unsigned int trial, bad;         // Kept here: they live across longjmp
+static unsigned long worst_reads;
+static sim_time_t worst_boot;
+
+static void power_cut(void *arg) {
+    (void)arg;
+    longjmp(cut_jump, 1);
+}
+
+static void power_cuts(void) {
+    const sim_flash_stats_t *st = sim_flash_stats();
+    unsigned long torn0, reads0;
+    unsigned int t;
+
+    sim_flash_wipe();
+    srand(1);
+    for (t = 0; t < TAGS; t++) {
+        committed[t] = in_flight[t] = 0;
+    }
+    torn0 = st->torn;
+    bad = 0;
+    worst_reads = 0;
+    worst_boot = 0;
+    for (trial = 0; trial < CUTS; trial++) {
+        sim_time_t boot;
+        uint32_t v;
+
+        sim_reset();
+        // Cut anywhere in the next 0-5 s: boot, writes, sector switches
+        sim_flash_power_cut((sim_time_t)(rand() % 5000) * 1000 * CCLK_US +
+                            (sim_time_t)(rand() % (1000 * CCLK_US)), power_cut, 0);
+        if (setjmp(cut_jump)) {
+            continue;
+        }
+        reads0 = st->line_reads;
+        flash_log_init(TAGS);
+        boot = sim_now();
+        if (st->line_reads - reads0 > worst_reads) worst_reads = st->line_reads - reads0;
+        if (boot > worst_boot) worst_boot = boot;
+
+        for (t = 0; t < TAGS; t++) {
+            v = recovered(t);
+            if (v != committed[t] && v != in_flight[t]) {
+                if (bad < 5) {
+                    printf("  trial %u tag %u: recovered %u, last written %u, in flight %u\n",
+                           trial, t, v, committed[t], in_flight[t]);
+                }
+                bad++;
+            }
+            committed[t] = in_flight[t] = v;
+        }
+        for (v = committed[TAG_COUNT] + 1; ; v++) {
+            in_flight[TAG_COUNT] = v;
+            if (write_value(TAG_COUNT, v) == IAP_CMD_SUCCESS) committed[TAG_COUNT] = v;
+            if (v % 100 == 0) {
+                in_flight[TAG_MODE] = v / 100;
+                if (write_value(TAG_MODE, v / 100) == IAP_CMD_SUCCESS) {
+                    committed[TAG_MODE] = v / 100;
+                }
+            }
+        }
+    }
+    printf("power cuts: %u, %lu inside an erase or copy, wrong values after boot %u\n",
+           CUTS, st->torn - torn0, bad);
+    printf("            sector erases A %lu B %lu, slowest boot %.0f us (%lu record reads)\n\n",
+           st->erases[FLASH_LOG_SECTOR_A], st->erases[FLASH_LOG_SECTOR_B],
+           worst_boot / (double)CCLK_US, worst_reads);
+}
+
+/*=============================================================================
+ * RECOVERY TIME - flash_log_init() from power-on in typical layouts
+ *============================================================================*/
+static void boot_case(const char *name, unsigned int tags) {
+    const sim_flash_stats_t *st = sim_flash_stats();
+    unsigned long reads0;
+
+    sim_reset();
+    reads0 = st->line_reads;
+    flash_log_init(tags);
+    printf("  %-40s %9.1f us %6lu reads\n", name,
+           sim_now() / (double)CCLK_US, st->line_reads - reads0);
+}
+
+static void fill(unsigned int tags, unsigned long writes) {
+    unsigned long n;
+
+    sim_flash_wipe();
+    sim_reset();
+    flash_log_init(tags);
+    for (n = 1; n <= writes; n++) {
+        write_value(n % tags, n);
+    }
+}
+
+static void recovery(void) {
+    printf("boot recovery (flash_log_init):\n");
+    sim_flash_wipe();
+    boot_case("blank flash (formats sector A)", 1);
+    fill(1, 10);
+    boot_case("1 tag, 10 records", 1);
+    fill(1, FLASH_LOG_SLOTS - 2);
+    boot_case("1 tag, sector full", 1);
+    fill(3, 3 * FLASH_LOG_SLOTS / 2);
+    boot_case("3 tags, half a sector after a switch", 3);
+    fill(1, FLASH_LOG_SLOTS - 2);
+    boot_case("tag 1 never written, sector full (worst)", 2);
+}
+
+int main(void) {
+    wear();
+    power_cuts();
+    recovery();
+    return 0;
+}
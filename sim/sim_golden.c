@@ -0,0 +1,522 @@
+/******************************************************************************
+ * FILE: sim/sim_golden.c
+ * DESCRIPTION: Golden-trace regression for the lab programs: records what
+ *              each one shows on its pins, compares it with the trace
+ *              checked in under sim/golden/ (output and timing apart) and
+ *              gates the cycles each program spends per operation
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c sim/sim_lcd.c sim/sim_golden.c -o sim_golden
+ * USAGE: sim_golden [-u] [-t percent] [-d dir] [program]...
+ *        -u  record the traces as the new golden ones instead of comparing
+ *        -t  budget threshold (default 5): fail when an operation's mean or
+ *            max cycles grow by more than this many percent
+ *        -d  golden trace directory (default sim/golden)
+ *        program: bcd, lcd, ring (default all three)
+ * PROGRAMS (their own code, delay loops timed in one step, SIM_DELAY_FAST):
+ *   bcd   bcd_counter_7seg.c for 25 s, SW2 held from 12 s to 18 s. Every
+ *         display_digit() is seen as its enable line rising (P1.23-P1.26)
+ *         with the segment word on P0.4-P0.11, decoded through
+ *         bcd_seg_words[]; a frame of four digits is logged when it
+ *         differs from the one before.
+ *         Operations: digit = all enables off to the next one on (the
+ *         body of display_digit()), frame = one digit 0 to the next.
+ *   lcd   lcd.c, main() up to its final while(1): every instruction and
+ *         data write the HD44780 model (sim_lcd.c) executes, with RS.
+ *         Operation: write = one executed write to the next (lcd_write()
+ *         and its delays).
+ *   ring  ring_counter_led.c for 3.2 s with SW2 pressed 10 times (120 ms
+ *         each, every 300 ms): every LED pattern update_leds() leaves on
+ *         P0.4-P0.11.
+ *         Operations: update = LEDs cleared to LEDs set (update_leds()),
+ *         press = SW2 pressed to the new pattern (debounce latency).
+ * RESULT: exit status 0 only if every program's output matches its golden
+ *         trace and no budget grew past the threshold. An event that
+ *         moved in time is reported, not failed: an optimised hot path
+ *         is expected to move them.
+ * FILES: sim/golden/<program>.trace, lines of
+ *          # comment
+ *          budget <operation> <count> <mean> <max>
+ *          <cycle> <event>
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "sim_lcd.h"
+
+/* The three programs, with their main() renamed */
+#define main bcd_main
+#include "FILE bcd counter 7seg.c"
+#undef main
+#define main lcd_main
+#include "lcd.c"
+#undef main
+#define main ring_main
+#include "FILE ring counter led.c"
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define MAX_EVENTS          1024
+#define MAX_OPS             4
+#define EVENT_LEN           40
+
+/*=============================================================================
+ * TRACE - events in order, and cycle statistics per operation
+ *============================================================================*/
+typedef struct {
+    sim_time_t at;
+    char text[EVENT_LEN];
+} event_t;
+
+typedef struct {
+    const char *name;
+    unsigned long count;
+    double mean;
+    unsigned long max;
+    unsigned long long total;
+    sim_time_t start;                   // Open measurement, 0 = none
+} op_t;
+
+typedef struct {
+    event_t ev[MAX_EVENTS];
+    int n_ev;
+    op_t op[MAX_OPS];
+    int n_op;
+} trace_t;
+
+static trace_t got, golden;
+static jmp_buf stop_jump;
+
+static void trace_clear(trace_t *t) {
+    memset(t, 0, sizeof *t);
+}
+
+static void trace_event(trace_t *t, sim_time_t at, const char *text) {
+    if (t->n_ev < MAX_EVENTS) {
+        t->ev[t->n_ev].at = at;
+        snprintf(t->ev[t->n_ev].text, EVENT_LEN, "%s", text);
+        t->n_ev++;
+    }
+}
+
+static op_t *trace_op(trace_t *t, const char *name) {
+    int k;
+
+    for (k = 0; k < t->n_op; k++) {
+        if (!strcmp(t->op[k].name, name)) {
+            return &t->op[k];
+        }
+    }
+    return 0;
+}
+
+static void op_begin(trace_t *t, const char *name, sim_time_t when) {
+    op_t *op = trace_op(t, name);
+
+    if (op) {
+        op->start = when;
+    }
+}
+
+static void op_end(trace_t *t, const char *name, sim_time_t when) {
+    op_t *op = trace_op(t, name);
+    unsigned long cycles;
+
+    if (!op || !op->start) {
+        return;
+    }
+    cycles = (unsigned long)(when - op->start);
+    op->start = 0;
+    op->total += cycles;
+    op->count++;
+    if (cycles > op->max) {
+        op->max = cycles;
+    }
+    op->mean = (double)op->total / op->count;
+}
+
+static void stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+static void ev_switch(void *arg) {
+    sim_set_input(2, 12, (int)(intptr_t)arg);
+}
+
+/*=============================================================================
+ * bcd_counter_7seg.c
+ *============================================================================*/
+static char bcd_digits[5] = "----";
+static char bcd_shown[5];
+
+static char bcd_decode(uint32_t word) {
+    int v;
+
+    for (v = 0; v < 16; v++) {
+        if ((word & SEG7_MASK) == bcd_seg_words[v]) {
+            return "0123456789ABCDEF"[v];
+        }
+    }
+    return '?';
+}
+
+static void bcd_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    char text[EVENT_LEN];
+    int pos;
+
+    if (port != 1) {
+        return;
+    }
+    if ((old_pins & ENABLE_ALL) && !(new_pins & ENABLE_ALL)) {
+        op_begin(&got, "digit", when);
+    }
+    if ((old_pins & ENABLE_ALL) || !(new_pins & ENABLE_ALL)) {
+        return;
+    }
+    op_end(&got, "digit", when);
+    for (pos = 0; pos < 4; pos++) {
+        if (new_pins & (DIGIT_1 << pos)) {
+            break;
+        }
+    }
+    if (pos == 4) {
+        return;
+    }
+    bcd_digits[pos] = bcd_decode(sim_pins(0));
+    if (pos == 0) {
+        op_end(&got, "frame", when);
+        op_begin(&got, "frame", when);
+    } else if (pos == 3 && strcmp(bcd_digits, bcd_shown)) {
+        memcpy(bcd_shown, bcd_digits, sizeof bcd_shown);
+        snprintf(text, sizeof text, "show %s", bcd_digits);
+        trace_event(&got, when, text);
+    }
+}
+
+static void bcd_run(void) {
+    got.op[got.n_op++].name = "digit";
+    got.op[got.n_op++].name = "frame";
+    memcpy(bcd_digits, "----", sizeof bcd_digits);
+    bcd_shown[0] = '\0';
+    sim_gpio_hook(bcd_hook);
+    sim_set_input(2, 12, 1);
+    sim_schedule(12000 * CCLK_MS, ev_switch, (void *)(intptr_t)0);
+    sim_schedule(18000 * CCLK_MS, ev_switch, (void *)(intptr_t)1);
+    sim_schedule(25000 * CCLK_MS, stop, 0);
+    if (!setjmp(stop_jump)) {
+        bcd_main();
+    }
+}
+
+/*=============================================================================
+ * lcd.c - the HD44780 wired as lcd_bus.h has it: D4-D7 on P0.23-P0.26
+ *============================================================================*/
+static sim_lcd_t lcd;
+
+static void lcd_on_write(int rs, unsigned char v, sim_time_t when, void *ctx) {
+    char text[EVENT_LEN];
+
+    (void)ctx;
+    op_end(&got, "write", when);
+    op_begin(&got, "write", when);
+    if (rs) {
+        snprintf(text, sizeof text, "data %02X '%c'", v, (v >= 0x20 && v < 0x7F) ? v : '.');
+    } else {
+        snprintf(text, sizeof text, "cmd  %02X", v);
+    }
+    trace_event(&got, when, text);
+}
+
+static void lcd_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    (void)old_pins;
+    sim_lcd_bus(&lcd, port, new_pins, when);
+}
+
+/* lcd.c main() without its final while(1) */
+static void lcd_run(void) {
+    static const sim_lcd_pins_t pins = { 0, 23, 4, 0, 27, 0, 28 };
+    char line[17], text[EVENT_LEN];
+    int k;
+
+    got.op[got.n_op++].name = "write";
+    sim_lcd_init(&lcd, &pins);
+    lcd.on_write = lcd_on_write;
+    sim_gpio_hook(lcd_hook);
+
+    SystemInit();
+    SystemCoreClockUpdate();
+    lcd_bus_init();
+    flag1 = 0;
+    for (i = 0; i < 9; i++) {
+        temp1 = init_command[i];
+        lcd_write();
+    }
+    flag1 = 1;
+    i = 0;
+    while (msg[i] != '\0') {
+        temp1 = msg[i++];
+        lcd_write();
+    }
+
+    sim_lcd_line(&lcd, 0, line, 16);
+    for (k = 0; line[k]; k++) {
+        if (line[k] < 0x20 || line[k] > 0x7E) {
+            line[k] = '.';
+        }
+    }
+    snprintf(text, sizeof text, "line0 \"%s\" lost %lu", line, lcd.busy_lost);
+    trace_event(&got, sim_now(), text);
+}
+
+/*=============================================================================
+ * ring_counter_led.c
+ *============================================================================*/
+#define RING_PRESSES        10
+#define RING_FIRST_MS       200
+#define RING_EVERY_MS       300
+#define RING_HOLD_MS        120
+
+static void ring_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    char text[EVENT_LEN];
+
+    if (port != 0 || !((old_pins ^ new_pins) & LED_MASK)) {
+        return;
+    }
+    if (!(new_pins & LED_MASK)) {
+        op_begin(&got, "update", when);
+        return;
+    }
+    op_end(&got, "update", when);
+    op_end(&got, "press", when);
+    snprintf(text, sizeof text, "leds %02X", (unsigned int)((new_pins & LED_MASK) >> 4));
+    trace_event(&got, when, text);
+}
+
+static void ev_ring_press(void *arg) {
+    (void)arg;
+    sim_set_input(2, 12, 0);
+    op_begin(&got, "press", sim_now());
+}
+
+static void ring_run(void) {
+    int k;
+
+    got.op[got.n_op++].name = "update";
+    got.op[got.n_op++].name = "press";
+    sim_gpio_hook(ring_hook);
+    sim_set_input(2, 12, 1);
+    for (k = 0; k < RING_PRESSES; k++) {
+        sim_time_t at = (sim_time_t)(RING_FIRST_MS + k * RING_EVERY_MS) * CCLK_MS;
+
+        sim_schedule(at, ev_ring_press, 0);
+        sim_schedule(at + RING_HOLD_MS * CCLK_MS, ev_switch, (void *)(intptr_t)1);
+    }
+    sim_schedule((sim_time_t)(RING_FIRST_MS + RING_PRESSES * RING_EVERY_MS) * CCLK_MS,
+                 stop, 0);
+    if (!setjmp(stop_jump)) {
+        ring_main();
+    }
+}
+
+/*=============================================================================
+ * PROGRAM TABLE
+ *============================================================================*/
+typedef struct {
+    const char *name;
+    const char *about;
+    void (*run)(void);
+} program_t;
+
+static const program_t programs[] = {
+    { "bcd",  "bcd_counter_7seg.c, 25 s, SW2 held 12-18 s", bcd_run },
+    { "lcd",  "lcd.c, init commands and message",           lcd_run },
+    { "ring", "ring_counter_led.c, 3.2 s, 10 presses of SW2", ring_run },
+};
+#define N_PROGRAMS  (int)(sizeof programs / sizeof programs[0])
+
+static void record(const program_t *p) {
+    trace_clear(&got);
+    sim_reset();
+    sim_delay_mode(SIM_DELAY_FAST);
+    p->run();
+    sim_gpio_hook(0);
+}
+
+/*=============================================================================
+ * GOLDEN FILES
+ *============================================================================*/
+static int write_golden(const char *dir, const program_t *p) {
+    char path[256];
+    FILE *f;
+    int k;
+
+    snprintf(path, sizeof path, "%s/%s.trace", dir, p->name);
+    f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    fprintf(f, "# sim_golden: %s\n", p->about);
+    fprintf(f, "# budget <operation> <count> <mean> <max> (cycles)\n");
+    for (k = 0; k < got.n_op; k++) {
+        fprintf(f, "budget %s %lu %.4f %lu\n", got.op[k].name, got.op[k].count,
+                got.op[k].mean, got.op[k].max);
+    }
+    fprintf(f, "# <cycle> <event>\n");
+    for (k = 0; k < got.n_ev; k++) {
+        fprintf(f, "%llu %s\n", (unsigned long long)got.ev[k].at, got.ev[k].text);
+    }
+    fclose(f);
+    printf("%-5s %d events, %d operations -> %s\n", p->name, got.n_ev, got.n_op, path);
+    return 1;
+}
+
+static int read_golden(const char *dir, const program_t *p) {
+    static char names[MAX_OPS][EVENT_LEN];
+    char path[256], line[128];
+    FILE *f;
+
+    snprintf(path, sizeof path, "%s/%s.trace", dir, p->name);
+    f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    trace_clear(&golden);
+    while (fgets(line, sizeof line, f)) {
+        unsigned long long at;
+        int used;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+        if (!strncmp(line, "budget ", 7)) {
+            op_t *op = &golden.op[golden.n_op];
+
+            if (golden.n_op < MAX_OPS &&
+                sscanf(line + 7, "%39s %lu %lf %lu", names[golden.n_op], &op->count,
+                       &op->mean, &op->max) == 4) {
+                op->name = names[golden.n_op++];
+            }
+        } else if (sscanf(line, "%llu %n", &at, &used) == 1) {
+            trace_event(&golden, (sim_time_t)at, line + used);
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+/*=============================================================================
+ * COMPARE - output first, then timing, then budgets
+ *============================================================================*/
+static int compare(const program_t *p, double threshold) {
+    int k, ok = 1, moved = 0, n;
+    long long max_shift = 0;
+
+    printf("%s: %s\n", p->name, p->about);
+
+    /* OUTPUT: the event texts, in order */
+    n = (got.n_ev < golden.n_ev) ? got.n_ev : golden.n_ev;
+    for (k = 0; k < n && !strcmp(got.ev[k].text, golden.ev[k].text); k++) {
+    }
+    if (k == n && got.n_ev == golden.n_ev) {
+        printf("  output   %d events, same as golden\n", got.n_ev);
+    } else {
+        ok = 0;
+        printf("  output   DIFFERS at event %d of %d (golden %d)\n", k + 1, got.n_ev, golden.n_ev);
+        printf("             got    %s\n", (k < got.n_ev) ? got.ev[k].text : "(end)");
+        printf("             golden %s\n", (k < golden.n_ev) ? golden.ev[k].text : "(end)");
+    }
+
+    /* TIMING: the same events, moved in time (reported only) */
+    for (k = 0; k < n; k++) {
+        long long shift = (long long)got.ev[k].at - (long long)golden.ev[k].at;
+
+        if (shift) {
+            moved++;
+            if (llabs(shift) > llabs(max_shift)) {
+                max_shift = shift;
+            }
+        }
+    }
+    printf("  timing   %d of %d events moved, largest by %+lld cycles\n", moved, n, max_shift);
+
+    /* BUDGETS: mean and max cycles per operation */
+    for (k = 0; k < got.n_op; k++) {
+        const op_t *g = &got.op[k];
+        const op_t *b = trace_op(&golden, g->name);
+        double d_mean, d_max;
+        int over;
+
+        if (!b) {
+            printf("  budget   %-6s %8lu ops  mean %10.2f  max %8lu   (no golden budget)\n",
+                   g->name, g->count, g->mean, g->max);
+            continue;
+        }
+        d_mean = b->mean ? 100.0 * (g->mean - b->mean) / b->mean : 0.0;
+        d_max = b->max ? 100.0 * ((double)g->max - (double)b->max) / (double)b->max : 0.0;
+        over = d_mean > threshold || d_max > threshold;
+        if (over) {
+            ok = 0;
+        }
+        printf("  budget   %-6s %8lu ops  mean %10.2f (%+6.1f%%)  max %8lu (%+6.1f%%)  %s\n",
+               g->name, g->count, g->mean, d_mean, g->max, d_max, over ? "OVER" : "ok");
+    }
+    printf("  %s\n", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/*=============================================================================
+ * MAIN
+ *============================================================================*/
+static void usage(void) {
+    fprintf(stderr, "usage: sim_golden [-u] [-t percent] [-d dir] [bcd|lcd|ring]...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *dir = "sim/golden";
+    double threshold = 5.0;
+    int update = 0, failed = 0, selected = 0, k, a;
+    int want[N_PROGRAMS] = { 0 };
+
+    for (a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "-u")) {
+            update = 1;
+        } else if (!strcmp(argv[a], "-t") && a + 1 < argc) {
+            threshold = atof(argv[++a]);
+        } else if (!strcmp(argv[a], "-d") && a + 1 < argc) {
+            dir = argv[++a];
+        } else {
+            for (k = 0; k < N_PROGRAMS && strcmp(argv[a], programs[k].name); k++) {
+            }
+            if (k == N_PROGRAMS) {
+                usage();
+            }
+            want[k] = selected = 1;
+        }
+    }
+
+    for (k = 0; k < N_PROGRAMS; k++) {
+        const program_t *p = &programs[k];
+
+        if (selected && !want[k]) {
+            continue;
+        }
+        record(p);
+        if (update) {
+            failed |= !write_golden(dir, p);
+        } else if (!read_golden(dir, p)) {
+            printf("%s: no golden trace in %s (record one with -u)\n  FAIL\n", p->name, dir);
+            failed = 1;
+        } else {
+            failed |= !compare(p, threshold);
+        }
+    }
+    if (!update) {
+        printf("%s (budget threshold %.1f%%)\n", failed ? "FAIL" : "PASS", threshold);
+    }
+    return failed;
+}
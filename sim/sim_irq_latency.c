@@ -0,0 +1,79 @@
+/******************************************************************************
+ * FILE: sim/sim_irq_latency.c
+ * DESCRIPTION: Runs irq_latency.c on the simulated board: a 1 ms TIMER0
+ *              tick configured like bcd_counter_7seg.c (priority 3), first
+ *              alone, then against interrupt-masking main code and TIMER1
+ *              load at higher, equal and lower priority
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c irq_latency.c sim/sim_irq_latency.c -o sim_irq_latency
+ ******************************************************************************/
+
+#include <stdio.h>
+#include "sim.h"
+#include "irq_latency.h"
+
+#define TICK_MR         24999           // 1 ms at PCLK = CCLK/4 = 25 MHz
+#define TICK_PRIORITY   3
+#define TICKS_PER_RUN   2000
+#define TICK_WORK       60              // update_bcd_counter() and friends
+
+static irq_lat_t tick;
+
+void TIMER0_IRQHandler(void) {
+    irq_lat_enter(&tick, irq_lat_since_match(LPC_TIM0, TICK_MR, 4));
+    LPC_TIM0->IR = (1 << 0);
+    sim_charge(TICK_WORK);
+    irq_lat_exit(&tick);
+}
+
+void TIMER1_IRQHandler(void) {
+    irq_lat_load_isr();
+}
+
+static void start_tick(void) {
+    LPC_SC->PCONP |= (1 << 1);
+    LPC_TIM0->TCR = 0x02;
+    LPC_TIM0->CTCR = 0;
+    LPC_TIM0->PR = 0;
+    LPC_TIM0->MR0 = TICK_MR;
+    LPC_TIM0->MCR = (1 << 0) | (1 << 1);
+    NVIC_SetPriority(TIMER0_IRQn, TICK_PRIORITY);
+    NVIC_EnableIRQ(TIMER0_IRQn);
+    LPC_TIM0->TCR = 0x01;
+}
+
+/* Thread-mode workload: 'mask' cycles with interrupts off out of every
+ * 'period' cycles (mask = 0: the core sleeps in __WFI between ticks)
+ */
+static void run(const char *title, uint32_t mask, uint32_t period,
+                int load_prio, uint32_t load_period, uint32_t load_busy) {
+    sim_reset();
+    SystemInit();
+    irq_lat_init();
+    irq_lat_reset(&tick, title);
+    if (load_prio >= 0) {
+        irq_lat_load_start(load_period, load_busy, (uint32_t)load_prio);
+    }
+    start_tick();
+
+    while (tick.count < TICKS_PER_RUN) {
+        if (mask) {
+            __disable_irq();
+            sim_charge(mask);
+            __enable_irq();
+            sim_charge(period - mask);
+        } else {
+            __WFI();
+        }
+    }
+    irq_lat_dump(&tick);
+    printf("\n");
+}
+
+int main(void) {
+    run("TIMER0, idle core", 0, 0, -1, 0, 0);
+    run("TIMER0, main masks IRQs 300 of every 2000 cycles", 300, 2000, -1, 0, 0);
+    run("TIMER0, TIMER1 load prio 1 (higher): 800 cycles every 7919", 0, 0, 1, 7919, 800);
+    run("TIMER0, TIMER1 load prio 3 (equal): 800 cycles every 7919", 0, 0, 3, 7919, 800);
+    run("TIMER0, TIMER1 load prio 5 (lower): 800 cycles every 7919", 0, 0, 5, 7919, 800);
+    return 0;
+}
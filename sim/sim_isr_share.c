@@ -0,0 +1,171 @@
+/******************************************************************************
+ * FILE: sim/sim_isr_share.c
+ * DESCRIPTION: Stress test for isr_share.c - fires an interrupt at random
+ *              cycles while main() reads shared state, and counts torn
+ *              snapshots, lost ring messages and lost counter updates
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c isr_share.c sim/sim_isr_share.c -o sim_isr_share
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "isr_share.h"
+
+#define ITERATIONS      2000000UL
+#define RING_SIZE       16
+
+/* Every load/store of shared memory costs a cycle, which is also a point
+ * where the simulated interrupt may fire
+ */
+#define LD(x)           (sim_charge(1), (x))
+#define ST(x, v)        (sim_charge(1), (x) = (v))
+
+/*=============================================================================
+ * SHARED STATE - four words that the ISR always keeps equal
+ *============================================================================*/
+typedef struct {
+    uint32_t w[4];
+} shared_quad_t;
+
+static volatile shared_quad_t shared;
+static seqlock_t shared_lock;
+
+static uint32_t ring_storage[RING_SIZE];
+static spsc_ring_t ring;
+static uint32_t ring_next_msg;
+
+static volatile uint32_t plain_count;       // Updated with LD/ST
+static volatile uint32_t atomic_count;      // Updated with LDREX/STREX
+static unsigned long isr_runs;
+
+/*=============================================================================
+ * INTERRUPT - writer, producer and concurrent incrementer
+ *============================================================================*/
+void TIMER1_IRQHandler(void) {
+    uint32_t n = shared.w[0] + 1, tmp;
+    int i;
+
+    isr_runs++;
+
+    seqlock_write_begin(&shared_lock);
+    for (i = 0; i < 4; i++) {
+        ST(shared.w[i], n);
+    }
+    seqlock_write_end(&shared_lock);
+
+    spsc_push(&ring, ring_next_msg++);      // A drop still uses up a number
+
+    tmp = LD(plain_count);
+    ST(plain_count, tmp + 1);
+    atomic_add_u32(&atomic_count, 1);
+}
+
+/* Random interrupt source: next IRQ 1..96 cycles after the previous one */
+static void irq_event(void *arg) {
+    (void)arg;
+    sim_raise_irq(TIMER1_IRQn);
+    sim_schedule(sim_now() + 1 + (sim_time_t)(rand() % 96), irq_event, 0);
+}
+
+/*=============================================================================
+ * READERS
+ *============================================================================*/
+static int torn(const shared_quad_t *q) {
+    return q->w[0] != q->w[1] || q->w[1] != q->w[2] || q->w[2] != q->w[3];
+}
+
+static void read_naive(shared_quad_t *q) {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        q->w[i] = LD(shared.w[i]);
+    }
+}
+
+static unsigned long read_seqlock(shared_quad_t *q) {
+    unsigned long retries = 0;
+    uint32_t seq;
+    int i;
+
+    for (;;) {
+        seq = seqlock_read_begin(&shared_lock);
+        for (i = 0; i < 4; i++) {
+            q->w[i] = LD(shared.w[i]);
+        }
+        if (!seqlock_read_retry(&shared_lock, seq)) {
+            return retries;
+        }
+        retries++;
+    }
+}
+
+int main(void) {
+    unsigned long i, naive_torn = 0, seq_torn = 0, seq_retries = 0;
+    unsigned long main_adds = 0, received = 0, gaps = 0, dropped = 0;
+    unsigned long reorders = 0;
+    uint32_t msg, expect = 0, tmp;
+    shared_quad_t q;
+
+    srand(1);
+    sim_reset();
+    SystemInit();
+    spsc_init(&ring, ring_storage, RING_SIZE);
+    NVIC_SetPriority(TIMER1_IRQn, 1);
+    NVIC_EnableIRQ(TIMER1_IRQn);
+    sim_schedule(sim_now() + 1, irq_event, 0);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        read_naive(&q);
+        naive_torn += torn(&q);
+
+        seq_retries += read_seqlock(&q);
+        seq_torn += torn(&q);
+
+        while (spsc_pop(&ring, &msg)) {
+            if (msg < expect) {
+                reorders++;
+            } else if (msg != expect) {
+                gaps++;
+            }
+            expect = msg + 1;
+            received++;
+        }
+        dropped += spsc_take_dropped(&ring);
+
+        tmp = LD(plain_count);
+        ST(plain_count, tmp + 1);
+        atomic_add_u32(&atomic_count, 1);
+        main_adds++;
+
+        if ((i & 4095) == 4095) {
+            sim_charge(2000);               // Slow display update: ring overflows
+        }
+    }
+
+    __disable_irq();                        // Stop the source, then drain
+    while (spsc_pop(&ring, &msg)) {
+        received++;
+    }
+    dropped += spsc_take_dropped(&ring);
+
+    printf("%lu main iterations, %lu interrupts, %llu cycles\n",
+           ITERATIONS, isr_runs, (unsigned long long)sim_now());
+    printf("\nSNAPSHOT of 4 words\n");
+    printf("  plain reads   : %lu torn (%.3f%%)\n", naive_torn,
+           100.0 * naive_torn / ITERATIONS);
+    printf("  seqlock reads : %lu torn, %lu retries (%.3f%% of reads)\n",
+           seq_torn, seq_retries, 100.0 * seq_retries / ITERATIONS);
+    printf("\nSPSC RING (%d slots)\n", RING_SIZE);
+    printf("  received %lu + dropped %lu = %lu of %lu pushed\n",
+           received, dropped, received + dropped, (unsigned long)ring_next_msg);
+    printf("  %lu sequence gaps (one per overflow burst), %lu out of order\n",
+           gaps, reorders);
+    printf("\nSHARED COUNTER (%lu main + %lu ISR increments)\n", main_adds, isr_runs);
+    printf("  plain load/store : %lu (%ld lost)\n", (unsigned long)plain_count,
+           (long)(main_adds + isr_runs) - (long)plain_count);
+    printf("  LDREX/STREX      : %lu (%ld lost)\n", (unsigned long)atomic_count,
+           (long)(main_adds + isr_runs) - (long)atomic_count);
+
+    return (seq_torn || reorders || atomic_count != main_adds + isr_runs ||
+            received + dropped != ring_next_msg) ? 1 : 0;
+}
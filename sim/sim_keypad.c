@@ -0,0 +1,153 @@
+/******************************************************************************
+ * FILE: sim/sim_keypad.c
+ * DESCRIPTION: Key matrix model and key script player (see sim_keypad.h)
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "sim_keypad.h"
+
+struct sim_keypad_action {
+    sim_keypad_t *kp;
+    int key;                            // Index into kp->keys
+    int down;
+};
+
+void sim_keypad_init(sim_keypad_t *kp, int port, const int *row_bits, int rows,
+                     const int *col_bits, int cols, const char *keys) {
+    int i;
+
+    memset(kp, 0, sizeof *kp);
+    kp->port = port;
+    kp->rows = (rows < SIM_KEYPAD_MAX_LINES) ? rows : SIM_KEYPAD_MAX_LINES;
+    kp->cols = (cols < SIM_KEYPAD_MAX_LINES) ? cols : SIM_KEYPAD_MAX_LINES;
+    for (i = 0; i < kp->rows; i++) kp->row_bit[i] = row_bits[i];
+    for (i = 0; i < kp->cols; i++) kp->col_bit[i] = col_bits[i];
+    kp->keys = keys;
+}
+
+void sim_keypad_free(sim_keypad_t *kp) {
+    free(kp->actions);
+    kp->actions = 0;
+    kp->n_actions = 0;
+}
+
+/*=============================================================================
+ * MATRIX
+ *============================================================================*/
+static uint32_t cols_low(const sim_keypad_t *kp, uint32_t pins) {
+    uint32_t low = 0;
+    int r, c;
+
+    for (r = 0; r < kp->rows; r++) {
+        if (pins & (1u << kp->row_bit[r])) continue;
+        for (c = 0; c < kp->cols; c++) {
+            if (kp->down[r * kp->cols + c]) low |= 1u << kp->col_bit[c];
+        }
+    }
+    return low;
+}
+
+/* Drives the columns from the present rows and keys (not from the hook) */
+static void update(sim_keypad_t *kp) {
+    uint32_t low = cols_low(kp, sim_pins(kp->port));
+    uint32_t change = low ^ kp->cols_low;
+    int c;
+
+    kp->cols_low = low;
+    for (c = 0; c < kp->cols; c++) {
+        uint32_t bit = 1u << kp->col_bit[c];
+        if (change & bit) {
+            sim_set_input(kp->port, kp->col_bit[c], !(low & bit));
+        }
+    }
+}
+
+static void ev_update(void *arg) {
+    update(arg);
+}
+
+void sim_keypad_bus(sim_keypad_t *kp, int port, uint32_t new_pins) {
+    if (port == kp->port && cols_low(kp, new_pins) != kp->cols_low) {
+        sim_schedule(sim_now(), ev_update, kp);
+    }
+}
+
+static int key_index(const sim_keypad_t *kp, char key) {
+    const char *k = memchr(kp->keys, key, (size_t)(kp->rows * kp->cols));
+
+    return k ? (int)(k - kp->keys) : -1;
+}
+
+int sim_keypad_press(sim_keypad_t *kp, char key, int down) {
+    int i = key_index(kp, key);
+
+    if (i < 0) {
+        return -1;
+    }
+    kp->down[i] = (unsigned char)(down != 0);
+    update(kp);
+    return 0;
+}
+
+/*=============================================================================
+ * SCRIPT
+ *============================================================================*/
+static void ev_action(void *arg) {
+    sim_keypad_action_t *a = arg;
+
+    a->kp->down[a->key] = (unsigned char)a->down;
+    update(a->kp);
+}
+
+int sim_keypad_play(sim_keypad_t *kp, const sim_key_t *script, int n) {
+    double per_ms = sim_cclk() / 1000.0;
+    int i;
+
+    sim_keypad_free(kp);
+    kp->actions = calloc((size_t)(2 * n), sizeof *kp->actions);
+    if (n > 0 && !kp->actions) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        sim_keypad_action_t *a = &kp->actions[2 * i];
+        int k = key_index(kp, script[i].key);
+
+        if (k < 0) {
+            return -1;
+        }
+        a[0].kp = a[1].kp = kp;
+        a[0].key = a[1].key = k;
+        a[0].down = 1;
+        a[1].down = 0;
+        sim_schedule((sim_time_t)(script[i].press_ms * per_ms), ev_action, &a[0]);
+        sim_schedule((sim_time_t)((script[i].press_ms + script[i].hold_ms) * per_ms),
+                     ev_action, &a[1]);
+    }
+    kp->n_actions = 2 * n;
+    return 0;
+}
+
+int sim_keypad_read(FILE *f, sim_key_t *script, int max) {
+    char line[128];
+    int n = 0;
+
+    while (fgets(line, sizeof line, f)) {
+        char key;
+        double press, hold;
+        const char *s = line + strspn(line, " \t");
+
+        if (*s == '\0' || *s == '\n' || *s == '\r' || *s == ';') {
+            continue;
+        }
+        if (sscanf(s, "%c %lf %lf", &key, &press, &hold) != 3 || press < 0 || hold < 0 ||
+            n >= max) {
+            return -1;
+        }
+        script[n].key = key;
+        script[n].press_ms = press;
+        script[n].hold_ms = hold;
+        n++;
+    }
+    return n;
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * FILE: sim/sim_keypad.h
+ * DESCRIPTION: Key matrix model for the host simulator, driven by a key
+ *              script (key, press time, hold time)
+ * OPERATION: Rows are firmware outputs and columns pulled-up inputs on one
+ *            port. A pressed key connects its row to its column, so a
+ *            column reads low while any pressed key on it has its row
+ *            driven low. Feed every port change to sim_keypad_bus() from
+ *            the harness's sim_gpio_hook() callback; the columns follow the
+ *            rows through an event at the same instant, so the hook never
+ *            drives pins from inside the simulator. Contacts are clean:
+ *            bounce is sim_debounce.c's business.
+ * SCRIPT: one key per line, "<key> <press ms> <hold ms>", press times from
+ *         sim_reset(); blank lines and lines starting with ';' are skipped
+ *         ('#' is a key).
+ *         Example:  5  1200  80
+ ******************************************************************************/
+
+#ifndef SIM_KEYPAD_H
+#define SIM_KEYPAD_H
+
+#include <stdio.h>
+#include "sim.h"
+
+#define SIM_KEYPAD_MAX_LINES    8       // Rows, and columns
+
+typedef struct {
+    char key;
+    double press_ms;                    // From sim_reset()
+    double hold_ms;
+} sim_key_t;
+
+typedef struct sim_keypad_action sim_keypad_action_t;
+
+typedef struct {
+    int port;
+    int rows, cols;
+    int row_bit[SIM_KEYPAD_MAX_LINES];
+    int col_bit[SIM_KEYPAD_MAX_LINES];
+    const char *keys;                   // rows * cols characters, row by row
+    unsigned char down[SIM_KEYPAD_MAX_LINES * SIM_KEYPAD_MAX_LINES];
+    uint32_t cols_low;                  // Column pins being pulled low
+    sim_keypad_action_t *actions;       // Scheduled by sim_keypad_play()
+    int n_actions;
+} sim_keypad_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void sim_keypad_init(sim_keypad_t *kp, int port, const int *row_bits, int rows,
+                     const int *col_bits, int cols, const char *keys);
+void sim_keypad_free(sim_keypad_t *kp);
+void sim_keypad_bus(sim_keypad_t *kp, int port, uint32_t new_pins);
+int sim_keypad_press(sim_keypad_t *kp, char key, int down);     // Now; -1 unknown key
+int sim_keypad_play(sim_keypad_t *kp, const sim_key_t *script, int n);  // -1: bad key
+int sim_keypad_read(FILE *f, sim_key_t *script, int max);       // Keys read, -1 on error
+
+#endif /* SIM_KEYPAD_H */
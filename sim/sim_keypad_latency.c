@@ -0,0 +1,271 @@
+/******************************************************************************
+ * FILE: sim/sim_keypad_latency.c
+ * DESCRIPTION: End-to-end key-to-glyph latency of the keypad calculator
+ *              ("include LPCfdsfsdf17xx h include.c"): scripted presses on
+ *              the simulated key matrix, every character timed as it lands
+ *              in the simulated HD44780's DDRAM, at 1 to 20 keys/s
+ * BUILD: gcc -O2 -pthread -Isim -I. sim/sim.c sim/sim_farm.c sim/sim_lcd.c
+ *        sim/sim_keypad.c sim/sim_keypad_latency.c -o sim_keypad_latency
+ *        (the coroutine build: add -DCORO_KEYPAD and coro.c)
+ * USAGE: sim_keypad_latency [-n keys] [-s script]
+ *        -n  keys per typing rate (default 60)
+ *        -s  play a key script (format in sim_keypad.h) instead, and list
+ *            each key with its glyph time
+ * OPERATION: the program runs unchanged from its own main(); delay_ms()
+ *            is timed in one step (SIM_DELAY_FAST), its release spin runs
+ *            read by read. Typing alternates a digit, which the calculator
+ *            echoes at line 2 column 8, and '*', which rewrites line 2
+ *            ending with the '=' at column 7. A key's latency runs from
+ *            its press to the landing of that character; each response is
+ *            credited to the earliest key still waiting for it that was
+ *            pressed before it and released less than 150 ms before it
+ *            (the calculator echoes on release, the CORO_KEYPAD build on
+ *            press), and whose window the next press of the same key has
+ *            not closed: a response after that press is the later key's.
+ *            A key with no response is dropped.
+ * NOTE: delay_ms(1) is 10000 passes of roughly 8 cycles, 0.8 ms at 100 MHz,
+ *       as in sim_debounce.c.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "sim_farm.h"
+#include "sim_lcd.h"
+#include "sim_keypad.h"
+
+/* The calculator itself */
+#define main calc_main
+#include "include LPCfdsfsdf17xx h include.c"
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define FIRST_KEY_MS        500             // Boot and prompt are done by then
+#define MATCH_WINDOW        (150 * CCLK_MS)
+#define MAX_KEYS            1000
+#define MAX_RESPONSES       (2 * MAX_KEYS)
+
+#define ECHO_ADDR           0x48            // Line 2 column 8
+#define PROMPT_END_ADDR     0x47            // '=' of "A op B ="
+
+static const int row_bits[4] = { 19, 20, 21, 22 };
+static const int col_bits[3] = { 23, 24, 25 };
+static const double rates[] = { 1, 2, 5, 10, 15, 20 };
+#define N_RATES             (sizeof rates / sizeof rates[0])
+
+/*=============================================================================
+ * BOARD - LCD and keypad on the GPIO hook, responses logged as they land
+ *============================================================================*/
+typedef struct {
+    sim_time_t at;
+    char ch;                                // Digit echoed, or '=' of a redraw
+    unsigned char taken;
+} response_t;
+
+static sim_lcd_t lcd;
+static sim_keypad_t kp;
+static response_t responses[MAX_RESPONSES];
+static int n_responses;
+static jmp_buf stop_jump;
+
+static void bus_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    (void)old_pins;
+    sim_lcd_bus(&lcd, port, new_pins, when);
+    sim_keypad_bus(&kp, port, new_pins);
+}
+
+static void on_glyph(unsigned char addr, unsigned char ch, sim_time_t when, void *ctx) {
+    (void)ctx;
+    if (((addr == ECHO_ADDR && ch >= '0' && ch <= '9') || (addr == PROMPT_END_ADDR && ch == '=')) &&
+        n_responses < MAX_RESPONSES) {
+        responses[n_responses].at = when;
+        responses[n_responses].ch = (char)ch;
+        responses[n_responses].taken = 0;
+        n_responses++;
+    }
+}
+
+static void stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+/* Runs the calculator from reset through the script; latency_ms[i] < 0
+ * for a dropped key */
+static void run_script(const sim_key_t *script, int n, double *latency_ms) {
+    static const sim_lcd_pins_t pins = { 0, 0, 8, 1, 16, 1, 18 };
+    double end_ms = 0;
+    int i, j, r;
+
+    sim_reset();
+    sim_delay_mode(SIM_DELAY_FAST);
+    sim_lcd_init(&lcd, &pins);
+    lcd.on_glyph = on_glyph;
+    sim_keypad_init(&kp, 2, row_bits, 4, col_bits, 3, &keypad[0][0]);
+    sim_gpio_hook(bus_hook);
+    n_responses = 0;
+    for (i = 0; i < n; i++) {
+        if (script[i].press_ms + script[i].hold_ms > end_ms) {
+            end_ms = script[i].press_ms + script[i].hold_ms;
+        }
+    }
+    if (sim_keypad_play(&kp, script, n) < 0) {
+        fprintf(stderr, "sim_keypad_latency: key not on the keypad\n");
+        exit(1);
+    }
+    sim_schedule((sim_time_t)((end_ms + 500) * CCLK_MS), stop, 0);
+    if (!setjmp(stop_jump)) {
+        calc_main();
+    }
+    sim_gpio_hook(0);
+
+    for (i = 0; i < n; i++) {
+        sim_time_t press = (sim_time_t)(script[i].press_ms * CCLK_MS);
+        sim_time_t end = (sim_time_t)((script[i].press_ms + script[i].hold_ms) * CCLK_MS) +
+                         MATCH_WINDOW;
+        char want = (script[i].key == '*') ? '=' : script[i].key;
+
+        for (j = i + 1; j < n; j++) {
+            sim_time_t next = (sim_time_t)(script[j].press_ms * CCLK_MS);
+            if (script[j].key == script[i].key) {
+                if (next < end) {
+                    end = next;             // Later responses are the next key's
+                }
+                break;
+            }
+        }
+        latency_ms[i] = -1;
+        for (r = 0; r < n_responses; r++) {
+            response_t *p = &responses[r];
+            if (!p->taken && p->ch == want && p->at > press && p->at <= end) {
+                p->taken = 1;
+                latency_ms[i] = (double)(p->at - press) / CCLK_MS;
+                break;
+            }
+        }
+    }
+    sim_keypad_free(&kp);
+}
+
+/*=============================================================================
+ * TYPING - digit, '*', digit, ... at a mean rate; gaps vary by +-25 %,
+ * holds are 90 ms +-20 % but at most 45 % of the mean gap
+ *============================================================================*/
+static uint32_t next_rand(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static void make_typing(sim_key_t *script, int n, double rate, uint32_t seed) {
+    double gap = 1000.0 / rate, hold = (90 < 0.45 * gap) ? 90 : 0.45 * gap, t = FIRST_KEY_MS;
+    uint32_t x = 2463534242u ^ (seed * 2654435761u);
+    int i;
+
+    for (i = 0; i < n; i++) {
+        script[i].key = (i & 1) ? '*' : (char)('0' + (i / 2 + 1) % 10);
+        script[i].press_ms = t;
+        script[i].hold_ms = hold * (0.8 + 0.4 * (next_rand(&x) % 1000) / 1000.0);
+        t += gap * (0.75 + 0.5 * (next_rand(&x) % 1000) / 1000.0);
+    }
+}
+
+/*=============================================================================
+ * REPORT
+ *============================================================================*/
+static void rate_table(int n) {
+    sim_key_t *script = malloc(sizeof *script * n);
+    double *lat = malloc(sizeof *lat * n);
+    double *echo = malloc(sizeof *echo * n), *redraw = malloc(sizeof *redraw * n);
+    unsigned int k;
+
+    printf("Digit echo (key -> its digit at line 2 col 8) and '*' redraw (key -> '=' of\n"
+           "\"A op B =\"), %d keys per rate alternating digit and '*', latency in ms\n", n);
+    printf("  %-6s %6s %7s %7s %7s %7s %7s %8s %8s %8s %8s\n", "keys/s", "hold",
+           "echo50", "echo90", "echo99", "echomax", "*50", "*max", "dropped", "dropped*",
+           "lcd lost");
+    for (k = 0; k < N_RATES; k++) {
+        size_t ne = 0, nr = 0;
+        unsigned int drop_d = 0, drop_s = 0;
+        double hold = 0;
+        sim_pct_t pe, pr;
+        int i;
+
+        make_typing(script, n, rates[k], k + 1);
+        run_script(script, n, lat);
+        for (i = 0; i < n; i++) {
+            hold += script[i].hold_ms / n;
+            if (script[i].key == '*') {
+                if (lat[i] < 0) drop_s++;
+                else redraw[nr++] = lat[i];
+            } else {
+                if (lat[i] < 0) drop_d++;
+                else echo[ne++] = lat[i];
+            }
+        }
+        sim_percentiles(echo, ne, &pe);
+        sim_percentiles(redraw, nr, &pr);
+        printf("  %-6.0f %6.1f %7.1f %7.1f %7.1f %7.1f %7.1f %8.1f %8u %8u %8lu\n", rates[k],
+               hold, pe.p50, pe.p90, pe.p99, pe.max, pr.p50, pr.max, drop_d, drop_s,
+               lcd.busy_lost);
+    }
+    free(script);
+    free(lat);
+    free(echo);
+    free(redraw);
+}
+
+static void script_listing(const char *path) {
+    static sim_key_t script[MAX_KEYS];
+    static double lat[MAX_KEYS];
+    char line[17];
+    FILE *f = fopen(path, "r");
+    int n, i;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    n = sim_keypad_read(f, script, MAX_KEYS);
+    fclose(f);
+    if (n < 0) {
+        fprintf(stderr, "%s: bad script line\n", path);
+        exit(1);
+    }
+    run_script(script, n, lat);
+    printf("  key  press ms  hold ms  latency ms\n");
+    for (i = 0; i < n; i++) {
+        printf("  %c   %9.1f %8.1f  ", script[i].key, script[i].press_ms, script[i].hold_ms);
+        if (lat[i] < 0) printf("%10s\n", "dropped");
+        else printf("%10.1f\n", lat[i]);
+    }
+    sim_lcd_line(&lcd, 0, line, 16);
+    printf("LCD: |%s|\n", line);
+    sim_lcd_line(&lcd, 1, line, 16);
+    printf("     |%s|   (%lu writes lost while busy)\n", line, lcd.busy_lost);
+}
+
+int main(int argc, char **argv) {
+    const char *path = 0;
+    int n = 60, i;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-n")) {
+            n = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-s")) {
+            path = argv[i + 1];
+        }
+    }
+    if (n < 2) n = 2;
+    if (n > MAX_KEYS) n = MAX_KEYS;
+
+    if (path) {
+        script_listing(path);
+    } else {
+        rate_table(n);
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * FILE: sim/sim_lcd.c
+ * DESCRIPTION: HD44780 character LCD model (see sim_lcd.h)
+ ******************************************************************************/
+
+#include <string.h>
+#include "sim_lcd.h"
+
+static sim_time_t us_cycles(uint32_t us) {
+    return (sim_time_t)us * sim_cclk() / 1000000u;
+}
+
+void sim_lcd_init(sim_lcd_t *lcd, const sim_lcd_pins_t *pins) {
+    int p;
+
+    memset(lcd, 0, sizeof *lcd);
+    lcd->pins = *pins;
+    for (p = 0; p < 5; p++) {
+        lcd->port_pins[p] = sim_pins(p);
+    }
+    memset(lcd->ddram, ' ', sizeof lcd->ddram);
+    lcd->increment = 1;
+    lcd->bus8 = 1;
+}
+
+/*=============================================================================
+ * ADDRESS COUNTER - two lines are 0x00-0x27 and 0x40-0x67, one line is
+ * 0x00-0x4F; the counter wraps from the end of one to the start of the next
+ *============================================================================*/
+static void ac_step(sim_lcd_t *lcd) {
+    unsigned char a = lcd->ac;
+
+    if (lcd->cgram) {
+        lcd->ac = (unsigned char)((a + (lcd->increment ? 1 : -1)) & 0x3F);
+    } else if (lcd->two_lines) {
+        if (lcd->increment) {
+            a = (a == 0x27) ? 0x40 : (a == 0x67) ? 0x00 : a + 1;
+        } else {
+            a = (a == 0x40) ? 0x27 : (a == 0x00) ? 0x67 : a - 1;
+        }
+        lcd->ac = a;
+    } else {
+        lcd->ac = lcd->increment ? (a + 1) % 0x50 : (a ? a - 1 : 0x4F);
+    }
+}
+
+/*=============================================================================
+ * INSTRUCTIONS
+ *============================================================================*/
+static void execute(sim_lcd_t *lcd, int rs, unsigned char v, sim_time_t when) {
+    uint32_t us = SIM_LCD_EXEC_US;
+
+    if (lcd->on_write) {
+        lcd->on_write(rs, v, when, lcd->ctx);
+    }
+    if (rs) {
+        if (!lcd->cgram) {
+            lcd->ddram[lcd->ac & 0x7F] = v;
+            lcd->landed_at[lcd->ac & 0x7F] = when + us_cycles(us);
+            lcd->glyphs++;
+            if (lcd->on_glyph) {
+                lcd->on_glyph(lcd->ac & 0x7F, v, when + us_cycles(us), lcd->ctx);
+            }
+        }
+        ac_step(lcd);
+    } else {
+        lcd->commands++;
+        if (v & 0x80) {                             // Set DDRAM address
+            lcd->ac = v & 0x7F;
+            lcd->cgram = 0;
+        } else if (v & 0x40) {                      // Set CGRAM address
+            lcd->ac = v & 0x3F;
+            lcd->cgram = 1;
+        } else if (v & 0x20) {                      // Function set
+            lcd->bus8 = (v & 0x10) != 0;
+            lcd->two_lines = (v & 0x08) != 0;
+            lcd->half = 0;
+        } else if (v & 0x10) {                      // Cursor / display shift
+            if (!(v & 0x08)) {
+                unsigned char inc = lcd->increment;
+                lcd->increment = (v & 0x04) != 0;
+                ac_step(lcd);
+                lcd->increment = inc;
+            }
+        } else if (v & 0x08) {                      // Display on/off: no state kept
+        } else if (v & 0x04) {                      // Entry mode
+            lcd->increment = (v & 0x02) != 0;
+        } else if (v & 0x02) {                      // Return home
+            lcd->ac = 0;
+            lcd->cgram = 0;
+            us = SIM_LCD_CLEAR_US;
+        } else if (v & 0x01) {                      // Clear display
+            memset(lcd->ddram, ' ', sizeof lcd->ddram);
+            lcd->ac = 0;
+            lcd->cgram = 0;
+            lcd->increment = 1;
+            us = SIM_LCD_CLEAR_US;
+        }
+    }
+    lcd->busy_until = when + us_cycles(us);
+}
+
+/*=============================================================================
+ * BUS - one latch per EN falling edge
+ *============================================================================*/
+static void latch(sim_lcd_t *lcd, sim_time_t when) {
+    const sim_lcd_pins_t *p = &lcd->pins;
+    uint32_t bus = lcd->port_pins[p->data_port] >> p->data_shift;
+    int rs = (lcd->port_pins[p->rs_port] >> p->rs_bit) & 1;
+    unsigned char high;                             // D7-D4
+
+    lcd->latches++;
+    if (when < lcd->busy_until) {
+        lcd->busy_lost++;
+        return;
+    }
+    high = (p->width == 4) ? (bus & 0x0F) : ((bus >> 4) & 0x0F);
+    if (lcd->bus8) {
+        // On 4-bit wiring D3-D0 are not connected and read as 0
+        execute(lcd, rs, (p->width == 4) ? (unsigned char)(high << 4) : (unsigned char)bus,
+                when);
+    } else if (!lcd->half) {
+        lcd->high_nibble = high;
+        lcd->half = 1;
+    } else {
+        lcd->half = 0;
+        execute(lcd, rs, (unsigned char)((lcd->high_nibble << 4) | high), when);
+    }
+}
+
+void sim_lcd_bus(sim_lcd_t *lcd, int port, uint32_t new_pins, sim_time_t when) {
+    uint32_t en = 1u << lcd->pins.en_bit;
+    uint32_t old = lcd->port_pins[port];
+
+    lcd->port_pins[port] = new_pins;
+    if (port == lcd->pins.en_port && (old & en) && !(new_pins & en)) {
+        latch(lcd, when);
+    }
+}
+
+void sim_lcd_line(const sim_lcd_t *lcd, int row, char *out, int len) {
+    int i;
+
+    for (i = 0; i < len; i++) {
+        out[i] = (char)lcd->ddram[((row ? 0x40 : 0x00) + i) & 0x7F];
+    }
+    out[len] = '\0';
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * FILE: sim/sim_lcd.h
+ * DESCRIPTION: HD44780 character LCD model for the host simulator - decodes
+ *              the bus from the GPIO hook, keeps DDRAM and timestamps every
+ *              character when it lands there
+ * OPERATION: Feed every port change to sim_lcd_bus() from the harness's
+ *            sim_gpio_hook() callback. The controller latches RS and the
+ *            data lines on the falling edge of EN (RW is taken as low).
+ *            It powers up in 8-bit mode; function set switches between 4
+ *            and 8 bits as on the chip, so the 4-bit wake-up sequence works
+ *            on 4-bit wiring. Each instruction keeps the controller busy
+ *            for its datasheet execution time, and a write that arrives
+ *            while it is busy is lost (counted in busy_lost). A character
+ *            lands in DDRAM when its write has executed: latch + 37 us.
+ *            CGRAM writes, display shift and reads are not modelled.
+ ******************************************************************************/
+
+#ifndef SIM_LCD_H
+#define SIM_LCD_H
+
+#include "sim.h"
+
+#define SIM_LCD_EXEC_US     37          // Most instructions and data writes
+#define SIM_LCD_CLEAR_US    1520        // Clear display, return home
+#define SIM_LCD_DDRAM       0x80        // Address space (2 lines: 0x00-0x27, 0x40-0x67)
+
+/* Where the LCD is wired: data bus D0 (8-bit) or D4 (4-bit) on data_shift */
+typedef struct {
+    int data_port, data_shift, width;   // width: 4 or 8 data lines
+    int rs_port, rs_bit;
+    int en_port, en_bit;
+} sim_lcd_pins_t;
+
+/* A character written to DDRAM address addr, landing at 'when' (cycles) */
+typedef void (*sim_lcd_glyph_fn)(unsigned char addr, unsigned char ch, sim_time_t when,
+                                 void *ctx);
+
+/* Any write the controller executes: instruction (rs 0) or data (rs 1),
+ * at its latch time 'when' (cycles) */
+typedef void (*sim_lcd_write_fn)(int rs, unsigned char v, sim_time_t when, void *ctx);
+
+typedef struct {
+    sim_lcd_pins_t pins;
+    uint32_t port_pins[5];              // Last levels seen per port
+    unsigned char ddram[SIM_LCD_DDRAM];
+    sim_time_t landed_at[SIM_LCD_DDRAM];    // Last write per address
+    unsigned char ac;                   // Address counter
+    unsigned char increment;            // Entry mode I/D
+    unsigned char bus8;                 // Interface data length
+    unsigned char two_lines;
+    unsigned char cgram;                // Address counter points into CGRAM
+    unsigned char half, high_nibble;    // 4-bit mode: first nibble held
+    sim_time_t busy_until;
+    unsigned long latches;              // EN falling edges
+    unsigned long commands, glyphs;     // Executed instructions / DDRAM writes
+    unsigned long busy_lost;            // Latched while busy: dropped
+    sim_lcd_glyph_fn on_glyph;          // May be 0
+    sim_lcd_write_fn on_write;          // May be 0
+    void *ctx;
+} sim_lcd_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void sim_lcd_init(sim_lcd_t *lcd, const sim_lcd_pins_t *pins);    // Power-on state
+void sim_lcd_bus(sim_lcd_t *lcd, int port, uint32_t new_pins, sim_time_t when);
+void sim_lcd_line(const sim_lcd_t *lcd, int row, char *out, int len);  // len + 1 bytes
+
+#endif /* SIM_LCD_H */
@@ -0,0 +1,228 @@
+/******************************************************************************
+ * FILE: sim/sim_led_sequencer.c
+ * DESCRIPTION: Runs led_sequencer.c on the simulated board: checks that the
+ *              ring, Johnson, bounce and table patterns reach P0.4-P0.11 in
+ *              order and on time with zero CPU cycles per step, finds
+ *              the highest step rate the timer + GPDMA path sustains, and
+ *              runs ring_counter_led.c built with LED_SEQ_AUTO
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c led_sequencer.c sim/sim_led_sequencer.c -o sim_led_sequencer
+ ******************************************************************************/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include "sim.h"
+#include "led_sequencer.h"
+
+/* The ring counter program, stepped by the sequencer, with main() renamed */
+#define LED_SEQ_AUTO
+#define main ring_main
+#include "FILE ring counter led.c"
+#undef main
+
+#define LED_MASK        0x00000FF0      // P0.4-P0.11, as in the ring counter program
+#define LED_SHIFT       4
+#define MAX_STEPS       20000
+
+/*=============================================================================
+ * LED OBSERVER - every change of the LED pins, with its time
+ *============================================================================*/
+static uint32_t seen_word[MAX_STEPS];
+static sim_time_t seen_at[MAX_STEPS];
+static unsigned int seen;
+
+static void led_hook(int port, uint32_t old_pins, uint32_t new_pins, sim_time_t when) {
+    if (port == 0 && ((old_pins ^ new_pins) & LED_MASK) && seen < MAX_STEPS) {
+        seen_word[seen] = new_pins & LED_MASK;
+        seen_at[seen] = when;
+        seen++;
+    }
+}
+
+static void start(const uint32_t *words, unsigned int n, uint32_t step_hz) {
+    sim_reset();
+    SystemInit();
+    sim_gpio_hook(led_hook);
+    LPC_GPIO0->FIODIR |= LED_MASK;
+    LPC_GPIO0->FIOCLR = LED_MASK;
+    led_seq_start(LPC_GPIO0, LED_MASK, words, n, step_hz);
+    seen = 0;
+}
+
+/*=============================================================================
+ * PATTERN CHECK - 'cycles' full passes at 1 kHz
+ *============================================================================*/
+static int check_pattern(const char *name, const uint32_t *words, unsigned int n,
+                         unsigned int cycles) {
+    const sim_cpu_stats_t *st;
+    sim_time_t busy0, period = SIM_DEFAULT_CCLK / 1000, t0;
+    unsigned long irqs0 = 0;
+    unsigned int i, steps = n * cycles, order_errors = 0, timing_errors = 0;
+
+    start(words, n, 1000);
+    st = sim_cpu_stats();
+    busy0 = st->busy;
+    for (i = 0; i <= SIM_IRQ_COUNT; i++) irqs0 += st->irq_count[i];
+    t0 = sim_now();
+
+    sim_advance(steps * period + period / 2);
+
+    for (i = 0; i <= SIM_IRQ_COUNT; i++) irqs0 -= st->irq_count[i];
+    for (i = 0; i < seen; i++) {
+        if (seen_word[i] != words[i % n]) order_errors++;
+        if (i > 0 && seen_at[i] - seen_at[i - 1] != period) timing_errors++;
+    }
+    printf("  %-8s %3u words x %u: %5u steps seen, %u out of order, %u mistimed,"
+           " first after %llu cycles, CPU %llu cycles, %ld IRQs\n",
+           name, n, cycles, seen, order_errors, timing_errors,
+           seen ? (unsigned long long)(seen_at[0] - t0) : 0ULL,
+           (unsigned long long)(st->busy - busy0), -(long)irqs0);
+    return seen != steps || order_errors || timing_errors || st->busy != busy0;
+}
+
+/*=============================================================================
+ * RATE SWEEP - steps delivered vs timer matches, and step-to-step jitter
+ *============================================================================*/
+static unsigned int sweep(const uint32_t *words, unsigned int n, const char *name) {
+    static const unsigned int periods[] = {40, 32, 24, 20, 16, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4};
+    unsigned int k, best = 0;
+
+    printf("\n%s (%u words, linked-list reload every %u steps)\n", name, n, n);
+    printf("  cycles/step   Msteps/s   matches   delivered   lost   jitter\n");
+    for (k = 0; k < sizeof periods / sizeof periods[0]; k++) {
+        unsigned int p = periods[k], i, lost, matches;
+        sim_time_t jmin = (sim_time_t)-1, jmax = 0, t0;
+
+        start(words, n, SIM_DEFAULT_CCLK / p);
+        t0 = sim_now();
+        sim_advance((sim_time_t)p * 4000);
+        matches = (unsigned int)((sim_now() - t0) / p);
+        for (i = 1; i < seen; i++) {
+            sim_time_t d = seen_at[i] - seen_at[i - 1];
+            if (d < jmin) jmin = d;
+            if (d > jmax) jmax = d;
+        }
+        lost = (matches > seen + 1) ? matches - seen - 1 : 0;  // One may be in flight
+        printf("  %11u %10.2f %9u %11u %6u %5llu-%llu\n", p, 100.0 / p, matches, seen,
+               lost, (unsigned long long)jmin, (unsigned long long)jmax);
+        if (lost == 0 && jmin == p && jmax == p) {
+            best = p;
+        }
+    }
+    return best;
+}
+
+/*=============================================================================
+ * RING COUNTER PROGRAM - runs by itself at RING_STEP_HZ; SW2 pauses it at
+ * PAUSE_MS and resumes it at RESUME_MS. Each lit LED must be the previous
+ * one shifted round the ring, steps must come exactly one period apart
+ * while it runs, and nothing may move while it is paused.
+ *============================================================================*/
+#define CCLK_MS         100000UL        // Cycles per millisecond
+#define PAUSE_MS        2100
+#define RESUME_MS       3100
+#define HOLD_MS         120
+#define RING_RUN_MS     4600
+
+static jmp_buf stop_jump;
+
+static void ev_sw2(void *arg) {
+    sim_set_input(2, 12, (int)(intptr_t)arg);
+}
+
+static void ev_stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+/* Nothing of the caller's lives across the longjmp() out of ring_main() */
+static void run_program(void) {
+    sim_reset();
+    sim_delay_mode(SIM_DELAY_FAST);
+    sim_gpio_hook(led_hook);
+    sim_set_input(2, 12, 1);
+    sim_schedule(PAUSE_MS * CCLK_MS, ev_sw2, (void *)(intptr_t)0);
+    sim_schedule((PAUSE_MS + HOLD_MS) * CCLK_MS, ev_sw2, (void *)(intptr_t)1);
+    sim_schedule(RESUME_MS * CCLK_MS, ev_sw2, (void *)(intptr_t)0);
+    sim_schedule((RESUME_MS + HOLD_MS) * CCLK_MS, ev_sw2, (void *)(intptr_t)1);
+    sim_schedule(RING_RUN_MS * CCLK_MS, ev_stop, 0);
+    seen = 0;
+    if (!setjmp(stop_jump)) {
+        ring_main();
+    }
+}
+
+static int check_program(void) {
+    sim_time_t period = SIM_DEFAULT_CCLK / RING_STEP_HZ, prev_at = 0, paused_for = 0;
+    uint32_t prev = 0;
+    unsigned int i, steps = 0, order_errors = 0, timing_errors = 0, run_steps = 0;
+
+    run_program();
+
+    /* update_leds() clears before it sets: only lit words count as steps.
+     * The pause shows as the one gap longer than a period: from the last
+     * step before it to the first step after the resume */
+    for (i = 0; i < seen; i++) {
+        uint32_t w = seen_word[i];
+
+        if (!w || w == prev) {
+            continue;
+        }
+        if (prev) {
+            uint32_t next = (prev == 0x800) ? 0x010 : prev << 1;
+            sim_time_t gap = seen_at[i] - prev_at;
+
+            steps++;
+            if (w != next) order_errors++;
+            if (steps == 1) {
+                /* Timed from update_leds(), a little before the start */
+            } else if (gap != period) {
+                if (gap > period && paused_for == 0) {
+                    paused_for = gap;   // The one pause, resumed a period late
+                } else {
+                    timing_errors++;
+                }
+            } else {
+                run_steps++;
+            }
+        }
+        prev = w;
+        prev_at = seen_at[i];
+    }
+    printf("\nring_counter_led.c with LED_SEQ_AUTO, %u steps/s, SW2 at %u and %u ms\n",
+           RING_STEP_HZ, PAUSE_MS, RESUME_MS);
+    printf("  %u steps, %u out of order, %u on time, %u mistimed, held %.1f ms over the pause\n",
+           steps, order_errors, run_steps, timing_errors,
+           (double)paused_for / CCLK_MS);
+    return order_errors || timing_errors || paused_for == 0 || steps == 0;
+}
+
+int main(void) {
+    static uint32_t ring[8], johnson[16], bounce[14], table[6], long_ring[256];
+    static const unsigned char heartbeat[6] = { 0x18, 0x3C, 0x7E, 0xFF, 0x7E, 0x3C };
+    unsigned int n_ring, n_johnson, n_bounce, n_table, i, best_short, best_long;
+    int fail = 0;
+
+    n_ring = led_seq_ring(ring, 8, LED_SHIFT);
+    n_johnson = led_seq_johnson(johnson, 8, LED_SHIFT);
+    n_bounce = led_seq_bounce(bounce, 8, LED_SHIFT);
+    n_table = led_seq_from_bytes(table, heartbeat, 6, LED_SHIFT);
+    for (i = 0; i < 256; i++) {
+        long_ring[i] = ring[i % 8];
+    }
+
+    printf("Patterns at 1000 steps/s, CPU idle after led_seq_start()\n");
+    fail |= check_pattern("ring", ring, n_ring, 5);
+    fail |= check_pattern("johnson", johnson, n_johnson, 5);
+    fail |= check_pattern("bounce", bounce, n_bounce, 5);
+    fail |= check_pattern("table", table, n_table, 5);
+
+    best_short = sweep(ring, n_ring, "Ring, 8-word buffer");
+    best_long = sweep(long_ring, 256, "Ring, 256-word buffer");
+    printf("\nFastest exact rate: %u cycles/step (%.2f M steps/s) with 8 words,"
+           " %u cycles/step (%.2f M steps/s) with 256 words\n",
+           best_short, best_short ? 100.0 / best_short : 0.0,
+           best_long, best_long ? 100.0 / best_long : 0.0);
+
+    fail |= check_program();
+    return fail;
+}
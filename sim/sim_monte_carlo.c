@@ -0,0 +1,244 @@
+/******************************************************************************
+ * FILE: sim/sim_monte_carlo.c
+ * DESCRIPTION: Monte Carlo sweep of port_debounce.c on the simulation farm:
+ *              SysTick period against contact bounce, hundreds of random
+ *              press sequences per setting, with latency percentiles and
+ *              missed/false presses; then the same sweep on 1..N threads
+ *              for the throughput scaling
+ * BUILD: gcc -O2 -pthread -Isim -I. sim/sim.c sim/sim_farm.c port_debounce.c
+ *        sim/sim_monte_carlo.c -o sim_monte_carlo
+ * USAGE: sim_monte_carlo [-j max_threads] [-n seeds]
+ *        -j  largest thread count in the scaling table (default: cores)
+ *        -n  press sequences per setting (default 200)
+ * OPERATION: one job = one tick period, one bounce profile, one seed. The
+ *            seed picks the press times and the bounce pattern, and the
+ *            same seeds are used for every setting. Scoring as in
+ *            sim_debounce.c: a detection belongs to the last press that
+ *            started before it, if not already taken and less than 600 ms
+ *            earlier; anything else is a false press.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_farm.h"
+#include "port_debounce.h"
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define PRESSES             20              // Per sequence
+#define MATCH_WINDOW        (600 * CCLK_MS)
+#define MAX_DETECTS         (4 * PRESSES)
+
+#define SW_PORT             2
+#define SW_BIT              12              // SW2, P2.12
+
+/*=============================================================================
+ * SWEEP
+ *============================================================================*/
+static const unsigned int tick_ms[] = { 1, 2, 5, 10 };
+#define N_TICKS             (sizeof tick_ms / sizeof tick_ms[0])
+
+static const struct {
+    const char *name;
+    sim_bounce_t b;                         // seed is set per job
+} profiles[] = {
+    { "2 ms bursts, 20-500 us pulses",
+      { 2 * CCLK_MS, 2000, 50000, 0, 0, 0 } },
+    { "5 ms bursts, 20-500 us pulses",
+      { 5 * CCLK_MS, 2000, 50000, 0, 0, 0 } },
+    { "15 ms bursts, 10 us-2 ms pulses, 10 us spikes every ~300 ms",
+      { 15 * CCLK_MS, 1000, 200000, 300 * CCLK_MS, 1000, 0 } },
+    { "30 ms bursts, 10 us-4 ms pulses, 50 us spikes every ~100 ms",
+      { 30 * CCLK_MS, 1000, 400000, 100 * CCLK_MS, 5000, 0 } },
+};
+#define N_PROFILES          (sizeof profiles / sizeof profiles[0])
+
+typedef struct {
+    float latency_ms[PRESSES];              // < 0: missed
+    unsigned short falses;
+} result_t;
+
+typedef struct {
+    unsigned int seeds;
+    result_t *results;                      // [profile][tick][seed]
+} sweep_t;
+
+/*=============================================================================
+ * ONE BOARD - state of the job running on this thread
+ *============================================================================*/
+typedef struct {
+    sim_time_t press_at[PRESSES], release_at[PRESSES];
+    sim_time_t detect_at[MAX_DETECTS];
+    int detects;
+} job_state_t;
+
+static _Thread_local job_state_t *job;
+static _Thread_local port_debounce_t port2;
+
+void SysTick_Handler(void) {
+    if (port_debounce_tick(&port2, LPC_GPIO2->FIOPIN) & port2.state & (1u << SW_BIT)) {
+        if (job->detects < MAX_DETECTS) {
+            job->detect_at[job->detects++] = sim_now();
+        }
+    }
+}
+
+static void ev_press(void *arg)   { (void)arg; sim_set_input(SW_PORT, SW_BIT, 0); }
+static void ev_release(void *arg) { (void)arg; sim_set_input(SW_PORT, SW_BIT, 1); }
+
+static uint32_t next_rand(uint32_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+/* Holds 40-400 ms, gaps 60-700 ms, as in sim_debounce.c */
+static sim_time_t make_scenario(job_state_t *s, unsigned int seed) {
+    uint32_t x = 2463534242u ^ (seed * 2654435761u);
+    sim_time_t t = 50 * CCLK_MS;
+    int i;
+
+    for (i = 0; i < PRESSES; i++) {
+        s->press_at[i] = t;
+        s->release_at[i] = t + (40 + next_rand(&x) % 360) * CCLK_MS;
+        t = s->release_at[i] + (60 + next_rand(&x) % 640) * CCLK_MS;
+    }
+    return t;
+}
+
+static void score(const job_state_t *s, result_t *r) {
+    unsigned char matched[PRESSES] = { 0 };
+    int i, p = 0;
+
+    for (i = 0; i < PRESSES; i++) {
+        r->latency_ms[i] = -1.0f;
+    }
+    r->falses = 0;
+    for (i = 0; i < s->detects; i++) {
+        sim_time_t d = s->detect_at[i];
+        while (p + 1 < PRESSES && s->press_at[p + 1] <= d) {
+            p++;
+        }
+        if (s->press_at[p] <= d && d < s->press_at[p] + MATCH_WINDOW && !matched[p]) {
+            matched[p] = 1;
+            r->latency_ms[p] = (float)(d - s->press_at[p]) / CCLK_MS;
+        } else {
+            r->falses++;
+        }
+    }
+}
+
+static void run_job(unsigned int n, void *ctx) {
+    const sweep_t *sw = ctx;
+    unsigned int seed = n % sw->seeds;
+    unsigned int tick = (n / sw->seeds) % N_TICKS;
+    unsigned int prof = n / sw->seeds / N_TICKS;
+    sim_bounce_t b = profiles[prof].b;
+    job_state_t state;
+    sim_time_t end;
+    int i;
+
+    job = &state;
+    state.detects = 0;
+    end = make_scenario(&state, seed);
+
+    sim_reset();
+    b.seed = seed + 1;
+    sim_bounce(SW_PORT, SW_BIT, &b);
+    for (i = 0; i < PRESSES; i++) {
+        sim_schedule(state.press_at[i], ev_press, 0);
+        sim_schedule(state.release_at[i], ev_release, 0);
+    }
+    port_debounce_init(&port2, 1u << SW_BIT, LPC_GPIO2->FIOPIN);
+    SysTick_Config(SystemCoreClock / 1000 * tick_ms[tick]);
+    while (sim_now() < end) {
+        __WFI();
+    }
+    SysTick->CTRL = 0;
+
+    score(&state, &sw->results[n]);
+    job = 0;
+}
+
+/*=============================================================================
+ * REPORT
+ *============================================================================*/
+static void print_tables(const sweep_t *sw) {
+    double *lat = malloc(sizeof *lat * sw->seeds * PRESSES);
+    unsigned int prof, tick, seed, i;
+
+    for (prof = 0; prof < N_PROFILES; prof++) {
+        printf("\n%s\n", profiles[prof].name);
+        printf("  %-7s %7s %7s %7s %7s %7s %7s %7s\n", "tick ms", "presses", "p50 ms",
+               "p90 ms", "p99 ms", "max ms", "missed", "false");
+        for (tick = 0; tick < N_TICKS; tick++) {
+            const result_t *r = &sw->results[(prof * N_TICKS + tick) * sw->seeds];
+            unsigned long missed = 0, falses = 0;
+            size_t n = 0;
+            sim_pct_t pct;
+
+            for (seed = 0; seed < sw->seeds; seed++) {
+                for (i = 0; i < PRESSES; i++) {
+                    if (r[seed].latency_ms[i] < 0) {
+                        missed++;
+                    } else {
+                        lat[n++] = r[seed].latency_ms[i];
+                    }
+                }
+                falses += r[seed].falses;
+            }
+            sim_percentiles(lat, n, &pct);
+            printf("  %-7u %7u %7.1f %7.1f %7.1f %7.1f %7lu %7lu\n", tick_ms[tick],
+                   sw->seeds * PRESSES, pct.p50, pct.p90, pct.p99, pct.max, missed, falses);
+        }
+    }
+    free(lat);
+}
+
+int main(int argc, char **argv) {
+    unsigned int max_threads = sim_farm_cores(), seeds = 200, jobs, t;
+    sim_farm_stats_t st, base;
+    sweep_t sw, ref;
+    int i;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-j")) {
+            max_threads = (unsigned int)atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-n")) {
+            seeds = (unsigned int)atoi(argv[i + 1]);
+        }
+    }
+    if (max_threads < 1) max_threads = 1;
+    if (seeds < 1) seeds = 1;
+    jobs = N_PROFILES * N_TICKS * seeds;
+
+    ref.seeds = sw.seeds = seeds;
+    ref.results = calloc(jobs, sizeof *ref.results);
+    sw.results = calloc(jobs, sizeof *sw.results);
+    sim_farm_run(jobs, 1, run_job, &ref, &base);
+
+    printf("port_debounce.c (4 equal samples), %u sequences of %d presses per setting,\n"
+           "holds 40-400 ms, gaps 60-700 ms; latency from the press to the debounced edge\n",
+           seeds, PRESSES);
+    print_tables(&ref);
+
+    printf("\n%u jobs, %u host cores\n", jobs, sim_farm_cores());
+    printf("  %-7s %8s %9s %8s %7s %7s %11s %s\n", "threads", "seconds", "jobs/s", "speedup",
+           "eff %", "steals", "jobs/thread", "results");
+    printf("  %-7u %8.2f %9.0f %8.2f %7.0f %7lu %5lu-%-5lu %s\n", 1u, base.seconds,
+           jobs / base.seconds, 1.0, 100.0, base.steals, base.least_jobs, base.most_jobs,
+           "reference");
+    for (t = 2; t <= max_threads; t = (t * 2 > max_threads && t < max_threads) ? max_threads : t * 2) {
+        memset(sw.results, 0, jobs * sizeof *sw.results);
+        sim_farm_run(jobs, t, run_job, &sw, &st);
+        printf("  %-7u %8.2f %9.0f %8.2f %7.0f %7lu %5lu-%-5lu %s\n", t, st.seconds,
+               jobs / st.seconds, base.seconds / st.seconds,
+               100.0 * base.seconds / st.seconds / t, st.steals, st.least_jobs, st.most_jobs,
+               memcmp(sw.results, ref.results, jobs * sizeof *sw.results) ? "DIFFER" : "same");
+    }
+    free(sw.results);
+    free(ref.results);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * FILE: sim/sim_pc_prof.c
+ * DESCRIPTION: Runs pc_prof.c on the simulator: first a calibration load
+ *              whose split between functions is known, then the ADC
+ *              display program ("include LPC17xx hfdfad.c") built with
+ *              PC_PROFILE for 10 s. Prints the ITM dumps for pc_prof_report
+ * BUILD: gcc -O2 -Isim -I. -DPC_PROF_LOW=0 -DPC_PROF_HIGH=0x100000 sim/sim.c
+ *        pc_prof.c adc_filter.c adc_sampler.c display_gate.c sim/sim_pc_prof.c -o sim_pc_prof
+ * RUN:   ./sim_pc_prof | ./pc_prof_report sim_pc_prof
+ * NOTE: the simulated PC is the call site of the peripheral access (or
+ *       __WFI / __NOP / sim_charge) an interrupt is taken in, because
+ *       plain C costs no virtual time. A profile therefore shows where the
+ *       time charged to the firmware goes: waits, bus accesses and sleep,
+ *       not arithmetic. The host range is 1 MB of text, so the RAM cost
+ *       printed by the firmware does not apply here.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "pc_prof.h"
+
+/* The ADC program itself, sampling enabled */
+#define PC_PROFILE
+#define main adc_main
+#include "include LPC17xx hfdfad.c"
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define SAMPLE_RATE_HZ      1000
+
+/*=============================================================================
+ * CALIBRATION - three functions with a known share of the cycles
+ *============================================================================*/
+static sim_time_t spent_a, spent_b, spent_isr;
+
+__attribute__((noinline)) static void work_a(void) {
+    int i;
+
+    for (i = 0; i < 30; i++) {
+        sim_charge(10);
+    }
+    spent_a += 300;
+}
+
+__attribute__((noinline)) static void work_b(void) {
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        sim_charge(10);
+    }
+    spent_b += 100;
+}
+
+/* TIMER1 at 10 kHz, 2000 cycles of work per interrupt */
+void TIMER1_IRQHandler(void) {
+    int i;
+
+    LPC_TIM1->IR = (1 << 0);
+    for (i = 0; i < 100; i++) {
+        sim_charge(20);
+    }
+    spent_isr += 2000 + 2 * SIM_COST_APB;
+}
+
+static void calibration(void) {
+    sim_time_t total;
+
+    sim_reset();
+    LPC_SC->PCONP |= (1 << 2);
+    LPC_TIM1->MR0 = 2500 - 1;               // 10 kHz at PCLK 25 MHz
+    LPC_TIM1->MCR = 3;
+    LPC_TIM1->TCR = 1;
+    NVIC_SetPriority(TIMER1_IRQn, 2);
+    NVIC_EnableIRQ(TIMER1_IRQn);
+    pc_prof_reset();
+    pc_prof_start(SAMPLE_RATE_HZ);
+    while (sim_now() < 10000 * CCLK_MS) {
+        work_a();
+        work_b();
+    }
+    pc_prof_stop();
+    NVIC_DisableIRQ(TIMER1_IRQn);
+
+    total = spent_a + spent_b + spent_isr;
+    printf("calibration, 10 s: cycles work_a %.1f%%  work_b %.1f%%  "
+           "TIMER1_IRQHandler %.1f%%\n", 100.0 * spent_a / total,
+           100.0 * spent_b / total, 100.0 * spent_isr / total);
+    pc_prof_dump();
+}
+
+/*=============================================================================
+ * ADC PROGRAM - two slowly moving inputs, stopped just after its 10 s dump
+ *============================================================================*/
+static jmp_buf stop_jump;
+
+static unsigned int adc_input(int channel, sim_time_t when) {
+    unsigned int t = (unsigned int)((when / CCLK_MS) % 4000);   // 4 s triangle
+    unsigned int tri = (t < 2000) ? t : 4000 - t;
+
+    return (channel == 4) ? 1000 + tri : 3000 - tri / 2;
+}
+
+static void stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+static void adc_program(void) {
+    sim_reset();
+    sim_adc_source(adc_input);
+    sim_schedule(10050 * CCLK_MS, stop, 0);
+    pc_prof_reset();                        // Statics outlive sim_reset()
+    printf("\nADC program, first 10 s:\n");
+    if (!setjmp(stop_jump)) {
+        adc_main();
+    }
+    printf("  %lu samples, %lu LCD redraws, CPU busy %.1f%%\n", disp_gate.samples,
+           disp_gate.updates, 100.0 * sim_cpu_stats()->busy / sim_now());
+}
+
+int main(void) {
+    calibration();
+    adc_program();
+    return 0;
+}
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * FILE: sim/sim_stack.c
+ * DESCRIPTION: Checks stack_paint.c against known stack use (a 4 KB frame
+ *              in main(), a 2 KB one in an interrupt), then runs the ADC
+ *              display program ("include LPC17xx hfdfad.c") built with
+ *              STACK_WATERMARK for 10 s and prints its report
+ * BUILD: gcc -O2 -Isim -I. sim/sim.c stack_paint.c adc_filter.c adc_sampler.c
+ *        display_gate.c clock.c sim/sim_stack.c -o sim_stack
+ * NOTE: depths are host (x86-64) bytes below the frame of stack_paint(),
+ *       including the simulator's frames between a firmware access and
+ *       the handler it dispatches. Use them to compare builds; target
+ *       figures come from the same report on the board.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "sim.h"
+#include "stack_paint.h"
+
+/* The ADC program itself, stack report enabled */
+#define STACK_WATERMARK
+#define main adc_main
+#include "include LPC17xx hfdfad.c"
+#undef main
+
+#define CCLK_MS             100000UL        // Cycles per millisecond
+#define MAIN_FRAME          1024            // Words
+#define ISR_FRAME           512
+
+/*=============================================================================
+ * KNOWN LOADS
+ *============================================================================*/
+static unsigned int checks, wrong;
+static stack_isr_t isr_stack;
+
+static void check(const char *what, int ok) {
+    checks++;
+    if (!ok) {
+        wrong++;
+        printf("  FAILED: %s\n", what);
+    }
+}
+
+__attribute__((noinline)) static void deep_call(void) {
+    volatile uint32_t frame[MAIN_FRAME];
+    int i;
+
+    for (i = 0; i < MAIN_FRAME; i++) {
+        frame[i] = i;
+    }
+    (void)frame[0];
+}
+
+void TIMER1_IRQHandler(void) {
+    volatile uint32_t frame[ISR_FRAME];
+    int i;
+
+    STACK_ISR_ENTER(&isr_stack);
+    for (i = 0; i < ISR_FRAME; i++) {
+        frame[i] = i;
+    }
+    (void)frame[0];
+    LPC_TIM1->IR = (1 << 0);
+    STACK_ISR_EXIT(&isr_stack);
+}
+
+__attribute__((noinline)) static void known_loads(void) {
+    uint32_t painted, isr_used, after;
+
+    sim_reset();
+    stack_paint();                          // Top = this call's frame
+    stack_isr_reset(&isr_stack, "TIMER1");
+    painted = stack_used();                 // The unpainted margin
+
+    // The handler first: it sets the mark, then main() goes deeper
+    NVIC_EnableIRQ(TIMER1_IRQn);
+    sim_raise_irq(TIMER1_IRQn);
+    __NOP();                                // Taken here
+    isr_used = stack_used();                // Before printf() adds its own
+    NVIC_DisableIRQ(TIMER1_IRQn);
+    printf("TIMER1 (%u-byte frame): %u bytes deep after its prologue, mark %u\n",
+           ISR_FRAME * 4, isr_stack.entry_max, isr_stack.peak);
+    check("handler ran", isr_stack.count == 1);
+    check("entry depth holds the handler's frame", isr_stack.entry_max >= ISR_FRAME * 4);
+    check("handler set the mark", isr_stack.peak >= isr_stack.entry_max);
+    check("handler mark not overstated", isr_stack.peak < isr_stack.entry_max + 512);
+    check("stack_used() agrees", isr_used == isr_stack.peak);
+
+    deep_call();
+    after = stack_used();
+    printf("main(): margin %u, %u after a %u-byte frame\n", painted, after,
+           MAIN_FRAME * 4);
+    check("frame seen", after >= MAIN_FRAME * 4);
+    check("frame not overstated", after < MAIN_FRAME * 4 + 256);
+    check("no overflow", !stack_overflowed());
+    printf("%u checks, %u wrong\n\n", checks, wrong);
+}
+
+/*=============================================================================
+ * ADC PROGRAM - stopped just after its 10 s report
+ *============================================================================*/
+static jmp_buf stop_jump;
+
+static unsigned int adc_input(int channel, sim_time_t when) {
+    unsigned int t = (unsigned int)((when / CCLK_MS) % 4000);   // 4 s triangle
+    unsigned int tri = (t < 2000) ? t : 4000 - t;
+
+    return (channel == 4) ? 1000 + tri : 3000 - tri / 2;
+}
+
+static void stop(void *arg) {
+    (void)arg;
+    longjmp(stop_jump, 1);
+}
+
+static void adc_program(void) {
+    sim_reset();
+    sim_adc_source(adc_input);
+    sim_schedule(10050 * CCLK_MS, stop, 0);
+    printf("ADC program, first 10 s:\n");
+    if (!setjmp(stop_jump)) {
+        adc_main();
+    }
+}
+
+int main(void) {
+    known_loads();
+    adc_program();
+    return wrong ? 1 : 0;
+}
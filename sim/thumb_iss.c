@@ -0,0 +1,1405 @@
+/******************************************************************************
+ * FILE: sim/thumb_iss.c
+ * DESCRIPTION: Cycle-counting Thumb-2 interpreter for the assembly labs -
+ *              reads an armasm source file (LAB 4 Q3.asm, LAB 5 Q3.asm or a
+ *              rewrite of one), lays it out like the linker, runs it from
+ *              the reset vector and reports the cycles taken and the
+ *              READWRITE data (BCD_RESULT, RESULT) left behind
+ * BUILD: gcc -O2 sim/thumb_iss.c -o thumb_iss
+ * USAGE: thumb_iss [-p refill] [-w waits] [-ram AREA]... [-l] [-set LABEL=value]...
+ *                  file.asm
+ *        -p    pipeline refill cycles P of a taken branch (1-3, default 2)
+ *        -w    flash wait states (FLASHCFG FLASHTIM, 0-9; default 0, the
+ *              ideal accelerator; 4 for 100 MHz)
+ *        -ram  run a READONLY area from SRAM instead (copied there before
+ *              the reset vector is taken, as scatter loading would)
+ *        -l    listing: executions and cycles per source line
+ *        -set  overwrite a data label before running (a DCB/DCW/DCD of a
+ *              READONLY area too, e.g. -set HEX_NUM=0x3F)
+ * OPERATION: The program stops at the first unconditional branch to itself
+ *            (B STOP); the cycles of that loop are not counted. READONLY
+ *            areas go to flash from 0 in source order (RESET first), each
+ *            code area followed by its literal pool; READWRITE areas go to
+ *            RAM from 0x10000000. LDR Rd,=constant becomes MOV when the
+ *            constant fits, as armasm does.
+ * TIMING: Cortex-M3 TRM cycle counts with zero-wait-state memory (flash
+ *         accelerator hits): data processing 1, MUL 1, MLA 2, UDIV/SDIV
+ *         2-12 (early termination, modelled on the quotient's size), LDR
+ *         and STR 2 whatever the addressing mode (post-increment included),
+ *         1 when pipelined behind another single load/store whose result
+ *         does not form its address, LDM/STM/PUSH/POP 1+N, taken branch
+ *         1+P, not taken 1, LDR/POP into PC add P.
+ * FLASH: with -w W the LPC17xx flash accelerator is modelled as eight
+ *        128-bit line buffers, least recently used replaced, shared by
+ *        instruction fetches and data loads. An access to a line not held
+ *        waits W cycles; each fetch starts a prefetch of the next line,
+ *        ready W + 1 cycles later, and an access to it before then waits
+ *        for the rest. SRAM has no wait states.
+ * SUBSET: MOV MVN ADD ADC SUB SBC RSB AND ORR EOR BIC ORN CMP CMN TST TEQ
+ *         LSL LSR ASR ROR MUL MLA UDIV SDIV, {S} and condition suffixes, IT
+ *         blocks, LDR/STR{B,H,SB,SH} with immediate/register offsets,
+ *         pre/post-index and writeback, LDR =expr, PUSH POP LDM STM, B BL
+ *         BX CBZ CBNZ NOP; directives AREA EXPORT IMPORT ENTRY END ALIGN
+ *         THUMB PRESERVE8 EQU DCB DCW DCD SPACE FILL LTORG.
+ *         Code size is estimated from the narrow/wide encoding rules.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+#define MAX_LINE        512
+#define MAX_ITEMS       4096
+#define MAX_SYMS        1024
+#define MAX_AREAS       32
+#define MAX_SETS        16
+#define MAX_STEPS       100000000UL
+#define FLASH_BASE      0x00000000u
+#define FLASH_SIZE      0x00080000u
+#define RAM_BASE        0x10000000u
+#define RAM_SIZE        0x00008000u
+#define FLASH_LINES     8               // Accelerator buffers, 16 bytes each
+
+/*=============================================================================
+ * SOURCE MODEL
+ *============================================================================*/
+enum { OP_NONE, OP_REG, OP_IMM, OP_SHREG, OP_MEM, OP_LIT, OP_LABEL, OP_LIST };
+enum { SH_LSL, SH_LSR, SH_ASR, SH_ROR };
+
+typedef struct {
+    int type;
+    int reg;                            // OP_REG / OP_SHREG / OP_MEM base
+    int shift, amount, shift_reg;       // OP_SHREG (shift_reg >= 0: by register)
+    int32_t imm;                        // OP_IMM / OP_MEM offset
+    int index;                          // OP_MEM register offset, -1 = immediate
+    int pre, writeback;
+    uint32_t list;                      // OP_LIST
+    char expr[64];                      // OP_LIT / OP_LABEL, resolved later
+    uint32_t value;
+} operand_t;
+
+typedef struct {
+    int line;
+    int area;
+    int is_insn;
+    char mnem[12];                      // Base mnemonic, upper case
+    int setflags, cond, size_q;         // size_q: 0 any, 2 .N, 4 .W
+    int nops;
+    operand_t op[4];
+    char it_mask[5];                    // IT: "T", "TE", ...
+    uint32_t addr, bytes;
+    uint32_t lit_addr;                  // LDR =expr: 1 = from the pool, 0 = became MOV
+    // data
+    int unit;                           // 1, 2, 4 for DCB/DCW/DCD
+    char *text;                         // DCx operands
+    uint8_t *data;
+    uint32_t count;                     // Executions
+    unsigned long long cycles;
+} item_t;
+
+typedef struct {
+    char name[64];
+    uint32_t value;
+    int item;                           // Defining item, -1 for EQU
+    int defined;
+} symbol_t;
+
+typedef struct {
+    char name[64];
+    int code, readonly;
+    int in_ram;                         // READONLY area moved by -ram
+    uint32_t base, size;
+    char lit_expr[256][64];
+    int n_lits;
+    uint32_t lit_base;
+} area_t;
+
+static item_t items[MAX_ITEMS];
+static int n_items;
+static symbol_t syms[MAX_SYMS];
+static int n_syms;
+static area_t areas[MAX_AREAS];
+static int n_areas;
+static const char *src_path;
+static char *src_lines[MAX_ITEMS * 2];
+static int n_src;
+
+static uint8_t flash[FLASH_SIZE], ram[RAM_SIZE];
+
+static void fail(int line, const char *msg, const char *what) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", src_path, line, msg, what ? ": " : "", what ? what : "");
+    exit(1);
+}
+
+static symbol_t *find_sym(const char *name) {
+    int i;
+
+    for (i = 0; i < n_syms; i++) {
+        if (!strcmp(syms[i].name, name)) return &syms[i];
+    }
+    return 0;
+}
+
+static symbol_t *add_sym(const char *name, int line) {
+    symbol_t *s = find_sym(name);
+
+    if (s && s->defined) fail(line, "label defined twice", name);
+    if (!s) {
+        if (n_syms == MAX_SYMS) fail(line, "too many symbols", 0);
+        s = &syms[n_syms++];
+        snprintf(s->name, sizeof s->name, "%s", name);
+    }
+    s->defined = 1;
+    s->item = -1;
+    return s;
+}
+
+/*=============================================================================
+ * EXPRESSIONS - numbers, 'c', labels and EQU names joined by + and -
+ *============================================================================*/
+static int eval(const char *expr, uint32_t *out, int line, int need) {
+    const char *p = expr;
+    uint32_t total = 0;
+    int sign = 1;
+
+    while (*p) {
+        uint32_t v;
+        char name[64];
+        int n = 0;
+
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '+') { sign = 1; p++; continue; }
+        if (*p == '-') { sign = -1; p++; continue; }
+        if (!*p) break;
+        if (*p == '\'' && p[1] && p[2] == '\'') {
+            v = (unsigned char)p[1];
+            p += 3;
+        } else if (isdigit((unsigned char)*p)) {
+            char *end;
+            if (p[0] == '2' && p[1] == '_') {
+                v = (uint32_t)strtoul(p + 2, &end, 2);
+            } else if (p[0] == '&') {
+                v = (uint32_t)strtoul(p + 1, &end, 16);
+            } else {
+                v = (uint32_t)strtoul(p, &end, 0);
+            }
+            p = end;
+        } else if (*p == '&') {
+            char *end;
+            v = (uint32_t)strtoul(p + 1, &end, 16);
+            p = end;
+        } else if (isalpha((unsigned char)*p) || *p == '_' || *p == '|') {
+            symbol_t *s;
+            if (*p == '|') p++;
+            while ((isalnum((unsigned char)*p) || *p == '_') && n < 63) name[n++] = *p++;
+            if (*p == '|') p++;
+            name[n] = 0;
+            s = find_sym(name);
+            if (!s || !s->defined) {
+                if (need) fail(line, "undefined symbol", name);
+                return 0;
+            }
+            v = s->value;
+        } else {
+            fail(line, "bad expression", expr);
+            return 0;
+        }
+        total += sign > 0 ? v : (uint32_t)-v;
+        sign = 1;
+    }
+    *out = total;
+    return 1;
+}
+
+/*=============================================================================
+ * PARSER
+ *============================================================================*/
+static const char *const cond_names[] = {
+    "EQ", "NE", "CS", "CC", "MI", "PL", "VS", "VC",
+    "HI", "LS", "GE", "LT", "GT", "LE", "AL", "HS", "LO"
+};
+
+static int parse_cond(const char *s) {
+    int i;
+
+    if (!*s) return 14;
+    for (i = 0; i < 17; i++) {
+        if (!strcmp(s, cond_names[i])) return i == 15 ? 2 : i == 16 ? 3 : i;
+    }
+    return -1;
+}
+
+/* Base mnemonics, longest first where one is a prefix of another */
+static const char *const bases[] = {
+    "LDRSB", "LDRSH", "LDRB", "LDRH", "LDR", "STRB", "STRH", "STR",
+    "LDMIA", "LDMFD", "LDM", "STMIA", "STMEA", "STM", "PUSH", "POP",
+    "MOVW", "MOVT", "MOV", "MVN", "ADD", "ADC", "SUB", "SBC", "RSB",
+    "AND", "ORR", "ORN", "EOR", "BIC", "CMP", "CMN", "TST", "TEQ",
+    "LSL", "LSR", "ASR", "ROR", "MUL", "MLA", "UDIV", "SDIV",
+    "CBZ", "CBNZ", "BX", "BL", "B", "NOP", "IT", 0
+};
+
+static int flag_setting(const char *base) {
+    static const char *const no_s[] = {
+        "LDRSB", "LDRSH", "LDRB", "LDRH", "LDR", "STRB", "STRH", "STR", "LDMIA", "LDMFD",
+        "LDM", "STMIA", "STMEA", "STM", "PUSH", "POP", "MOVW", "MOVT", "CMP", "CMN", "TST",
+        "TEQ", "UDIV", "SDIV", "CBZ", "CBNZ", "BX", "BL", "B", "NOP", "IT", 0
+    };
+    int i;
+
+    for (i = 0; no_s[i]; i++) {
+        if (!strcmp(base, no_s[i])) return 0;
+    }
+    return 1;
+}
+
+static int split_mnemonic(item_t *it, char *m) {
+    char *dot = strchr(m, '.');
+    int i;
+
+    it->size_q = 0;
+    if (dot) {
+        it->size_q = !strcmp(dot, ".W") ? 4 : !strcmp(dot, ".N") ? 2 : -1;
+        *dot = 0;
+        if (it->size_q < 0) return 0;
+    }
+    if (!strncmp(m, "IT", 2) && strlen(m) <= 2) return 0;
+    for (i = 0; bases[i]; i++) {
+        size_t n = strlen(bases[i]);
+        const char *rest = m + n;
+        int s = 0, c;
+
+        if (strncmp(m, bases[i], n)) continue;
+        if (!strcmp(bases[i], "IT")) {             // IT{x{y{z}}} cond, mask only here
+            if (strspn(rest, "TE") != strlen(rest) || strlen(rest) > 3) continue;
+            snprintf(it->it_mask, sizeof it->it_mask, "T%s", rest);
+            strcpy(it->mnem, "IT");
+            it->cond = 14;
+            return 1;
+        }
+        if (*rest == 'S' && flag_setting(bases[i])) {
+            c = parse_cond(rest + 1);
+            if (c >= 0) {
+                s = 1;
+                rest++;
+            }
+        }
+        c = parse_cond(rest);
+        if (c < 0) continue;
+        strcpy(it->mnem, bases[i]);
+        it->setflags = s;
+        it->cond = c;
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_reg(const char *s) {
+    if (!strcmp(s, "SP")) return 13;
+    if (!strcmp(s, "LR")) return 14;
+    if (!strcmp(s, "PC")) return 15;
+    if ((s[0] == 'R') && isdigit((unsigned char)s[1])) {
+        char *end;
+        long n = strtol(s + 1, &end, 10);
+        if (!*end && n >= 0 && n <= 15) return (int)n;
+    }
+    return -1;
+}
+
+static int parse_shift(const char *s, int *type) {
+    static const char *const names[] = { "LSL", "LSR", "ASR", "ROR" };
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (!strncmp(s, names[i], 3) && (s[3] == ' ' || s[3] == '\t' || s[3] == '#' || !s[3])) {
+            *type = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static char *trim(char *s) {
+    char *e;
+
+    while (isspace((unsigned char)*s)) s++;
+    e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = 0;
+    return s;
+}
+
+/* Splits on commas outside [] and {} */
+static int split_args(char *s, char **out, int max) {
+    int n = 0, depth = 0;
+    char *start = s;
+
+    if (!*trim(s)) return 0;
+    for (; ; s++) {
+        if (*s == '[' || *s == '{') depth++;
+        if (*s == ']' || *s == '}') depth--;
+        if ((*s == ',' && depth == 0) || !*s) {
+            int end = !*s;
+            *s = 0;
+            if (n < max) out[n++] = trim(start);
+            if (end) break;
+            start = s + 1;
+        }
+    }
+    return n;
+}
+
+static void parse_imm(operand_t *o, const char *s, int line) {
+    o->type = OP_IMM;
+    snprintf(o->expr, sizeof o->expr, "%s", s + 1);
+    if (!eval(o->expr, &o->value, line, 0)) o->value = 0;   // Resolved again later
+    o->imm = (int32_t)o->value;
+}
+
+static uint32_t parse_list(char *s, int line) {
+    uint32_t mask = 0;
+    char *tok;
+
+    s[strlen(s) - 1] = 0;
+    for (tok = strtok(s + 1, ","); tok; tok = strtok(0, ",")) {
+        char *dash = strchr(tok, '-');
+        int a, b;
+        if (dash) {
+            *dash = 0;
+            a = parse_reg(trim(tok));
+            b = parse_reg(trim(dash + 1));
+        } else {
+            a = b = parse_reg(trim(tok));
+        }
+        if (a < 0 || b < a) fail(line, "bad register list", 0);
+        for (; a <= b; a++) mask |= 1u << a;
+    }
+    return mask;
+}
+
+static void parse_mem(operand_t *o, char *s, char *post, int line) {
+    char *close = strchr(s, ']');
+    char *args[3];
+    int n;
+
+    o->type = OP_MEM;
+    o->index = -1;
+    o->pre = 1;
+    o->writeback = close[1] == '!';
+    *close = 0;
+    n = split_args(s + 1, args, 3);
+    if (n < 1 || (o->reg = parse_reg(args[0])) < 0) fail(line, "bad address", s);
+    if (n >= 2) {
+        if (args[1][0] == '#') {
+            uint32_t v;
+            eval(args[1] + 1, &v, line, 1);
+            o->imm = (int32_t)v;
+        } else {
+            o->index = parse_reg(args[1]);
+            if (o->index < 0) fail(line, "bad index register", args[1]);
+            if (n == 3) {
+                if (!parse_shift(args[2], &o->shift) || o->shift != SH_LSL) {
+                    fail(line, "only LSL #n on an index", args[2]);
+                }
+                o->amount = atoi(strchr(args[2], '#') + 1);
+            }
+        }
+    }
+    if (post) {                                 // [Rn], #imm
+        uint32_t v;
+        if (post[0] != '#') fail(line, "post-index must be an immediate", post);
+        eval(post + 1, &v, line, 1);
+        o->imm = (int32_t)v;
+        o->pre = 0;
+        o->writeback = 1;
+    }
+}
+
+static void parse_operands(item_t *it, char *text) {
+    char *args[6];
+    int n = split_args(text, args, 6), i, k = 0;
+
+    for (i = 0; i < n; i++) {
+        operand_t *o = &it->op[k];
+        char *a = args[i];
+        int r = parse_reg(a);
+
+        if (k == 4) fail(it->line, "too many operands", 0);
+        memset(o, 0, sizeof *o);
+        o->shift_reg = -1;
+        if (r >= 0) {
+            o->type = OP_REG;
+            o->reg = r;
+            if (a[strlen(a) - 1] == '!') o->writeback = 1;
+        } else if (a[0] == 'R' && a[strlen(a) - 1] == '!' ) {
+            a[strlen(a) - 1] = 0;
+            o->type = OP_REG;
+            o->reg = parse_reg(a);
+            o->writeback = 1;
+        } else if (a[0] == '#') {
+            parse_imm(o, a, it->line);
+        } else if (a[0] == '[') {
+            char *post = (i + 1 < n && strchr(a, ']')[1] != '!' && args[i + 1][0] == '#' &&
+                          a[strlen(a) - 1] == ']' && strchr(a, ',') == 0) ? args[++i] : 0;
+            parse_mem(o, a, post, it->line);
+        } else if (a[0] == '=') {
+            o->type = OP_LIT;
+            snprintf(o->expr, sizeof o->expr, "%s", trim(a + 1));
+        } else if (a[0] == '{') {
+            o->type = OP_LIST;
+            o->list = parse_list(a, it->line);
+        } else if (parse_shift(a, &o->shift) && k > 0 && it->op[k - 1].type == OP_REG) {
+            operand_t *prev = &it->op[k - 1];
+            char *amt = trim(a + 3);
+            prev->type = OP_SHREG;
+            prev->shift = o->shift;
+            if (amt[0] == '#') {
+                uint32_t v;
+                eval(amt + 1, &v, it->line, 1);
+                prev->amount = (int)v;
+            } else {
+                prev->shift_reg = parse_reg(amt);
+                if (prev->shift_reg < 0) fail(it->line, "bad shift", a);
+            }
+            continue;
+        } else {
+            o->type = OP_LABEL;
+            snprintf(o->expr, sizeof o->expr, "%s", a);
+        }
+        k++;
+    }
+    it->nops = k;
+}
+
+/* Sizes now, values in fill_data() once every label has an address */
+static void parse_data(item_t *it, const char *dir, char *text) {
+    char *args[256], *copy = strdup(text);
+    int n = split_args(copy, args, 256), i;
+
+    it->unit = !strcmp(dir, "DCB") ? 1 : !strcmp(dir, "DCW") ? 2 : 4;
+    it->text = strdup(text);
+    it->bytes = 0;
+    for (i = 0; i < n; i++) {
+        if (args[i][0] == '"') {                // String in a DCB
+            it->bytes += (uint32_t)(strchr(args[i] + 1, '"') ? strchr(args[i] + 1, '"') - args[i] - 1
+                                                             : (long)strlen(args[i]) - 1);
+        } else {
+            it->bytes += (uint32_t)it->unit;
+        }
+    }
+    it->data = calloc(1, it->bytes ? it->bytes : 1);
+    free(copy);
+}
+
+static void fill_data(item_t *it) {
+    char *args[256], *copy = strdup(it->text);
+    int n = split_args(copy, args, 256), i, k;
+    uint32_t len = 0;
+
+    for (i = 0; i < n; i++) {
+        if (args[i][0] == '"') {
+            char *p = args[i] + 1;
+            for (; *p && *p != '"'; p++) it->data[len++] = (uint8_t)*p;
+        } else {
+            uint32_t v = 0;
+            eval(args[i], &v, it->line, 1);
+            for (k = 0; k < it->unit; k++) it->data[len++] = (uint8_t)(v >> (8 * k));
+        }
+    }
+    free(copy);
+}
+
+static int is_directive(const char *w) {
+    static const char *const dirs[] = {
+        "AREA", "EXPORT", "IMPORT", "GLOBAL", "EXTERN", "ENTRY", "END", "ALIGN", "THUMB",
+        "PRESERVE8", "REQUIRE8", "EQU", "DCB", "DCW", "DCD", "DCDU", "SPACE", "FILL", "LTORG",
+        "CODE16", "INCLUDE", "GET", 0
+    };
+    int i;
+
+    for (i = 0; dirs[i]; i++) {
+        if (!strcmp(w, dirs[i])) return 1;
+    }
+    return 0;
+}
+
+static void upcase(char *s) {
+    for (; *s; s++) *s = (char)toupper((unsigned char)*s);
+}
+
+/* Upper-cases the line except inside quotes and after a ';' */
+static void prepare(char *line) {
+    char *p;
+    int quote = 0;
+
+    for (p = line; *p; p++) {
+        if (*p == '"') quote = !quote;
+        if (*p == ';' && !quote) {
+            *p = 0;
+            break;
+        }
+        if (!quote && *p != '\'') *p = (char)toupper((unsigned char)*p);
+        if (*p == '\'' && p[1] && p[2] == '\'') p += 2;     // Keep 'a' as written
+    }
+}
+
+static void read_source(const char *path) {
+    FILE *f = fopen(path, "r");
+    char raw[MAX_LINE];
+    int line = 0, area = -1;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(raw, sizeof raw, f)) {
+        char buf[MAX_LINE], *p, *word, label[64] = "";
+        item_t *it;
+
+        line++;
+        if (n_src < (int)(sizeof src_lines / sizeof src_lines[0])) {
+            raw[strcspn(raw, "\r\n")] = 0;
+            src_lines[n_src++] = strdup(raw);
+        }
+        snprintf(buf, sizeof buf, "%s", raw);
+        prepare(buf);
+        p = buf;
+        if (*p && !isspace((unsigned char)*p)) {             // Label in column 1
+            int n = 0;
+            while (*p && !isspace((unsigned char)*p) && n < 63) label[n++] = *p++;
+            label[n] = 0;
+        }
+        p = trim(p);
+        word = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        if (*p) *p++ = 0;
+        p = trim(p);
+
+        if (label[0] && is_directive(label) && !*word) {   // Directive in column 1
+            word = label;
+            label[0] = 0;
+        }
+        if (!strcmp(word, "EQU")) {
+            symbol_t *s = add_sym(label, line);
+            eval(p, &s->value, line, 1);
+            continue;
+        }
+        if (!strcmp(word, "AREA")) {
+            char *args[8];
+            int n = split_args(p, args, 8), k;
+            area_t *a;
+            if (n < 1) fail(line, "missing operand", 0);
+            if (n_areas == MAX_AREAS) fail(line, "too many areas", 0);
+            a = &areas[n_areas];
+            snprintf(a->name, sizeof a->name, "%s", args[0]);
+            a->code = 0;
+            a->readonly = 0;
+            for (k = 1; k < n; k++) {
+                if (!strcmp(args[k], "CODE")) a->code = 1, a->readonly = 1;
+                if (!strcmp(args[k], "READONLY")) a->readonly = 1;
+                if (!strcmp(args[k], "READWRITE")) a->readonly = 0;
+            }
+            area = n_areas++;
+            if (label[0]) fail(line, "label on AREA", label);
+            continue;
+        }
+        if (!strcmp(word, "END")) break;
+        if (!word[0] && !label[0]) continue;
+        if (area < 0) fail(line, "code before the first AREA", 0);
+        if (n_items == MAX_ITEMS) fail(line, "program too long", 0);
+        it = &items[n_items];
+        memset(it, 0, sizeof *it);
+        it->line = line;
+        it->area = area;
+        if (label[0]) {
+            symbol_t *s = add_sym(label, line);
+            s->item = n_items;
+        }
+        if (!word[0] || !strcmp(word, "EXPORT") || !strcmp(word, "IMPORT") ||
+            !strcmp(word, "GLOBAL") || !strcmp(word, "EXTERN") || !strcmp(word, "ENTRY") ||
+            !strcmp(word, "THUMB") || !strcmp(word, "CODE16") || !strcmp(word, "PRESERVE8") ||
+            !strcmp(word, "REQUIRE8") || !strcmp(word, "LTORG")) {
+            n_items++;                                      // Zero-size anchor
+            continue;
+        }
+        if (!strcmp(word, "ALIGN")) {
+            uint32_t v = 4;
+            if (*p) eval(p, &v, line, 1);
+            it->unit = -(int)v;                             // Resolved at layout
+            n_items++;
+            continue;
+        }
+        if (!strcmp(word, "DCB") || !strcmp(word, "DCW") || !strcmp(word, "DCD") ||
+            !strcmp(word, "DCDU")) {
+            parse_data(it, word[2] == 'B' ? "DCB" : word[2] == 'W' ? "DCW" : "DCD", p);
+            n_items++;
+            continue;
+        }
+        if (!strcmp(word, "SPACE") || !strcmp(word, "FILL")) {
+            uint32_t v;
+            char *args[2];
+            if (split_args(p, args, 2) < 1) fail(line, "missing operand", 0);
+            eval(args[0], &v, line, 1);
+            it->unit = 1;
+            it->bytes = v;
+            it->data = calloc(1, v ? v : 1);
+            n_items++;
+            continue;
+        }
+        {
+            char m[24];
+            snprintf(m, sizeof m, "%s", word);
+            if (!split_mnemonic(it, m)) fail(line, "unknown instruction", word);
+        }
+        if (!areas[area].code) fail(line, "instruction in a DATA area", word);
+        it->is_insn = 1;
+        if (strcmp(it->mnem, "IT")) {
+            parse_operands(it, p);
+        } else {
+            it->cond = parse_cond(p);
+            if (it->cond < 0 || it->cond == 14) fail(line, "bad IT condition", p);
+        }
+        n_items++;
+    }
+    fclose(f);
+    if (n_areas == 0) fail(line, "no AREA", 0);
+}
+
+/*=============================================================================
+ * LAYOUT - encoding widths, literal pools, addresses
+ *============================================================================*/
+static int low(int r) { return r >= 0 && r < 8; }
+
+static int thumb_imm(uint32_t v) {             // Thumb-2 modified immediate
+    int k;
+    uint32_t b = v & 0xFF;
+
+    if (v < 256) return 1;
+    if (v == (b | b << 16) || v == (b << 8 | b << 24) || v == (b | b << 8 | b << 16 | b << 24)) {
+        return 1;
+    }
+    for (k = 8; k < 32; k++) {
+        uint32_t r = (v << k) | (v >> (32 - k));            // Rotate left to undo ROR k
+        if (r >= 0x80 && r < 0x100) return 1;
+    }
+    return 0;
+}
+
+/* Narrow (16-bit) when armasm would pick it outside an IT block */
+static uint32_t width(item_t *it, int in_it) {
+    const char *m = it->mnem;
+    operand_t *o = it->op;
+    int s_ok = in_it ? !it->setflags : it->setflags;     // 16-bit forms set flags outside IT
+
+    if (it->size_q) return (uint32_t)it->size_q;
+    if (!strcmp(m, "IT") || !strcmp(m, "NOP") || !strcmp(m, "BX") || !strcmp(m, "CBZ") ||
+        !strcmp(m, "CBNZ")) return 2;
+    if (!strcmp(m, "BL")) return 4;
+    if (!strcmp(m, "B")) return 2;                        // Labs fit the short ranges
+    if (!strcmp(m, "PUSH") || !strcmp(m, "POP")) {
+        return (o[0].list & ~(0xFFu | (1u << 14) | (1u << 15))) ? 4 : 2;
+    }
+    if (!strcmp(m, "MOV") && it->nops == 2 && o[1].type == OP_REG) return 2;
+    if (!strcmp(m, "MOV") && o[1].type == OP_IMM) {
+        return (s_ok && low(o[0].reg) && o[1].value < 256) ? 2 : 4;
+    }
+    if (!strcmp(m, "CMP")) {
+        if (o[1].type == OP_IMM) return (low(o[0].reg) && o[1].value < 256) ? 2 : 4;
+        return o[1].type == OP_REG ? 2 : 4;
+    }
+    if (!strcmp(m, "CMN") || !strcmp(m, "TST")) {
+        return (o[1].type == OP_REG && low(o[0].reg) && low(o[1].reg)) ? 2 : 4;
+    }
+    if (!strcmp(m, "ADD") || !strcmp(m, "SUB")) {
+        int rd = o[0].reg, rn = it->nops == 3 ? o[1].reg : rd;
+        operand_t *b = &o[it->nops - 1];
+        if (!strcmp(m, "ADD") && b->type == OP_REG && rd == rn && !it->setflags) return 2;
+        if (!s_ok || !low(rd) || !low(rn)) return 4;
+        if (b->type == OP_REG) return low(b->reg) ? 2 : 4;
+        if (b->type == OP_IMM) return (b->value < 8 || (rd == rn && b->value < 256)) ? 2 : 4;
+        return 4;
+    }
+    if (!strcmp(m, "AND") || !strcmp(m, "ORR") || !strcmp(m, "EOR") || !strcmp(m, "BIC") ||
+        !strcmp(m, "ADC") || !strcmp(m, "SBC") || !strcmp(m, "MVN") || !strcmp(m, "MUL")) {
+        int rd = o[0].reg;
+        operand_t *b = &o[it->nops - 1];
+        int rn = it->nops == 3 ? o[1].reg : rd;
+        if (!strcmp(m, "MVN")) return (s_ok && b->type == OP_REG && low(rd) && low(b->reg)) ? 2 : 4;
+        return (s_ok && b->type == OP_REG && low(rd) && low(b->reg) &&
+                (rn == rd || (!strcmp(m, "MUL") && b->reg == rd))) ? 2 : 4;
+    }
+    if (!strcmp(m, "LSL") || !strcmp(m, "LSR") || !strcmp(m, "ASR")) {
+        operand_t *b = &o[it->nops - 1];
+        return (s_ok && low(o[0].reg) && low(o[1].reg) && b->type != OP_LIST) ? 2 : 4;
+    }
+    if (!strncmp(m, "LDR", 3) || !strncmp(m, "STR", 3)) {
+        operand_t *a = &o[1];
+        int unit = strchr(m + 3, 'B') ? 1 : strchr(m + 3, 'H') ? 2 : 4;
+        if (a->type == OP_LIT) return low(o[0].reg) ? 2 : 4;
+        if (a->type != OP_MEM || a->writeback || !low(o[0].reg)) return 4;
+        if (!strcmp(m, "LDRSB") || !strcmp(m, "LDRSH")) {
+            return (a->index >= 0 && low(a->reg) && low(a->index) && !a->amount) ? 2 : 4;
+        }
+        if (a->index >= 0) return (low(a->reg) && low(a->index) && !a->amount) ? 2 : 4;
+        if (a->reg == 13 && unit == 4) return (a->imm >= 0 && a->imm < 1024 && !(a->imm & 3)) ? 2 : 4;
+        return (low(a->reg) && a->imm >= 0 && a->imm < 32 * unit && !(a->imm % unit)) ? 2 : 4;
+    }
+    if (!strncmp(m, "LDM", 3) || !strncmp(m, "STM", 3)) {
+        return (low(o[0].reg) && !(o[1].list & ~0xFFu)) ? 2 : 4;
+    }
+    return 4;
+}
+
+static int add_literal(area_t *a, const char *expr, int line) {
+    int i;
+
+    for (i = 0; i < a->n_lits; i++) {
+        if (!strcmp(a->lit_expr[i], expr)) return i;
+    }
+    if (a->n_lits == 256) fail(line, "literal pool full", 0);
+    snprintf(a->lit_expr[a->n_lits], sizeof a->lit_expr[0], "%s", expr);
+    return a->n_lits++;
+}
+
+static void layout(void) {
+    uint32_t flash_at = FLASH_BASE, ram_at = RAM_BASE;
+    int pass, a, i;
+
+    for (pass = 0; pass < 2; pass++) {                  // Pass 2 with every label known
+        flash_at = FLASH_BASE;
+        ram_at = RAM_BASE;
+        for (a = 0; a < n_areas; a++) {
+            area_t *ar = &areas[a];
+            int in_flash = ar->readonly && !ar->in_ram;
+            uint32_t at = in_flash ? flash_at : ram_at;
+            int it_left = 0;
+
+            at = (at + 3) & ~3u;
+            ar->base = at;
+            ar->n_lits = 0;
+            for (i = 0; i < n_items; i++) {
+                item_t *it = &items[i];
+                if (it->area != a) continue;
+                if (it->unit < 0) {                         // ALIGN
+                    uint32_t al = (uint32_t)-it->unit;
+                    at = (at + al - 1) / al * al;
+                }
+                if (it->is_insn) {
+                    if (it->op[1].type == OP_LIT) {
+                        uint32_t v;
+                        it->lit_addr = 1;
+                        if (eval(it->op[1].expr, &v, it->line, pass) && !find_sym(it->op[1].expr) &&
+                            (thumb_imm(v) || v < 0x10000)) {
+                            it->lit_addr = 0;               // A constant MOV can make
+                            it->op[1].value = v;
+                        } else {
+                            add_literal(ar, it->op[1].expr, it->line);
+                        }
+                    }
+                    it->bytes = width(it, it_left > 0);
+                    if (it->lit_addr == 0 && it->op[1].type == OP_LIT) {
+                        it->bytes = (low(it->op[0].reg) && it->op[1].value < 256) ? 2 : 4;
+                    }
+                    if (it_left > 0) it_left--;
+                    if (!strcmp(it->mnem, "IT")) it_left = (int)strlen(it->it_mask);
+                }
+                it->addr = at;
+                for (int s = 0; s < n_syms; s++) {
+                    if (syms[s].item == i) syms[s].value = at;
+                }
+                at += it->bytes;
+            }
+            ar->lit_base = (at + 3) & ~3u;
+            if (ar->n_lits) at = ar->lit_base + 4u * (uint32_t)ar->n_lits;
+            ar->size = at - ar->base;
+            if (in_flash) flash_at = at; else ram_at = at;
+        }
+    }
+    if (flash_at > FLASH_BASE + FLASH_SIZE || ram_at > RAM_BASE + RAM_SIZE) {
+        fail(0, "program does not fit", 0);
+    }
+}
+
+/*=============================================================================
+ * MEMORY
+ *============================================================================*/
+static uint8_t *mem(uint32_t addr, uint32_t size, int write, int line) {
+    if (addr + size <= FLASH_BASE + FLASH_SIZE) {        // Flash starts at 0
+        if (write) {
+            fprintf(stderr, "%s:%d: store to flash at 0x%08X\n", src_path, line, addr);
+            exit(1);
+        }
+        return &flash[addr - FLASH_BASE];
+    }
+    if (addr >= RAM_BASE && addr + size <= RAM_BASE + RAM_SIZE) return &ram[addr - RAM_BASE];
+    fprintf(stderr, "%s:%d: access outside flash and RAM at 0x%08X\n", src_path, line, addr);
+    exit(1);
+}
+
+static uint32_t rd(uint32_t addr, uint32_t size, int line) {
+    uint8_t *p = mem(addr, size, 0, line);
+    uint32_t v = 0, k;
+
+    if (addr % size) {
+        fprintf(stderr, "%s:%d: unaligned %u-byte load at 0x%08X\n", src_path, line, size, addr);
+        exit(1);
+    }
+    for (k = 0; k < size; k++) v |= (uint32_t)p[k] << (8 * k);
+    return v;
+}
+
+static void wr(uint32_t addr, uint32_t size, uint32_t v, int line) {
+    uint8_t *p = mem(addr, size, 1, line);
+    uint32_t k;
+
+    if (addr % size) {
+        fprintf(stderr, "%s:%d: unaligned %u-byte store at 0x%08X\n", src_path, line, size, addr);
+        exit(1);
+    }
+    for (k = 0; k < size; k++) p[k] = (uint8_t)(v >> (8 * k));
+}
+
+static void load_image(void) {
+    int i, a;
+
+    for (i = 0; i < n_items; i++) {
+        item_t *it = &items[i];
+        if (!it->is_insn && it->data && it->bytes) {
+            if (it->text) fill_data(it);
+            memcpy(mem(it->addr, it->bytes, 0, it->line), it->data, it->bytes);
+        }
+    }
+    for (a = 0; a < n_areas; a++) {
+        for (i = 0; i < areas[a].n_lits; i++) {
+            uint32_t v;
+            eval(areas[a].lit_expr[i], &v, 0, 1);
+            memcpy(mem(areas[a].lit_base + 4u * (uint32_t)i, 4, 0, 0), &v, 4);
+        }
+    }
+}
+
+/*=============================================================================
+ * FLASH ACCELERATOR
+ *============================================================================*/
+typedef struct {
+    uint32_t line;                      // Address >> 4
+    int valid;
+    unsigned long long ready, used;     // Cycle the data arrives, last access
+} flash_line_t;
+
+static flash_line_t flash_buf[FLASH_LINES];
+static int wait_states;
+static unsigned long long flash_stalls, flash_fills;
+
+static flash_line_t *flash_find(uint32_t line) {
+    int k;
+
+    for (k = 0; k < FLASH_LINES; k++) {
+        if (flash_buf[k].valid && flash_buf[k].line == line) return &flash_buf[k];
+    }
+    return 0;
+}
+
+static flash_line_t *flash_fill(uint32_t line, unsigned long long ready) {
+    flash_line_t *e = &flash_buf[0];
+    int k;
+
+    for (k = 1; k < FLASH_LINES && e->valid; k++) {
+        if (!flash_buf[k].valid || flash_buf[k].used < e->used) e = &flash_buf[k];
+    }
+    e->line = line;
+    e->valid = 1;
+    e->ready = e->used = ready;
+    flash_fills++;
+    return e;
+}
+
+/* Cycles an access at 'now' waits for flash; fetches prefetch a line */
+static unsigned int flash_wait(uint32_t addr, unsigned long long now, int fetch) {
+    uint32_t line = addr >> 4;
+    flash_line_t *e;
+    unsigned int stall = 0;
+
+    if (!wait_states || addr >= FLASH_BASE + FLASH_SIZE) return 0;
+    e = flash_find(line);
+    if (!e) {
+        stall = (unsigned int)wait_states;
+        e = flash_fill(line, now + stall);
+    } else if (e->ready > now) {
+        stall = (unsigned int)(e->ready - now);
+    }
+    e->used = now + stall;
+    if (fetch && (line + 1) << 4 < FLASH_BASE + FLASH_SIZE && !flash_find(line + 1)) {
+        flash_fill(line + 1, now + stall + (unsigned int)wait_states + 1);
+    }
+    flash_stalls += stall;
+    return stall;
+}
+
+/*=============================================================================
+ * EXECUTION
+ *============================================================================*/
+static uint32_t r[16];
+static int fn, fz, fc, fv;
+static int refill = 2;
+
+static int passes(int cond) {
+    switch (cond) {
+    case 0: return fz;
+    case 1: return !fz;
+    case 2: return fc;
+    case 3: return !fc;
+    case 4: return fn;
+    case 5: return !fn;
+    case 6: return fv;
+    case 7: return !fv;
+    case 8: return fc && !fz;
+    case 9: return !fc || fz;
+    case 10: return fn == fv;
+    case 11: return fn != fv;
+    case 12: return !fz && fn == fv;
+    case 13: return fz || fn != fv;
+    default: return 1;
+    }
+}
+
+static uint32_t shift(uint32_t v, int type, int n, int *carry) {
+    if (n == 0) return v;
+    switch (type) {
+    case SH_LSL:
+        if (n >= 32) { *carry = n == 32 ? (int)(v & 1) : 0; return 0; }
+        *carry = (int)((v >> (32 - n)) & 1);
+        return v << n;
+    case SH_LSR:
+        if (n >= 32) { *carry = n == 32 ? (int)(v >> 31) : 0; return 0; }
+        *carry = (int)((v >> (n - 1)) & 1);
+        return v >> n;
+    case SH_ASR:
+        if (n >= 32) { *carry = (int)(v >> 31); return (v >> 31) ? 0xFFFFFFFFu : 0; }
+        *carry = (int)(((int32_t)v >> (n - 1)) & 1);
+        return (uint32_t)((int32_t)v >> n);
+    default:
+        n &= 31;
+        if (n == 0) { *carry = (int)(v >> 31); return v; }
+        v = (v >> n) | (v << (32 - n));
+        *carry = (int)(v >> 31);
+        return v;
+    }
+}
+
+static uint32_t reg_value(int reg, const item_t *it) {
+    return reg == 15 ? it->addr + 4 : r[reg];
+}
+
+static uint32_t operand2(const item_t *it, const operand_t *o, int *carry) {
+    switch (o->type) {
+    case OP_IMM:
+        return o->value;
+    case OP_REG:
+        return reg_value(o->reg, it);
+    case OP_SHREG:
+        return shift(reg_value(o->reg, it), o->shift,
+                     o->shift_reg >= 0 ? (int)(r[o->shift_reg] & 0xFF) : o->amount, carry);
+    default:
+        fail(it->line, "bad operand", it->mnem);
+        return 0;
+    }
+}
+
+static uint32_t add_flags(uint32_t a, uint32_t b, int cin, int set) {
+    uint64_t u = (uint64_t)a + b + (unsigned)cin;
+    int64_t s = (int64_t)(int32_t)a + (int32_t)b + cin;
+    uint32_t res = (uint32_t)u;
+
+    if (set) {
+        fn = (int)(res >> 31);
+        fz = res == 0;
+        fc = (int)(u >> 32);
+        fv = s != (int32_t)res;
+    }
+    return res;
+}
+
+static void logic_flags(uint32_t res, int carry, int set) {
+    if (set) {
+        fn = (int)(res >> 31);
+        fz = res == 0;
+        fc = carry;
+    }
+}
+
+typedef struct {
+    unsigned long long cycles, insns;
+    int last_ls;                        // Previous instruction: single load/store
+    int last_load_rd;                   // Its destination, -1 if a store
+} run_t;
+
+static int item_at(uint32_t addr) {
+    int i;
+
+    for (i = 0; i < n_items; i++) {
+        if (items[i].is_insn && items[i].addr == addr) return i;
+    }
+    return -1;
+}
+
+static uint32_t label_addr(item_t *it, operand_t *o) {
+    uint32_t v;
+
+    eval(o->expr, &v, it->line, 1);
+    return v;
+}
+
+/* One instruction; returns its cycles, 0 when the program has stopped */
+static unsigned int step(int *pc_item, run_t *run, int *it_conds, int *it_left) {
+    item_t *it = &items[*pc_item];
+    const char *m = it->mnem;
+    operand_t *o = it->op;
+    unsigned int cyc = 1;
+    int cond = it->cond, next = -1, carry = fc, taken = 0, is_ls = 0, load_rd = -1;
+    uint32_t next_addr = it->addr + it->bytes;
+    unsigned int stall = flash_wait(it->addr, run->cycles, 1);
+
+    stall += flash_wait(it->addr + it->bytes - 1, run->cycles + stall, 1);
+    if (*it_left > 0) {
+        cond = *it_conds & 0xF;
+        *it_conds >>= 4;
+        (*it_left)--;
+    }
+    if (!strcmp(m, "IT")) {
+        size_t k;
+        *it_conds = 0;
+        for (k = 0; k < strlen(it->it_mask); k++) {
+            int c = it->it_mask[k] == 'T' ? it->cond : (it->cond ^ 1);
+            *it_conds |= c << (4 * k);
+        }
+        *it_left = (int)strlen(it->it_mask);
+    } else if (!passes(cond)) {
+        if (!strcmp(m, "B")) cyc = 1;           // Not taken
+    } else if (!strcmp(m, "B") || !strcmp(m, "BL")) {
+        uint32_t target = label_addr(it, &o[0]);
+        if (target == it->addr && cond == 14) return 0;       // B STOP
+        if (!strcmp(m, "BL")) r[14] = next_addr | 1;
+        next_addr = target;
+        taken = 1;
+    } else if (!strcmp(m, "BX")) {
+        next_addr = r[o[0].reg] & ~1u;
+        taken = 1;
+    } else if (!strcmp(m, "CBZ") || !strcmp(m, "CBNZ")) {
+        if ((r[o[0].reg] == 0) == (m[2] == 'Z')) {
+            next_addr = label_addr(it, &o[1]);
+            taken = 1;
+        }
+    } else if (!strcmp(m, "NOP")) {
+    } else if (!strcmp(m, "MOV") || !strcmp(m, "MVN") || !strcmp(m, "MOVW")) {
+        uint32_t v = o[1].type == OP_LIT ? o[1].value : operand2(it, &o[1], &carry);
+        if (m[1] == 'V') v = ~v;
+        r[o[0].reg] = v;
+        logic_flags(v, carry, it->setflags);
+        if (o[0].reg == 15) { next_addr = v & ~1u; taken = 1; }
+    } else if (!strcmp(m, "MOVT")) {
+        r[o[0].reg] = (r[o[0].reg] & 0xFFFF) | (o[1].value << 16);
+    } else if (!strcmp(m, "CMP") || !strcmp(m, "CMN")) {
+        uint32_t b = operand2(it, &o[1], &carry);
+        if (m[2] == 'P') add_flags(reg_value(o[0].reg, it), ~b, 1, 1);
+        else add_flags(reg_value(o[0].reg, it), b, 0, 1);
+    } else if (!strcmp(m, "TST") || !strcmp(m, "TEQ")) {
+        uint32_t b = operand2(it, &o[1], &carry);
+        uint32_t v = m[1] == 'S' ? (reg_value(o[0].reg, it) & b) : (reg_value(o[0].reg, it) ^ b);
+        logic_flags(v, carry, 1);
+    } else if (!strcmp(m, "ADD") || !strcmp(m, "ADC") || !strcmp(m, "SUB") ||
+               !strcmp(m, "SBC") || !strcmp(m, "RSB") || !strcmp(m, "AND") ||
+               !strcmp(m, "ORR") || !strcmp(m, "EOR") || !strcmp(m, "BIC") ||
+               !strcmp(m, "ORN")) {
+        int three = it->nops == 3;
+        uint32_t a = reg_value(three ? o[1].reg : o[0].reg, it);
+        uint32_t b = operand2(it, &o[three ? 2 : 1], &carry), v;
+        if (!strcmp(m, "ADD")) v = add_flags(a, b, 0, it->setflags);
+        else if (!strcmp(m, "ADC")) v = add_flags(a, b, fc, it->setflags);
+        else if (!strcmp(m, "SUB")) v = add_flags(a, ~b, 1, it->setflags);
+        else if (!strcmp(m, "SBC")) v = add_flags(a, ~b, fc, it->setflags);
+        else if (!strcmp(m, "RSB")) v = add_flags(b, ~a, 1, it->setflags);
+        else {
+            v = !strcmp(m, "AND") ? a & b : !strcmp(m, "ORR") ? a | b : !strcmp(m, "EOR") ? a ^ b :
+                !strcmp(m, "BIC") ? a & ~b : a | ~b;
+            logic_flags(v, carry, it->setflags);
+        }
+        r[o[0].reg] = v;
+        if (o[0].reg == 15) { next_addr = v & ~1u; taken = 1; }
+    } else if (!strcmp(m, "LSL") || !strcmp(m, "LSR") || !strcmp(m, "ASR") ||
+               !strcmp(m, "ROR")) {
+        int type = !strcmp(m, "LSL") ? SH_LSL : !strcmp(m, "LSR") ? SH_LSR :
+                   !strcmp(m, "ASR") ? SH_ASR : SH_ROR;
+        int three = it->nops == 3;
+        uint32_t a = reg_value(three ? o[1].reg : o[0].reg, it);
+        operand_t *n = &o[three ? 2 : 1];
+        uint32_t v = shift(a, type, n->type == OP_IMM ? (int)n->value : (int)(r[n->reg] & 0xFF),
+                           &carry);
+        r[o[0].reg] = v;
+        logic_flags(v, carry, it->setflags);
+    } else if (!strcmp(m, "MUL")) {
+        uint32_t a = r[o[it->nops == 3 ? 1 : 0].reg], b = r[o[it->nops - 1].reg];
+        r[o[0].reg] = a * b;
+        if (it->setflags) { fn = (int)(r[o[0].reg] >> 31); fz = r[o[0].reg] == 0; }
+    } else if (!strcmp(m, "MLA")) {
+        r[o[0].reg] = r[o[1].reg] * r[o[2].reg] + r[o[3].reg];
+        cyc = 2;
+    } else if (!strcmp(m, "UDIV") || !strcmp(m, "SDIV")) {
+        int three = it->nops == 3;
+        uint32_t a = r[o[three ? 1 : 0].reg], b = r[o[three ? 2 : 1].reg], q, mag;
+        if (b == 0) q = 0;
+        else if (m[0] == 'U') q = a / b;
+        else if ((int32_t)a == INT32_MIN && (int32_t)b == -1) q = a;
+        else q = (uint32_t)((int32_t)a / (int32_t)b);
+        r[o[0].reg] = q;
+        mag = (m[0] == 'S' && (int32_t)q < 0) ? (uint32_t)-q : q;
+        cyc = 2;                                 // 2-12: about 4 quotient bits a cycle
+        while (mag && cyc < 12) { cyc++; mag >>= 4; }
+    } else if (!strncmp(m, "LDR", 3) || !strncmp(m, "STR", 3)) {
+        int load = m[0] == 'L';
+        uint32_t unit = strstr(m, "B") ? 1 : strstr(m + 3, "H") ? 2 : 4, addr, v;
+        int sign = strstr(m, "S") != 0 && load;
+        operand_t *a = &o[1];
+        if (a->type == OP_LIT && !it->lit_addr) {   // Became a MOV
+            r[o[0].reg] = a->value;
+        } else {
+            if (a->type == OP_LIT) {
+                area_t *ar = &areas[it->area];
+                addr = ar->lit_base + 4u * (uint32_t)add_literal(ar, a->expr, it->line);
+            } else if (a->type == OP_LABEL) {
+                addr = label_addr(it, a);
+            } else if (a->type == OP_MEM) {
+                uint32_t base = reg_value(a->reg, it);
+                uint32_t off = a->index >= 0 ? r[a->index] << a->amount : (uint32_t)a->imm;
+                addr = a->pre ? base + off : base;
+                if (a->writeback) r[a->reg] = base + off;
+                if (run->last_ls && run->last_load_rd != a->reg &&
+                    (a->index < 0 || run->last_load_rd != a->index)) {
+                    cyc = 0;                    // Pipelined behind the last access: 1
+                }
+            } else {
+                fail(it->line, "bad address operand", m);
+                addr = 0;
+            }
+            if (a->type != OP_MEM && run->last_ls) cyc = 0;
+            if (load) {
+                stall += flash_wait(addr, run->cycles + stall + 1, 0);
+                v = rd(addr, unit, it->line);
+                if (sign && unit == 1) v = (uint32_t)(int32_t)(int8_t)v;
+                if (sign && unit == 2) v = (uint32_t)(int32_t)(int16_t)v;
+                r[o[0].reg] = v;
+                load_rd = o[0].reg;
+                if (o[0].reg == 15) { next_addr = v & ~1u; taken = 1; }
+            } else {
+                wr(addr, unit, r[o[0].reg], it->line);
+            }
+            cyc += 1;                           // 2, or 1 when pipelined
+            is_ls = 1;
+        }
+    } else if (!strcmp(m, "PUSH") || !strcmp(m, "STM") || !strcmp(m, "STMIA") ||
+               !strcmp(m, "STMEA")) {
+        int push = m[0] == 'P';
+        uint32_t list = push ? o[0].list : o[1].list, n = 0, k, addr;
+        for (k = 0; k < 16; k++) n += (list >> k) & 1;
+        addr = push ? r[13] - 4 * n : r[o[0].reg];
+        for (k = 0; k < 16; k++) {
+            if (list & (1u << k)) { wr(addr, 4, r[k], it->line); addr += 4; }
+        }
+        if (push) r[13] -= 4 * n;
+        else if (o[0].writeback) r[o[0].reg] += 4 * n;
+        cyc = 1 + n;
+    } else if (!strcmp(m, "POP") || !strcmp(m, "LDM") || !strcmp(m, "LDMIA") ||
+               !strcmp(m, "LDMFD")) {
+        int pop = m[0] == 'P';
+        uint32_t list = pop ? o[0].list : o[1].list, n = 0, k, addr, base;
+        for (k = 0; k < 16; k++) n += (list >> k) & 1;
+        base = addr = pop ? r[13] : r[o[0].reg];
+        for (k = 0; k < 16; k++) {
+            if (list & (1u << k)) {
+                stall += flash_wait(addr, run->cycles + stall + 1, 0);
+                r[k] = rd(addr, 4, it->line);
+                addr += 4;
+            }
+        }
+        if (pop) r[13] = base + 4 * n;
+        else if (o[0].writeback && !(list & (1u << o[0].reg))) r[o[0].reg] = base + 4 * n;
+        cyc = 1 + n;
+        if (list & (1u << 15)) { next_addr = r[15] & ~1u; taken = 1; }
+    } else {
+        fail(it->line, "not implemented", m);
+    }
+
+    if (taken) cyc += (unsigned int)refill;
+    cyc += stall;
+    run->last_ls = is_ls;
+    run->last_load_rd = load_rd;
+    next = item_at(next_addr);
+    if (next < 0) {
+        fprintf(stderr, "%s:%d: execution left the code at 0x%08X\n", src_path, it->line,
+                next_addr);
+        exit(1);
+    }
+    *pc_item = next;
+    return cyc;
+}
+
+/*=============================================================================
+ * REPORT
+ *============================================================================*/
+static void print_data(void) {
+    int i;
+
+    printf("READWRITE data:\n");
+    for (i = 0; i < n_syms; i++) {
+        symbol_t *s = &syms[i];
+        item_t *it;
+        uint32_t k;
+        if (s->item < 0 || items[s->item].is_insn || areas[items[s->item].area].readonly) {
+            continue;
+        }
+        it = &items[s->item];
+        if (!it->bytes) continue;
+        printf("  %-16s 0x%08X =", s->name, it->addr);
+        for (k = 0; k < it->bytes && k < 16 * (uint32_t)it->unit; k += (uint32_t)it->unit) {
+            printf(" 0x%0*X", 2 * it->unit, rd(it->addr + k, (uint32_t)it->unit, it->line));
+        }
+        if (it->bytes > 16 * (uint32_t)it->unit) printf(" ...");
+        printf("\n");
+    }
+}
+
+static void print_listing(void) {
+    int i, line;
+
+    printf("\n  line    runs   cycles  source\n");
+    for (line = 1; line <= n_src; line++) {
+        item_t *hit = 0;
+        for (i = 0; i < n_items; i++) {
+            if (items[i].is_insn && items[i].line == line) hit = &items[i];
+        }
+        if (hit) {
+            printf("  %4d %7u %8llu  %s\n", line, hit->count, hit->cycles, src_lines[line - 1]);
+        } else {
+            printf("  %4d                  %s\n", line, src_lines[line - 1]);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *sets[MAX_SETS], *ram_areas[MAX_AREAS];
+    int n_sets = 0, n_ram = 0, listing = 0, i, pc_item, it_conds = 0, it_left = 0;
+    uint32_t code_bytes = 0, entry, sp;
+    run_t run = { 0, 0, 0, -1 };
+    symbol_t *vec;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-p") && i + 1 < argc - 1) {
+            refill = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc - 1) {
+            wait_states = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-ram") && i + 1 < argc - 1 && n_ram < MAX_AREAS) {
+            ram_areas[n_ram++] = argv[++i];
+        } else if (!strcmp(argv[i], "-l")) {
+            listing = 1;
+        } else if (!strcmp(argv[i], "-set") && i + 1 < argc - 1 && n_sets < MAX_SETS) {
+            sets[n_sets++] = argv[++i];
+        } else {
+            break;
+        }
+    }
+    if (i != argc - 1 || refill < 1 || refill > 3 || wait_states < 0 || wait_states > 9) {
+        fprintf(stderr, "usage: %s [-p refill] [-w waits] [-ram AREA]... [-l] "
+                "[-set LABEL=value]... file.asm\n", argv[0]);
+        return 2;
+    }
+    src_path = argv[i];
+    read_source(src_path);
+    for (i = 0; i < n_ram; i++) {                       // -ram AREA
+        char name[64];
+        int a;
+        snprintf(name, sizeof name, "%s", ram_areas[i]);
+        upcase(name);
+        for (a = 0; a < n_areas && strcmp(areas[a].name, name); a++) {
+        }
+        if (a == n_areas || !areas[a].readonly || a == 0) {
+            fprintf(stderr, "-ram: %s is not a READONLY area after the vectors\n", name);
+            return 2;
+        }
+        areas[a].in_ram = 1;
+    }
+    layout();
+    load_image();
+
+    for (i = 0; i < n_sets; i++) {                      // -set LABEL=value
+        char name[64];
+        const char *eq = strchr(sets[i], '=');
+        symbol_t *s;
+        uint32_t v;
+        if (!eq || eq - sets[i] >= 64) { fprintf(stderr, "bad -set %s\n", sets[i]); return 2; }
+        snprintf(name, sizeof name, "%.*s", (int)(eq - sets[i]), sets[i]);
+        upcase(name);
+        s = find_sym(name);
+        if (!s || s->item < 0 || items[s->item].is_insn || !items[s->item].unit) {
+            fprintf(stderr, "-set: %s is not a data label\n", name);
+            return 2;
+        }
+        v = (uint32_t)strtoul(eq + 1, 0, 0);
+        {
+            item_t *it = &items[s->item];
+            uint8_t *p = mem(it->addr, (uint32_t)it->unit, 0, it->line);
+            int k;
+            for (k = 0; k < it->unit; k++) p[k] = (uint8_t)(v >> (8 * k));
+        }
+    }
+
+    vec = find_sym("__VECTORS");
+    if (!vec || !vec->defined) {
+        fprintf(stderr, "%s: no __Vectors table\n", src_path);
+        return 1;
+    }
+    sp = rd(vec->value, 4, 0);
+    entry = rd(vec->value + 4, 4, 0) & ~1u;
+    r[13] = sp;
+    r[14] = 0xFFFFFFFFu;
+    pc_item = item_at(entry);
+    if (pc_item < 0) {
+        fprintf(stderr, "%s: reset vector 0x%08X is not an instruction\n", src_path, entry);
+        return 1;
+    }
+    for (i = 0; i < n_items; i++) {
+        if (items[i].is_insn) code_bytes += items[i].bytes;
+    }
+    for (i = 0; i < n_areas; i++) {
+        if (areas[i].code) code_bytes += 4u * (uint32_t)areas[i].n_lits;
+    }
+
+    while (run.insns < MAX_STEPS) {
+        item_t *it = &items[pc_item];
+        unsigned int c = step(&pc_item, &run, &it_conds, &it_left);
+        if (c == 0) break;
+        it->count++;
+        it->cycles += c;
+        run.cycles += c;
+        run.insns++;
+    }
+    if (run.insns == MAX_STEPS) {
+        fprintf(stderr, "%s: no B-to-self after %lu instructions\n", src_path, MAX_STEPS);
+        return 1;
+    }
+
+    printf("%s: %llu cycles, %llu instructions to the stop loop (refill P = %d)\n",
+           src_path, run.cycles, run.insns, refill);
+    printf("code %u bytes (Thumb-2 estimate, literal pools included)\n", code_bytes);
+    if (wait_states || n_ram) {
+        printf("flash: %d wait states, %llu stall cycles, %llu line fills;", wait_states,
+               flash_stalls, flash_fills);
+        for (i = 0; i < n_areas; i++) {
+            if (areas[i].in_ram) printf(" %s", areas[i].name);
+        }
+        printf(n_ram ? " in SRAM\n" : " nothing in SRAM\n");
+    }
+    print_data();
+    if (listing) print_listing();
+    return 0;
+}
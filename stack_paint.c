@@ -0,0 +1,133 @@
+/******************************************************************************
+ * FILE: stack_paint.c
+ * DESCRIPTION: Stack painting and high-water marks (see stack_paint.h)
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ ******************************************************************************/
+
+#include "stack_paint.h"
+#include "itm_print.h"
+
+static uintptr_t top;                   // Initial SP: depths are measured from here
+static volatile uint32_t *bottom;       // Lowest stack word
+static volatile uint32_t *mark;         // Lowest word known to be used
+
+/*=============================================================================
+ * PAINTING
+ *============================================================================*/
+void stack_paint(void) {
+    volatile uint32_t *p;
+    uintptr_t limit;
+
+    top = (uintptr_t)STACK_TOP();
+    bottom = (volatile uint32_t *)(top - STACK_SIZE);
+    limit = ((uintptr_t)STACK_SP() - STACK_PAINT_MARGIN) & ~(uintptr_t)3;
+    for (p = bottom; (uintptr_t)p < limit; p++) {
+        *p = STACK_PATTERN;
+    }
+    mark = p;
+}
+
+/*=============================================================================
+ * HIGH-WATER MARK
+ *============================================================================*/
+uint32_t stack_used(void) {
+    volatile uint32_t *p = bottom;
+
+    while (p < mark && *p == STACK_PATTERN) {
+        p++;
+    }
+    mark = p;
+    return (uint32_t)(top - (uintptr_t)mark);
+}
+
+uint32_t stack_free(void) {
+    return STACK_SIZE - stack_used();
+}
+
+int stack_overflowed(void) {
+    return *bottom != STACK_PATTERN;
+}
+
+/* Moves the mark down to 'sp' (everything above it is in use) and on past
+ * used words, giving up after STACK_GAP_WORDS untouched ones. Returns 1 if
+ * it moved.
+ */
+static int stack_extend(uintptr_t sp) {
+    volatile uint32_t *p = mark;
+    volatile uint32_t *found;
+    unsigned int gap = 0;
+
+    if (sp < (uintptr_t)p && sp > (uintptr_t)bottom) {
+        p = (volatile uint32_t *)(sp & ~(uintptr_t)3);
+    }
+    found = p;
+
+    while (p > bottom && gap < STACK_GAP_WORDS) {
+        p--;
+        if (*p != STACK_PATTERN) {
+            found = p;
+            gap = 0;
+        } else {
+            gap++;
+        }
+    }
+    if (found == mark) {
+        return 0;
+    }
+    mark = found;
+    return 1;
+}
+
+/*=============================================================================
+ * HANDLER PROBES
+ *============================================================================*/
+void stack_isr_reset(stack_isr_t *s, const char *name) {
+    s->name = name;
+    s->count = 0;
+    s->entry_max = 0;
+    s->peak = 0;
+}
+
+void stack_isr_depth(stack_isr_t *s, uintptr_t sp) {
+    uint32_t depth = (uint32_t)(top - sp);
+
+    if (depth > s->entry_max) s->entry_max = depth;
+}
+
+void stack_isr_exit(stack_isr_t *s, uintptr_t sp) {
+    s->count++;
+    if (stack_extend(sp)) {
+        s->peak = (uint32_t)(top - (uintptr_t)mark);
+    }
+}
+
+/*=============================================================================
+ * DUMP over ITM stimulus port 0
+ *============================================================================*/
+void stack_dump(const stack_isr_t *const *isrs, unsigned int n) {
+    uint32_t used = stack_used();
+    unsigned int k;
+
+    itm_puts("STACK ");
+    itm_putu(used, 0);
+    itm_puts(" of ");
+    itm_putu(STACK_SIZE, 0);
+    itm_puts(" bytes used");
+    if (stack_overflowed()) {
+        itm_puts(" - OVERFLOW");
+    }
+    itm_puts("\r\n");
+    for (k = 0; k < n; k++) {
+        itm_puts("  ");
+        itm_puts(isrs[k]->name);
+        itm_puts(": ");
+        itm_putu(isrs[k]->count, 0);
+        itm_puts(" runs, entered at up to ");
+        itm_putu(isrs[k]->entry_max, 0);
+        if (isrs[k]->peak) {
+            itm_puts(", set the mark at ");
+            itm_putu(isrs[k]->peak, 0);
+        }
+        itm_puts("\r\n");
+    }
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * FILE: stack_paint.h
+ * DESCRIPTION: Stack painting - fills the unused stack with a pattern at
+ *              boot, then reports how deep the stack has ever been (the
+ *              high-water mark) and which handler took it there
+ * MICROCONTROLLER: LPC1768 (Cortex-M3)
+ * OPERATION:
+ *   stack_paint() must be the first call in main(), before any interrupt
+ *   is enabled. It writes STACK_PATTERN over the stack from its bottom
+ *   (STACK_TOP - STACK_SIZE) to just below the current SP. A word that
+ *   no longer holds the pattern has been used. stack_used() scans up from
+ *   the bottom to the first used word (about 2 cycles per unused word),
+ *   so it belongs in the main loop, not in a handler.
+ *   Handler probes: STACK_ISR_ENTER() records the stack depth the handler
+ *   found (the interrupted code, the 32-byte exception frame and the
+ *   handler's prologue). STACK_ISR_EXIT() extends the known high-water
+ *   mark down to the handler's SP and on through what its calls used,
+ *   stopping after STACK_GAP_WORDS untouched words in a row (a few
+ *   cycles when the stack did not get deeper). If the mark moved, this
+ *   handler set the deepest stack so far and its peak is updated; the
+ *   probe's own call counts towards it. A callee's array left partly
+ *   unwritten can hide words below the gap; stack_used() still finds
+ *   them.
+ *   STACK_SIZE must match Stack_Size in startup_LPC17xx.s (0x200 in the
+ *   Keil template). The top comes from vector 0, the initial MSP.
+ *   stack_dump() prints the figures on ITM stimulus port 0.
+ *   Under the host simulator the stack is the host's, the top is the
+ *   frame of stack_paint() and depths are x86-64 frames plus the
+ *   simulator's own dispatch frames: compare runs, not target bytes.
+ ******************************************************************************/
+
+#ifndef STACK_PAINT_H
+#define STACK_PAINT_H
+
+#include <LPC17xx.h>
+#include <stdint.h>
+
+/*=============================================================================
+ * CONFIGURATION
+ *============================================================================*/
+#ifndef STACK_SIZE
+#define STACK_SIZE          0x00000200UL    // Stack_Size in startup_LPC17xx.s
+#endif
+#ifndef STACK_TOP
+#define STACK_TOP()         (*(volatile uint32_t *)0x00000000)  // Initial MSP
+#define STACK_SP()          __get_MSP()
+#define STACK_PAINT_MARGIN  32              // Bytes left unpainted below SP
+#endif
+#define STACK_PATTERN       0xC5C5C5C5UL
+#define STACK_GAP_WORDS     8               // Untouched words that end a scan
+
+/*=============================================================================
+ * PER-HANDLER STATISTICS
+ *============================================================================*/
+typedef struct {
+    const char *name;
+    unsigned long count;
+    uint32_t entry_max;                 // Deepest stack found at entry (bytes)
+    uint32_t peak;                      // Deepest mark set while running, 0 = none
+} stack_isr_t;
+
+/*=============================================================================
+ * FUNCTION PROTOTYPES
+ *============================================================================*/
+void stack_paint(void);                         // First thing in main()
+uint32_t stack_used(void);                      // High-water mark in bytes
+uint32_t stack_free(void);                      // Bytes never touched
+int stack_overflowed(void);                     // Bottom word overwritten
+void stack_isr_reset(stack_isr_t *s, const char *name);
+void stack_isr_depth(stack_isr_t *s, uintptr_t sp);
+void stack_isr_exit(stack_isr_t *s, uintptr_t sp);
+void stack_dump(const stack_isr_t *const *isrs, unsigned int n);  // Over ITM
+
+/*=============================================================================
+ * HANDLER PROBES - first and last statements of the measured handler
+ *============================================================================*/
+#define STACK_ISR_ENTER(s)  stack_isr_depth((s), (uintptr_t)STACK_SP())
+#define STACK_ISR_EXIT(s)   stack_isr_exit((s), (uintptr_t)STACK_SP())
+
+#endif /* STACK_PAINT_H */